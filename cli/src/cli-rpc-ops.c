@@ -1044,6 +1044,75 @@ out:
         return ret;
 }
 
+/* per source subvolume lines below the row of node @node */
+static void
+gf_cli_print_rebalance_subvols (dict_t *dict, int node)
+{
+        char            key[256]  = {0,};
+        char           *name      = NULL;
+        char           *size_str  = NULL;
+        char           *rate_str  = NULL;
+        char            rate[64]  = {0,};
+        uint64_t        files     = 0;
+        uint64_t        size      = 0;
+        uint64_t        failures  = 0;
+        double          elapsed   = 0;
+        int32_t         count     = 0;
+        int32_t         i         = 0;
+        int             ret       = 0;
+
+        snprintf (key, 256, "subvol-count-%d", node);
+        ret = dict_get_int32 (dict, key, &count);
+        if (ret)
+                return;
+
+        for (i = 0; i < count; i++) {
+                snprintf (key, 256, "subvol-name-%d-%d", node, i);
+                ret = dict_get_str (dict, key, &name);
+                if (ret)
+                        break;
+
+                snprintf (key, 256, "subvol-files-%d-%d", node, i);
+                ret = dict_get_uint64 (dict, key, &files);
+                if (ret)
+                        gf_log (THIS->name, GF_LOG_TRACE,
+                                "failed to get subvolume file count");
+
+                snprintf (key, 256, "subvol-size-%d-%d", node, i);
+                ret = dict_get_uint64 (dict, key, &size);
+                if (ret)
+                        gf_log (THIS->name, GF_LOG_TRACE,
+                                "failed to get subvolume size of xfer");
+
+                snprintf (key, 256, "subvol-failures-%d-%d", node, i);
+                ret = dict_get_uint64 (dict, key, &failures);
+                if (ret)
+                        gf_log (THIS->name, GF_LOG_TRACE,
+                                "failed to get subvolume failures count");
+
+                snprintf (key, 256, "subvol-run-time-%d-%d", node, i);
+                ret = dict_get_double (dict, key, &elapsed);
+                if (ret)
+                        gf_log (THIS->name, GF_LOG_TRACE,
+                                "failed to get subvolume run-time");
+
+                size_str = gf_uint64_2human_readable (size);
+                rate_str = NULL;
+                if (elapsed > 0)
+                        rate_str = gf_uint64_2human_readable
+                                        ((uint64_t) (size / elapsed));
+                snprintf (rate, sizeof (rate), "%s/s",
+                          rate_str ? rate_str : "0");
+
+                cli_out ("%40s %16"PRIu64 " %13s" " %13s" " %13"PRIu64
+                         " %14s %16.2f", name, files, size_str ? size_str : "",
+                         "", failures, rate, elapsed);
+
+                GF_FREE (size_str);
+                GF_FREE (rate_str);
+        }
+}
+
 int
 gf_cli_defrag_volume_cbk (struct rpc_req *req, struct iovec *iov,
                              int count, void *myframe)
@@ -1250,6 +1319,8 @@ gf_cli_defrag_volume_cbk (struct rpc_req *req, struct iovec *iov,
                          failures, status, elapsed);
                 GF_FREE(size_str);
 
+                gf_cli_print_rebalance_subvols (dict, i);
+
                 i++;
         } while (i <= counter);
 
@@ -1645,6 +1716,8 @@ xml_output:
                          failures, status, elapsed);
                 GF_FREE(size_str);
 
+                gf_cli_print_rebalance_subvols (dict, i);
+
                 i++;
         } while (i <= counter);
 
@@ -5577,6 +5650,9 @@ cmd_heal_volume_brick_out (dict_t *dict, int brick)
         uint64_t        i = 0;
         uint32_t        time = 0;
         char            timestr[32] = {0};
+        uint64_t        healed = 0;
+        double          elapsed = 0;
+        int32_t         running = 0;
 
         snprintf (key, sizeof key, "%d-hostname", brick);
         ret = dict_get_str (dict, key, &hostname);
@@ -5594,6 +5670,18 @@ cmd_heal_volume_brick_out (dict_t *dict, int brick)
         ret = dict_get_str (dict, key, &status);
         if (status && strlen (status))
                 cli_out ("Status: %s", status);
+        snprintf (key, sizeof key, "%d-heal-count", brick);
+        ret = dict_get_uint64 (dict, key, &healed);
+        if (!ret) {
+                snprintf (key, sizeof key, "%d-heal-time", brick);
+                ret = dict_get_double (dict, key, &elapsed);
+                snprintf (key, sizeof key, "%d-heal-running", brick);
+                ret = dict_get_int32 (dict, key, &running);
+                cli_out ("Heal rate: %.2f entries/sec (%"PRIu64" entries in "
+                         "%.0f secs, %s crawl)",
+                         (elapsed > 0) ? healed / elapsed : 0, healed,
+                         elapsed, running ? "current" : "last");
+        }
         for (i = 0; i < num_entries; i++) {
                 snprintf (key, sizeof key, "%d-%"PRIu64, brick, i);
                 ret = dict_get_str (dict, key, &path);
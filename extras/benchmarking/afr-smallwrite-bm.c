@@ -0,0 +1,232 @@
+/*
+   Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+
+/* afr-smallwrite-bm: IOPS of small random writes from a number of threads,
+ * meant to be run on the mount of a replicated volume, where every write
+ * is an AFR transaction with its changelog pre-op and post-op:
+ *
+ *   file-per-thread - each thread writes a file of its own
+ *   fd-per-thread   - the threads write one file, each through an fd of
+ *                     its own
+ *   shared-fd       - the threads write one file through the same fd
+ *
+ * Every write is O_DSYNC, so that write-behind does not hide the
+ * transactions. The counts of fxattrop in 'gluster volume profile' tell
+ * how many changelog updates the writes cost.
+ *
+ * usage: afr-smallwrite-bm <directory> [threads] [seconds] [write-size]
+ *                          [file-size-in-MB]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+enum {
+        BM_FILE_PER_THREAD,
+        BM_FD_PER_THREAD,
+        BM_SHARED_FD,
+};
+
+struct bm_thread {
+        pthread_t       thread;
+        int             fd;
+        unsigned int    seed;
+        uint64_t        writes;
+        int             error;
+};
+
+static const char      *dir;
+static size_t           wsize = 4096;
+static off_t            fsize = 64 << 20;
+static volatile int     stop;
+
+
+static uint64_t
+tv_us (struct timeval *tv)
+{
+        return ((uint64_t) tv->tv_sec) * 1000000 + tv->tv_usec;
+}
+
+
+static void *
+bm_worker (void *data)
+{
+        struct bm_thread *bt = data;
+        char             *buf = NULL;
+        off_t             offset = 0;
+
+        buf = malloc (wsize);
+        if (!buf) {
+                bt->error = 1;
+                return NULL;
+        }
+        memset (buf, 'a' + (bt->seed % 26), wsize);
+
+        while (!stop) {
+                offset = (rand_r (&bt->seed) % (fsize / wsize)) * wsize;
+                if (pwrite (bt->fd, buf, wsize, offset) != wsize) {
+                        perror ("pwrite");
+                        bt->error = 1;
+                        break;
+                }
+                bt->writes++;
+        }
+
+        free (buf);
+        return NULL;
+}
+
+
+static int
+bm_open (int n)
+{
+        char path[PATH_MAX];
+        int  fd = -1;
+
+        snprintf (path, sizeof (path), "%s/afr-smallwrite-bm.%d", dir, n);
+
+        fd = open (path, O_RDWR | O_CREAT | O_DSYNC, 0600);
+        if (fd == -1) {
+                perror (path);
+                return -1;
+        }
+
+        if (ftruncate (fd, fsize)) {
+                perror ("ftruncate");
+                close (fd);
+                return -1;
+        }
+
+        return fd;
+}
+
+
+static int
+bm_run (const char *how, int mode, int nthreads, int seconds)
+{
+        struct bm_thread *threads = NULL;
+        struct timeval    start = {0, };
+        struct timeval    end = {0, };
+        uint64_t          writes = 0;
+        uint64_t          usecs = 0;
+        int               i = 0;
+        int               ret = -1;
+
+        threads = calloc (nthreads, sizeof (*threads));
+        if (!threads)
+                return -1;
+
+        for (i = 0; i < nthreads; i++) {
+                threads[i].fd = -1;
+                threads[i].seed = i + 1;
+        }
+
+        for (i = 0; i < nthreads; i++) {
+                if (mode == BM_SHARED_FD && i > 0)
+                        threads[i].fd = threads[0].fd;
+                else
+                        threads[i].fd = bm_open ((mode == BM_FILE_PER_THREAD) ?
+                                                 i : 0);
+                if (threads[i].fd == -1)
+                        goto out;
+        }
+
+        stop = 0;
+        gettimeofday (&start, NULL);
+        for (i = 0; i < nthreads; i++)
+                pthread_create (&threads[i].thread, NULL, bm_worker,
+                                &threads[i]);
+        sleep (seconds);
+        stop = 1;
+        for (i = 0; i < nthreads; i++) {
+                pthread_join (threads[i].thread, NULL);
+                writes += threads[i].writes;
+                if (threads[i].error)
+                        goto out;
+        }
+        gettimeofday (&end, NULL);
+
+        usecs = tv_us (&end) - tv_us (&start);
+
+        printf ("%-16s %8d %12.1f %14.1f\n", how, nthreads,
+                writes / (usecs / 1e6),
+                writes ? (double) usecs * nthreads / writes : 0);
+        ret = 0;
+out:
+        for (i = 0; i < nthreads; i++) {
+                if (threads[i].fd == -1)
+                        continue;
+                if (mode == BM_SHARED_FD && i > 0)
+                        continue;
+                close (threads[i].fd);
+        }
+        free (threads);
+
+        return ret;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        char  path[PATH_MAX];
+        int   nthreads = 8;
+        int   seconds = 10;
+        int   i = 0;
+        int   ret = 1;
+
+        if (argc < 2) {
+                fprintf (stderr, "usage: %s <directory> [threads] [seconds] "
+                         "[write-size] [file-size-in-MB]\n", argv[0]);
+                return 1;
+        }
+
+        dir = argv[1];
+        if (argc > 2)
+                nthreads = atoi (argv[2]);
+        if (argc > 3)
+                seconds = atoi (argv[3]);
+        if (argc > 4)
+                wsize = atoll (argv[4]);
+        if (argc > 5)
+                fsize = ((off_t) atoll (argv[5])) << 20;
+
+        if (nthreads < 1 || !wsize || fsize < wsize) {
+                fprintf (stderr, "threads must be at least 1 and write-size "
+                         "between 1 and file-size\n");
+                return 1;
+        }
+
+        printf ("%-16s %8s %12s %14s\n", "test", "threads", "IOPS",
+                "usecs/write");
+
+        if (bm_run ("file-per-thread", BM_FILE_PER_THREAD, nthreads,
+                    seconds) ||
+            bm_run ("fd-per-thread", BM_FD_PER_THREAD, nthreads, seconds) ||
+            bm_run ("shared-fd", BM_SHARED_FD, nthreads, seconds))
+                goto out;
+
+        ret = 0;
+out:
+        for (i = 0; i < nthreads; i++) {
+                snprintf (path, sizeof (path), "%s/afr-smallwrite-bm.%d",
+                          dir, i);
+                unlink (path);
+        }
+
+        return ret;
+}
@@ -0,0 +1,161 @@
+/*
+   Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+
+/* dht-layout-bm: measures dht_layout_search throughput against the number
+ * of subvolumes in a directory layout, with the layout scanned linearly
+ * and bisected through its search index.
+ *
+ * usage: dht-layout-bm [max-subvolumes] [lookups]
+ */
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "glusterfs.h"
+#include "globals.h"
+#include "xlator.h"
+#include "dht-common.h"
+
+#define BM_NAMES 4096
+
+
+static uint64_t
+tv_us (struct timeval *tv)
+{
+        return ((uint64_t) tv->tv_sec) * 1000000 + tv->tv_usec;
+}
+
+
+static void
+bm_entry_swap (dht_layout_t *layout, int i, int j)
+{
+        uint32_t  start = layout->list[i].start;
+        uint32_t  stop = layout->list[i].stop;
+        xlator_t *xlator = layout->list[i].xlator;
+
+        layout->list[i].start  = layout->list[j].start;
+        layout->list[i].stop   = layout->list[j].stop;
+        layout->list[i].xlator = layout->list[j].xlator;
+
+        layout->list[j].start  = start;
+        layout->list[j].stop   = stop;
+        layout->list[j].xlator = xlator;
+}
+
+
+static double
+bm_run (xlator_t *this, dht_layout_t *layout, char **names, long lookups)
+{
+        struct timeval  start = {0, };
+        struct timeval  stop = {0, };
+        long            i = 0;
+        long            misses = 0;
+
+        gettimeofday (&start, NULL);
+        for (i = 0; i < lookups; i++) {
+                if (!dht_layout_search (this, layout, names[i % BM_NAMES]))
+                        misses++;
+        }
+        gettimeofday (&stop, NULL);
+
+        if (misses)
+                printf ("%ld lookups found no subvolume\n", misses);
+
+        return (double)(tv_us (&stop) - tv_us (&start)) * 1000 / lookups;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        glusterfs_ctx_t  *ctx = NULL;
+        xlator_t          this = {0, };
+        xlator_t         *subvols = NULL;
+        dht_layout_t     *layout = NULL;
+        char             *names[BM_NAMES];
+        uint32_t          chunk = 0;
+        int               max = 128;
+        long              lookups = 1000000;
+        double            linear = 0;
+        double            indexed = 0;
+        int               cnt = 0;
+        int               i = 0;
+
+        if (argc > 1)
+                max = atoi (argv[1]);
+        if (argc > 2)
+                lookups = atol (argv[2]);
+
+        ctx = glusterfs_ctx_new ();
+        if (!ctx || glusterfs_globals_init (ctx))
+                return 1;
+        THIS->ctx = ctx;
+
+        this.name = "dht-layout-bm";
+        this.ctx = ctx;
+
+        subvols = calloc (max, sizeof (*subvols));
+        if (!subvols)
+                return 1;
+
+        srandom (getpid ());
+
+        /* every eighth name looks like an rsync temporary file */
+        for (i = 0; i < BM_NAMES; i++) {
+                if (i % 8)
+                        gf_asprintf (&names[i], "file-%08lx", random ());
+                else
+                        gf_asprintf (&names[i], ".file-%08lx.%06lx",
+                                     random (), random () % 1000000);
+        }
+
+        printf ("%8s %14s %14s\n", "subvols", "linear ns/op", "indexed ns/op");
+
+        for (cnt = 1; cnt <= max; cnt = (cnt < 8) ? cnt * 2 : cnt + 8) {
+                layout = dht_layout_new (&this, cnt);
+                if (!layout)
+                        return 1;
+
+                chunk = 0xffffffff / cnt;
+                for (i = 0; i < cnt; i++) {
+                        layout->list[i].xlator = &subvols[i];
+                        layout->list[i].start = i * chunk;
+                        layout->list[i].stop = (i == cnt - 1) ? 0xffffffff
+                                : layout->list[i].start + chunk - 1;
+                }
+
+                /* ->list is in subvolume order, not in hash order */
+                for (i = cnt - 1; i > 0; i--)
+                        bm_entry_swap (layout, i, random () % (i + 1));
+
+                layout->search_cnt = 0;
+                linear = bm_run (&this, layout, names, lookups);
+
+                dht_layout_search_prepare (layout);
+                indexed = bm_run (&this, layout, names, lookups);
+
+                printf ("%8d %14.1f %14.1f\n", cnt, linear, indexed);
+
+                GF_FREE (layout);
+        }
+
+        for (i = 0; i < BM_NAMES; i++)
+                GF_FREE (names[i]);
+        free (subvols);
+
+        return 0;
+}
@@ -0,0 +1,235 @@
+/*
+   Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+
+/* inode-table-bm: throughput of one inode table shared by 1, 2, 4 ... up
+ * to the given number of threads, for:
+ *
+ *   resolve  - inode_grep by name and inode_find by gfid, then unref of
+ *              both, the way the server resolves a fop. Run with the
+ *              inodes idle (on the lru list) and held (in use, e.g. open)
+ *   churn    - inode_new, inode_link, inode_lookup, inode_forget and
+ *              inode_unref of a new name, against a small lru limit, the
+ *              way a create-heavy load goes through the fuse bridge
+ *
+ * usage: inode-table-bm [max-threads] [inodes] [ops-per-thread]
+ */
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "glusterfs.h"
+#include "globals.h"
+#include "xlator.h"
+#include "inode.h"
+
+#define BM_CHURN_LRU    1024
+
+struct bm_thread {
+        pthread_t       thread;
+        int             id;
+        unsigned int    seed;
+};
+
+static inode_table_t   *table;
+static char           **names;
+static uuid_t          *gfids;
+static long             ninodes = 100000;
+static long             ops = 1000000;
+static int              churn;
+
+
+static uint64_t
+tv_us (struct timeval *tv)
+{
+        return ((uint64_t) tv->tv_sec) * 1000000 + tv->tv_usec;
+}
+
+
+static void *
+bm_resolve (struct bm_thread *bt)
+{
+        inode_t *parent = NULL;
+        inode_t *inode = NULL;
+        long     i = 0;
+        long     n = 0;
+
+        for (i = 0; i < ops; i++) {
+                n = rand_r (&bt->seed) % ninodes;
+
+                parent = inode_grep (table, table->root, names[n]);
+                inode = inode_find (table, gfids[n]);
+                if (!parent || !inode) {
+                        fprintf (stderr, "inode %ld not found\n", n);
+                        exit (1);
+                }
+
+                inode_unref (inode);
+                inode_unref (parent);
+        }
+
+        return NULL;
+}
+
+
+static void *
+bm_churn (struct bm_thread *bt)
+{
+        struct iatt  iatt = {0, };
+        inode_t     *inode = NULL;
+        inode_t     *linked = NULL;
+        char         name[64];
+        long         i = 0;
+
+        iatt.ia_type = IA_IFREG;
+
+        for (i = 0; i < ops; i++) {
+                snprintf (name, sizeof (name), "churn-%d-%ld", bt->id, i);
+                uuid_generate (iatt.ia_gfid);
+
+                inode = inode_new (table);
+                linked = inode_link (inode, table->root, name, &iatt);
+                inode_lookup (linked);
+                inode_unref (inode);
+
+                inode_unlink (linked, table->root, name);
+                inode_forget (linked, 1);
+                inode_unref (linked);
+        }
+
+        return NULL;
+}
+
+
+static void *
+bm_worker (void *data)
+{
+        struct bm_thread *bt = data;
+
+        if (churn)
+                return bm_churn (bt);
+
+        return bm_resolve (bt);
+}
+
+
+static void
+bm_run (const char *how, int nthreads)
+{
+        struct bm_thread *threads = NULL;
+        struct timeval    start = {0, };
+        struct timeval    stop = {0, };
+        uint64_t          total = 0;
+        int               i = 0;
+
+        threads = calloc (nthreads, sizeof (*threads));
+        if (!threads)
+                exit (1);
+
+        gettimeofday (&start, NULL);
+        for (i = 0; i < nthreads; i++) {
+                threads[i].id = i;
+                threads[i].seed = i + 1;
+                pthread_create (&threads[i].thread, NULL, bm_worker,
+                                &threads[i]);
+        }
+        for (i = 0; i < nthreads; i++)
+                pthread_join (threads[i].thread, NULL);
+        gettimeofday (&stop, NULL);
+
+        total = (uint64_t) nthreads * ops;
+
+        printf ("%-14s %8d %14.2f %12.1f\n", how, nthreads,
+                (double) total / (tv_us (&stop) - tv_us (&start)),
+                (double)(tv_us (&stop) - tv_us (&start)) * 1000 / total);
+
+        free (threads);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        glusterfs_ctx_t    *ctx = NULL;
+        glusterfs_graph_t   graph = {{0, }, };
+        xlator_t            xl = {0, };
+        struct iatt         iatt = {0, };
+        inode_t           **held = NULL;
+        inode_t            *inode = NULL;
+        inode_t            *linked = NULL;
+        char                name[64];
+        int                 max_threads = 8;
+        int                 nthreads = 0;
+        long                i = 0;
+
+        if (argc > 1)
+                max_threads = atoi (argv[1]);
+        if (argc > 2)
+                ninodes = atol (argv[2]);
+        if (argc > 3)
+                ops = atol (argv[3]);
+
+        ctx = glusterfs_ctx_new ();
+        if (!ctx || glusterfs_globals_init (ctx))
+                return 1;
+        THIS->ctx = ctx;
+
+        graph.xl_count = 1;
+        xl.name = "inode-table-bm";
+        xl.ctx = ctx;
+        xl.graph = &graph;
+
+        table = inode_table_new (ninodes * 2, &xl);
+        names = calloc (ninodes, sizeof (*names));
+        gfids = calloc (ninodes, sizeof (*gfids));
+        held = calloc (ninodes, sizeof (*held));
+        if (!table || !names || !gfids || !held)
+                return 1;
+
+        iatt.ia_type = IA_IFREG;
+        for (i = 0; i < ninodes; i++) {
+                snprintf (name, sizeof (name), "file-%ld", i);
+                names[i] = strdup (name);
+                uuid_generate (gfids[i]);
+                uuid_copy (iatt.ia_gfid, gfids[i]);
+
+                inode = inode_new (table);
+                linked = inode_link (inode, table->root, names[i], &iatt);
+                inode_lookup (linked);
+                inode_unref (inode);
+                held[i] = linked;
+        }
+
+        printf ("%-14s %8s %14s %12s\n", "test", "threads", "Mops/s",
+                "ns/op");
+
+        /* in use, the way inodes with open fds or fops in flight are */
+        for (nthreads = 1; nthreads <= max_threads; nthreads *= 2)
+                bm_run ("resolve-held", nthreads);
+
+        for (i = 0; i < ninodes; i++)
+                inode_unref (held[i]);
+
+        for (nthreads = 1; nthreads <= max_threads; nthreads *= 2)
+                bm_run ("resolve-idle", nthreads);
+
+        churn = 1;
+        table->lru_limit = BM_CHURN_LRU;
+        for (nthreads = 1; nthreads <= max_threads; nthreads *= 2)
+                bm_run ("churn", nthreads);
+
+        return 0;
+}
@@ -0,0 +1,237 @@
+/*
+   Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+
+/* locks-bm: throughput of fcntl lock and unlock pairs on one file against
+ * the number of posix locks already held on it, meant to be run on a
+ * glusterfs mount, where every call goes to the locks translator:
+ *
+ *   held     - another process holds 1, 10, 100 ... up to max-held one
+ *              byte write locks on the file, none of which the measured
+ *              locks overlap
+ *   waiting  - the same, with a number of processes also blocked in
+ *              F_SETLKW behind the held locks, which every unlock has to
+ *              consider waking
+ *
+ * usage: locks-bm <directory> [max-held] [waiters] [ops]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define BM_SPREAD       1024    /* distinct ranges the measured locks use */
+
+static char     path[PATH_MAX];
+static long     ops = 10000;
+
+
+static uint64_t
+tv_us (struct timeval *tv)
+{
+        return ((uint64_t) tv->tv_sec) * 1000000 + tv->tv_usec;
+}
+
+
+static int
+bm_lock (int fd, int cmd, short type, off_t start)
+{
+        struct flock fl = {0, };
+
+        fl.l_type = type;
+        fl.l_whence = SEEK_SET;
+        fl.l_start = start;
+        fl.l_len = 1;
+
+        return fcntl (fd, cmd, &fl);
+}
+
+
+/* takes the locks in a child and tells the parent once they are held, the
+ * child keeps them until it is killed */
+static pid_t
+bm_hold (long held, int ready)
+{
+        pid_t pid = 0;
+        long  i = 0;
+        int   fd = -1;
+
+        pid = fork ();
+        if (pid)
+                return pid;
+
+        fd = open (path, O_RDWR);
+        if (fd == -1) {
+                perror (path);
+                _exit (1);
+        }
+
+        for (i = 0; i < held; i++) {
+                if (bm_lock (fd, F_SETLK, F_WRLCK, i * 2)) {
+                        perror ("fcntl");
+                        _exit (1);
+                }
+        }
+
+        if (write (ready, "", 1) != 1)
+                _exit (1);
+
+        for (;;)
+                pause ();
+}
+
+
+static pid_t
+bm_wait (long n)
+{
+        pid_t pid = 0;
+        int   fd = -1;
+
+        pid = fork ();
+        if (pid)
+                return pid;
+
+        fd = open (path, O_RDWR);
+        if (fd == -1) {
+                perror (path);
+                _exit (1);
+        }
+
+        bm_lock (fd, F_SETLKW, F_WRLCK, n * 2);
+
+        for (;;)
+                pause ();
+}
+
+
+static int
+bm_run (const char *how, int fd, long held, int waiters)
+{
+        struct timeval  start = {0, };
+        struct timeval  end = {0, };
+        pid_t          *pids = NULL;
+        uint64_t        usecs = 0;
+        off_t           offset = 0;
+        int             ready[2] = {-1, -1};
+        char            c = 0;
+        long            i = 0;
+        int             ret = -1;
+
+        pids = calloc (waiters + 1, sizeof (*pids));
+        if (!pids || pipe (ready)) {
+                perror ("locks-bm");
+                goto out;
+        }
+
+        pids[0] = bm_hold (held, ready[1]);
+        if ((pids[0] == -1) || (read (ready[0], &c, 1) != 1)) {
+                fprintf (stderr, "could not take the held locks\n");
+                goto out;
+        }
+
+        for (i = 0; i < waiters; i++)
+                pids[i + 1] = bm_wait (i % held);
+
+        /* no way to tell when the waiters got blocked */
+        if (waiters)
+                sleep (1);
+
+        gettimeofday (&start, NULL);
+        for (i = 0; i < ops; i++) {
+                offset = (held + (i % BM_SPREAD)) * 2;
+
+                if (bm_lock (fd, F_SETLK, F_WRLCK, offset) ||
+                    bm_lock (fd, F_SETLK, F_UNLCK, offset)) {
+                        perror ("fcntl");
+                        goto out;
+                }
+        }
+        gettimeofday (&end, NULL);
+
+        usecs = tv_us (&end) - tv_us (&start);
+
+        printf ("%-8s %8ld %8d %12.1f %14.1f\n", how, held, waiters,
+                ops / (usecs / 1e6), (double) usecs / ops);
+        ret = 0;
+out:
+        for (i = 0; pids && i <= waiters; i++) {
+                if (pids[i] <= 0)
+                        continue;
+                kill (pids[i], SIGKILL);
+                waitpid (pids[i], NULL, 0);
+        }
+        if (ready[0] != -1) {
+                close (ready[0]);
+                close (ready[1]);
+        }
+        free (pids);
+
+        return ret;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        long  max_held = 10000;
+        long  held = 0;
+        int   waiters = 64;
+        int   fd = -1;
+        int   ret = 1;
+
+        if (argc < 2) {
+                fprintf (stderr, "usage: %s <directory> [max-held] [waiters] "
+                         "[ops]\n", argv[0]);
+                return 1;
+        }
+
+        if (argc > 2)
+                max_held = atol (argv[2]);
+        if (argc > 3)
+                waiters = atoi (argv[3]);
+        if (argc > 4)
+                ops = atol (argv[4]);
+
+        if (max_held < 1 || waiters < 0 || ops < 1) {
+                fprintf (stderr, "max-held and ops must be at least 1\n");
+                return 1;
+        }
+
+        snprintf (path, sizeof (path), "%s/locks-bm.dat", argv[1]);
+
+        fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd == -1) {
+                perror (path);
+                return 1;
+        }
+
+        printf ("%-8s %8s %8s %12s %14s\n", "test", "held", "waiters",
+                "lk+unlk/s", "usecs/lk+unlk");
+
+        for (held = 1; held <= max_held; held *= 10) {
+                if (bm_run ("held", fd, held, 0))
+                        goto out;
+                if (waiters && bm_run ("waiting", fd, held, waiters))
+                        goto out;
+        }
+
+        ret = 0;
+out:
+        close (fd);
+        unlink (path);
+
+        return ret;
+}
@@ -0,0 +1,126 @@
+/*
+   Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+
+/* mem-pool-bm: measures mem_get/mem_put throughput of one shared pool with
+ * a given number of threads hammering it, the way frames and dicts are
+ * allocated by the epoll and io-threads workers.
+ *
+ * usage: mem-pool-bm [threads] [iterations-per-thread] [objects-held]
+ */
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "glusterfs.h"
+#include "globals.h"
+#include "mem-pool.h"
+
+struct bm_obj {
+        char pad[256];
+};
+
+static struct mem_pool *bm_pool;
+static long             iterations = 1000000;
+static int              held = 8;
+
+
+static uint64_t
+tv_us (struct timeval *tv)
+{
+        return ((uint64_t) tv->tv_sec) * 1000000 + tv->tv_usec;
+}
+
+
+static void *
+bm_worker (void *data)
+{
+        struct bm_obj **objs = NULL;
+        long            i = 0;
+        int             j = 0;
+
+        objs = calloc (held, sizeof (*objs));
+        if (!objs)
+                return NULL;
+
+        for (i = 0; i < iterations; i++) {
+                for (j = 0; j < held; j++) {
+                        objs[j] = mem_get (bm_pool);
+                        objs[j]->pad[0] = j;
+                }
+                for (j = 0; j < held; j++)
+                        mem_put (objs[j]);
+        }
+
+        free (objs);
+
+        return NULL;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        glusterfs_ctx_t  *ctx = NULL;
+        pthread_t        *threads = NULL;
+        struct timeval    start = {0, };
+        struct timeval    stop = {0, };
+        int               nthreads = 4;
+        int               hot_count = 0;
+        int               cold_count = 0;
+        uint64_t          alloc_count = 0;
+        uint64_t          ops = 0;
+        int               i = 0;
+
+        if (argc > 1)
+                nthreads = atoi (argv[1]);
+        if (argc > 2)
+                iterations = atol (argv[2]);
+        if (argc > 3)
+                held = atoi (argv[3]);
+
+        ctx = glusterfs_ctx_new ();
+        if (!ctx || glusterfs_globals_init (ctx))
+                return 1;
+        THIS->ctx = ctx;
+
+        bm_pool = mem_pool_new (struct bm_obj, 4096);
+        threads = calloc (nthreads, sizeof (*threads));
+        if (!bm_pool || !threads)
+                return 1;
+
+        gettimeofday (&start, NULL);
+        for (i = 0; i < nthreads; i++)
+                pthread_create (&threads[i], NULL, bm_worker, NULL);
+        for (i = 0; i < nthreads; i++)
+                pthread_join (threads[i], NULL);
+        gettimeofday (&stop, NULL);
+
+        ops = (uint64_t) nthreads * iterations * held;
+        mem_pool_counts (bm_pool, &hot_count, &cold_count, &alloc_count);
+
+        printf ("%d threads, %"PRIu64" get+put pairs, %.1f ns/pair, "
+                "%.2f Mpairs/s\n", nthreads, ops,
+                (double)(tv_us (&stop) - tv_us (&start)) * 1000 / ops,
+                (double) ops / (tv_us (&stop) - tv_us (&start)));
+        printf ("pool: hot %d, cold %d, allocs %"PRIu64", misses %"PRIu64"\n",
+                hot_count, cold_count, alloc_count, bm_pool->pool_misses);
+
+        mem_pool_destroy (bm_pool);
+        free (threads);
+
+        return 0;
+}
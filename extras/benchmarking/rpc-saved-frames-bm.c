@@ -0,0 +1,192 @@
+/*
+   Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+
+/* rpc-saved-frames-bm: cost of matching a reply to its saved frame in
+ * rpc-clnt with N calls outstanding on one connection. Each reply picks
+ * an outstanding xid, takes its frame out and saves a new call, so N
+ * stays constant. Replies come back either in the order the calls were
+ * sent (fifo) or in random order (random). Two lookups are compared:
+ *
+ *   list  - walking saved_frames->sf, as rpc-clnt used to
+ *   hash  - __saved_frame_get (), through the xid index
+ *
+ * usage: rpc-saved-frames-bm [replies] [outstanding...]
+ */
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "glusterfs.h"
+#include "globals.h"
+#include "mem-pool.h"
+#include "rpc-clnt.h"
+#include "protocol-common.h"
+
+struct saved_frame *
+__saved_frames_put (struct saved_frames *frames, void *frame,
+                    struct rpc_req *rpcreq);
+struct saved_frame *
+__saved_frame_get (struct saved_frames *frames, int64_t callid);
+struct saved_frames *
+saved_frames_new (void);
+
+static rpc_clnt_prog_t bm_prog = {
+        .progname = "bm",
+        .prognum  = GLUSTER_FOP_PROGRAM,
+        .progver  = GLUSTER_FOP_VERSION,
+};
+
+
+static uint64_t
+tv_us (struct timeval *tv)
+{
+        return ((uint64_t) tv->tv_sec) * 1000000 + tv->tv_usec;
+}
+
+
+static struct saved_frame *
+bm_list_get (struct saved_frames *frames, uint32_t xid)
+{
+        struct saved_frame *tmp = NULL;
+
+        list_for_each_entry (tmp, &frames->sf.list, list) {
+                if (tmp->rpcreq->xid == xid) {
+                        list_del_init (&tmp->list);
+                        list_del_init (&tmp->hash);
+                        frames->count--;
+                        return tmp;
+                }
+        }
+
+        return NULL;
+}
+
+
+static int
+bm_run (struct rpc_clnt *clnt, int outstanding, int replies, int hash,
+        int random_order)
+{
+        struct saved_frames *frames  = NULL;
+        struct saved_frame  *sframe  = NULL;
+        struct rpc_req      *reqs    = NULL;
+        uint32_t            *pending = NULL;
+        struct timeval       start   = {0,};
+        struct timeval       end     = {0,};
+        uint32_t             xid     = 0;
+        int                  head    = 0;
+        int                  idx     = 0;
+        int                  i       = 0;
+
+        frames = saved_frames_new ();
+        reqs = calloc (outstanding + replies, sizeof (*reqs));
+        pending = calloc (outstanding, sizeof (*pending));
+        if (!frames || !reqs || !pending)
+                return -1;
+
+        for (i = 0; i < outstanding + replies; i++) {
+                reqs[i].conn    = &clnt->conn;
+                reqs[i].xid     = i + 1;
+                reqs[i].prog    = &bm_prog;
+                reqs[i].procnum = GFS3_OP_WRITE;
+        }
+
+        for (i = 0; i < outstanding; i++) {
+                __saved_frames_put (frames, NULL, &reqs[xid]);
+                pending[i] = reqs[xid++].xid;
+        }
+
+        srandom (outstanding);
+        gettimeofday (&start, NULL);
+
+        for (i = 0; i < replies; i++) {
+                /* pending[] is a ring in sending order for fifo */
+                idx = random_order ? random () % outstanding : head;
+                head = (head + 1) % outstanding;
+
+                if (hash)
+                        sframe = __saved_frame_get (frames, pending[idx]);
+                else
+                        sframe = bm_list_get (frames, pending[idx]);
+                if (!sframe) {
+                        fprintf (stderr, "xid %u not found\n", pending[idx]);
+                        return -1;
+                }
+                mem_put (sframe);
+
+                __saved_frames_put (frames, NULL, &reqs[xid]);
+                pending[idx] = reqs[xid++].xid;
+        }
+
+        gettimeofday (&end, NULL);
+
+        printf ("%-6s %-8s %10d %14.1f\n", hash ? "hash" : "list",
+                random_order ? "random" : "fifo", outstanding,
+                (tv_us (&end) - tv_us (&start)) * 1000.0 / replies);
+
+        while ((sframe = list_entry (frames->sf.list.next, struct saved_frame,
+                                     list)) != &frames->sf) {
+                list_del_init (&sframe->list);
+                mem_put (sframe);
+        }
+        GF_FREE (frames->hash);
+        GF_FREE (frames);
+        free (reqs);
+        free (pending);
+
+        return 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        glusterfs_ctx_t *ctx         = NULL;
+        struct rpc_clnt  clnt;
+        int              defaults[]  = { 1000, 10000, 100000 };
+        int              replies     = 10000;
+        int              outstanding = 0;
+        int              i           = 0;
+        int              j           = 0;
+
+        ctx = glusterfs_ctx_new ();
+        if (!ctx || glusterfs_globals_init (ctx))
+                return 1;
+        THIS->ctx = ctx;
+
+        if (argc > 1)
+                replies = atoi (argv[1]);
+
+        memset (&clnt, 0, sizeof (clnt));
+        clnt.conn.rpc_clnt = &clnt;
+        clnt.saved_frames_pool = mem_pool_new (struct saved_frame, 1024);
+        if (!clnt.saved_frames_pool)
+                return 1;
+
+        printf ("%-6s %-8s %10s %14s\n", "lookup", "order", "outstanding",
+                "ns/reply");
+
+        for (i = 0; i < ((argc > 2) ? argc - 2 : 3); i++) {
+                outstanding = (argc > 2) ? atoi (argv[i + 2]) : defaults[i];
+
+                for (j = 0; j < 4; j++) {
+                        if (bm_run (&clnt, outstanding, replies, j / 2, j % 2))
+                                return 1;
+                }
+        }
+
+        return 0;
+}
@@ -0,0 +1,296 @@
+/*
+   Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+
+/* sparse-migrate-bm: copies a sparse image the way rebalance migrates a
+ * file with holes, on the local filesystem, and reports time, bytes read
+ * and writes issued for:
+ *
+ *   sector  - 128KB reads, byte-wise zero check of each 512 byte sector
+ *             and one write per run of data sectors (the old behaviour)
+ *   extent  - 128KB reads, mem_0filled () over whole buffers and sectors,
+ *             one writev per data extent, zero runs under 4KB written
+ *   seek    - as extent, reading only the extents SEEK_DATA/SEEK_HOLE
+ *             report
+ *
+ * The image gets a 64KB extent of data every 16MB.
+ *
+ * usage: sparse-migrate-bm [size-in-GB] [directory]
+ */
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+
+#include "glusterfs.h"
+#include "common-utils.h"
+
+#define BM_SECTOR       512
+#define BM_BLKSIZE      (128 * 1024)
+#define BM_HOLE_MIN     (4 * 1024)
+#define BM_EXTENT       (64 * 1024)
+#define BM_STRIDE       (16 * 1024 * 1024)
+
+struct bm_stats {
+        uint64_t read_bytes;
+        uint64_t writes;
+};
+
+
+static uint64_t
+tv_us (struct timeval *tv)
+{
+        return ((uint64_t) tv->tv_sec) * 1000000 + tv->tv_usec;
+}
+
+
+static int
+bm_sector_0filled (const char *buf, size_t size)
+{
+        size_t i = 0;
+
+        for (i = 0; i < size; i++) {
+                if (buf[i])
+                        return 1;
+        }
+
+        return 0;
+}
+
+
+static int
+bm_write (int fd, char *buf, size_t len, off_t offset, struct bm_stats *st)
+{
+        st->writes++;
+        return (pwrite (fd, buf, len, offset) == len) ? 0 : -1;
+}
+
+
+/* one write per run of non-zero sectors */
+static int
+bm_copy_sector (int dst, char *buf, size_t len, off_t offset,
+                struct bm_stats *st)
+{
+        size_t  idx   = 0;
+        size_t  start = 0;
+        int     data  = 0;
+
+        for (idx = 0; idx < len; idx += BM_SECTOR) {
+                if (bm_sector_0filled (buf + idx, BM_SECTOR)) {
+                        if (!data)
+                                start = idx;
+                        data = 1;
+                        continue;
+                }
+                if (data && bm_write (dst, buf + start, idx - start,
+                                      offset + start, st))
+                        return -1;
+                data = 0;
+        }
+
+        if (data && bm_write (dst, buf + start, len - start, offset + start,
+                              st))
+                return -1;
+
+        return 0;
+}
+
+
+/* one write per extent, zero runs shorter than BM_HOLE_MIN included */
+static int
+bm_copy_extent (int dst, char *buf, size_t len, off_t offset,
+                struct bm_stats *st)
+{
+        size_t  idx        = 0;
+        size_t  blk        = 0;
+        off_t   data_start = -1;
+        off_t   data_end   = 0;
+        size_t  zero_run   = 0;
+
+        if (!mem_0filled (buf, len))
+                return 0;
+
+        for (idx = 0; idx < len; idx += blk) {
+                blk = min (BM_SECTOR, len - idx);
+                if (mem_0filled (buf + idx, blk)) {
+                        if (data_start < 0)
+                                data_start = idx;
+                        data_end = idx + blk;
+                        zero_run = 0;
+                } else {
+                        zero_run += blk;
+                }
+
+                if ((data_start < 0) || (zero_run < BM_HOLE_MIN))
+                        continue;
+
+                if (bm_write (dst, buf + data_start, data_end - data_start,
+                              offset + data_start, st))
+                        return -1;
+                data_start = -1;
+        }
+
+        if ((data_start >= 0) &&
+            bm_write (dst, buf + data_start, data_end - data_start,
+                      offset + data_start, st))
+                return -1;
+
+        return 0;
+}
+
+
+static int
+bm_migrate (const char *how, int src, int dst, off_t size)
+{
+        struct bm_stats  st        = {0,};
+        struct timeval   start     = {0,};
+        struct timeval   end       = {0,};
+        struct stat      stbuf     = {0,};
+        char            *buf       = NULL;
+        off_t            offset    = 0;
+        off_t            data_end  = 0;
+        ssize_t          len       = 0;
+        int              seek      = 0;
+        int              ret       = -1;
+
+        buf = malloc (BM_BLKSIZE);
+        if (!buf)
+                return -1;
+
+        if (ftruncate (dst, 0))
+                goto out;
+
+        seek = !strcmp (how, "seek");
+
+        gettimeofday (&start, NULL);
+
+        while (offset < size) {
+                if (seek && (offset >= data_end)) {
+                        offset = lseek (src, offset, SEEK_DATA);
+                        if ((offset == -1) && (errno == ENXIO))
+                                break;
+                        data_end = lseek (src, offset, SEEK_HOLE);
+                        if ((offset == -1) || (data_end == -1)) {
+                                perror ("lseek");
+                                goto out;
+                        }
+                }
+
+                len = min (BM_BLKSIZE, (seek ? data_end : size) - offset);
+                len = pread (src, buf, len, offset);
+                if (len <= 0)
+                        break;
+                st.read_bytes += len;
+
+                if (!strcmp (how, "sector"))
+                        ret = bm_copy_sector (dst, buf, len, offset, &st);
+                else
+                        ret = bm_copy_extent (dst, buf, len, offset, &st);
+                if (ret) {
+                        perror ("pwrite");
+                        goto out;
+                }
+
+                offset += len;
+        }
+
+        if (ftruncate (dst, size))
+                goto out;
+
+        gettimeofday (&end, NULL);
+
+        fstat (dst, &stbuf);
+
+        printf ("%-8s %10.2f %14"PRIu64" %10"PRIu64" %14"PRIu64"\n", how,
+                (tv_us (&end) - tv_us (&start)) / 1e6, st.read_bytes >> 20,
+                st.writes, (uint64_t) stbuf.st_blocks * 512 >> 20);
+        ret = 0;
+out:
+        free (buf);
+        return ret;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        const char  *dir  = ".";
+        char         src_path[PATH_MAX];
+        char         dst_path[PATH_MAX];
+        char        *data = NULL;
+        off_t        size = 10;
+        off_t        off  = 0;
+        int          src  = -1;
+        int          dst  = -1;
+        int          ret  = 1;
+
+        if (argc > 1)
+                size = atoll (argv[1]);
+        if (argc > 2)
+                dir = argv[2];
+
+        size <<= 30;
+
+        snprintf (src_path, sizeof (src_path), "%s/sparse-migrate-bm.src",
+                  dir);
+        snprintf (dst_path, sizeof (dst_path), "%s/sparse-migrate-bm.dst",
+                  dir);
+
+        src = open (src_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        dst = open (dst_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        data = malloc (BM_EXTENT);
+        if ((src == -1) || (dst == -1) || !data) {
+                perror ("open");
+                goto out;
+        }
+
+        memset (data, 0xab, BM_EXTENT);
+        for (off = 0; off + BM_STRIDE <= size; off += BM_STRIDE) {
+                if (pwrite (src, data, BM_EXTENT, off) != BM_EXTENT) {
+                        perror ("pwrite");
+                        goto out;
+                }
+        }
+        if (ftruncate (src, size)) {
+                perror ("ftruncate");
+                goto out;
+        }
+        fsync (src);
+
+        printf ("%-8s %10s %14s %10s %14s\n", "method", "secs", "read (MB)",
+                "writes", "allocated (MB)");
+
+        if (bm_migrate ("sector", src, dst, size) ||
+            bm_migrate ("extent", src, dst, size) ||
+            bm_migrate ("seek", src, dst, size))
+                goto out;
+
+        ret = 0;
+out:
+        if (src != -1)
+                close (src);
+        if (dst != -1)
+                close (dst);
+        unlink (src_path);
+        unlink (dst_path);
+        free (data);
+
+        return ret;
+}
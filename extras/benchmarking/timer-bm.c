@@ -0,0 +1,158 @@
+/*
+   Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+
+/* timer-bm: measures gf_timer_call_after/gf_timer_call_cancel cost with a
+ * given number of timers pending, and how late short timers fire.
+ *
+ * usage: timer-bm [pending-timers] [probe-timers]
+ */
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "glusterfs.h"
+#include "globals.h"
+#include "timer.h"
+
+static pthread_mutex_t fired_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  fired_cond = PTHREAD_COND_INITIALIZER;
+static long            fired;
+static uint64_t        lateness_us;
+static long            early;
+
+struct probe {
+        struct timeval due;
+        gf_timer_t    *timer;
+};
+
+
+static uint64_t
+tv_us (struct timeval *tv)
+{
+        return ((uint64_t) tv->tv_sec) * 1000000 + tv->tv_usec;
+}
+
+
+static void
+probe_cbk (void *data)
+{
+        struct probe   *probe = data;
+        struct timeval  now = {0, };
+
+        gettimeofday (&now, NULL);
+
+        pthread_mutex_lock (&fired_lock);
+        {
+                if (tv_us (&now) >= tv_us (&probe->due))
+                        lateness_us += tv_us (&now) - tv_us (&probe->due);
+                else
+                        early++;
+                fired++;
+                pthread_cond_signal (&fired_cond);
+        }
+        pthread_mutex_unlock (&fired_lock);
+}
+
+
+static void
+never_cbk (void *data)
+{
+        return;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        glusterfs_ctx_t  *ctx = NULL;
+        gf_timer_t      **timers = NULL;
+        struct probe     *probes = NULL;
+        struct timeval    delta = {0, };
+        struct timeval    start = {0, };
+        struct timeval    stop = {0, };
+        long              pending = 100000;
+        long              nprobes = 100;
+        long              i = 0;
+
+        if (argc > 1)
+                pending = atol (argv[1]);
+        if (argc > 2)
+                nprobes = atol (argv[2]);
+
+        ctx = glusterfs_ctx_new ();
+        if (!ctx || glusterfs_globals_init (ctx))
+                return 1;
+        THIS->ctx = ctx;
+
+        timers = calloc (pending, sizeof (*timers));
+        probes = calloc (nprobes, sizeof (*probes));
+        if (!timers || !probes)
+                return 1;
+
+        srandom (getpid ());
+
+        /* spread over the next hour, as ping and grace timers would be */
+        gettimeofday (&start, NULL);
+        for (i = 0; i < pending; i++) {
+                delta.tv_sec = 60 + random () % 3600;
+                delta.tv_usec = random () % 1000000;
+                timers[i] = gf_timer_call_after (ctx, delta, never_cbk, NULL);
+        }
+        gettimeofday (&stop, NULL);
+
+        printf ("insert: %ld timers, %.3f us/op\n", pending,
+                (double)(tv_us (&stop) - tv_us (&start)) / pending);
+
+        /* short timers while the wheel is loaded */
+        for (i = 0; i < nprobes; i++) {
+                delta.tv_sec = 0;
+                delta.tv_usec = 1000 + (random () % 50) * 1000;
+                gettimeofday (&probes[i].due, NULL);
+                probes[i].due.tv_usec += delta.tv_usec;
+                probes[i].due.tv_sec += probes[i].due.tv_usec / 1000000;
+                probes[i].due.tv_usec %= 1000000;
+                probes[i].timer = gf_timer_call_after (ctx, delta, probe_cbk,
+                                                       &probes[i]);
+        }
+
+        pthread_mutex_lock (&fired_lock);
+        {
+                while (fired < nprobes)
+                        pthread_cond_wait (&fired_cond, &fired_lock);
+        }
+        pthread_mutex_unlock (&fired_lock);
+
+        printf ("fire: %ld timers of 1-50ms, %.3f ms late on average, "
+                "%ld early\n", nprobes,
+                nprobes ? (double) lateness_us / nprobes / 1000 : 0, early);
+
+        gettimeofday (&start, NULL);
+        for (i = 0; i < pending; i++)
+                gf_timer_call_cancel (ctx, timers[i]);
+        gettimeofday (&stop, NULL);
+
+        printf ("cancel: %ld timers, %.3f us/op\n", pending,
+                (double)(tv_us (&stop) - tv_us (&start)) / pending);
+
+        for (i = 0; i < nprobes; i++)
+                gf_timer_call_cancel (ctx, probes[i].timer);
+
+        free (timers);
+        free (probes);
+
+        return 0;
+}
@@ -0,0 +1,213 @@
+/*
+   Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+
+/* wb-aggregate-bm: sequential writes, each in a buffer of its own as they
+ * come from fuse, aggregated the way write-behind collapses them before
+ * the result is written to a local file:
+ *
+ *   copy   - every write copied into one aggregate-size buffer, one
+ *            write per full buffer (the old behaviour)
+ *   chain  - writes chained as iovecs, up to 7 of them, the rest copied
+ *            into a tail buffer, one pwritev per aggregate
+ *
+ * and reports wall clock time, throughput and CPU time (user + system)
+ * per MB written.
+ *
+ * usage: wb-aggregate-bm [size-in-MB] [write-size] [aggregate-size]
+ *                        [directory]
+ */
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+
+#include "glusterfs.h"
+#include "common-utils.h"
+
+#define BM_BUFFERS        64
+#define BM_VECTOR_COUNT   8       /* MAX_VECTOR_COUNT of write-behind */
+
+
+static uint64_t
+tv_us (struct timeval *tv)
+{
+        return ((uint64_t) tv->tv_sec) * 1000000 + tv->tv_usec;
+}
+
+
+static uint64_t
+cpu_us (void)
+{
+        struct rusage ru = {{0,}, };
+
+        getrusage (RUSAGE_SELF, &ru);
+
+        return tv_us (&ru.ru_utime) + tv_us (&ru.ru_stime);
+}
+
+
+static int
+bm_run (const char *how, int fd, char **bufs, size_t wsize, size_t agg,
+        uint64_t total, int report)
+{
+        struct iovec     vector[BM_VECTOR_COUNT];
+        struct timeval   start     = {0,};
+        struct timeval   end       = {0,};
+        uint64_t         cpu       = 0;
+        uint64_t         written   = 0;
+        uint64_t         usecs     = 0;
+        off_t            offset    = 0;
+        char            *tail      = NULL;
+        size_t           size      = 0;
+        int              count     = 0;
+        int              chain     = 0;
+        int              i         = 0;
+        int              ret       = -1;
+
+        tail = malloc (agg);
+        if (!tail)
+                return -1;
+
+        chain = !strcmp (how, "chain");
+
+        gettimeofday (&start, NULL);
+        cpu = cpu_us ();
+
+        while (written < total) {
+                struct iovec in = {bufs[i++ % BM_BUFFERS], wsize};
+
+                if (chain && (wsize > 1024) &&
+                    (count < BM_VECTOR_COUNT - 1)) {
+                        vector[count++] = in;
+                } else {
+                        if (!count || (vector[count - 1].iov_base !=
+                                       tail)) {
+                                vector[count].iov_base = tail;
+                                vector[count].iov_len = 0;
+                                count++;
+                        }
+                        iov_unload ((char *)tail + vector[count - 1].iov_len,
+                                    &in, 1);
+                        vector[count - 1].iov_len += wsize;
+                }
+
+                size += wsize;
+                written += wsize;
+
+                if ((size + wsize <= agg) && (written < total) &&
+                    ((count < BM_VECTOR_COUNT) ||
+                     (vector[count - 1].iov_base == tail)))
+                        continue;
+
+                if (pwritev (fd, vector, count, offset) != size) {
+                        perror ("pwritev");
+                        goto out;
+                }
+
+                offset += size;
+                size = 0;
+                count = 0;
+        }
+
+        cpu = cpu_us () - cpu;
+        gettimeofday (&end, NULL);
+
+        usecs = tv_us (&end) - tv_us (&start);
+
+        ret = 0;
+        if (!report)
+                goto out;
+
+        printf ("%-8s %10.2f %10.1f %16.1f\n", how, usecs / 1e6,
+                (total / 1048576.0) / (usecs / 1e6),
+                (double) cpu / (total / 1048576.0));
+out:
+        free (tail);
+        return ret;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        const char  *dir   = ".";
+        char         path[PATH_MAX];
+        char        *bufs[BM_BUFFERS] = {NULL, };
+        uint64_t     total = 1024;
+        size_t       wsize = 4096;
+        size_t       agg   = 128 * 1024;
+        int          fd    = -1;
+        int          i     = 0;
+        int          ret   = 1;
+
+        if (argc > 1)
+                total = atoll (argv[1]);
+        if (argc > 2)
+                wsize = atoll (argv[2]);
+        if (argc > 3)
+                agg = atoll (argv[3]);
+        if (argc > 4)
+                dir = argv[4];
+
+        total <<= 20;
+
+        if (!wsize || (wsize > agg)) {
+                fprintf (stderr, "write-size must be between 1 and "
+                         "aggregate-size\n");
+                return 1;
+        }
+
+        for (i = 0; i < BM_BUFFERS; i++) {
+                bufs[i] = malloc (wsize);
+                if (!bufs[i]) {
+                        perror ("malloc");
+                        goto out;
+                }
+                memset (bufs[i], 'a' + (i % 26), wsize);
+        }
+
+        snprintf (path, sizeof (path), "%s/wb-aggregate-bm.dat", dir);
+
+        fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd == -1) {
+                perror ("open");
+                goto out;
+        }
+
+        printf ("%-8s %10s %10s %16s\n", "method", "secs", "MB/s",
+                "cpu usecs / MB");
+
+        /* the first pass allocates the file, later ones overwrite it */
+        if (bm_run ("copy", fd, bufs, wsize, agg, total, 0) ||
+            bm_run ("copy", fd, bufs, wsize, agg, total, 1) ||
+            bm_run ("chain", fd, bufs, wsize, agg, total, 1))
+                goto out;
+
+        ret = 0;
+out:
+        if (fd != -1) {
+                close (fd);
+                unlink (path);
+        }
+        for (i = 0; i < BM_BUFFERS; i++)
+                free (bufs[i]);
+
+        return ret;
+}
@@ -185,6 +185,15 @@ static struct argp_option gf_options[] = {
 	{"congestion-threshold", ARGP_FUSE_CONGESTION_THRESHOLD_KEY, "N", 0,
 	 "Set fuse module's congestion threshold to N "
 	 "[default: 48]"},
+        {"reader-thread-count", ARGP_FUSE_READER_THREAD_COUNT_KEY, "N", 0,
+         "Read and dispatch requests from /dev/fuse with N threads "
+         "[default: 1]"},
+        {"max-write", ARGP_FUSE_MAX_WRITE_KEY, "SIZE", 0,
+         "Let fuse module send READ and WRITE requests of up to SIZE bytes "
+         "[default: 128KB]"},
+        {"use-readdirp", ARGP_FUSE_USE_READDIRP_KEY, "BOOL",
+         OPTION_ARG_OPTIONAL, "Use READDIRPLUS if the fuse kernel module "
+         "supports it [default: \"on\"]"},
         {"client-pid", ARGP_CLIENT_PID_KEY, "PID", OPTION_HIDDEN,
          "client will authenticate itself with process id PID to server"},
         {"user-map-root", ARGP_USER_MAP_ROOT_KEY, "USER", OPTION_HIDDEN,
@@ -401,6 +410,47 @@ set_fuse_mount_options (glusterfs_ctx_t *ctx, dict_t *options)
 			goto err;
 		}
 	}
+        if (cmd_args->reader_thread_count) {
+                ret = dict_set_int32 (options, "reader-thread-count",
+                                      cmd_args->reader_thread_count);
+                if (ret < 0) {
+                        gf_log ("glusterfsd", GF_LOG_ERROR, "failed to set "
+                                "dict value for key reader-thread-count");
+                        goto err;
+                }
+        }
+
+        if (cmd_args->fuse_max_write) {
+                ret = dict_set_uint64 (options, "max-write",
+                                       cmd_args->fuse_max_write);
+                if (ret < 0) {
+                        gf_log ("glusterfsd", GF_LOG_ERROR, "failed to set "
+                                "dict value for key max-write");
+                        goto err;
+                }
+        }
+
+        switch (cmd_args->use_readdirp) {
+        case GF_OPTION_DISABLE:
+                ret = dict_set_static_ptr (options, "use-readdirp", "off");
+                if (ret < 0) {
+                        gf_log ("glusterfsd", GF_LOG_ERROR, "failed to set "
+                                "'off' for key use-readdirp");
+                        goto err;
+                }
+                break;
+        case GF_OPTION_ENABLE:
+                ret = dict_set_static_ptr (options, "use-readdirp", "on");
+                if (ret < 0) {
+                        gf_log ("glusterfsd", GF_LOG_ERROR, "failed to set "
+                                "'on' for key use-readdirp");
+                        goto err;
+                }
+                break;
+        case GF_OPTION_DEFERRED:
+        default:
+                break;
+        }
 
         switch (cmd_args->fuse_direct_io_mode) {
         case GF_OPTION_DISABLE: /* disable */
@@ -944,6 +994,32 @@ parse_opts (int key, char *arg, struct argp_state *state)
                 argp_failure (state, -1, 0,
                               "unknown congestion threshold option %s", arg);
                 break;
+        case ARGP_FUSE_READER_THREAD_COUNT_KEY:
+                if (!gf_string2int (arg, &cmd_args->reader_thread_count))
+                        break;
+
+                argp_failure (state, -1, 0,
+                              "unknown reader thread count option %s", arg);
+                break;
+        case ARGP_FUSE_MAX_WRITE_KEY:
+                if (!gf_string2bytesize (arg, &cmd_args->fuse_max_write))
+                        break;
+
+                argp_failure (state, -1, 0,
+                              "unknown max write size %s", arg);
+                break;
+        case ARGP_FUSE_USE_READDIRP_KEY:
+                if (!arg)
+                        arg = "on";
+
+                if (gf_string2boolean (arg, &b) == 0) {
+                        cmd_args->use_readdirp = b;
+                        break;
+                }
+
+                argp_failure (state, -1, 0,
+                              "unknown use-readdirp setting \"%s\"", arg);
+                break;
 
         case ARGP_FUSE_MOUNTOPTS_KEY:
                 cmd_args->fuse_mountopts = gf_strdup (arg);
@@ -1235,6 +1311,7 @@ glusterfs_ctx_defaults_init (glusterfs_ctx_t *ctx)
 #endif
         cmd_args->fuse_attribute_timeout = -1;
         cmd_args->fuse_entry_timeout = -1;
+        cmd_args->use_readdirp = GF_OPTION_DEFERRED;
 
         INIT_LIST_HEAD (&cmd_args->xlator_options);
 
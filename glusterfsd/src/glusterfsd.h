@@ -84,6 +84,9 @@ enum argp_option_keys {
 	ARGP_FUSE_CONGESTION_THRESHOLD_KEY = 162,
         ARGP_INODE32_KEY                  = 163,
 	ARGP_FUSE_MOUNTOPTS_KEY		  = 164,
+        ARGP_FUSE_READER_THREAD_COUNT_KEY = 165,
+        ARGP_FUSE_USE_READDIRP_KEY        = 166,
+        ARGP_FUSE_MAX_WRITE_KEY           = 167,
 };
 
 struct _gfd_vol_top_priv_t {
@@ -27,6 +27,8 @@ typedef struct {
 	glusterfs_fop_t fop;
         struct mem_pool *stub_mem_pool; /* pointer to stub mempool in ctx_t */
         dict_t *xdata;                  /* common accross all the fops */
+        struct timeval queued;          /* set by xlators which queue stubs,
+                                           for their wait time statistics */
 
 	union {
 		/* lookup */
@@ -11,7 +11,12 @@
 #include <openssl/md5.h>
 #include <stdint.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "glusterfs.h"
+#include "checksum.h"
 
 /*
  * The "weak" checksum required for the rsync algorithm,
@@ -21,25 +26,77 @@
  * "a simple 32 bit checksum that can be upadted from either end
  *  (inspired by Mark Adler's Adler-32 checksum)"
  *
- * Note: these functions are only called to compute checksums on
- * pathnames; they don't need to handle arbitrarily long strings of
- * data. Thus int32_t and uint32_t are sufficient
+ * With n = len, the result is s1 = sum (buf[k]) and
+ * s2 = sum ((n - k) * buf[k]), both modulo 2^32. Since that is linear
+ * the bytes can be summed in any order, which lets the SSE2 path below
+ * fold 16 bytes at a time while producing exactly the same value as the
+ * byte-wise loop.
  */
 
+#if defined(__SSE2__)
+static inline uint32_t
+__weak_checksum_hsum (__m128i v)
+{
+        v = _mm_add_epi32 (v, _mm_shuffle_epi32 (v, _MM_SHUFFLE (1, 0, 3, 2)));
+        v = _mm_add_epi32 (v, _mm_shuffle_epi32 (v, _MM_SHUFFLE (2, 3, 0, 1)));
+
+        return (uint32_t) _mm_cvtsi128_si32 (v);
+}
+
+static size_t
+__weak_checksum_sse2 (unsigned char *buf, size_t len, uint32_t *s1p,
+                      uint32_t *s2p)
+{
+        const __m128i  zero    = _mm_setzero_si128 ();
+        const __m128i  w_lo    = _mm_set_epi16 (9, 10, 11, 12, 13, 14, 15, 16);
+        const __m128i  w_hi    = _mm_set_epi16 (1, 2, 3, 4, 5, 6, 7, 8);
+        __m128i        v_s1    = zero;
+        __m128i        v_ps    = zero;
+        __m128i        v_w     = zero;
+        __m128i        chunk;
+        size_t         nchunks = len / 16;
+        size_t         i       = 0;
+
+        for (i = 0; i < nchunks; i++) {
+                chunk = _mm_loadu_si128 ((const __m128i *) (buf + i * 16));
+
+                /* bytes of every earlier chunk weigh 16 more per chunk */
+                v_ps = _mm_add_epi32 (v_ps, v_s1);
+                v_s1 = _mm_add_epi32 (v_s1, _mm_sad_epu8 (chunk, zero));
+                v_w  = _mm_add_epi32 (v_w, _mm_madd_epi16 (
+                                              _mm_unpacklo_epi8 (chunk, zero),
+                                              w_lo));
+                v_w  = _mm_add_epi32 (v_w, _mm_madd_epi16 (
+                                              _mm_unpackhi_epi8 (chunk, zero),
+                                              w_hi));
+        }
+
+        *s2p += (uint32_t) (nchunks * 16) * *s1p
+                + 16 * __weak_checksum_hsum (v_ps)
+                + __weak_checksum_hsum (v_w);
+        *s1p += __weak_checksum_hsum (v_s1);
+
+        return nchunks * 16;
+}
+#endif
+
 uint32_t
 gf_rsync_weak_checksum (unsigned char *buf, size_t len)
 {
-        int32_t i = 0;
+        size_t   i = 0;
         uint32_t s1, s2;
 
         uint32_t csum;
 
         s1 = s2 = 0;
-        if (len >= 4) {
-                for (; i < (len-4); i+=4) {
-                        s2 += 4*(s1 + buf[i]) + 3*buf[i+1] + 2*buf[i+2] + buf[i+3];
-                        s1 += buf[i+0] + buf[i+1] + buf[i+2] + buf[i+3];
-                }
+
+#if defined(__SSE2__)
+        i = __weak_checksum_sse2 (buf, len, &s1, &s2);
+#endif
+
+        for (; i + 4 <= len; i += 4) {
+                s2 += 4*(s1 + buf[i]) + 3*buf[i+1] + 2*buf[i+2] + buf[i+3];
+                s1 += buf[i+0] + buf[i+1] + buf[i+2] + buf[i+3];
         }
 
         for (; i < len; i++) {
@@ -63,3 +120,179 @@ gf_rsync_strong_checksum (unsigned char *data, size_t len, unsigned char *md5)
 {
         MD5(data, len, md5);
 }
+
+
+/*
+ * XXH64 (xxHash, Yann Collet, BSD licensed), seed 0. Input is read
+ * little-endian and the digest is stored big-endian, so bricks of
+ * either byte order agree on it.
+ */
+
+#define XXH_PRIME64_1   11400714785074694791ULL
+#define XXH_PRIME64_2   14029467366897019727ULL
+#define XXH_PRIME64_3    1609587929392839161ULL
+#define XXH_PRIME64_4    9650029242287828579ULL
+#define XXH_PRIME64_5    2870177450012600261ULL
+
+#define XXH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline uint64_t
+__xxh64_read64 (const unsigned char *p)
+{
+        uint64_t v;
+
+        memcpy (&v, p, sizeof (v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        v = __builtin_bswap64 (v);
+#endif
+        return v;
+}
+
+static inline uint32_t
+__xxh64_read32 (const unsigned char *p)
+{
+        uint32_t v;
+
+        memcpy (&v, p, sizeof (v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        v = __builtin_bswap32 (v);
+#endif
+        return v;
+}
+
+static inline uint64_t
+__xxh64_round (uint64_t acc, uint64_t input)
+{
+        acc += input * XXH_PRIME64_2;
+        acc  = XXH_ROTL64 (acc, 31);
+        return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t
+__xxh64_merge (uint64_t acc, uint64_t val)
+{
+        acc ^= __xxh64_round (0, val);
+        return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static void
+gf_xxh64 (unsigned char *data, size_t len, unsigned char *sum)
+{
+        const unsigned char *p   = data;
+        const unsigned char *end = data + len;
+        uint64_t             v1, v2, v3, v4;
+        uint64_t             h   = 0;
+        int                  i   = 0;
+
+        if (len >= 32) {
+                v1 = XXH_PRIME64_1 + XXH_PRIME64_2;
+                v2 = XXH_PRIME64_2;
+                v3 = 0;
+                v4 = -XXH_PRIME64_1;
+
+                do {
+                        v1 = __xxh64_round (v1, __xxh64_read64 (p));
+                        v2 = __xxh64_round (v2, __xxh64_read64 (p + 8));
+                        v3 = __xxh64_round (v3, __xxh64_read64 (p + 16));
+                        v4 = __xxh64_round (v4, __xxh64_read64 (p + 24));
+                        p += 32;
+                } while (p + 32 <= end);
+
+                h = XXH_ROTL64 (v1, 1) + XXH_ROTL64 (v2, 7) +
+                    XXH_ROTL64 (v3, 12) + XXH_ROTL64 (v4, 18);
+                h = __xxh64_merge (h, v1);
+                h = __xxh64_merge (h, v2);
+                h = __xxh64_merge (h, v3);
+                h = __xxh64_merge (h, v4);
+        } else {
+                h = XXH_PRIME64_5;
+        }
+
+        h += (uint64_t) len;
+
+        for (; p + 8 <= end; p += 8) {
+                h ^= __xxh64_round (0, __xxh64_read64 (p));
+                h  = XXH_ROTL64 (h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        }
+
+        if (p + 4 <= end) {
+                h ^= (uint64_t) __xxh64_read32 (p) * XXH_PRIME64_1;
+                h  = XXH_ROTL64 (h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+                p += 4;
+        }
+
+        for (; p < end; p++) {
+                h ^= (*p) * XXH_PRIME64_5;
+                h  = XXH_ROTL64 (h, 11) * XXH_PRIME64_1;
+        }
+
+        h ^= h >> 33;
+        h *= XXH_PRIME64_2;
+        h ^= h >> 29;
+        h *= XXH_PRIME64_3;
+        h ^= h >> 32;
+
+        for (i = 7; i >= 0; i--) {
+                sum[i] = h & 0xff;
+                h >>= 8;
+        }
+}
+
+
+static struct {
+        const char *name;
+        size_t      len;
+        void      (*fn) (unsigned char *data, size_t len, unsigned char *sum);
+} gf_rsync_strong_types[GF_RSYNC_STRONG_MAX] = {
+        [GF_RSYNC_STRONG_MD5]   = { "md5",   MD5_DIGEST_LENGTH,
+                                    gf_rsync_strong_checksum },
+        [GF_RSYNC_STRONG_XXH64] = { "xxh64", 8, gf_xxh64 },
+};
+
+
+int
+gf_rsync_strong_type_from_name (const char *name)
+{
+        int i = 0;
+
+        if (!name)
+                return -1;
+
+        for (i = 0; i < GF_RSYNC_STRONG_MAX; i++) {
+                if (!strcmp (name, gf_rsync_strong_types[i].name))
+                        return i;
+        }
+
+        return -1;
+}
+
+
+const char *
+gf_rsync_strong_type_name (int type)
+{
+        if ((type < 0) || (type >= GF_RSYNC_STRONG_MAX))
+                return NULL;
+
+        return gf_rsync_strong_types[type].name;
+}
+
+
+size_t
+gf_rsync_strong_checksum_len (int type)
+{
+        if ((type < 0) || (type >= GF_RSYNC_STRONG_MAX))
+                return 0;
+
+        return gf_rsync_strong_types[type].len;
+}
+
+
+void
+gf_rsync_strong_checksum_by_type (int type, unsigned char *data, size_t len,
+                                  unsigned char *sum)
+{
+        if ((type < 0) || (type >= GF_RSYNC_STRONG_MAX))
+                return;
+
+        gf_rsync_strong_types[type].fn (data, len, sum);
+}
@@ -11,10 +11,33 @@
 #ifndef __CHECKSUM_H__
 #define __CHECKSUM_H__
 
+/* strong checksums rchecksum can return, named in GF_RCHECKSUM_TYPE_KEY */
+typedef enum {
+        GF_RSYNC_STRONG_MD5 = 0,     /* the default, all peers have it */
+        GF_RSYNC_STRONG_XXH64,
+        GF_RSYNC_STRONG_MAX
+} gf_rsync_strong_type_t;
+
+/* largest digest of any type above (MD5_DIGEST_LENGTH) */
+#define GF_RSYNC_STRONG_CHECKSUM_MAXLEN 16
+
 uint32_t
 gf_rsync_weak_checksum (unsigned char *buf, size_t len);
 
 void
 gf_rsync_strong_checksum (unsigned char *buf, size_t len, unsigned char *sum);
 
+int
+gf_rsync_strong_type_from_name (const char *name);
+
+const char *
+gf_rsync_strong_type_name (int type);
+
+size_t
+gf_rsync_strong_checksum_len (int type);
+
+void
+gf_rsync_strong_checksum_by_type (int type, unsigned char *buf, size_t len,
+                                  unsigned char *sum);
+
 #endif /* __CHECKSUM_H__ */
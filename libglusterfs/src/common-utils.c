@@ -32,6 +32,9 @@
 #include <arpa/inet.h>
 #include <signal.h>
 #include <stdlib.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #if defined GF_BSD_HOST_OS || defined GF_DARWIN_HOST_OS
 #include <sys/sysctl.h>
@@ -1220,6 +1223,47 @@ gf_string2uint64_base10 (const char *str, uint64_t *n)
         return -1;
 }
 
+/* Returns non-zero if any byte of @buf is set. Scans 64 bytes per
+ * iteration, with SSE2 where the compiler targets it. */
+int
+mem_0filled (const char *buf, size_t size)
+{
+        size_t   i    = 0;
+#if defined(__SSE2__)
+        __m128i  block = _mm_setzero_si128 ();
+
+        for (; i + 64 <= size; i += 64) {
+                block = _mm_or_si128 (
+                        _mm_or_si128 (_mm_loadu_si128 ((void *)(buf + i)),
+                                      _mm_loadu_si128 ((void *)(buf + i + 16))),
+                        _mm_or_si128 (_mm_loadu_si128 ((void *)(buf + i + 32)),
+                                      _mm_loadu_si128 ((void *)(buf + i + 48))));
+                if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (block,
+                                       _mm_setzero_si128 ())) != 0xffff)
+                        return 1;
+        }
+#else
+        uint64_t words[8];
+        uint64_t block = 0;
+        int      j    = 0;
+
+        for (; i + 64 <= size; i += 64) {
+                memcpy (words, buf + i, sizeof (words));
+                block = 0;
+                for (j = 0; j < 8; j++)
+                        block |= words[j];
+                if (block)
+                        return 1;
+        }
+#endif
+        for (; i < size; i++) {
+                if (buf[i])
+                        return 1;
+        }
+
+        return 0;
+}
+
 char *
 gf_uint64_2human_readable (uint64_t n)
 {
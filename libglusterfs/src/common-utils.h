@@ -384,21 +384,7 @@ iov_copy (const struct iovec *dst, int dcnt,
 }
 
 
-static inline int
-mem_0filled (const char *buf, size_t size)
-{
-	int i = 0;
-	int ret = 0;
-
-	for (i = 0; i < size; i++) {
-		ret = buf[i];
-		if (ret)
-			break;
-	}
-
-	return ret;
-}
-
+int mem_0filled (const char *buf, size_t size);
 
 static inline int
 iov_0filled (struct iovec *vector, int count)
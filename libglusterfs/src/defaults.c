@@ -1323,6 +1323,17 @@ default_notify (xlator_t *this, int32_t event, void *data, ...)
                 }
         }
         break;
+        case GF_EVENT_CLIENT_DESTROY:
+        {
+                xlator_list_t *list = this->children;
+
+                /* data is the client going away, as in frame->root->trans */
+                while (list) {
+                        xlator_notify (list->xlator, event, data);
+                        list = list->next;
+                }
+        }
+        break;
         case GF_EVENT_CHILD_CONNECTING:
         case GF_EVENT_CHILD_MODIFIED:
         case GF_EVENT_CHILD_DOWN:
@@ -1342,6 +1353,19 @@ default_notify (xlator_t *this, int32_t event, void *data, ...)
                 }
         }
         break;
+        case GF_EVENT_UPCALL:
+        {
+                xlator_list_t *parent = this->parents;
+
+                /* data is the struct gf_upcall for protocol/server */
+                while (parent) {
+                        if (parent->xlator->init_succeeded)
+                                xlator_notify (parent->xlator, event,
+                                               data, NULL);
+                        parent = parent->next;
+                }
+        }
+        break;
         default:
         {
                 xlator_list_t *parent = this->parents;
@@ -20,6 +20,7 @@
 #include "event.h"
 #include "mem-pool.h"
 #include "common-utils.h"
+#include "locking.h"
 
 #ifndef _CONFIG_H
 #define _CONFIG_H
@@ -31,28 +32,274 @@
 #include <sys/epoll.h>
 
 
+struct event_slot_epoll {
+        int              fd;
+        int              events;
+        int              gen;
+        int              ref;
+        int              in_use;
+        int              in_handler;
+        void            *data;
+        event_handler_t  handler;
+        gf_lock_t        lock;
+};
+
+
+struct event_thread_data {
+        struct event_pool *event_pool;
+        int                event_index;
+};
+
+
 static int
-__event_getindex (struct event_pool *event_pool, int fd, int idx)
+__event_newtable (struct event_pool *event_pool, int table_idx)
 {
-        int  ret = -1;
-        int  i = 0;
+        struct event_slot_epoll *table = NULL;
+        int                      i = 0;
 
-        GF_VALIDATE_OR_GOTO ("event", event_pool, out);
+        table = GF_CALLOC (EVENT_EPOLL_SLOTS, sizeof (*table),
+                           gf_common_mt_reg);
+        if (!table)
+                return -1;
 
-        if (idx > -1 && idx < event_pool->used) {
-                if (event_pool->reg[idx].fd == fd)
-                        ret = idx;
+        for (i = 0; i < EVENT_EPOLL_SLOTS; i++) {
+                table[i].fd = -1;
+                LOCK_INIT (&table[i].lock);
         }
 
-        for (i=0; ret == -1 && i<event_pool->used; i++) {
-                if (event_pool->reg[i].fd == fd) {
-                        ret = i;
+        /* dispatchers index ereg[] without the mutex, make sure they
+           never see the table before its slots are initialized */
+        __sync_synchronize ();
+
+        event_pool->ereg[table_idx] = table;
+        event_pool->slots_used[table_idx] = 0;
+
+        return 0;
+}
+
+
+static int
+__event_slot_alloc (struct event_pool *event_pool, int fd,
+                    event_handler_t handler, void *data)
+{
+        struct event_slot_epoll *table = NULL;
+        int                      table_idx = -1;
+        int                      gen = -1;
+        int                      i = 0;
+
+        for (i = 0; i < EVENT_EPOLL_TABLES; i++) {
+                switch (event_pool->slots_used[i]) {
+                case EVENT_EPOLL_SLOTS:
+                        continue;
+                case 0:
+                        if (!event_pool->ereg[i]) {
+                                if (__event_newtable (event_pool, i))
+                                        return -1;
+                        }
+                        break;
+                default:
                         break;
                 }
+
+                table_idx = i;
+                break;
         }
 
-out:
-        return ret;
+        if (table_idx == -1)
+                return -1;
+
+        table = event_pool->ereg[table_idx];
+
+        for (i = 0; i < EVENT_EPOLL_SLOTS; i++) {
+                if (!table[i].in_use)
+                        break;
+        }
+
+        LOCK (&table[i].lock);
+        {
+                gen = ++table[i].gen;
+
+                table[i].in_use = 1;
+                table[i].fd = fd;
+                table[i].events = EPOLLPRI;
+                table[i].handler = handler;
+                table[i].data = data;
+                table[i].in_handler = 0;
+                /* a dispatcher might still hold a reference taken on a
+                   stale event, so add to the count instead of setting it */
+                table[i].ref++;
+        }
+        UNLOCK (&table[i].lock);
+
+        event_pool->slots_used[table_idx]++;
+
+        gf_log ("epoll", GF_LOG_TRACE, "allocated slot %d (gen=%d) for fd=%d",
+                table_idx * EVENT_EPOLL_SLOTS + i, gen, fd);
+
+        return table_idx * EVENT_EPOLL_SLOTS + i;
+}
+
+
+static int
+__event_slot_find (struct event_pool *event_pool, int fd)
+{
+        struct event_slot_epoll *table = NULL;
+        int                      i = 0;
+        int                      j = 0;
+
+        for (i = 0; i < EVENT_EPOLL_TABLES; i++) {
+                table = event_pool->ereg[i];
+                if (!table)
+                        break;
+
+                if (!event_pool->slots_used[i])
+                        continue;
+
+                for (j = 0; j < EVENT_EPOLL_SLOTS; j++) {
+                        if (table[j].in_use && table[j].fd == fd)
+                                return i * EVENT_EPOLL_SLOTS + j;
+                }
+        }
+
+        return -1;
+}
+
+
+static struct event_slot_epoll *
+event_slot_get (struct event_pool *event_pool, int idx)
+{
+        struct event_slot_epoll *table = NULL;
+        struct event_slot_epoll *slot = NULL;
+        int                      table_idx = 0;
+
+        if (idx < 0)
+                return NULL;
+
+        table_idx = idx / EVENT_EPOLL_SLOTS;
+        if (table_idx >= EVENT_EPOLL_TABLES)
+                return NULL;
+
+        table = event_pool->ereg[table_idx];
+        if (!table)
+                return NULL;
+
+        slot = &table[idx % EVENT_EPOLL_SLOTS];
+
+        LOCK (&slot->lock);
+        {
+                slot->ref++;
+        }
+        UNLOCK (&slot->lock);
+
+        return slot;
+}
+
+
+static void
+event_slot_unref (struct event_pool *event_pool, struct event_slot_epoll *slot,
+                  int idx)
+{
+        int ref = -1;
+
+        LOCK (&slot->lock);
+        {
+                ref = --slot->ref;
+        }
+        UNLOCK (&slot->lock);
+
+        if (ref)
+                return;
+
+        /* re-check under the mutex, __event_slot_alloc() could have
+           handed the slot out again in the meantime */
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                LOCK (&slot->lock);
+                {
+                        if (slot->ref == 0 && slot->in_use) {
+                                slot->in_use = 0;
+                                slot->fd = -1;
+                                slot->handler = NULL;
+                                slot->data = NULL;
+                                event_pool->slots_used[idx /
+                                                       EVENT_EPOLL_SLOTS]--;
+                        }
+                }
+                UNLOCK (&slot->lock);
+        }
+        pthread_mutex_unlock (&event_pool->mutex);
+}
+
+
+static struct event_slot_epoll *
+event_slot_get_fd (struct event_pool *event_pool, int fd, int *idx_p)
+{
+        struct event_slot_epoll *slot = NULL;
+        int                      idx = *idx_p;
+        int                      match = 0;
+
+        slot = event_slot_get (event_pool, idx);
+        if (slot) {
+                LOCK (&slot->lock);
+                {
+                        match = (slot->in_use && slot->fd == fd);
+                }
+                UNLOCK (&slot->lock);
+
+                if (match)
+                        return slot;
+
+                event_slot_unref (event_pool, slot, idx);
+        }
+
+        /* stale or missing hint from the caller */
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                idx = __event_slot_find (event_pool, fd);
+        }
+        pthread_mutex_unlock (&event_pool->mutex);
+
+        *idx_p = idx;
+
+        return event_slot_get (event_pool, idx);
+}
+
+
+static void
+__event_slot_update_events (struct event_slot_epoll *slot, int poll_in,
+                            int poll_out)
+{
+        switch (poll_in) {
+        case 1:
+                slot->events |= EPOLLIN;
+                break;
+        case 0:
+                slot->events &= ~EPOLLIN;
+                break;
+        case -1:
+                /* do nothing */
+                break;
+        default:
+                gf_log ("epoll", GF_LOG_ERROR,
+                        "invalid poll_in value %d", poll_in);
+                break;
+        }
+
+        switch (poll_out) {
+        case 1:
+                slot->events |= EPOLLOUT;
+                break;
+        case 0:
+                slot->events &= ~EPOLLOUT;
+                break;
+        case -1:
+                /* do nothing */
+                break;
+        default:
+                gf_log ("epoll", GF_LOG_ERROR,
+                        "invalid poll_out value %d", poll_out);
+                break;
+        }
 }
 
 
@@ -69,22 +316,12 @@ event_pool_new_epoll (int count)
                 goto out;
 
         event_pool->count = count;
-        event_pool->reg = GF_CALLOC (event_pool->count,
-                                     sizeof (*event_pool->reg),
-                                     gf_common_mt_reg);
-
-        if (!event_pool->reg) {
-                GF_FREE (event_pool);
-                event_pool = NULL;
-                goto out;
-        }
 
         epfd = epoll_create (count);
 
         if (epfd == -1) {
                 gf_log ("epoll", GF_LOG_ERROR, "epoll fd creation failed (%s)",
                         strerror (errno));
-                GF_FREE (event_pool->reg);
                 GF_FREE (event_pool);
                 event_pool = NULL;
                 goto out;
@@ -92,8 +329,6 @@ event_pool_new_epoll (int count)
 
         event_pool->fd = epfd;
 
-        event_pool->count = count;
-
         pthread_mutex_init (&event_pool->mutex, NULL);
         pthread_cond_init (&event_pool->cond, NULL);
 
@@ -102,96 +337,66 @@ out:
 }
 
 
+/* All fds are registered with EPOLLONESHOT: once an event is handed to
+ * one dispatcher thread the fd stays disarmed until that thread is done
+ * with the handler and re-arms it, so a connection is never serviced by
+ * two threads at the same time.
+ */
 int
 event_register_epoll (struct event_pool *event_pool, int fd,
                       event_handler_t handler,
                       void *data, int poll_in, int poll_out)
 {
-        int                 idx = -1;
-        int                 ret = -1;
-        struct epoll_event  epoll_event = {0, };
-        struct event_data  *ev_data = (void *)&epoll_event.data;
+        int                      idx = -1;
+        int                      ret = -1;
+        struct epoll_event       epoll_event = {0, };
+        struct event_data       *ev_data = (void *)&epoll_event.data;
+        struct event_slot_epoll *slot = NULL;
 
 
         GF_VALIDATE_OR_GOTO ("event", event_pool, out);
 
         pthread_mutex_lock (&event_pool->mutex);
         {
-                if (event_pool->count == event_pool->used) {
-                        event_pool->count *= 2;
-
-                        event_pool->reg = GF_REALLOC (event_pool->reg,
-                                                      event_pool->count *
-                                                      sizeof (*event_pool->reg));
-
-                        if (!event_pool->reg) {
-                                gf_log ("epoll", GF_LOG_ERROR,
-                                        "event registry re-allocation failed");
-                                goto unlock;
-                        }
-                }
-
-                idx = event_pool->used;
-                event_pool->used++;
-
-                event_pool->reg[idx].fd = fd;
-                event_pool->reg[idx].events = EPOLLPRI;
-                event_pool->reg[idx].handler = handler;
-                event_pool->reg[idx].data = data;
+                idx = __event_slot_alloc (event_pool, fd, handler, data);
+        }
+        pthread_mutex_unlock (&event_pool->mutex);
 
-                switch (poll_in) {
-                case 1:
-                        event_pool->reg[idx].events |= EPOLLIN;
-                        break;
-                case 0:
-                        event_pool->reg[idx].events &= ~EPOLLIN;
-                        break;
-                case -1:
-                        /* do nothing */
-                        break;
-                default:
-                        gf_log ("epoll", GF_LOG_ERROR,
-                                "invalid poll_in value %d", poll_in);
-                        break;
-                }
+        if (idx == -1) {
+                gf_log ("epoll", GF_LOG_ERROR,
+                        "could not allocate an event slot for fd=%d", fd);
+                goto out;
+        }
 
-                switch (poll_out) {
-                case 1:
-                        event_pool->reg[idx].events |= EPOLLOUT;
-                        break;
-                case 0:
-                        event_pool->reg[idx].events &= ~EPOLLOUT;
-                        break;
-                case -1:
-                        /* do nothing */
-                        break;
-                default:
-                        gf_log ("epoll", GF_LOG_ERROR,
-                                "invalid poll_out value %d", poll_out);
-                        break;
-                }
+        slot = event_slot_get (event_pool, idx);
 
-                event_pool->changed = 1;
+        LOCK (&slot->lock);
+        {
+                __event_slot_update_events (slot, poll_in, poll_out);
 
-                epoll_event.events = event_pool->reg[idx].events;
-                ev_data->fd = fd;
+                epoll_event.events = slot->events | EPOLLONESHOT;
                 ev_data->idx = idx;
+                ev_data->gen = slot->gen;
 
                 ret = epoll_ctl (event_pool->fd, EPOLL_CTL_ADD, fd,
                                  &epoll_event);
-
-                if (ret == -1) {
-                        gf_log ("epoll", GF_LOG_ERROR,
-                                "failed to add fd(=%d) to epoll fd(=%d) (%s)",
-                                fd, event_pool->fd, strerror (errno));
-                        goto unlock;
-                }
-
-                pthread_cond_broadcast (&event_pool->cond);
+                if (ret == -1)
+                        slot->fd = -1;
         }
-unlock:
-        pthread_mutex_unlock (&event_pool->mutex);
+        UNLOCK (&slot->lock);
+
+        if (ret == -1) {
+                gf_log ("epoll", GF_LOG_ERROR,
+                        "failed to add fd(=%d) to epoll fd(=%d) (%s)",
+                        fd, event_pool->fd, strerror (errno));
+                /* drop the registration reference as well */
+                event_slot_unref (event_pool, slot, idx);
+        }
+
+        event_slot_unref (event_pool, slot, idx);
 
+        if (ret == 0)
+                ret = idx;
 out:
         return ret;
 }
@@ -200,70 +405,46 @@ out:
 static int
 event_unregister_epoll (struct event_pool *event_pool, int fd, int idx_hint)
 {
-        int  idx = -1;
-        int  ret = -1;
-
-        struct epoll_event epoll_event = {0, };
-        struct event_data *ev_data = (void *)&epoll_event.data;
-        int                lastidx = -1;
+        int                      idx = idx_hint;
+        int                      ret = -1;
+        int                      found = 0;
+        struct event_slot_epoll *slot = NULL;
 
         GF_VALIDATE_OR_GOTO ("event", event_pool, out);
 
-        pthread_mutex_lock (&event_pool->mutex);
-        {
-                idx = __event_getindex (event_pool, fd, idx_hint);
-
-                if (idx == -1) {
-                        gf_log ("epoll", GF_LOG_ERROR,
-                                "index not found for fd=%d (idx_hint=%d)",
-                                fd, idx_hint);
-                        errno = ENOENT;
-                        goto unlock;
-                }
-
-                ret = epoll_ctl (event_pool->fd, EPOLL_CTL_DEL, fd, NULL);
-
-                /* if ret is -1, this array member should never be accessed */
-                /* if it is 0, the array member might be used by idx_cache
-                 * in which case the member should not be accessed till
-                 * it is reallocated
-                 */
-
-                event_pool->reg[idx].fd = -1;
-
-                if (ret == -1) {
-                        gf_log ("epoll", GF_LOG_ERROR,
-                                "fail to del fd(=%d) from epoll fd(=%d) (%s)",
-                                fd, event_pool->fd, strerror (errno));
-                        goto unlock;
-                }
+        slot = event_slot_get_fd (event_pool, fd, &idx);
+        if (!slot) {
+                gf_log ("epoll", GF_LOG_ERROR,
+                        "index not found for fd=%d (idx_hint=%d)",
+                        fd, idx_hint);
+                errno = ENOENT;
+                goto out;
+        }
 
-                lastidx = event_pool->used - 1;
-                if (lastidx == idx) {
-                        event_pool->used--;
-                        goto unlock;
+        LOCK (&slot->lock);
+        {
+                if (slot->fd == fd) {
+                        ret = epoll_ctl (event_pool->fd, EPOLL_CTL_DEL, fd,
+                                         NULL);
+                        if (ret == -1)
+                                gf_log ("epoll", GF_LOG_ERROR,
+                                        "fail to del fd(=%d) from epoll "
+                                        "fd(=%d) (%s)", fd, event_pool->fd,
+                                        strerror (errno));
+
+                        /* a handler still running on another thread will
+                           see this and neither re-arm nor reuse the slot */
+                        slot->fd = -1;
+                        found = 1;
                 }
+        }
+        UNLOCK (&slot->lock);
 
-                epoll_event.events = event_pool->reg[lastidx].events;
-                ev_data->fd = event_pool->reg[lastidx].fd;
-                ev_data->idx = idx;
+        if (found)
+                /* release the reference taken by event_register_epoll */
+                event_slot_unref (event_pool, slot, idx);
 
-                ret = epoll_ctl (event_pool->fd, EPOLL_CTL_MOD, ev_data->fd,
-                                 &epoll_event);
-                if (ret == -1) {
-                        gf_log ("epoll", GF_LOG_ERROR,
-                                "fail to modify fd(=%d) index %d to %d (%s)",
-                                ev_data->fd, event_pool->used, idx,
-                                strerror (errno));
-                        goto unlock;
-                }
-
-                /* just replace the unregistered idx by last one */
-                event_pool->reg[idx] = event_pool->reg[lastidx];
-                event_pool->used--;
-        }
-unlock:
-        pthread_mutex_unlock (&event_pool->mutex);
+        event_slot_unref (event_pool, slot, idx);
 
 out:
         return ret;
@@ -274,62 +455,43 @@ static int
 event_select_on_epoll (struct event_pool *event_pool, int fd, int idx_hint,
                        int poll_in, int poll_out)
 {
-        int idx = -1;
-        int ret = -1;
-
-        struct epoll_event epoll_event = {0, };
-        struct event_data *ev_data = (void *)&epoll_event.data;
+        int                      idx = idx_hint;
+        int                      ret = -1;
+        struct epoll_event       epoll_event = {0, };
+        struct event_data       *ev_data = (void *)&epoll_event.data;
+        struct event_slot_epoll *slot = NULL;
 
 
         GF_VALIDATE_OR_GOTO ("event", event_pool, out);
 
-        pthread_mutex_lock (&event_pool->mutex);
-        {
-                idx = __event_getindex (event_pool, fd, idx_hint);
+        slot = event_slot_get_fd (event_pool, fd, &idx);
+        if (!slot) {
+                gf_log ("epoll", GF_LOG_ERROR,
+                        "index not found for fd=%d (idx_hint=%d)",
+                        fd, idx_hint);
+                errno = ENOENT;
+                goto out;
+        }
 
-                if (idx == -1) {
-                        gf_log ("epoll", GF_LOG_ERROR,
-                                "index not found for fd=%d (idx_hint=%d)",
-                                fd, idx_hint);
+        LOCK (&slot->lock);
+        {
+                if (slot->fd != fd) {
                         errno = ENOENT;
                         goto unlock;
                 }
 
-                switch (poll_in) {
-                case 1:
-                        event_pool->reg[idx].events |= EPOLLIN;
-                        break;
-                case 0:
-                        event_pool->reg[idx].events &= ~EPOLLIN;
-                        break;
-                case -1:
-                        /* do nothing */
-                        break;
-                default:
-                        gf_log ("epoll", GF_LOG_ERROR,
-                                "invalid poll_in value %d", poll_in);
-                        break;
-                }
+                __event_slot_update_events (slot, poll_in, poll_out);
 
-                switch (poll_out) {
-                case 1:
-                        event_pool->reg[idx].events |= EPOLLOUT;
-                        break;
-                case 0:
-                        event_pool->reg[idx].events &= ~EPOLLOUT;
-                        break;
-                case -1:
-                        /* do nothing */
-                        break;
-                default:
-                        gf_log ("epoll", GF_LOG_ERROR,
-                                "invalid poll_out value %d", poll_out);
-                        break;
+                if (slot->in_handler) {
+                        /* the dispatcher re-arms with the updated events
+                           once the handler returns */
+                        ret = 0;
+                        goto unlock;
                 }
 
-                epoll_event.events = event_pool->reg[idx].events;
-                ev_data->fd = fd;
+                epoll_event.events = slot->events | EPOLLONESHOT;
                 ev_data->idx = idx;
+                ev_data->gen = slot->gen;
 
                 ret = epoll_ctl (event_pool->fd, EPOLL_CTL_MOD, fd,
                                  &epoll_event);
@@ -340,8 +502,12 @@ event_select_on_epoll (struct event_pool *event_pool, int fd, int idx_hint,
                 }
         }
 unlock:
-        pthread_mutex_unlock (&event_pool->mutex);
+        UNLOCK (&slot->lock);
+
+        event_slot_unref (event_pool, slot, idx);
 
+        if (ret == 0)
+                ret = idx;
 out:
         return ret;
 }
@@ -349,42 +515,180 @@ out:
 
 static int
 event_dispatch_epoll_handler (struct event_pool *event_pool,
-                              struct epoll_event *events, int i)
+                              struct epoll_event *event)
 {
-        struct event_data  *event_data = NULL;
-        event_handler_t     handler = NULL;
-        void               *data = NULL;
-        int                 idx = -1;
-        int                 ret = -1;
+        struct event_data       *ev_data = NULL;
+        struct event_slot_epoll *slot = NULL;
+        struct epoll_event       epoll_event = {0, };
+        event_handler_t          handler = NULL;
+        void                    *data = NULL;
+        int                      idx = -1;
+        int                      gen = -1;
+        int                      fd = -1;
+        int                      ret = -1;
+
+
+        ev_data = (void *)&event->data;
+        idx = ev_data->idx;
+        gen = ev_data->gen;
+
+        slot = event_slot_get (event_pool, idx);
+        if (!slot) {
+                gf_log ("epoll", GF_LOG_ERROR,
+                        "no slot for idx=%d (gen=%d)", idx, gen);
+                goto out;
+        }
+
+        LOCK (&slot->lock);
+        {
+                fd = slot->fd;
+                if (fd == -1 || slot->gen != gen) {
+                        /* fd was unregistered after this event was
+                           queued, possibly with the slot reused since */
+                        gf_log ("epoll", GF_LOG_DEBUG,
+                                "stale event for idx=%d (gen=%d, "
+                                "slot gen=%d)", idx, gen, slot->gen);
+                        goto pre_unlock;
+                }
+
+                handler = slot->handler;
+                data = slot->data;
+                slot->in_handler++;
+        }
+pre_unlock:
+        UNLOCK (&slot->lock);
 
+        if (!handler)
+                goto unref;
 
-        event_data = (void *)&events[i].data;
-        handler = NULL;
-        data = NULL;
+        ret = handler (fd, idx, data,
+                       (event->events & (EPOLLIN|EPOLLPRI)),
+                       (event->events & (EPOLLOUT)),
+                       (event->events & (EPOLLERR|EPOLLHUP)));
 
-        pthread_mutex_lock (&event_pool->mutex);
+        LOCK (&slot->lock);
         {
-                idx = __event_getindex (event_pool, event_data->fd,
-                                        event_data->idx);
+                slot->in_handler--;
 
-                if (idx == -1) {
+                if (slot->fd != fd || slot->gen != gen || slot->in_handler)
+                        /* unregistered, or someone else re-arms */
+                        goto post_unlock;
+
+                epoll_event.events = slot->events | EPOLLONESHOT;
+                ev_data = (void *)&epoll_event.data;
+                ev_data->idx = idx;
+                ev_data->gen = gen;
+
+                if (epoll_ctl (event_pool->fd, EPOLL_CTL_MOD, fd,
+                               &epoll_event) == -1)
                         gf_log ("epoll", GF_LOG_ERROR,
-                                "index not found for fd(=%d) (idx_hint=%d)",
-                                event_data->fd, event_data->idx);
-                        goto unlock;
+                                "failed to re-arm fd(=%d) (%s)", fd,
+                                strerror (errno));
+        }
+post_unlock:
+        UNLOCK (&slot->lock);
+unref:
+        event_slot_unref (event_pool, slot, idx);
+out:
+        return ret;
+}
+
+
+static int __event_dispatch_epoll_spawn (struct event_pool *event_pool,
+                                         int index);
+
+
+static void *
+event_dispatch_epoll_worker (void *data)
+{
+        struct event_thread_data *ev_data = data;
+        struct event_pool        *event_pool = NULL;
+        struct epoll_event        event = {0, };
+        int                       myindex = -1;
+        int                       ret = -1;
+
+        event_pool = ev_data->event_pool;
+        myindex = ev_data->event_index;
+        GF_FREE (ev_data);
+
+        gf_log ("epoll", GF_LOG_DEBUG, "started epoll dispatcher %d",
+                myindex);
+
+        for (;;) {
+                if (myindex && myindex >= event_pool->eventthreadcount) {
+                        pthread_mutex_lock (&event_pool->mutex);
+                        {
+                                /* thread count may have gone up again */
+                                ret = (myindex >=
+                                       event_pool->eventthreadcount);
+                                if (ret) {
+                                        event_pool->pollers[myindex] = 0;
+                                        event_pool->activethreadcount--;
+                                }
+                        }
+                        pthread_mutex_unlock (&event_pool->mutex);
+
+                        if (ret)
+                                break;
                 }
 
-                handler = event_pool->reg[idx].handler;
-                data = event_pool->reg[idx].data;
+                /* one event per wakeup so that a burst of ready fds is
+                   spread over all the dispatchers */
+                ret = epoll_wait (event_pool->fd, &event, 1, -1);
+
+                if (ret == 0)
+                        /* timeout */
+                        continue;
+
+                if (ret == -1) {
+                        if (errno != EINTR)
+                                gf_log ("epoll", GF_LOG_WARNING,
+                                        "epoll_wait failed (%s)",
+                                        strerror (errno));
+                        continue;
+                }
+
+                event_dispatch_epoll_handler (event_pool, &event);
+                event_pool->dispatched[myindex]++;
         }
-unlock:
-        pthread_mutex_unlock (&event_pool->mutex);
 
-        if (handler)
-                ret = handler (event_data->fd, event_data->idx, data,
-                               (events[i].events & (EPOLLIN|EPOLLPRI)),
-                               (events[i].events & (EPOLLOUT)),
-                               (events[i].events & (EPOLLERR|EPOLLHUP)));
+        gf_log ("epoll", GF_LOG_DEBUG, "exited epoll dispatcher %d",
+                myindex);
+
+        return NULL;
+}
+
+
+static int
+__event_dispatch_epoll_spawn (struct event_pool *event_pool, int index)
+{
+        struct event_thread_data *ev_data = NULL;
+        pthread_t                 t_id;
+        int                       ret = -1;
+
+        ev_data = GF_CALLOC (1, sizeof (*ev_data), gf_common_mt_event_pool);
+        if (!ev_data)
+                goto out;
+
+        ev_data->event_pool = event_pool;
+        ev_data->event_index = index;
+
+        ret = pthread_create (&t_id, NULL, event_dispatch_epoll_worker,
+                              ev_data);
+        if (ret) {
+                gf_log ("epoll", GF_LOG_WARNING,
+                        "failed to start epoll dispatcher %d (%s)",
+                        index, strerror (ret));
+                GF_FREE (ev_data);
+                ret = -1;
+                goto out;
+        }
+
+        pthread_detach (t_id);
+
+        event_pool->pollers[index] = t_id;
+        event_pool->activethreadcount++;
+out:
         return ret;
 }
 
@@ -392,72 +696,88 @@ unlock:
 static int
 event_dispatch_epoll (struct event_pool *event_pool)
 {
-        struct epoll_event *events = NULL;
-        int                 size = 0;
-        int                 i = 0;
-        int                 ret = -1;
+        struct event_thread_data *ev_data = NULL;
+        int                       i = 0;
+        int                       ret = -1;
 
         GF_VALIDATE_OR_GOTO ("event", event_pool, out);
 
-        while (1) {
-                pthread_mutex_lock (&event_pool->mutex);
-                {
-                        while (event_pool->used == 0)
-                                pthread_cond_wait (&event_pool->cond,
-                                                   &event_pool->mutex);
+        ev_data = GF_CALLOC (1, sizeof (*ev_data), gf_common_mt_event_pool);
+        if (!ev_data)
+                goto out;
 
-                        if (event_pool->used > event_pool->evcache_size) {
-                                GF_FREE (event_pool->evcache);
+        ev_data->event_pool = event_pool;
+        ev_data->event_index = 0;
 
-                                event_pool->evcache = events = NULL;
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                /* the calling thread is dispatcher 0 and never exits */
+                event_pool->pollers[0] = pthread_self ();
+                event_pool->activethreadcount = 1;
 
-                                event_pool->evcache_size =
-                                        event_pool->used + 256;
+                for (i = 1; i < event_pool->eventthreadcount; i++)
+                        __event_dispatch_epoll_spawn (event_pool, i);
+        }
+        pthread_mutex_unlock (&event_pool->mutex);
 
-                                events = GF_CALLOC (event_pool->evcache_size,
-                                                    sizeof (struct epoll_event),
-                                                    gf_common_mt_epoll_event);
-                                if (!events)
-                                        break;
+        event_dispatch_epoll_worker (ev_data);
 
-                                event_pool->evcache = events;
-                        }
-                }
-                pthread_mutex_unlock (&event_pool->mutex);
+out:
+        return ret;
+}
 
-                ret = epoll_wait (event_pool->fd, event_pool->evcache,
-                                  event_pool->evcache_size, -1);
 
-                if (ret == 0)
-                        /* timeout */
-                        continue;
+static int
+event_reconfigure_threads_epoll (struct event_pool *event_pool, int value)
+{
+        int i = 0;
 
-                if (ret == -1 && errno == EINTR)
-                        /* sys call */
-                        continue;
+        GF_VALIDATE_OR_GOTO ("event", event_pool, out);
 
-                size = ret;
+        if (value < 1)
+                value = 1;
 
-                for (i = 0; i < size; i++) {
-                        if (!events || !events[i].events)
-                                continue;
+        if (value > EVENT_MAX_THREADS) {
+                gf_log ("epoll", GF_LOG_WARNING,
+                        "limiting event threads to %d (asked for %d)",
+                        EVENT_MAX_THREADS, value);
+                value = EVENT_MAX_THREADS;
+        }
 
-                        ret = event_dispatch_epoll_handler (event_pool,
-                                                            events, i);
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                if (event_pool->eventthreadcount != value)
+                        gf_log ("epoll", GF_LOG_INFO,
+                                "changing event threads from %d to %d",
+                                event_pool->eventthreadcount, value);
+
+                event_pool->eventthreadcount = value;
+
+                /* threads beyond the new count exit on their own after
+                   their next event; nothing to start before dispatch */
+                if (!event_pool->activethreadcount)
+                        goto unlock;
+
+                for (i = 1; i < value; i++) {
+                        if (!event_pool->pollers[i])
+                                __event_dispatch_epoll_spawn (event_pool, i);
                 }
         }
+unlock:
+        pthread_mutex_unlock (&event_pool->mutex);
 
 out:
-        return ret;
+        return 0;
 }
 
 
 struct event_ops event_ops_epoll = {
-        .new              = event_pool_new_epoll,
-        .event_register   = event_register_epoll,
-        .event_select_on  = event_select_on_epoll,
-        .event_unregister = event_unregister_epoll,
-        .event_dispatch   = event_dispatch_epoll
+        .new                       = event_pool_new_epoll,
+        .event_register            = event_register_epoll,
+        .event_select_on           = event_select_on_epoll,
+        .event_unregister          = event_unregister_epoll,
+        .event_dispatch            = event_dispatch_epoll,
+        .event_reconfigure_threads = event_reconfigure_threads_epoll,
 };
 
 #endif
@@ -415,6 +415,8 @@ event_dispatch_poll (struct event_pool *event_pool)
 
         GF_VALIDATE_OR_GOTO ("event", event_pool, out);
 
+        event_pool->activethreadcount = 1;
+
         while (1) {
                 size = event_dispatch_poll_resize (event_pool, ufds, size);
                 ufds = event_pool->evcache;
@@ -434,6 +436,7 @@ event_dispatch_poll (struct event_pool *event_pool)
                                 continue;
 
                         event_dispatch_poll_handler (event_pool, ufds, i);
+                        event_pool->dispatched[0]++;
                 }
         }
 
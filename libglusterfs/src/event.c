@@ -20,6 +20,7 @@
 #include "event.h"
 #include "mem-pool.h"
 #include "common-utils.h"
+#include "statedump.h"
 
 #ifndef _CONFIG_H
 #define _CONFIG_H
@@ -54,6 +55,9 @@ event_pool_new (int count)
                         event_pool->ops = &event_ops_poll;
         }
 
+        if (event_pool)
+                event_pool->eventthreadcount = 1;
+
         return event_pool;
 }
 
@@ -115,3 +119,52 @@ event_dispatch (struct event_pool *event_pool)
 out:
         return ret;
 }
+
+
+int
+event_reconfigure_threads (struct event_pool *event_pool, int value)
+{
+        int ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("event", event_pool, out);
+
+        if (!event_pool->ops->event_reconfigure_threads) {
+                /* dispatcher is single threaded by design */
+                ret = 0;
+                goto out;
+        }
+
+        ret = event_pool->ops->event_reconfigure_threads (event_pool, value);
+
+out:
+        return ret;
+}
+
+
+void
+event_pool_stats_dump (struct event_pool *event_pool)
+{
+        char key[GF_DUMP_MAX_BUF_LEN];
+        int  i = 0;
+
+        if (!event_pool)
+                return;
+
+        gf_proc_dump_add_section ("event-pool");
+
+        gf_proc_dump_write ("thread-count", "%d",
+                            event_pool->eventthreadcount);
+        gf_proc_dump_write ("active-thread-count", "%d",
+                            event_pool->activethreadcount);
+
+        for (i = 0; i < EVENT_MAX_THREADS; i++) {
+                if (!event_pool->dispatched[i] &&
+                    i >= event_pool->activethreadcount)
+                        continue;
+
+                gf_proc_dump_build_key (key, "event-pool",
+                                        "thread[%d].dispatched", i);
+                gf_proc_dump_write (key, "%"PRIu64,
+                                    event_pool->dispatched[i]);
+        }
+}
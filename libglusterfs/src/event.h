@@ -17,12 +17,17 @@
 #endif
 
 #include <pthread.h>
+#include <stdint.h>
+
+#define EVENT_EPOLL_TABLES 1024
+#define EVENT_EPOLL_SLOTS  1024
+#define EVENT_MAX_THREADS  32
 
 struct event_pool;
 struct event_ops;
 struct event_data {
-	int fd;
 	int idx;
+	int gen;
 } __attribute__ ((__packed__, __may_alias__));
 
 
@@ -51,6 +56,17 @@ struct event_pool {
 
 	void *evcache;
 	int evcache_size;
+
+	/* epoll: fd registrations live in lazily allocated tables of
+	   EVENT_EPOLL_SLOTS slots each. A table is never freed or moved
+	   once allocated, so dispatchers can index it without the mutex */
+	void *ereg[EVENT_EPOLL_TABLES];
+	int slots_used[EVENT_EPOLL_TABLES];
+
+	int eventthreadcount; /* number of dispatcher threads wanted */
+	int activethreadcount; /* number of dispatcher threads running */
+	pthread_t pollers[EVENT_MAX_THREADS];
+	uint64_t dispatched[EVENT_MAX_THREADS]; /* written by owner only */
 };
 
 struct event_ops {
@@ -66,6 +82,9 @@ struct event_ops {
         int (*event_unregister) (struct event_pool *event_pool, int fd, int idx);
 
         int (*event_dispatch) (struct event_pool *event_pool);
+
+        int (*event_reconfigure_threads) (struct event_pool *event_pool,
+                                          int newcount);
 };
 
 struct event_pool * event_pool_new (int count);
@@ -76,5 +95,7 @@ int event_register (struct event_pool *event_pool, int fd,
 		    void *data, int poll_in, int poll_out);
 int event_unregister (struct event_pool *event_pool, int fd, int idx);
 int event_dispatch (struct event_pool *event_pool);
+int event_reconfigure_threads (struct event_pool *event_pool, int value);
+void event_pool_stats_dump (struct event_pool *event_pool);
 
 #endif /* _EVENT_H_ */
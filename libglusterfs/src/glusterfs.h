@@ -105,6 +105,10 @@
 #define GLUSTERFS_PARENT_ENTRYLK "glusterfs.parent-entrylk"
 #define QUOTA_SIZE_KEY "trusted.glusterfs.quota.size"
 #define GFID_TO_PATH_KEY "glusterfs.gfid2path"
+/* "glusterfs.seek-data.<offset>" on an fd: the next data extent */
+#define GF_SEEK_DATA_KEY "glusterfs.seek-data"
+/* rchecksum xdata: strong checksum wanted (request) and used (reply) */
+#define GF_RCHECKSUM_TYPE_KEY "glusterfs.rchecksum-type"
 
 /* Index xlator related */
 #define GF_XATTROP_INDEX_GFID "glusterfs.xattrop_index_gfid"
@@ -319,6 +323,9 @@ struct _cmd_args {
         unsigned         uid_map_root;
         int              background_qlen;
         int              congestion_threshold;
+        int              reader_thread_count;
+        int              use_readdirp;
+        uint64_t         fuse_max_write;
         char            *fuse_mountopts;
 
 	/* key args */
@@ -417,6 +424,8 @@ typedef enum {
         GF_EVENT_AUTH_FAILED,
         GF_EVENT_VOLUME_DEFRAG,
         GF_EVENT_PARENT_DOWN,
+        GF_EVENT_UPCALL,
+        GF_EVENT_CLIENT_DESTROY,
         GF_EVENT_MAXVAL,
 } glusterfs_event_t;
 
@@ -40,9 +40,32 @@
                 }                                                       \
         }
 
+/* the lru list may outgrow its limit by this much before it is pruned,
+   so that pruning is done in batches */
+#define INODE_LRU_SLACK(limit)  ((limit) >> 4)
+
+#define INODE_HASH_LOCK(table, hash)                                    \
+        (&(table)->hash_locks[(hash) % INODE_TABLE_LOCK_STRIPES])
+
+#define INODE_NAME_LOCK(table, hash)                                    \
+        (&(table)->name_locks[(hash) % INODE_TABLE_LOCK_STRIPES])
+
 static inode_t *
 __inode_unref (inode_t *inode);
 
+static void
+__dentry_unhash (dentry_t *dentry);
+
+
+/* called whenever the dentries of @inode change, which changes its path
+   and those of all the inodes below it */
+static inline void
+__inode_path_invalidate (inode_t *inode)
+{
+        if (inode->path)
+                inode->table->path_gen++;
+}
+
 static int
 inode_table_prune (inode_table_t *table);
 
@@ -93,8 +116,14 @@ __dentry_hash (dentry_t *dentry)
         hash = hash_dentry (dentry->parent, dentry->name,
                             table->hashsize);
 
-        list_del_init (&dentry->hash);
-        list_add (&dentry->hash, &table->name_hash[hash]);
+        __dentry_unhash (dentry);
+        __inode_path_invalidate (dentry->inode);
+
+        pthread_mutex_lock (INODE_NAME_LOCK (table, hash));
+        {
+                list_add (&dentry->hash, &table->name_hash[hash]);
+        }
+        pthread_mutex_unlock (INODE_NAME_LOCK (table, hash));
 }
 
 
@@ -113,12 +142,29 @@ __is_dentry_hashed (dentry_t *dentry)
 static void
 __dentry_unhash (dentry_t *dentry)
 {
+        inode_table_t   *table = NULL;
+        int              hash = 0;
+
         if (!dentry) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "dentry not found");
                 return;
         }
 
-        list_del_init (&dentry->hash);
+        /* only changed under table->lock, which we hold */
+        if (list_empty (&dentry->hash))
+                return;
+
+        __inode_path_invalidate (dentry->inode);
+
+        table = dentry->inode->table;
+        hash = hash_dentry (dentry->parent, dentry->name,
+                            table->hashsize);
+
+        pthread_mutex_lock (INODE_NAME_LOCK (table, hash));
+        {
+                list_del_init (&dentry->hash);
+        }
+        pthread_mutex_unlock (INODE_NAME_LOCK (table, hash));
 }
 
 
@@ -132,6 +178,7 @@ __dentry_unset (dentry_t *dentry)
 
         __dentry_unhash (dentry);
 
+        __inode_path_invalidate (dentry->inode);
         list_del_init (&dentry->inode_list);
 
         GF_FREE (dentry->name);
@@ -224,12 +271,24 @@ __is_dentry_cyclic (dentry_t *dentry)
 static void
 __inode_unhash (inode_t *inode)
 {
+        int            hash = 0;
+
         if (!inode) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "inode not found");
                 return;
         }
 
-        list_del_init (&inode->hash);
+        /* only changed under table->lock, which we hold */
+        if (list_empty (&inode->hash))
+                return;
+
+        hash = hash_gfid (inode->gfid, 65536);
+
+        pthread_mutex_lock (INODE_HASH_LOCK (inode->table, hash));
+        {
+                list_del_init (&inode->hash);
+        }
+        pthread_mutex_unlock (INODE_HASH_LOCK (inode->table, hash));
 }
 
 
@@ -259,8 +318,12 @@ __inode_hash (inode_t *inode)
         table = inode->table;
         hash = hash_gfid (inode->gfid, 65536);
 
-        list_del_init (&inode->hash);
-        list_add (&inode->hash, &table->inode_hash[hash]);
+        pthread_mutex_lock (INODE_HASH_LOCK (table, hash));
+        {
+                list_del_init (&inode->hash);
+                list_add (&inode->hash, &table->inode_hash[hash]);
+        }
+        pthread_mutex_unlock (INODE_HASH_LOCK (table, hash));
 }
 
 
@@ -323,6 +386,7 @@ __inode_destroy (inode_t *inode)
 
         GF_FREE (inode->_ctx);
 noctx:
+        GF_FREE (inode->path);
         LOCK_DESTROY (&inode->lock);
         //  memset (inode, 0xb, sizeof (*inode));
         mem_put (inode);
@@ -377,12 +441,56 @@ __inode_retire (inode_t *inode)
 
         __inode_unhash (inode);
 
+        /* no inode below can be in the table, as each would hold a ref on
+           this one through its dentry */
+        GF_FREE (inode->path);
+        inode->path = NULL;
+
         list_for_each_entry_safe (dentry, t, &inode->dentry_list, inode_list) {
                 __dentry_unset (dentry);
         }
 }
 
 
+/* Takes a ref on an inode which has one already, without table->lock.
+   Refs from and to 0 move the inode between the lru and active lists and
+   are only taken or dropped under table->lock. */
+static gf_boolean_t
+inode_ref_fast (inode_t *inode)
+{
+        uint32_t ref = 0;
+        uint32_t old = 0;
+
+        ref = inode->ref;
+        while (ref) {
+                old = __sync_val_compare_and_swap (&inode->ref, ref, ref + 1);
+                if (old == ref)
+                        return _gf_true;
+                ref = old;
+        }
+
+        return _gf_false;
+}
+
+
+static gf_boolean_t
+inode_unref_fast (inode_t *inode)
+{
+        uint32_t ref = 0;
+        uint32_t old = 0;
+
+        ref = inode->ref;
+        while (ref > 1) {
+                old = __sync_val_compare_and_swap (&inode->ref, ref, ref - 1);
+                if (old == ref)
+                        return _gf_true;
+                ref = old;
+        }
+
+        return _gf_false;
+}
+
+
 static inode_t *
 __inode_unref (inode_t *inode)
 {
@@ -394,9 +502,7 @@ __inode_unref (inode_t *inode)
 
         GF_ASSERT (inode->ref);
 
-        --inode->ref;
-
-        if (!inode->ref) {
+        if (__sync_sub_and_fetch (&inode->ref, 1) == 0) {
                 inode->table->active_size--;
 
                 if (inode->nlookup)
@@ -415,11 +521,10 @@ __inode_ref (inode_t *inode)
         if (!inode)
                 return NULL;
 
-        if (!inode->ref) {
+        if (__sync_fetch_and_add (&inode->ref, 1) == 0) {
                 inode->table->lru_size--;
                 __inode_activate (inode);
         }
-        inode->ref++;
 
         return inode;
 }
@@ -433,6 +538,12 @@ inode_unref (inode_t *inode)
         if (!inode)
                 return NULL;
 
+        if (__is_root_gfid (inode->gfid))
+                return inode;
+
+        if (inode_unref_fast (inode))
+                return inode;
+
         table = inode->table;
 
         pthread_mutex_lock (&table->lock);
@@ -455,6 +566,9 @@ inode_ref (inode_t *inode)
         if (!inode)
                 return NULL;
 
+        if (inode_ref_fast (inode))
+                return inode;
+
         table = inode->table;
 
         pthread_mutex_lock (&table->lock);
@@ -496,6 +610,7 @@ __dentry_create (inode_t *inode, inode_t *parent, const char *name)
         if (parent)
                 newd->parent = __inode_ref (parent);
 
+        __inode_path_invalidate (inode);
         list_add (&newd->inode_list, &inode->dentry_list);
         newd->inode = inode;
 
@@ -626,8 +741,10 @@ __dentry_grep (inode_table_t *table, inode_t *parent, const char *name)
 inode_t *
 inode_grep (inode_table_t *table, inode_t *parent, const char *name)
 {
-        inode_t   *inode = NULL;
-        dentry_t  *dentry = NULL;
+        inode_t         *inode = NULL;
+        dentry_t        *dentry = NULL;
+        pthread_mutex_t *lock = NULL;
+        gf_boolean_t     slow = _gf_false;
 
         if (!table || !parent || !name) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING,
@@ -635,6 +752,26 @@ inode_grep (inode_table_t *table, inode_t *parent, const char *name)
                 return NULL;
         }
 
+        lock = INODE_NAME_LOCK (table, hash_dentry (parent, name,
+                                                    table->hashsize));
+
+        pthread_mutex_lock (lock);
+        {
+                dentry = __dentry_grep (table, parent, name);
+
+                if (dentry)
+                        inode = dentry->inode;
+
+                if (inode && !inode_ref_fast (inode)) {
+                        inode = NULL;
+                        slow = _gf_true;
+                }
+        }
+        pthread_mutex_unlock (lock);
+
+        if (!slow)
+                return inode;
+
         pthread_mutex_lock (&table->lock);
         {
                 dentry = __dentry_grep (table, parent, name);
@@ -698,9 +835,10 @@ int
 inode_grep_for_gfid (inode_table_t *table, inode_t *parent, const char *name,
                      uuid_t gfid, ia_type_t *type)
 {
-        inode_t   *inode = NULL;
-        dentry_t  *dentry = NULL;
-        int        ret = -1;
+        inode_t         *inode = NULL;
+        dentry_t        *dentry = NULL;
+        pthread_mutex_t *lock = NULL;
+        int              ret = -1;
 
         if (!table || !parent || !name) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING,
@@ -708,7 +846,10 @@ inode_grep_for_gfid (inode_table_t *table, inode_t *parent, const char *name,
                 return ret;
         }
 
-        pthread_mutex_lock (&table->lock);
+        lock = INODE_NAME_LOCK (table, hash_dentry (parent, name,
+                                                    table->hashsize));
+
+        pthread_mutex_lock (lock);
         {
                 dentry = __dentry_grep (table, parent, name);
 
@@ -721,7 +862,7 @@ inode_grep_for_gfid (inode_table_t *table, inode_t *parent, const char *name,
                         ret = 0;
                 }
         }
-        pthread_mutex_unlock (&table->lock);
+        pthread_mutex_unlock (lock);
 
         return ret;
 }
@@ -775,13 +916,32 @@ out:
 inode_t *
 inode_find (inode_table_t *table, uuid_t gfid)
 {
-        inode_t   *inode = NULL;
+        inode_t         *inode = NULL;
+        pthread_mutex_t *lock = NULL;
+        gf_boolean_t     slow = _gf_false;
 
         if (!table) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "table not found");
                 return NULL;
         }
 
+        /* inodes in use are found and ref'd under their bucket lock only,
+           the others need table->lock to be moved off the lru list */
+        lock = INODE_HASH_LOCK (table, hash_gfid (gfid, 65536));
+
+        pthread_mutex_lock (lock);
+        {
+                inode = __inode_find (table, gfid);
+                if (inode && !inode_ref_fast (inode)) {
+                        inode = NULL;
+                        slow = _gf_true;
+                }
+        }
+        pthread_mutex_unlock (lock);
+
+        if (!slow)
+                return inode;
+
         pthread_mutex_lock (&table->lock);
         {
                 inode = __inode_find (table, gfid);
@@ -1121,100 +1281,224 @@ inode_parent (inode_t *inode, uuid_t pargfid, const char *name)
 }
 
 
-int
-__inode_path (inode_t *inode, const char *name, char **bufp)
+static int
+__inode_path_cached (inode_t *inode)
 {
-        inode_table_t *table = NULL;
-        inode_t       *itrav = NULL;
-        dentry_t      *trav  = NULL;
-        size_t         i     = 0, size = 0;
-        int64_t        ret   = 0;
-        int            len   = 0;
-        char          *buf   = NULL;
+        return (inode->path && inode->path_gen == inode->table->path_gen);
+}
 
-        if (!inode || uuid_is_null (inode->gfid)) {
-                GF_ASSERT (0);
-                gf_log_callingfn (THIS->name, GF_LOG_WARNING, "invalid inode");
-                return -1;
-        }
 
-        table = inode->table;
+/* Walks up from @inode to the nearest ancestor whose path is cached, or to
+ * the root or an inode without dentries. Returns the length of the path
+ * below that ancestor and sets *basep to it. */
+static ssize_t
+__inode_path_measure (inode_t *inode, const char *name, inode_t **basep)
+{
+        inode_t  *itrav = NULL;
+        dentry_t *trav = NULL;
+        ssize_t   len = 0;
 
         itrav = inode;
-        for (trav = __dentry_search_arbit (itrav); trav;
-             trav = __dentry_search_arbit (itrav)) {
-                itrav = trav->parent;
-                i ++; /* "/" */
-                i += strlen (trav->name);
-                if (i > PATH_MAX) {
-                        gf_log (table->name, GF_LOG_CRITICAL,
+        while (!__inode_path_cached (itrav)) {
+                trav = __dentry_search_arbit (itrav);
+                if (!trav)
+                        break;
+
+                len += 1 + strlen (trav->name); /* "/" */
+                if (len > PATH_MAX) {
+                        gf_log (inode->table->name, GF_LOG_CRITICAL,
                                 "possible infinite loop detected, "
                                 "forcing break. name=(%s)", name);
-                        ret = -ENOENT;
-                        goto out;
+                        return -ENOENT;
                 }
+
+                itrav = trav->parent;
+        }
+
+        *basep = itrav;
+        return len;
+}
+
+
+static size_t
+__inode_path_base_len (inode_t *base)
+{
+        if (__inode_path_cached (base))
+                return base->path_len;
+
+        if (__is_root_gfid (base->gfid))
+                return 0;
+
+        /* "<gfid:00000000-0000-0000-0000-000000000000>"/path */
+        return GFID_STR_PFX_LEN;
+}
+
+
+/* Caches the leading part of @buf as the path of each directory from
+ * @inode (when it is one) up to @base. Any directory with a cached path
+ * has the paths of all of its ancestors cached, so a change to the
+ * dentries of one without a cached path cannot leave a stale path in any
+ * other inode. */
+static void
+__inode_path_cache (inode_t *inode, inode_t *base, const char *buf,
+                    size_t len)
+{
+        inode_t  *itrav = NULL;
+        dentry_t *trav = NULL;
+        char     *path = NULL;
+
+        itrav = inode;
+        for (;;) {
+                if ((itrav != inode || inode->ia_type == IA_IFDIR) &&
+                    !__is_root_gfid (itrav->gfid) &&
+                    !__inode_path_cached (itrav)) {
+                        path = GF_MALLOC (len + 1, gf_common_mt_char);
+                        if (!path) {
+                                /* ancestors cannot be cached, drop the
+                                   caches of the descendants */
+                                itrav->table->path_gen++;
+                                return;
+                        }
+
+                        memcpy (path, buf, len);
+                        path[len] = '\0';
+
+                        GF_FREE (itrav->path);
+                        itrav->path = path;
+                        itrav->path_len = len;
+                        itrav->path_gen = itrav->table->path_gen;
+                }
+
+                if (itrav == base)
+                        break;
+
+                trav = __dentry_search_arbit (itrav);
+                len -= 1 + strlen (trav->name);
+                itrav = trav->parent;
         }
+}
+
+
+/* Returns the length of the path of @inode, followed by "/@name" if given,
+ * and sets *basep for __inode_path_fill (). */
+static ssize_t
+__inode_path_len (inode_t *inode, const char *name, inode_t **basep)
+{
+        ssize_t len = 0;
+
+        len = __inode_path_measure (inode, name, basep);
+        if (len < 0)
+                return len;
+
+        len += __inode_path_base_len (*basep);
+        if (name)
+                len += 1 + strlen (name);
+
+        /* the root itself */
+        if (!len)
+                len = 1;
+
+        return len;
+}
+
+
+/* Writes the path of @len bytes measured by __inode_path_len () into @buf,
+ * which has room for the terminating '\0'. */
+static void
+__inode_path_fill (inode_t *inode, const char *name, inode_t *base,
+                   char *buf, size_t len)
+{
+        inode_t  *itrav = NULL;
+        dentry_t *trav = NULL;
+        size_t    i = len;
+        size_t    n = 0;
 
-        if (!__is_root_gfid (itrav->gfid)) {
-                /* "<gfid:00000000-0000-0000-0000-000000000000>"/path */
-                i += GFID_STR_PFX_LEN;
+        if (__is_root_gfid (inode->gfid) && !name) {
+                strcpy (buf, "/");
+                return;
         }
 
+        buf[i] = '\0';
+
         if (name) {
-                i++;
-                i += strlen (name);
+                n = strlen (name);
+                memcpy (buf + (i - n), name, n);
+                buf[i-n-1] = '/';
+                i -= (n + 1);
         }
 
-        ret = i;
-        size = i + 1;
-        buf = GF_CALLOC (size, sizeof (char), gf_common_mt_char);
-        if (buf) {
+        for (itrav = inode; itrav != base; itrav = trav->parent) {
+                trav = __dentry_search_arbit (itrav);
+                n = strlen (trav->name);
+                memcpy (buf + (i - n), trav->name, n);
+                buf[i-n-1] = '/';
+                i -= (n + 1);
+        }
 
-                buf[size - 1] = 0;
+        if (__inode_path_cached (base)) {
+                memcpy (buf, base->path, i);
+        } else if (i) {
+                snprintf (buf, GFID_STR_PFX_LEN, INODE_PATH_FMT,
+                          uuid_utoa (base->gfid));
+                buf[i-1] = '>';
+        }
 
-                if (name) {
-                        len = strlen (name);
-                        strncpy (buf + (i - len), name, len);
-                        buf[i-len-1] = '/';
-                        i -= (len + 1);
-                }
+        __inode_path_cache (inode, base, buf,
+                            name ? len - strlen (name) - 1 : len);
+}
 
-                itrav = inode;
-                for (trav = __dentry_search_arbit (itrav); trav;
-                     trav = __dentry_search_arbit (itrav)) {
-                        itrav = trav->parent;
-                        len = strlen (trav->name);
-                        strncpy (buf + (i - len), trav->name, len);
-                        buf[i-len-1] = '/';
-                        i -= (len + 1);
-                }
 
-                if (!__is_root_gfid (itrav->gfid)) {
-                        snprintf (&buf[i-GFID_STR_PFX_LEN], GFID_STR_PFX_LEN,
-                                  INODE_PATH_FMT, uuid_utoa (itrav->gfid));
-                        buf[i-1] = '>';
-                }
+int
+__inode_path (inode_t *inode, const char *name, char **bufp)
+{
+        inode_t *base = NULL;
+        char    *buf = NULL;
+        ssize_t  ret = 0;
+
+        if (!inode || uuid_is_null (inode->gfid)) {
+                GF_ASSERT (0);
+                gf_log_callingfn (THIS->name, GF_LOG_WARNING, "invalid inode");
+                return -1;
+        }
 
-                *bufp = buf;
-        } else {
+        ret = __inode_path_len (inode, name, &base);
+        if (ret < 0)
+                goto out;
+
+        buf = GF_MALLOC (ret + 1, gf_common_mt_char);
+        if (!buf) {
                 ret = -ENOMEM;
+                goto out;
         }
 
+        __inode_path_fill (inode, name, base, buf, ret);
 out:
-        if (__is_root_gfid (inode->gfid) && !name) {
-                ret = 1;
-                GF_FREE (buf);
-                buf = GF_CALLOC (ret + 1, sizeof (char), gf_common_mt_char);
-                if (buf) {
-                        strcpy (buf, "/");
-                        *bufp = buf;
-                } else {
-                        ret = -ENOMEM;
-                }
+        *bufp = buf;
+        return ret;
+}
+
+
+int
+__inode_path_buf (inode_t *inode, const char *name, char *buf, size_t size)
+{
+        inode_t *base = NULL;
+        ssize_t  ret = 0;
+
+        if (!inode || uuid_is_null (inode->gfid)) {
+                GF_ASSERT (0);
+                gf_log_callingfn (THIS->name, GF_LOG_WARNING, "invalid inode");
+                return -1;
         }
 
+        ret = __inode_path_len (inode, name, &base);
         if (ret < 0)
-                *bufp = NULL;
+                return ret;
+
+        if (ret >= size)
+                return -ERANGE;
+
+        __inode_path_fill (inode, name, base, buf, ret);
+
         return ret;
 }
 
@@ -1240,6 +1524,27 @@ inode_path (inode_t *inode, const char *name, char **bufp)
 }
 
 
+int
+inode_path_buf (inode_t *inode, const char *name, char *buf, size_t size)
+{
+        inode_table_t *table = NULL;
+        int            ret   = -1;
+
+        if (!inode)
+                return -1;
+
+        table = inode->table;
+
+        pthread_mutex_lock (&table->lock);
+        {
+                ret = __inode_path_buf (inode, name, buf, size);
+        }
+        pthread_mutex_unlock (&table->lock);
+
+        return ret;
+}
+
+
 static int
 inode_table_prune (inode_table_t *table)
 {
@@ -1252,6 +1557,13 @@ inode_table_prune (inode_table_t *table)
         if (!table)
                 return -1;
 
+        /* unlocked peek, most callers have nothing to retire */
+        if (list_empty (&table->purge) &&
+            (!table->lru_limit ||
+             (table->lru_size <= (table->lru_limit +
+                                  INODE_LRU_SLACK (table->lru_limit)))))
+                return 0;
+
         INIT_LIST_HEAD (&purge);
 
         pthread_mutex_lock (&table->lock);
@@ -1363,6 +1675,11 @@ inode_table_new (size_t lru_limit, xlator_t *xl)
                 INIT_LIST_HEAD (&new->name_hash[i]);
         }
 
+        for (i = 0; i < INODE_TABLE_LOCK_STRIPES; i++) {
+                pthread_mutex_init (&new->hash_locks[i], NULL);
+                pthread_mutex_init (&new->name_locks[i], NULL);
+        }
+
         INIT_LIST_HEAD (&new->active);
         INIT_LIST_HEAD (&new->lru);
         INIT_LIST_HEAD (&new->purge);
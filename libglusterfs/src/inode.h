@@ -20,6 +20,7 @@
 #include <sys/types.h>
 
 #define DEFAULT_INODE_MEMPOOL_ENTRIES   32 * 1024
+#define INODE_TABLE_LOCK_STRIPES        64
 #define INODE_PATH_FMT "<gfid:%s>"
 struct _inode_table;
 typedef struct _inode_table inode_table_t;
@@ -36,6 +37,16 @@ typedef struct _dentry dentry_t;
 #include "uuid.h"
 
 
+/*
+ * Locking: table->lock covers the dentries, the cached paths, the
+ * active/lru/purge lists and the ref and nlookup transitions from and to 0.
+ * Each bucket of inode_hash and name_hash is also guarded by one of the
+ * striped locks, taken inside table->lock by whoever (un)hashes, so that
+ * inode_find () and inode_grep () can search and take refs on inodes already
+ * in use without table->lock.
+ * Refs which do not go from or to 0 are updated atomically, nlookup is only
+ * changed under table->lock.
+ */
 struct _inode_table {
         pthread_mutex_t    lock;
         size_t             hashsize;    /* bucket size of inode hash and dentry hash */
@@ -45,6 +56,10 @@ struct _inode_table {
         uint32_t           lru_limit;   /* maximum LRU cache size */
         struct list_head  *inode_hash;  /* buckets for inode hash table */
         struct list_head  *name_hash;   /* buckets for dentry hash table */
+        pthread_mutex_t    hash_locks[INODE_TABLE_LOCK_STRIPES];
+                                        /* guard inode_hash buckets */
+        pthread_mutex_t    name_locks[INODE_TABLE_LOCK_STRIPES];
+                                        /* guard name_hash buckets */
         struct list_head   active;      /* list of inodes currently active (in an fop) */
         uint32_t           active_size; /* count of inodes in active list */
         struct list_head   lru;         /* list of inodes recently used.
@@ -52,6 +67,8 @@ struct _inode_table {
         uint32_t           lru_size;    /* count of inodes in lru list  */
         struct list_head   purge;       /* list of inodes to be purged soon */
         uint32_t           purge_size;  /* count of inodes in purge list */
+        uint64_t           path_gen;    /* bumped whenever cached paths of
+                                           inodes may have gone stale */
 
         struct mem_pool   *inode_pool;  /* memory pool for inodes */
         struct mem_pool   *dentry_pool; /* memory pool for dentrys */
@@ -93,6 +110,9 @@ struct _inode {
         struct list_head     dentry_list;   /* list of directory entries for this inode */
         struct list_head     hash;          /* hash table pointers */
         struct list_head     list;          /* active/lru/purge */
+        char                *path;          /* cached path of a directory */
+        size_t               path_len;
+        uint64_t             path_gen;      /* table->path_gen it is valid for */
 
 	struct _inode_ctx   *_ctx;    /* replacement for dict_t *(inode->ctx) */
 };
@@ -154,6 +174,14 @@ inode_path (inode_t *inode, const char *name, char **bufp);
 int
 __inode_path (inode_t *inode, const char *name, char **bufp);
 
+/* like inode_path (), into @buf of @size bytes. Returns the length of the
+   path, or -ERANGE when it does not fit */
+int
+inode_path_buf (inode_t *inode, const char *name, char *buf, size_t size);
+
+int
+__inode_path_buf (inode_t *inode, const char *name, char *buf, size_t size);
+
 inode_t *
 inode_from_path (inode_table_t *table, const char *path);
 
@@ -0,0 +1,245 @@
+/*
+  Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+  This file is part of GlusterFS.
+
+  This file is licensed to you under your choice of the GNU Lesser
+  General Public License, version 3 or any later version (LGPLv3 or
+  later), or the GNU General Public License, version 2 (GPLv2), in all
+  cases as published by the Free Software Foundation.
+*/
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <stddef.h>
+
+#include "interval-tree.h"
+
+
+static inline int
+__itree_height (struct itree_node *node)
+{
+        return node ? node->height : 0;
+}
+
+
+static inline void
+__itree_update (struct itree_node *node)
+{
+        int lh = __itree_height (node->left);
+        int rh = __itree_height (node->right);
+
+        node->height = 1 + ((lh > rh) ? lh : rh);
+
+        node->max_last = node->last;
+        if (node->left && node->left->max_last > node->max_last)
+                node->max_last = node->left->max_last;
+        if (node->right && node->right->max_last > node->max_last)
+                node->max_last = node->right->max_last;
+}
+
+
+static struct itree_node *
+__itree_rotate_right (struct itree_node *node)
+{
+        struct itree_node *left = node->left;
+
+        node->left = left->right;
+        left->right = node;
+
+        __itree_update (node);
+        __itree_update (left);
+
+        return left;
+}
+
+
+static struct itree_node *
+__itree_rotate_left (struct itree_node *node)
+{
+        struct itree_node *right = node->right;
+
+        node->right = right->left;
+        right->left = node;
+
+        __itree_update (node);
+        __itree_update (right);
+
+        return right;
+}
+
+
+static struct itree_node *
+__itree_balance (struct itree_node *node)
+{
+        int balance = 0;
+
+        __itree_update (node);
+
+        balance = __itree_height (node->left) - __itree_height (node->right);
+
+        if (balance > 1) {
+                if (__itree_height (node->left->left) <
+                    __itree_height (node->left->right))
+                        node->left = __itree_rotate_left (node->left);
+                return __itree_rotate_right (node);
+        }
+
+        if (balance < -1) {
+                if (__itree_height (node->right->right) <
+                    __itree_height (node->right->left))
+                        node->right = __itree_rotate_right (node->right);
+                return __itree_rotate_left (node);
+        }
+
+        return node;
+}
+
+
+/* intervals with the same start are ordered on their address, which
+ * keeps every node reachable by its key on removal */
+static inline int
+__itree_cmp (struct itree_node *a, struct itree_node *b)
+{
+        if (a->start != b->start)
+                return (a->start < b->start) ? -1 : 1;
+        if (a != b)
+                return ((uintptr_t) a < (uintptr_t) b) ? -1 : 1;
+        return 0;
+}
+
+
+static struct itree_node *
+__itree_insert (struct itree_node *node, struct itree_node *new)
+{
+        if (!node)
+                return new;
+
+        if (__itree_cmp (new, node) < 0)
+                node->left = __itree_insert (node->left, new);
+        else
+                node->right = __itree_insert (node->right, new);
+
+        return __itree_balance (node);
+}
+
+
+static struct itree_node *
+__itree_remove_min (struct itree_node *node, struct itree_node **min)
+{
+        if (!node->left) {
+                *min = node;
+                return node->right;
+        }
+
+        node->left = __itree_remove_min (node->left, min);
+
+        return __itree_balance (node);
+}
+
+
+static struct itree_node *
+__itree_remove (struct itree_node *node, struct itree_node *old)
+{
+        struct itree_node *min = NULL;
+        int                cmp = 0;
+
+        if (!node)
+                return NULL;
+
+        cmp = __itree_cmp (old, node);
+        if (cmp < 0) {
+                node->left = __itree_remove (node->left, old);
+        } else if (cmp > 0) {
+                node->right = __itree_remove (node->right, old);
+        } else {
+                if (!node->right)
+                        return node->left;
+
+                node->right = __itree_remove_min (node->right, &min);
+                min->left = node->left;
+                min->right = node->right;
+                node = min;
+        }
+
+        return __itree_balance (node);
+}
+
+
+static int
+__itree_foreach_overlap (struct itree_node *node, uint64_t start,
+                         uint64_t last, itree_fn_t fn, void *data)
+{
+        int ret = 0;
+
+        while (node && node->max_last >= start) {
+                ret = __itree_foreach_overlap (node->left, start, last, fn,
+                                               data);
+                if (ret)
+                        break;
+
+                /* everything further right starts beyond the range */
+                if (node->start > last)
+                        break;
+
+                if (node->last >= start) {
+                        ret = fn (node, data);
+                        if (ret)
+                                break;
+                }
+
+                node = node->right;
+        }
+
+        return ret;
+}
+
+
+void
+itree_node_init (struct itree_node *node, uint64_t start, uint64_t last)
+{
+        node->left     = NULL;
+        node->right    = NULL;
+        node->height   = 0;
+        node->start    = start;
+        node->last     = last;
+        node->max_last = last;
+}
+
+
+void
+itree_insert (struct itree_root *root, struct itree_node *node)
+{
+        node->left     = NULL;
+        node->right    = NULL;
+        node->height   = 1;
+        node->max_last = node->last;
+
+        root->node = __itree_insert (root->node, node);
+        root->count++;
+}
+
+
+void
+itree_remove (struct itree_root *root, struct itree_node *node)
+{
+        if (!itree_node_linked (node))
+                return;
+
+        root->node = __itree_remove (root->node, node);
+        root->count--;
+
+        node->left   = NULL;
+        node->right  = NULL;
+        node->height = 0;
+}
+
+
+int
+itree_foreach_overlap (struct itree_root *root, uint64_t start, uint64_t last,
+                       itree_fn_t fn, void *data)
+{
+        return __itree_foreach_overlap (root->node, start, last, fn, data);
+}
@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+  This file is part of GlusterFS.
+
+  This file is licensed to you under your choice of the GNU Lesser
+  General Public License, version 3 or any later version (LGPLv3 or
+  later), or the GNU General Public License, version 2 (GPLv2), in all
+  cases as published by the Free Software Foundation.
+*/
+
+#ifndef __INTERVAL_TREE_H__
+#define __INTERVAL_TREE_H__
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+
+/*
+ * Intrusive interval tree: an AVL tree ordered on the start of the
+ * intervals, each node also keeping the largest end found in its subtree,
+ * so that lookups of the intervals overlapping a range skip every subtree
+ * which cannot hold one.
+ *
+ * Like list.h, the node is embedded in the structure being indexed and
+ * no locking is done here.
+ */
+
+struct itree_node {
+        struct itree_node  *left;
+        struct itree_node  *right;
+        int                 height;    /* 0 when not in a tree */
+        uint64_t            start;
+        uint64_t            last;      /* inclusive */
+        uint64_t            max_last;  /* largest @last in the subtree */
+};
+
+struct itree_root {
+        struct itree_node  *node;
+        uint64_t            count;
+};
+
+/* called for each overlapping interval, a non-zero return stops the walk
+ * and is passed back to the caller */
+typedef int (*itree_fn_t) (struct itree_node *node, void *data);
+
+#define itree_entry(ptr, type, member)                                  \
+        ((type *)((char *)(ptr)-(unsigned long)(&((type *)0)->member)))
+
+static inline void
+itree_init (struct itree_root *root)
+{
+        root->node  = NULL;
+        root->count = 0;
+}
+
+static inline int
+itree_empty (struct itree_root *root)
+{
+        return (root->node == NULL);
+}
+
+static inline int
+itree_node_linked (struct itree_node *node)
+{
+        return (node->height != 0);
+}
+
+/* @last is inclusive, [0, UINT64_MAX] covers everything */
+void itree_node_init (struct itree_node *node, uint64_t start, uint64_t last);
+
+void itree_insert (struct itree_root *root, struct itree_node *node);
+
+void itree_remove (struct itree_root *root, struct itree_node *node);
+
+/* Walks the intervals overlapping [start, last] in the order of their
+ * start. The tree must not be modified from @fn. */
+int itree_foreach_overlap (struct itree_root *root, uint64_t start,
+                           uint64_t last, itree_fn_t fn, void *data);
+
+#endif /* __INTERVAL_TREE_H__ */
@@ -12,6 +12,8 @@
 #include "iobuf.h"
 #include "statedump.h"
 #include <stdio.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 
 
 /*
@@ -31,9 +33,31 @@ struct iobuf_init_config gf_iobuf_init_config[] = {
         {32 * 1024, 64},
         {128 * 1024, 32},
         {256 * 1024, 8},
+        {512 * 1024, 4},
         {1 * 1024 * 1024, 2},
 };
 
+
+/* Free iobufs parked by one thread, so that the common get/put pairs of
+ * the data path do not take any lock. A thread caches iobufs of the first
+ * pool it uses only; the cached iobufs stay active in their arenas.
+ */
+struct iobuf_cache {
+        struct list_head    list;       /* in iobuf_pool->caches */
+        struct iobuf_pool  *iobuf_pool; /* NULL once the pool is destroyed */
+        int                 count[GF_VARIABLE_IOBUF_COUNT];
+        struct iobuf       *iobufs[GF_VARIABLE_IOBUF_COUNT]
+                                  [GF_IOBUF_CACHE_SIZE];
+};
+
+static pthread_key_t    iobuf_cache_key;
+static pthread_once_t   iobuf_cache_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t  iobuf_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int              iobuf_cache_key_ok;
+
+static void __iobuf_put (struct iobuf *iobuf, struct iobuf_arena *iobuf_arena);
+
+
 int
 gf_iobuf_get_arena_index (size_t page_size)
 {
@@ -68,6 +92,118 @@ gf_iobuf_get_pagesize (size_t page_size)
         return size;
 }
 
+
+static int
+iobuf_current_node (void)
+{
+#if defined(GF_LINUX_HOST_OS) && defined(SYS_getcpu)
+        unsigned int cpu  = 0;
+        unsigned int node = 0;
+
+        if (syscall (SYS_getcpu, &cpu, &node, NULL) == 0)
+                return node % GF_IOBUF_MAX_NODES;
+#endif
+        return 0;
+}
+
+
+/* big page sizes have only a couple of iobufs per arena, a thread must not
+ * hold on to them */
+static int
+iobuf_cache_limit (int index)
+{
+        return min (GF_IOBUF_CACHE_SIZE,
+                    gf_iobuf_init_config[index].num_pages / 4);
+}
+
+
+static void
+iobuf_put_locked (struct iobuf *iobuf)
+{
+        struct iobuf_node *iobuf_node = iobuf->iobuf_arena->iobuf_node;
+
+        pthread_mutex_lock (&iobuf_node->mutex);
+        {
+                __iobuf_put (iobuf, iobuf->iobuf_arena);
+        }
+        pthread_mutex_unlock (&iobuf_node->mutex);
+}
+
+
+static void
+iobuf_cache_release (void *data)
+{
+        struct iobuf_cache *cache = data;
+        struct iobuf_pool  *iobuf_pool = NULL;
+        int                 i = 0;
+
+        pthread_mutex_lock (&iobuf_cache_mutex);
+        {
+                iobuf_pool = cache->iobuf_pool;
+                if (!iobuf_pool)
+                        goto unlock;
+
+                for (i = 0; i < GF_VARIABLE_IOBUF_COUNT; i++) {
+                        while (cache->count[i])
+                                iobuf_put_locked (cache->iobufs[i]
+                                                  [--cache->count[i]]);
+                }
+
+                pthread_mutex_lock (&iobuf_pool->mutex);
+                {
+                        list_del_init (&cache->list);
+                }
+                pthread_mutex_unlock (&iobuf_pool->mutex);
+        }
+unlock:
+        pthread_mutex_unlock (&iobuf_cache_mutex);
+
+        FREE (cache);
+}
+
+
+static void
+iobuf_cache_key_init (void)
+{
+        if (pthread_key_create (&iobuf_cache_key, iobuf_cache_release) == 0)
+                iobuf_cache_key_ok = 1;
+}
+
+
+static struct iobuf_cache *
+iobuf_cache_get (struct iobuf_pool *iobuf_pool)
+{
+        struct iobuf_cache *cache = NULL;
+
+        if (!iobuf_cache_key_ok)
+                return NULL;
+
+        cache = pthread_getspecific (iobuf_cache_key);
+        if (cache)
+                return (cache->iobuf_pool == iobuf_pool) ? cache : NULL;
+
+        cache = CALLOC (1, sizeof (*cache));
+        if (!cache)
+                return NULL;
+
+        if (pthread_setspecific (iobuf_cache_key, cache)) {
+                FREE (cache);
+                return NULL;
+        }
+
+        INIT_LIST_HEAD (&cache->list);
+        cache->iobuf_pool = iobuf_pool;
+
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                list_add (&cache->list, &iobuf_pool->caches);
+        }
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+        return cache;
+}
+
+
 void
 __iobuf_arena_init_iobufs (struct iobuf_arena *iobuf_arena)
 {
@@ -88,7 +224,6 @@ __iobuf_arena_init_iobufs (struct iobuf_arena *iobuf_arena)
         iobuf = iobuf_arena->iobufs;
         for (i = 0; i < iobuf_cnt; i++) {
                 INIT_LIST_HEAD (&iobuf->list);
-                LOCK_INIT (&iobuf->lock);
 
                 iobuf->iobuf_arena = iobuf_arena;
 
@@ -155,7 +290,8 @@ out:
 
 
 struct iobuf_arena *
-__iobuf_arena_alloc (struct iobuf_pool *iobuf_pool, size_t page_size,
+__iobuf_arena_alloc (struct iobuf_pool *iobuf_pool,
+                     struct iobuf_node *iobuf_node, size_t page_size,
                      int32_t num_iobufs)
 {
         struct iobuf_arena *iobuf_arena = NULL;
@@ -172,6 +308,7 @@ __iobuf_arena_alloc (struct iobuf_pool *iobuf_pool, size_t page_size,
         INIT_LIST_HEAD (&iobuf_arena->active.list);
         INIT_LIST_HEAD (&iobuf_arena->passive.list);
         iobuf_arena->iobuf_pool = iobuf_pool;
+        iobuf_arena->iobuf_node = iobuf_node;
 
         rounded_size = gf_iobuf_get_pagesize (page_size);
 
@@ -180,6 +317,8 @@ __iobuf_arena_alloc (struct iobuf_pool *iobuf_pool, size_t page_size,
 
         iobuf_arena->arena_size = rounded_size * num_iobufs;
 
+        /* pages are placed on the node that first touches them, which
+         * is a thread of @iobuf_node taking iobufs from this arena */
         iobuf_arena->mem_base = mmap (NULL, iobuf_arena->arena_size,
                                       PROT_READ|PROT_WRITE,
                                       MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
@@ -194,7 +333,7 @@ __iobuf_arena_alloc (struct iobuf_pool *iobuf_pool, size_t page_size,
                 goto err;
         }
 
-        iobuf_pool->arena_cnt++;
+        __sync_fetch_and_add (&iobuf_pool->arena_cnt, 1);
 
         return iobuf_arena;
 
@@ -207,13 +346,13 @@ out:
 
 
 struct iobuf_arena *
-__iobuf_arena_unprune (struct iobuf_pool *iobuf_pool, size_t page_size)
+__iobuf_arena_unprune (struct iobuf_node *iobuf_node, size_t page_size)
 {
         struct iobuf_arena *iobuf_arena  = NULL;
         struct iobuf_arena *tmp          = NULL;
         int                 index        = 0;
 
-        GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
+        GF_VALIDATE_OR_GOTO ("iobuf", iobuf_node, out);
 
         index = gf_iobuf_get_arena_index (page_size);
         if (index == -1) {
@@ -223,7 +362,7 @@ __iobuf_arena_unprune (struct iobuf_pool *iobuf_pool, size_t page_size)
                 return NULL;
         }
 
-        list_for_each_entry (tmp, &iobuf_pool->purge[index], list) {
+        list_for_each_entry (tmp, &iobuf_node->purge[index], list) {
                 list_del_init (&tmp->list);
                 iobuf_arena = tmp;
                 break;
@@ -234,7 +373,8 @@ out:
 
 
 struct iobuf_arena *
-__iobuf_pool_add_arena (struct iobuf_pool *iobuf_pool, size_t page_size,
+__iobuf_pool_add_arena (struct iobuf_pool *iobuf_pool,
+                        struct iobuf_node *iobuf_node, size_t page_size,
                         int32_t num_pages)
 {
         struct iobuf_arena *iobuf_arena  = NULL;
@@ -248,37 +388,38 @@ __iobuf_pool_add_arena (struct iobuf_pool *iobuf_pool, size_t page_size,
                 return NULL;
         }
 
-        iobuf_arena = __iobuf_arena_unprune (iobuf_pool, page_size);
+        iobuf_arena = __iobuf_arena_unprune (iobuf_node, page_size);
 
         if (!iobuf_arena)
-                iobuf_arena = __iobuf_arena_alloc (iobuf_pool, page_size,
-                                                   num_pages);
+                iobuf_arena = __iobuf_arena_alloc (iobuf_pool, iobuf_node,
+                                                   page_size, num_pages);
 
         if (!iobuf_arena) {
                 gf_log (THIS->name, GF_LOG_WARNING, "arena not found");
                 return NULL;
         }
 
-        list_add_tail (&iobuf_arena->list, &iobuf_pool->arenas[index]);
+        list_add_tail (&iobuf_arena->list, &iobuf_node->arenas[index]);
 
         return iobuf_arena;
 }
 
 
 struct iobuf_arena *
-iobuf_pool_add_arena (struct iobuf_pool *iobuf_pool, size_t page_size,
+iobuf_pool_add_arena (struct iobuf_pool *iobuf_pool,
+                      struct iobuf_node *iobuf_node, size_t page_size,
                       int32_t num_pages)
 {
         struct iobuf_arena *iobuf_arena = NULL;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
 
-        pthread_mutex_lock (&iobuf_pool->mutex);
+        pthread_mutex_lock (&iobuf_node->mutex);
         {
-                iobuf_arena = __iobuf_pool_add_arena (iobuf_pool, page_size,
-                                                      num_pages);
+                iobuf_arena = __iobuf_pool_add_arena (iobuf_pool, iobuf_node,
+                                                      page_size, num_pages);
         }
-        pthread_mutex_unlock (&iobuf_pool->mutex);
+        pthread_mutex_unlock (&iobuf_node->mutex);
 
 out:
         return iobuf_arena;
@@ -290,18 +431,43 @@ iobuf_pool_destroy (struct iobuf_pool *iobuf_pool)
 {
         struct iobuf_arena *iobuf_arena = NULL;
         struct iobuf_arena *tmp         = NULL;
+        struct iobuf_cache *cache       = NULL;
+        struct iobuf_cache *tmp_cache   = NULL;
+        struct iobuf_node  *iobuf_node  = NULL;
         int                 i           = 0;
+        int                 n           = 0;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
 
-        for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
-                list_for_each_entry_safe (iobuf_arena, tmp,
-                                          &iobuf_pool->arenas[i], list) {
-                        list_del_init (&iobuf_arena->list);
-                        iobuf_pool->arena_cnt--;
-                        __iobuf_arena_destroy (iobuf_arena);
+        /* the caches are freed by their threads, only detach them */
+        pthread_mutex_lock (&iobuf_cache_mutex);
+        {
+                pthread_mutex_lock (&iobuf_pool->mutex);
+                {
+                        list_for_each_entry_safe (cache, tmp_cache,
+                                                  &iobuf_pool->caches, list) {
+                                list_del_init (&cache->list);
+                                cache->iobuf_pool = NULL;
+                                memset (cache->count, 0,
+                                        sizeof (cache->count));
+                        }
                 }
+                pthread_mutex_unlock (&iobuf_pool->mutex);
+        }
+        pthread_mutex_unlock (&iobuf_cache_mutex);
+
+        for (n = 0; n < GF_IOBUF_MAX_NODES; n++) {
+                iobuf_node = &iobuf_pool->nodes[n];
 
+                for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
+                        list_for_each_entry_safe (iobuf_arena, tmp,
+                                                  &iobuf_node->arenas[i],
+                                                  list) {
+                                list_del_init (&iobuf_arena->list);
+                                iobuf_pool->arena_cnt--;
+                                __iobuf_arena_destroy (iobuf_arena);
+                        }
+                }
         }
 
 out:
@@ -324,11 +490,12 @@ iobuf_create_stdalloc_arena (struct iobuf_pool *iobuf_pool)
         INIT_LIST_HEAD (&iobuf_arena->passive.list);
 
         iobuf_arena->iobuf_pool = iobuf_pool;
+        iobuf_arena->iobuf_node = &iobuf_pool->nodes[0];
 
         iobuf_arena->page_size = 0x7fffffff;
 
         list_add_tail (&iobuf_arena->list,
-                       &iobuf_pool->arenas[IOBUF_ARENA_MAX_INDEX]);
+                       &iobuf_pool->nodes[0].arenas[IOBUF_ARENA_MAX_INDEX]);
 
 err:
         return;
@@ -338,31 +505,47 @@ struct iobuf_pool *
 iobuf_pool_new (void)
 {
         struct iobuf_pool  *iobuf_pool = NULL;
+        struct iobuf_node  *iobuf_node = NULL;
         int                 i          = 0;
+        int                 n          = 0;
         size_t              page_size  = 0;
         size_t              arena_size = 0;
         int32_t             num_pages  = 0;
 
+        pthread_once (&iobuf_cache_once, iobuf_cache_key_init);
+
         iobuf_pool = GF_CALLOC (sizeof (*iobuf_pool), 1,
                                 gf_common_mt_iobuf_pool);
         if (!iobuf_pool)
                 goto out;
 
         pthread_mutex_init (&iobuf_pool->mutex, NULL);
-        for (i = 0; i <= IOBUF_ARENA_MAX_INDEX; i++) {
-                INIT_LIST_HEAD (&iobuf_pool->arenas[i]);
-                INIT_LIST_HEAD (&iobuf_pool->filled[i]);
-                INIT_LIST_HEAD (&iobuf_pool->purge[i]);
+        INIT_LIST_HEAD (&iobuf_pool->caches);
+
+        for (n = 0; n < GF_IOBUF_MAX_NODES; n++) {
+                iobuf_node = &iobuf_pool->nodes[n];
+
+                pthread_mutex_init (&iobuf_node->mutex, NULL);
+                iobuf_node->node = n;
+                for (i = 0; i <= IOBUF_ARENA_MAX_INDEX; i++) {
+                        INIT_LIST_HEAD (&iobuf_node->arenas[i]);
+                        INIT_LIST_HEAD (&iobuf_node->filled[i]);
+                        INIT_LIST_HEAD (&iobuf_node->purge[i]);
+                }
         }
 
         iobuf_pool->default_page_size  = 128 * GF_UNIT_KB;
 
+        /* other nodes get their arenas on their first request */
+        iobuf_node = &iobuf_pool->nodes[iobuf_current_node ()];
+
         arena_size = 0;
         for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
                 page_size = gf_iobuf_init_config[i].pagesize;
                 num_pages = gf_iobuf_init_config[i].num_pages;
 
-                iobuf_pool_add_arena (iobuf_pool, page_size, num_pages);
+                iobuf_pool_add_arena (iobuf_pool, iobuf_node, page_size,
+                                      num_pages);
 
                 arena_size += page_size * num_pages;
         }
@@ -381,19 +564,23 @@ void
 __iobuf_arena_prune (struct iobuf_pool *iobuf_pool,
                      struct iobuf_arena *iobuf_arena, int index)
 {
+        struct iobuf_node *iobuf_node = NULL;
+
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
 
+        iobuf_node = iobuf_arena->iobuf_node;
+
         /* code flow comes here only if the arena is in purge list and we can
          * free the arena only if we have atleast one arena in 'arenas' list
          * (ie, at least few iobufs free in arena), that way, there won't
          * be spurious mmap/unmap of buffers
          */
-        if (list_empty (&iobuf_pool->arenas[index]))
+        if (list_empty (&iobuf_node->arenas[index]))
                 goto out;
 
         /* All cases matched, destroy */
         list_del_init (&iobuf_arena->list);
-        iobuf_pool->arena_cnt--;
+        __sync_fetch_and_sub (&iobuf_pool->arena_cnt, 1);
 
         __iobuf_arena_destroy (iobuf_arena);
 
@@ -407,24 +594,32 @@ iobuf_pool_prune (struct iobuf_pool *iobuf_pool)
 {
         struct iobuf_arena *iobuf_arena = NULL;
         struct iobuf_arena *tmp         = NULL;
+        struct iobuf_node  *iobuf_node  = NULL;
         int                 i           = 0;
+        int                 n           = 0;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
 
-        pthread_mutex_lock (&iobuf_pool->mutex);
-        {
-                for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
-                        if (list_empty (&iobuf_pool->arenas[i])) {
-                                continue;
-                        }
-
-                        list_for_each_entry_safe (iobuf_arena, tmp,
-                                                  &iobuf_pool->purge[i], list) {
-                                __iobuf_arena_prune (iobuf_pool, iobuf_arena, i);
+        for (n = 0; n < GF_IOBUF_MAX_NODES; n++) {
+                iobuf_node = &iobuf_pool->nodes[n];
+
+                pthread_mutex_lock (&iobuf_node->mutex);
+                {
+                        for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
+                                if (list_empty (&iobuf_node->arenas[i])) {
+                                        continue;
+                                }
+
+                                list_for_each_entry_safe (iobuf_arena, tmp,
+                                                          &iobuf_node->purge[i],
+                                                          list) {
+                                        __iobuf_arena_prune (iobuf_pool,
+                                                             iobuf_arena, i);
+                                }
                         }
                 }
+                pthread_mutex_unlock (&iobuf_node->mutex);
         }
-        pthread_mutex_unlock (&iobuf_pool->mutex);
 
 out:
         return;
@@ -432,7 +627,8 @@ out:
 
 
 struct iobuf_arena *
-__iobuf_select_arena (struct iobuf_pool *iobuf_pool, size_t page_size)
+__iobuf_select_arena (struct iobuf_pool *iobuf_pool,
+                      struct iobuf_node *iobuf_node, size_t page_size)
 {
         struct iobuf_arena *iobuf_arena  = NULL;
         struct iobuf_arena *trav         = NULL;
@@ -449,7 +645,7 @@ __iobuf_select_arena (struct iobuf_pool *iobuf_pool, size_t page_size)
         }
 
         /* look for unused iobuf from the head-most arena */
-        list_for_each_entry (trav, &iobuf_pool->arenas[index], list) {
+        list_for_each_entry (trav, &iobuf_node->arenas[index], list) {
                 if (trav->passive_cnt) {
                         iobuf_arena = trav;
                         break;
@@ -458,7 +654,8 @@ __iobuf_select_arena (struct iobuf_pool *iobuf_pool, size_t page_size)
 
         if (!iobuf_arena) {
                 /* all arenas were full, find the right count to add */
-                iobuf_arena = __iobuf_pool_add_arena (iobuf_pool, page_size,
+                iobuf_arena = __iobuf_pool_add_arena (iobuf_pool, iobuf_node,
+                                                      page_size,
                                                       gf_iobuf_init_config[index].num_pages);
         }
 
@@ -470,7 +667,7 @@ out:
 struct iobuf *
 __iobuf_ref (struct iobuf *iobuf)
 {
-        iobuf->ref++;
+        __sync_fetch_and_add (&iobuf->ref, 1);
 
         return iobuf;
 }
@@ -479,7 +676,7 @@ __iobuf_ref (struct iobuf *iobuf)
 struct iobuf *
 __iobuf_unref (struct iobuf *iobuf)
 {
-        iobuf->ref--;
+        __sync_fetch_and_sub (&iobuf->ref, 1);
 
         return iobuf;
 }
@@ -488,12 +685,12 @@ struct iobuf *
 __iobuf_get (struct iobuf_arena *iobuf_arena, size_t page_size)
 {
         struct iobuf      *iobuf        = NULL;
-        struct iobuf_pool *iobuf_pool   = NULL;
+        struct iobuf_node *iobuf_node   = NULL;
         int                index        = 0;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_arena, out);
 
-        iobuf_pool = iobuf_arena->iobuf_pool;
+        iobuf_node = iobuf_arena->iobuf_node;
 
         list_for_each_entry (iobuf, &iobuf_arena->passive.list, list)
                 break;
@@ -520,7 +717,7 @@ __iobuf_get (struct iobuf_arena *iobuf_arena, size_t page_size)
                 }
 
                 list_del (&iobuf_arena->list);
-                list_add (&iobuf_arena->list, &iobuf_pool->filled[index]);
+                list_add (&iobuf_arena->list, &iobuf_node->filled[index]);
         }
 
 out:
@@ -536,7 +733,8 @@ iobuf_get_from_stdalloc (struct iobuf_pool *iobuf_pool, size_t page_size)
         int                 ret         = -1;
 
         /* The first arena in the 'MAX-INDEX' will always be used for misc */
-        list_for_each_entry (trav, &iobuf_pool->arenas[IOBUF_ARENA_MAX_INDEX],
+        list_for_each_entry (trav,
+                             &iobuf_pool->nodes[0].arenas[IOBUF_ARENA_MAX_INDEX],
                              list) {
                 iobuf_arena = trav;
                 break;
@@ -554,7 +752,6 @@ iobuf_get_from_stdalloc (struct iobuf_pool *iobuf_pool, size_t page_size)
 
         iobuf->ptr = GF_ALIGN_BUF (iobuf->free_ptr, GF_IOBUF_ALIGN_SIZE);
         iobuf->iobuf_arena = iobuf_arena;
-        LOCK_INIT (&iobuf->lock);
 
         /* Hold a ref because you are allocating and using it */
         iobuf->ref = 1;
@@ -576,7 +773,11 @@ iobuf_get2 (struct iobuf_pool *iobuf_pool, size_t page_size)
 {
         struct iobuf       *iobuf        = NULL;
         struct iobuf_arena *iobuf_arena  = NULL;
+        struct iobuf_node  *iobuf_node   = NULL;
+        struct iobuf_cache *cache        = NULL;
         size_t              rounded_size = 0;
+        int                 index        = 0;
+        int                 refill       = 0;
 
         if (page_size == 0) {
                 page_size = iobuf_pool->default_page_size;
@@ -593,14 +794,29 @@ iobuf_get2 (struct iobuf_pool *iobuf_pool, size_t page_size)
                         "exceeds the maximum available buffer size",
                         page_size, iobuf);
 
-                iobuf_pool->request_misses++;
+                __sync_fetch_and_add (&iobuf_pool->request_misses, 1);
                 return iobuf;
         }
 
-        pthread_mutex_lock (&iobuf_pool->mutex);
+        index = gf_iobuf_get_arena_index (rounded_size);
+
+        cache = iobuf_cache_get (iobuf_pool);
+        if (cache && cache->count[index]) {
+                iobuf = cache->iobufs[index][--cache->count[index]];
+                iobuf->ref = 1;
+                return iobuf;
+        }
+
+        if (cache)
+                refill = iobuf_cache_limit (index) / 2;
+
+        iobuf_node = &iobuf_pool->nodes[iobuf_current_node ()];
+
+        pthread_mutex_lock (&iobuf_node->mutex);
         {
                 /* most eligible arena for picking an iobuf */
-                iobuf_arena = __iobuf_select_arena (iobuf_pool, rounded_size);
+                iobuf_arena = __iobuf_select_arena (iobuf_pool, iobuf_node,
+                                                    rounded_size);
                 if (!iobuf_arena)
                         goto unlock;
 
@@ -609,9 +825,22 @@ iobuf_get2 (struct iobuf_pool *iobuf_pool, size_t page_size)
                         goto unlock;
 
                 __iobuf_ref (iobuf);
+
+                /* take a few more for the next requests of this thread,
+                   but only from arenas which are already there */
+                while (cache && cache->count[index] < refill &&
+                       !list_empty (&iobuf_node->arenas[index])) {
+                        iobuf_arena = list_entry (iobuf_node->arenas[index].next,
+                                                  struct iobuf_arena, list);
+                        if (!iobuf_arena->passive_cnt)
+                                break;
+
+                        cache->iobufs[index][cache->count[index]++] =
+                                __iobuf_get (iobuf_arena, rounded_size);
+                }
          }
 unlock:
-        pthread_mutex_unlock (&iobuf_pool->mutex);
+        pthread_mutex_unlock (&iobuf_node->mutex);
 
         return iobuf;
 }
@@ -620,46 +849,29 @@ struct iobuf *
 iobuf_get (struct iobuf_pool *iobuf_pool)
 {
         struct iobuf       *iobuf        = NULL;
-        struct iobuf_arena *iobuf_arena  = NULL;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
 
-        pthread_mutex_lock (&iobuf_pool->mutex);
-        {
-                /* most eligible arena for picking an iobuf */
-                iobuf_arena = __iobuf_select_arena (iobuf_pool,
-                                                    iobuf_pool->default_page_size);
-                if (!iobuf_arena) {
-                        gf_log (THIS->name, GF_LOG_WARNING, "arena not found");
-                        goto unlock;
-                }
-
-                iobuf = __iobuf_get (iobuf_arena,
-                                     iobuf_pool->default_page_size);
-                if (!iobuf) {
-                        gf_log (THIS->name, GF_LOG_WARNING, "iobuf not found");
-                        goto unlock;
-                }
-
-                __iobuf_ref (iobuf);
-        }
-unlock:
-        pthread_mutex_unlock (&iobuf_pool->mutex);
+        iobuf = iobuf_get2 (iobuf_pool, iobuf_pool->default_page_size);
+        if (!iobuf)
+                gf_log (THIS->name, GF_LOG_WARNING, "iobuf not found");
 
 out:
         return iobuf;
 }
 
-void
+static void
 __iobuf_put (struct iobuf *iobuf, struct iobuf_arena *iobuf_arena)
 {
         struct iobuf_pool *iobuf_pool = NULL;
+        struct iobuf_node *iobuf_node = NULL;
         int                index      = 0;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_arena, out);
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf, out);
 
         iobuf_pool = iobuf_arena->iobuf_pool;
+        iobuf_node = iobuf_arena->iobuf_node;
 
         index = gf_iobuf_get_arena_index (iobuf_arena->page_size);
         if (index == -1) {
@@ -667,7 +879,6 @@ __iobuf_put (struct iobuf *iobuf, struct iobuf_arena *iobuf_arena)
                         "allocated with standard calloc()", iobuf);
 
                 /* free up properly without bothering about lists and all */
-                LOCK_DESTROY (&iobuf->lock);
                 GF_FREE (iobuf->free_ptr);
                 GF_FREE (iobuf);
                 return;
@@ -675,7 +886,7 @@ __iobuf_put (struct iobuf *iobuf, struct iobuf_arena *iobuf_arena)
 
         if (iobuf_arena->passive_cnt == 0) {
                 list_del (&iobuf_arena->list);
-                list_add_tail (&iobuf_arena->list, &iobuf_pool->arenas[index]);
+                list_add_tail (&iobuf_arena->list, &iobuf_node->arenas[index]);
         }
 
         list_del_init (&iobuf->list);
@@ -686,7 +897,7 @@ __iobuf_put (struct iobuf *iobuf, struct iobuf_arena *iobuf_arena)
 
         if (iobuf_arena->active_cnt == 0) {
                 list_del (&iobuf_arena->list);
-                list_add_tail (&iobuf_arena->list, &iobuf_pool->purge[index]);
+                list_add_tail (&iobuf_arena->list, &iobuf_node->purge[index]);
                 __iobuf_arena_prune (iobuf_pool, iobuf_arena, index);
         }
 out:
@@ -699,6 +910,8 @@ iobuf_put (struct iobuf *iobuf)
 {
         struct iobuf_arena *iobuf_arena = NULL;
         struct iobuf_pool  *iobuf_pool = NULL;
+        struct iobuf_cache *cache = NULL;
+        int                 index = 0;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf, out);
 
@@ -714,11 +927,20 @@ iobuf_put (struct iobuf *iobuf)
                 return;
         }
 
-        pthread_mutex_lock (&iobuf_pool->mutex);
-        {
+        index = gf_iobuf_get_arena_index (iobuf_arena->page_size);
+        if (index == -1) {
+                /* stdalloc'ed, not on any list */
                 __iobuf_put (iobuf, iobuf_arena);
+                goto out;
         }
-        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+        cache = iobuf_cache_get (iobuf_pool);
+        if (cache && cache->count[index] < iobuf_cache_limit (index)) {
+                cache->iobufs[index][cache->count[index]++] = iobuf;
+                goto out;
+        }
+
+        iobuf_put_locked (iobuf);
 
 out:
         return;
@@ -728,18 +950,9 @@ out:
 void
 iobuf_unref (struct iobuf *iobuf)
 {
-        int  ref = 0;
-
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf, out);
 
-        LOCK (&iobuf->lock);
-        {
-                __iobuf_unref (iobuf);
-                ref = iobuf->ref;
-        }
-        UNLOCK (&iobuf->lock);
-
-        if (!ref)
+        if (__sync_sub_and_fetch (&iobuf->ref, 1) == 0)
                 iobuf_put (iobuf);
 
 out:
@@ -752,11 +965,7 @@ iobuf_ref (struct iobuf *iobuf)
 {
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf, out);
 
-        LOCK (&iobuf->lock);
-        {
-                __iobuf_ref (iobuf);
-        }
-        UNLOCK (&iobuf->lock);
+        __iobuf_ref (iobuf);
 
 out:
         return iobuf;
@@ -775,6 +984,9 @@ iobref_new ()
 
         LOCK_INIT (&iobref->lock);
 
+        iobref->iobrefs = iobref->inline_iobrefs;
+        iobref->alloced = GF_IOBREF_IOBUF_COUNT;
+
         iobref->ref++;
 
         return iobref;
@@ -786,11 +998,7 @@ iobref_ref (struct iobref *iobref)
 {
         GF_VALIDATE_OR_GOTO ("iobuf", iobref, out);
 
-        LOCK (&iobref->lock);
-        {
-                iobref->ref++;
-        }
-        UNLOCK (&iobref->lock);
+        __sync_fetch_and_add (&iobref->ref, 1);
 
 out:
         return iobref;
@@ -805,7 +1013,7 @@ iobref_destroy (struct iobref *iobref)
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobref, out);
 
-        for (i = 0; i < GF_IOBREF_IOBUF_COUNT; i++) {
+        for (i = 0; i < iobref->used; i++) {
                 iobuf = iobref->iobrefs[i];
 
                 iobref->iobrefs[i] = NULL;
@@ -813,6 +1021,10 @@ iobref_destroy (struct iobref *iobref)
                         iobuf_unref (iobuf);
         }
 
+        if (iobref->iobrefs != iobref->inline_iobrefs)
+                GF_FREE (iobref->iobrefs);
+
+        LOCK_DESTROY (&iobref->lock);
         GF_FREE (iobref);
 
 out:
@@ -823,17 +1035,9 @@ out:
 void
 iobref_unref (struct iobref *iobref)
 {
-        int ref = 0;
-
         GF_VALIDATE_OR_GOTO ("iobuf", iobref, out);
 
-        LOCK (&iobref->lock);
-        {
-                ref = (--iobref->ref);
-        }
-        UNLOCK (&iobref->lock);
-
-        if (!ref)
+        if (__sync_sub_and_fetch (&iobref->ref, 1) == 0)
                 iobref_destroy (iobref);
 
 out:
@@ -841,22 +1045,49 @@ out:
 }
 
 
+/* make room for @count more iobufs, doubling the vector as needed */
+static int
+__iobref_grow (struct iobref *iobref, int count)
+{
+        struct iobuf **iobrefs = NULL;
+        int            alloced = 0;
+
+        if (iobref->used + count <= iobref->alloced)
+                return 0;
+
+        alloced = iobref->alloced;
+        while (alloced < iobref->used + count)
+                alloced *= 2;
+
+        iobrefs = GF_CALLOC (alloced, sizeof (*iobrefs), gf_common_mt_iobrefs);
+        if (!iobrefs)
+                return -ENOMEM;
+
+        memcpy (iobrefs, iobref->iobrefs, iobref->used * sizeof (*iobrefs));
+
+        if (iobref->iobrefs != iobref->inline_iobrefs)
+                GF_FREE (iobref->iobrefs);
+
+        iobref->iobrefs = iobrefs;
+        iobref->alloced = alloced;
+
+        return 0;
+}
+
+
 int
 __iobref_add (struct iobref *iobref, struct iobuf *iobuf)
 {
-        int  i = 0;
         int  ret = -ENOMEM;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobref, out);
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf, out);
 
-        for (i = 0; i < GF_IOBREF_IOBUF_COUNT; i++) {
-                if (iobref->iobrefs[i] == NULL) {
-                        iobref->iobrefs[i] = iobuf_ref (iobuf);
-                        ret = 0;
-                        break;
-                }
-        }
+        ret = __iobref_grow (iobref, 1);
+        if (ret)
+                goto out;
+
+        iobref->iobrefs[iobref->used++] = iobuf_ref (iobuf);
 
 out:
         return ret;
@@ -885,28 +1116,53 @@ out:
 int
 iobref_merge (struct iobref *to, struct iobref *from)
 {
-        int           i = 0;
-        int           ret = -1;
-        struct iobuf *iobuf = NULL;
+        int            i = 0;
+        int            count = 0;
+        int            ret = -1;
+        struct iobuf  *stack_iobufs[GF_IOBREF_IOBUF_COUNT];
+        struct iobuf **iobufs = stack_iobufs;
 
         GF_VALIDATE_OR_GOTO ("iobuf", to, out);
         GF_VALIDATE_OR_GOTO ("iobuf", from, out);
 
+        /* take our own refs on @from's iobufs first, so that the two
+           iobrefs are never locked together */
         LOCK (&from->lock);
         {
-                for (i = 0; i < GF_IOBREF_IOBUF_COUNT; i++) {
-                        iobuf = from->iobrefs[i];
-
-                        if (!iobuf)
-                                break;
+                count = from->used;
+                if (count > GF_IOBREF_IOBUF_COUNT) {
+                        iobufs = GF_CALLOC (count, sizeof (*iobufs),
+                                            gf_common_mt_iobrefs);
+                        if (!iobufs) {
+                                UNLOCK (&from->lock);
+                                ret = -ENOMEM;
+                                goto out;
+                        }
+                }
 
-                        ret = iobref_add (to, iobuf);
+                for (i = 0; i < count; i++)
+                        iobufs[i] = iobuf_ref (from->iobrefs[i]);
+        }
+        UNLOCK (&from->lock);
 
-                        if (ret < 0)
-                                break;
+        LOCK (&to->lock);
+        {
+                ret = __iobref_grow (to, count);
+                if (!ret) {
+                        memcpy (&to->iobrefs[to->used], iobufs,
+                                count * sizeof (*iobufs));
+                        to->used += count;
                 }
         }
-        UNLOCK (&from->lock);
+        UNLOCK (&to->lock);
+
+        if (ret) {
+                for (i = 0; i < count; i++)
+                        iobuf_unref (iobufs[i]);
+        }
+
+        if (iobufs != stack_iobufs)
+                GF_FREE (iobufs);
 
 out:
         return ret;
@@ -946,10 +1202,8 @@ iobref_size (struct iobref *iobref)
 
         LOCK (&iobref->lock);
         {
-                for (i = 0; i < GF_IOBREF_IOBUF_COUNT; i++) {
-                        if (iobref->iobrefs[i])
-                                size += iobuf_size (iobref->iobrefs[i]);
-                }
+                for (i = 0; i < iobref->used; i++)
+                        size += iobuf_size (iobref->iobrefs[i]);
         }
         UNLOCK (&iobref->lock);
 
@@ -961,24 +1215,13 @@ void
 iobuf_info_dump (struct iobuf *iobuf, const char *key_prefix)
 {
         char   key[GF_DUMP_MAX_BUF_LEN];
-        struct iobuf my_iobuf;
-        int    ret = 0;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf, out);
 
-        memset(&my_iobuf, 0, sizeof(my_iobuf));
-
-        ret = TRY_LOCK(&iobuf->lock);
-        if (ret) {
-                return;
-        }
-        memcpy(&my_iobuf, iobuf, sizeof(my_iobuf));
-        UNLOCK(&iobuf->lock);
-
         gf_proc_dump_build_key(key, key_prefix,"ref");
-        gf_proc_dump_write(key, "%d", my_iobuf.ref);
+        gf_proc_dump_write(key, "%d", iobuf->ref);
         gf_proc_dump_build_key(key, key_prefix,"ptr");
-        gf_proc_dump_write(key, "%p", my_iobuf.ptr);
+        gf_proc_dump_write(key, "%p", iobuf->ptr);
 
 out:
         return;
@@ -1020,8 +1263,12 @@ iobuf_stats_dump (struct iobuf_pool *iobuf_pool)
 {
         char               msg[1024];
         struct iobuf_arena *trav = NULL;
+        struct iobuf_node  *iobuf_node = NULL;
+        struct iobuf_cache *cache = NULL;
         int                i = 1;
         int                j = 0;
+        int                n = 0;
+        int                cached = 0;
         int                ret = -1;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
@@ -1033,6 +1280,12 @@ iobuf_stats_dump (struct iobuf_pool *iobuf_pool)
         if (ret) {
                 return;
         }
+        list_for_each_entry (cache, &iobuf_pool->caches, list) {
+                for (j = 0; j < IOBUF_ARENA_MAX_INDEX; j++)
+                        cached += cache->count[j];
+        }
+        pthread_mutex_unlock(&iobuf_pool->mutex);
+
         gf_proc_dump_add_section("iobuf.global");
         gf_proc_dump_write("iobuf_pool","%p", iobuf_pool);
         gf_proc_dump_write("iobuf_pool.default_page_size", "%d",
@@ -1043,39 +1296,52 @@ iobuf_stats_dump (struct iobuf_pool *iobuf_pool)
                            iobuf_pool->arena_cnt);
         gf_proc_dump_write("iobuf_pool.request_misses", "%"PRId64,
                            iobuf_pool->request_misses);
-
-        for (j = 0; j < IOBUF_ARENA_MAX_INDEX; j++) {
-                list_for_each_entry (trav, &iobuf_pool->arenas[j], list) {
-                        snprintf(msg, sizeof(msg),
-                                 "arena.%d", i);
-                        gf_proc_dump_add_section(msg);
-                        iobuf_arena_info_dump(trav,msg);
-                        i++;
-                }
-                list_for_each_entry (trav, &iobuf_pool->purge[j], list) {
-                        snprintf(msg, sizeof(msg),
-                                 "purge.%d", i);
-                        gf_proc_dump_add_section(msg);
-                        iobuf_arena_info_dump(trav,msg);
-                        i++;
-                }
-                list_for_each_entry (trav, &iobuf_pool->filled[j], list) {
-                        snprintf(msg, sizeof(msg),
-                                 "filled.%d", i);
-                        gf_proc_dump_add_section(msg);
-                        iobuf_arena_info_dump(trav,msg);
-                        i++;
+        gf_proc_dump_write("iobuf_pool.thread_cached", "%d", cached);
+
+        for (n = 0; n < GF_IOBUF_MAX_NODES; n++) {
+                iobuf_node = &iobuf_pool->nodes[n];
+
+                ret = pthread_mutex_trylock(&iobuf_node->mutex);
+                if (ret)
+                        continue;
+
+                for (j = 0; j < IOBUF_ARENA_MAX_INDEX; j++) {
+                        list_for_each_entry (trav, &iobuf_node->arenas[j],
+                                             list) {
+                                snprintf(msg, sizeof(msg),
+                                         "arena.%d", i);
+                                gf_proc_dump_add_section(msg);
+                                gf_proc_dump_write("node", "%d", n);
+                                iobuf_arena_info_dump(trav,msg);
+                                i++;
+                        }
+                        list_for_each_entry (trav, &iobuf_node->purge[j],
+                                             list) {
+                                snprintf(msg, sizeof(msg),
+                                         "purge.%d", i);
+                                gf_proc_dump_add_section(msg);
+                                gf_proc_dump_write("node", "%d", n);
+                                iobuf_arena_info_dump(trav,msg);
+                                i++;
+                        }
+                        list_for_each_entry (trav, &iobuf_node->filled[j],
+                                             list) {
+                                snprintf(msg, sizeof(msg),
+                                         "filled.%d", i);
+                                gf_proc_dump_add_section(msg);
+                                gf_proc_dump_write("node", "%d", n);
+                                iobuf_arena_info_dump(trav,msg);
+                                i++;
+                        }
                 }
 
+                pthread_mutex_unlock(&iobuf_node->mutex);
         }
 
-        pthread_mutex_unlock(&iobuf_pool->mutex);
-
 out:
         return;
 }
 
-
 void
 iobuf_to_iovec(struct iobuf *iob, struct iovec *iov)
 {
@@ -18,7 +18,14 @@
 #include <sys/uio.h>
 
 #define GF_VARIABLE_IOBUF_COUNT 32
-#define GF_IOBREF_IOBUF_COUNT 16
+/* iobufs an iobref holds inline, it grows beyond that on demand */
+#define GF_IOBREF_IOBUF_COUNT 8
+
+/* arenas are kept per NUMA node; nodes beyond this share a slot */
+#define GF_IOBUF_MAX_NODES 8
+
+/* free iobufs of each page size a thread keeps for itself */
+#define GF_IOBUF_CACHE_SIZE 8
 
 /* Lets try to define the new anonymous mapping
  * flag, in case the system is still using the
@@ -45,6 +52,9 @@ struct iobuf;
 /* each arena hosts @arena_size / @page_size IOBUFs */
 struct iobuf_arena;
 
+/* arenas of one NUMA node, with their own lock */
+struct iobuf_node;
+
 /* expandable and contractable pool of memory, internally broken into arenas */
 struct iobuf_pool;
 
@@ -63,8 +73,8 @@ struct iobuf {
         };
         struct iobuf_arena  *iobuf_arena;
 
-        gf_lock_t            lock; /* for ->ptr and ->ref */
-        int                  ref;  /* 0 == passive, >0 == active */
+        int                  ref;  /* 0 == passive, >0 == active;
+                                      updated atomically */
 
         void                *ptr;  /* usable memory region by the consumer */
 
@@ -89,6 +99,7 @@ struct iobuf_arena {
         size_t              page_count;
 
         struct iobuf_pool  *iobuf_pool;
+        struct iobuf_node  *iobuf_node; /* node whose lists hold this */
 
         void               *mem_base;
         struct iobuf       *iobufs;     /* allocated iobufs list */
@@ -104,13 +115,11 @@ struct iobuf_arena {
 };
 
 
-struct iobuf_pool {
-        pthread_mutex_t     mutex;
-        size_t              arena_size; /* size of memory region in
-                                           arena */
-        size_t              default_page_size; /* default size of iobuf */
+struct iobuf_node {
+        pthread_mutex_t     mutex;      /* for the lists below and the
+                                           counters of their arenas */
+        int                 node;
 
-        int                 arena_cnt;
         struct list_head    arenas[GF_VARIABLE_IOBUF_COUNT];
         /* array of arenas. Each element of the array is a list of arenas
            holding iobufs of particular page_size */
@@ -120,6 +129,23 @@ struct iobuf_pool {
 
         struct list_head    purge[GF_VARIABLE_IOBUF_COUNT];
         /* array of of arenas which can be purged */
+};
+
+
+struct iobuf_pool {
+        pthread_mutex_t     mutex;      /* for ->caches */
+        size_t              arena_size; /* size of memory region in
+                                           arena */
+        size_t              default_page_size; /* default size of iobuf */
+
+        int                 arena_cnt;  /* updated atomically */
+
+        struct iobuf_node   nodes[GF_IOBUF_MAX_NODES];
+        /* iobufs are taken from the node of the calling thread, so that
+           the pages are first touched, and hence placed, locally */
+
+        struct list_head    caches;     /* per-thread caches of free
+                                           iobufs of this pool */
 
         uint64_t            request_misses; /* mostly the requests for higher
                                                value of iobufs */
@@ -140,9 +166,12 @@ void iobuf_to_iovec(struct iobuf *iob, struct iovec *iov);
 
 
 struct iobref {
-        gf_lock_t          lock;
-        int                ref;
-        struct iobuf      *iobrefs[GF_IOBREF_IOBUF_COUNT];
+        gf_lock_t          lock; /* for ->iobrefs, ->alloced and ->used */
+        int                ref;  /* updated atomically */
+        struct iobuf     **iobrefs; /* ->inline_iobrefs until it grows */
+        int                alloced;
+        int                used;
+        struct iobuf      *inline_iobrefs[GF_IOBREF_IOBUF_COUNT];
 };
 
 struct iobref *iobref_new ();
@@ -283,6 +283,135 @@ free:
 
 
 
+/* Magazine ids index the per-thread table. mem_pool_destroy() gives the id
+ * back for the next pool, and every use of an id gets a new generation, so a
+ * thread tells a stale magazine of a destroyed pool from one of the pool now
+ * holding the id. mem_magazine_mutex serializes thread-exit against
+ * mem_pool_destroy() and guards the ids.
+ */
+static pthread_key_t    mem_magazine_key;
+static pthread_once_t   mem_magazine_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t  mem_magazine_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int              mem_magazine_key_ok;
+static int              mem_magazine_next_id;
+static int              mem_magazine_free_ids[GF_MEM_POOL_MAX_MAGAZINES];
+static int              mem_magazine_free_count;
+static uint32_t         mem_magazine_gen[GF_MEM_POOL_MAX_MAGAZINES];
+static int              mem_magazine_exhausted;
+
+
+static void
+__mem_magazine_flush (struct mem_pool *pool, struct mem_magazine *mag,
+                      int count)
+{
+        struct list_head *list = NULL;
+
+        while (count-- > 0 && mag->count > 0) {
+                list = mag->chunks[--mag->count];
+                list_add (list, &pool->list);
+                pool->hot_count--;
+                pool->cold_count++;
+        }
+}
+
+
+static void
+mem_magazines_release (void *data)
+{
+        struct mem_magazine **magazines = data;
+        struct mem_magazine  *mag = NULL;
+        struct mem_pool      *pool = NULL;
+        int                   i = 0;
+
+        for (i = 0; i < GF_MEM_POOL_MAX_MAGAZINES; i++) {
+                mag = magazines[i];
+                if (!mag)
+                        continue;
+
+                pthread_mutex_lock (&mem_magazine_mutex);
+                {
+                        pool = mag->pool;
+                        if (pool) {
+                                LOCK (&pool->lock);
+                                {
+                                        __mem_magazine_flush (pool, mag,
+                                                              mag->count);
+                                        pool->alloc_count += mag->allocs;
+                                        list_del_init (&mag->list);
+                                }
+                                UNLOCK (&pool->lock);
+                        }
+                }
+                pthread_mutex_unlock (&mem_magazine_mutex);
+
+                FREE (mag);
+        }
+
+        FREE (magazines);
+}
+
+
+static void
+mem_magazine_key_init (void)
+{
+        if (pthread_key_create (&mem_magazine_key,
+                                mem_magazines_release) == 0)
+                mem_magazine_key_ok = 1;
+}
+
+
+static struct mem_magazine *
+mem_magazine_get (struct mem_pool *pool)
+{
+        struct mem_magazine **magazines = NULL;
+        struct mem_magazine  *mag = NULL;
+
+        if (pool->magazine_id < 0)
+                return NULL;
+
+        magazines = pthread_getspecific (mem_magazine_key);
+        if (!magazines) {
+                magazines = CALLOC (GF_MEM_POOL_MAX_MAGAZINES,
+                                    sizeof (*magazines));
+                if (!magazines)
+                        return NULL;
+
+                if (pthread_setspecific (mem_magazine_key, magazines)) {
+                        FREE (magazines);
+                        return NULL;
+                }
+        }
+
+        mag = magazines[pool->magazine_id];
+        if (mag) {
+                if (mag->gen == pool->magazine_gen)
+                        return mag;
+
+                /* left by a destroyed pool, which detached it already */
+                FREE (mag);
+                magazines[pool->magazine_id] = NULL;
+        }
+
+        mag = CALLOC (1, sizeof (*mag));
+        if (!mag)
+                return NULL;
+
+        INIT_LIST_HEAD (&mag->list);
+        mag->pool = pool;
+        mag->gen = pool->magazine_gen;
+
+        LOCK (&pool->lock);
+        {
+                list_add (&mag->list, &pool->magazines);
+        }
+        UNLOCK (&pool->lock);
+
+        magazines[pool->magazine_id] = mag;
+
+        return mag;
+}
+
+
 struct mem_pool *
 mem_pool_new_fn (unsigned long sizeof_type,
                  unsigned long count, char *name)
@@ -292,6 +421,8 @@ mem_pool_new_fn (unsigned long sizeof_type,
         void             *pool = NULL;
         int               i = 0;
         int               ret = 0;
+        int               id = -1;
+        int               exhausted = 0;
         struct list_head *list = NULL;
         glusterfs_ctx_t  *ctx = NULL;
 
@@ -317,6 +448,7 @@ mem_pool_new_fn (unsigned long sizeof_type,
         LOCK_INIT (&mem_pool->lock);
         INIT_LIST_HEAD (&mem_pool->list);
         INIT_LIST_HEAD (&mem_pool->global_list);
+        INIT_LIST_HEAD (&mem_pool->magazines);
 
         mem_pool->padded_sizeof_type = padded_sizeof_type;
         mem_pool->cold_count = count;
@@ -338,6 +470,38 @@ mem_pool_new_fn (unsigned long sizeof_type,
         mem_pool->pool = pool;
         mem_pool->pool_end = pool + (count * (padded_sizeof_type));
 
+        /* Small pools are not worth caching per thread: a handful of
+         * threads would drain them into their magazines.
+         */
+        mem_pool->magazine_id = -1;
+        mem_pool->magazine_size = min (count / 32, GF_MEM_POOL_MAGAZINE_SIZE);
+        pthread_once (&mem_magazine_once, mem_magazine_key_init);
+        if (mem_magazine_key_ok && mem_pool->magazine_size >= 4) {
+                pthread_mutex_lock (&mem_magazine_mutex);
+                {
+                        if (mem_magazine_free_count)
+                                id = mem_magazine_free_ids
+                                        [--mem_magazine_free_count];
+                        else if (mem_magazine_next_id <
+                                 GF_MEM_POOL_MAX_MAGAZINES)
+                                id = mem_magazine_next_id++;
+                        else if (!mem_magazine_exhausted)
+                                exhausted = mem_magazine_exhausted = 1;
+
+                        if (id >= 0) {
+                                mem_pool->magazine_id = id;
+                                mem_pool->magazine_gen = ++mem_magazine_gen[id];
+                        }
+                }
+                pthread_mutex_unlock (&mem_magazine_mutex);
+
+                if (exhausted)
+                        gf_log ("mem-pool", GF_LOG_WARNING, "all %d magazine "
+                                "ids in use, %s and later pools get no "
+                                "per-thread cache", GF_MEM_POOL_MAX_MAGAZINES,
+                                mem_pool->name);
+        }
+
         /* add this pool to the global list */
         ctx = THIS->ctx;
         if (!ctx)
@@ -370,16 +534,30 @@ mem_get0 (struct mem_pool *mem_pool)
 void *
 mem_get (struct mem_pool *mem_pool)
 {
-        struct list_head *list = NULL;
-        void             *ptr = NULL;
-        int             *in_use = NULL;
-        struct mem_pool **pool_ptr = NULL;
+        struct list_head    *list = NULL;
+        void                *ptr = NULL;
+        int                 *in_use = NULL;
+        struct mem_pool    **pool_ptr = NULL;
+        struct mem_magazine *mag = NULL;
 
         if (!mem_pool) {
                 gf_log_callingfn ("mem-pool", GF_LOG_ERROR, "invalid argument");
                 return NULL;
         }
 
+        mag = mem_magazine_get (mem_pool);
+        if (mag && mag->count) {
+                ptr = mag->chunks[--mag->count];
+                mag->allocs++;
+
+                in_use = (ptr + GF_MEM_POOL_LIST_BOUNDARY + GF_MEM_POOL_PTR);
+                *in_use = 1;
+
+                pool_ptr = mem_pool_from_ptr (ptr);
+                *pool_ptr = (struct mem_pool *)mem_pool;
+                return mem_pool_chunkhead2ptr (ptr);
+        }
+
         LOCK (&mem_pool->lock);
         {
                 mem_pool->alloc_count++;
@@ -390,6 +568,18 @@ mem_get (struct mem_pool *mem_pool)
                         mem_pool->hot_count++;
                         mem_pool->cold_count--;
 
+                        /* refill the magazine with half its size so that
+                         * alternating get/put does not bounce on the lock */
+                        while (mag && mem_pool->cold_count &&
+                               mag->count < mem_pool->magazine_size / 2) {
+                                mag->chunks[mag->count] = mem_pool->list.next;
+                                list_del (mem_pool->list.next);
+                                mag->count++;
+
+                                mem_pool->hot_count++;
+                                mem_pool->cold_count--;
+                        }
+
                         if (mem_pool->max_alloc < mem_pool->hot_count)
                                 mem_pool->max_alloc = mem_pool->hot_count;
 
@@ -467,11 +657,12 @@ __is_member (struct mem_pool *pool, void *ptr)
 void
 mem_put (void *ptr)
 {
-        struct list_head *list = NULL;
-        int    *in_use = NULL;
-        void   *head = NULL;
-        struct mem_pool **tmp = NULL;
-        struct mem_pool *pool = NULL;
+        struct list_head    *list = NULL;
+        int                 *in_use = NULL;
+        void                *head = NULL;
+        struct mem_pool    **tmp = NULL;
+        struct mem_pool     *pool = NULL;
+        struct mem_magazine *mag = NULL;
 
         if (!ptr) {
                 gf_log_callingfn ("mem-pool", GF_LOG_ERROR, "invalid argument");
@@ -492,50 +683,92 @@ mem_put (void *ptr)
                                   "mem-pool ptr is NULL");
                 return;
         }
-        LOCK (&pool->lock);
+
+        switch (__is_member (pool, ptr))
         {
+        case 1:
+                in_use = (head + GF_MEM_POOL_LIST_BOUNDARY +
+                          GF_MEM_POOL_PTR);
+                if (!is_mem_chunk_in_use(in_use)) {
+                        gf_log_callingfn ("mem-pool", GF_LOG_CRITICAL,
+                                          "mem_put called on freed ptr %p of mem "
+                                          "pool %p", ptr, pool);
+                        break;
+                }
+                *in_use = 0;
+
+                mag = mem_magazine_get (pool);
+                if (mag) {
+                        if (mag->count == pool->magazine_size) {
+                                LOCK (&pool->lock);
+                                {
+                                        __mem_magazine_flush (pool, mag,
+                                                              mag->count / 2);
+                                }
+                                UNLOCK (&pool->lock);
+                        }
+                        mag->chunks[mag->count++] = head;
+                        break;
+                }
 
-                switch (__is_member (pool, ptr))
+                LOCK (&pool->lock);
                 {
-                case 1:
-                        in_use = (head + GF_MEM_POOL_LIST_BOUNDARY +
-                                  GF_MEM_POOL_PTR);
-                        if (!is_mem_chunk_in_use(in_use)) {
-                                gf_log_callingfn ("mem-pool", GF_LOG_CRITICAL,
-                                                  "mem_put called on freed ptr %p of mem "
-                                                  "pool %p", ptr, pool);
-                                break;
-                        }
                         pool->hot_count--;
                         pool->cold_count++;
-                        *in_use = 0;
                         list_add (list, &pool->list);
-                        break;
-                case -1:
-                        /* For some reason, the address given is within
-                         * the address range of the mem-pool but does not align
-                         * with the expected start of a chunk that includes
-                         * the list headers also. Sounds like a problem in
-                         * layers of clouds up above us. ;)
-                         */
-                        abort ();
-                        break;
-                case 0:
-                        /* The address is outside the range of the mem-pool. We
-                         * assume here that this address was allocated at a
-                         * point when the mem-pool was out of chunks in mem_get
-                         * or the programmer has made a mistake by calling the
-                         * wrong de-allocation interface. We do
-                         * not have enough info to distinguish between the two
-                         * situations.
-                         */
+                }
+                UNLOCK (&pool->lock);
+                break;
+        case -1:
+                /* For some reason, the address given is within
+                 * the address range of the mem-pool but does not align
+                 * with the expected start of a chunk that includes
+                 * the list headers also. Sounds like a problem in
+                 * layers of clouds up above us. ;)
+                 */
+                abort ();
+                break;
+        case 0:
+                /* The address is outside the range of the mem-pool. We
+                 * assume here that this address was allocated at a
+                 * point when the mem-pool was out of chunks in mem_get
+                 * or the programmer has made a mistake by calling the
+                 * wrong de-allocation interface. We do
+                 * not have enough info to distinguish between the two
+                 * situations.
+                 */
+                LOCK (&pool->lock);
+                {
                         pool->curr_stdalloc--;
-                        GF_FREE (list);
-                        break;
-                default:
-                        /* log error */
-                        break;
                 }
+                UNLOCK (&pool->lock);
+                GF_FREE (list);
+                break;
+        default:
+                /* log error */
+                break;
+        }
+}
+
+void
+mem_pool_counts (struct mem_pool *pool, int *hot_count, int *cold_count,
+                 uint64_t *alloc_count)
+{
+        struct mem_magazine *mag = NULL;
+        int                  cached = 0;
+        uint64_t             allocs = 0;
+
+        LOCK (&pool->lock);
+        {
+                list_for_each_entry (mag, &pool->magazines, list) {
+                        cached += mag->count;
+                        allocs += mag->allocs;
+                }
+
+                /* chunks parked in magazines are free, not in use */
+                *hot_count = pool->hot_count - cached;
+                *cold_count = pool->cold_count + cached;
+                *alloc_count = pool->alloc_count + allocs;
         }
         UNLOCK (&pool->lock);
 }
@@ -543,6 +776,9 @@ mem_put (void *ptr)
 void
 mem_pool_destroy (struct mem_pool *pool)
 {
+        struct mem_magazine *mag = NULL;
+        struct mem_magazine *tmp = NULL;
+
         if (!pool)
                 return;
 
@@ -551,6 +787,27 @@ mem_pool_destroy (struct mem_pool *pool)
 
         list_del (&pool->global_list);
 
+        /* magazines are owned by their threads and freed at thread exit;
+         * only detach them so they stop pointing into this pool */
+        pthread_mutex_lock (&mem_magazine_mutex);
+        {
+                LOCK (&pool->lock);
+                {
+                        list_for_each_entry_safe (mag, tmp, &pool->magazines,
+                                                  list) {
+                                list_del_init (&mag->list);
+                                mag->pool = NULL;
+                                mag->count = 0;
+                        }
+                }
+                UNLOCK (&pool->lock);
+
+                if (pool->magazine_id >= 0)
+                        mem_magazine_free_ids[mem_magazine_free_count++] =
+                                pool->magazine_id;
+        }
+        pthread_mutex_unlock (&mem_magazine_mutex);
+
         LOCK_DESTROY (&pool->lock);
         GF_FREE (pool->name);
         GF_FREE (pool->pool);
@@ -147,6 +147,22 @@ char * gf_strdup (const char *src)
         return dup_str;
 }
 
+/* Per-thread cache of free chunks in front of a mem_pool. mem_get/mem_put
+ * are served from the calling thread's magazine without taking pool->lock
+ * and only go to the shared list, in batches, when it is empty or full.
+ */
+#define GF_MEM_POOL_MAX_MAGAZINES   1024
+#define GF_MEM_POOL_MAGAZINE_SIZE   32
+
+struct mem_magazine {
+        struct list_head  list;   /* in pool->magazines */
+        struct mem_pool  *pool;   /* NULL once the pool is destroyed */
+        uint32_t          gen;    /* magazine_gen of the pool */
+        int               count;
+        uint64_t          allocs; /* mem_get()s served from the magazine */
+        void             *chunks[GF_MEM_POOL_MAGAZINE_SIZE];
+};
+
 struct mem_pool {
         struct list_head  list;
         int               hot_count;
@@ -163,6 +179,10 @@ struct mem_pool {
         int               max_stdalloc;
         char             *name;
         struct list_head  global_list;
+        int               magazine_id;   /* -1 if the pool has none */
+        uint32_t          magazine_gen;  /* uses of magazine_id so far */
+        int               magazine_size; /* chunks cached per thread */
+        struct list_head  magazines;
 };
 
 struct mem_pool *
@@ -175,6 +195,8 @@ void *mem_get (struct mem_pool *pool);
 void *mem_get0 (struct mem_pool *pool);
 
 void mem_pool_destroy (struct mem_pool *pool);
+void mem_pool_counts (struct mem_pool *pool, int *hot_count, int *cold_count,
+                      uint64_t *alloc_count);
 
 void gf_mem_acct_enable_set (void *ctx);
 
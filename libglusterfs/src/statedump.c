@@ -15,6 +15,7 @@
 #include "statedump.h"
 #include "stack.h"
 #include "common-utils.h"
+#include "event.h"
 
 #ifdef HAVE_MALLOC_H
 #include <malloc.h>
@@ -318,17 +319,22 @@ void
 gf_proc_dump_mempool_info (glusterfs_ctx_t *ctx)
 {
         struct mem_pool *pool = NULL;
+        int              hot_count = 0;
+        int              cold_count = 0;
+        uint64_t         alloc_count = 0;
 
         gf_proc_dump_add_section ("mempool");
 
         list_for_each_entry (pool, &ctx->mempool_list, global_list) {
+                mem_pool_counts (pool, &hot_count, &cold_count, &alloc_count);
+
                 gf_proc_dump_write ("-----", "-----");
                 gf_proc_dump_write ("pool-name", "%s", pool->name);
-                gf_proc_dump_write ("hot-count", "%d", pool->hot_count);
-                gf_proc_dump_write ("cold-count", "%d", pool->cold_count);
+                gf_proc_dump_write ("hot-count", "%d", hot_count);
+                gf_proc_dump_write ("cold-count", "%d", cold_count);
                 gf_proc_dump_write ("padded_sizeof", "%lu",
                                     pool->padded_sizeof_type);
-                gf_proc_dump_write ("alloc-count", "%"PRIu64, pool->alloc_count);
+                gf_proc_dump_write ("alloc-count", "%"PRIu64, alloc_count);
                 gf_proc_dump_write ("max-alloc", "%d", pool->max_alloc);
 
                 gf_proc_dump_write ("pool-misses", "%"PRIu64, pool->pool_misses);
@@ -343,11 +349,16 @@ gf_proc_dump_mempool_info_to_dict (glusterfs_ctx_t *ctx, dict_t *dict)
         char            key[GF_DUMP_MAX_BUF_LEN] = {0,};
         int             count = 0;
         int             ret = -1;
+        int             hot_count = 0;
+        int             cold_count = 0;
+        uint64_t        alloc_count = 0;
 
         if (!ctx || !dict)
                 return;
 
         list_for_each_entry (pool, &ctx->mempool_list, global_list) {
+                mem_pool_counts (pool, &hot_count, &cold_count, &alloc_count);
+
                 memset (key, 0, sizeof (key));
                 snprintf (key, sizeof (key), "pool%d.name", count);
                 ret = dict_set_str (dict, key, pool->name);
@@ -356,13 +367,13 @@ gf_proc_dump_mempool_info_to_dict (glusterfs_ctx_t *ctx, dict_t *dict)
 
                 memset (key, 0, sizeof (key));
                 snprintf (key, sizeof (key), "pool%d.hotcount", count);
-                ret = dict_set_int32 (dict, key, pool->hot_count);
+                ret = dict_set_int32 (dict, key, hot_count);
                 if (ret)
                         return;
 
                 memset (key, 0, sizeof (key));
                 snprintf (key, sizeof (key), "pool%d.coldcount", count);
-                ret = dict_set_int32 (dict, key, pool->cold_count);
+                ret = dict_set_int32 (dict, key, cold_count);
                 if (ret)
                         return;
 
@@ -374,7 +385,7 @@ gf_proc_dump_mempool_info_to_dict (glusterfs_ctx_t *ctx, dict_t *dict)
 
                 memset (key, 0, sizeof (key));
                 snprintf (key, sizeof (key), "pool%d.alloccount", count);
-                ret = dict_set_uint64 (dict, key, pool->alloc_count);
+                ret = dict_set_uint64 (dict, key, alloc_count);
                 if (ret)
                         return;
 
@@ -758,6 +769,8 @@ gf_proc_dump_info (int signum, glusterfs_ctx_t *ctx)
         if (GF_PROC_DUMP_IS_OPTION_ENABLED (callpool))
                 gf_proc_dump_pending_frames (ctx->pool);
 
+        event_pool_stats_dump (ctx->event_pool);
+
         if (ctx->master) {
                 gf_proc_dump_add_section ("fuse");
                 gf_proc_dump_xlator_info (ctx->master);
@@ -13,12 +13,203 @@
 #include "config.h"
 #endif
 
+#include <time.h>
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
+
 #include "timer.h"
 #include "logging.h"
 #include "common-utils.h"
 #include "globals.h"
 
-#define TS(tv) ((((unsigned long long) tv.tv_sec) * 1000000) + (tv.tv_usec))
+#define TV_US(tv) ((((uint64_t) tv.tv_sec) * 1000000) + (tv.tv_usec))
+
+#define GF_TIMER_INDEX(clk, n) (((clk) >> (GF_TIMER_TVR_BITS +          \
+                                           (n) * GF_TIMER_TVN_BITS))    \
+                                & GF_TIMER_TVN_MASK)
+
+#define GF_TIMER_NEVER ((uint64_t) -1)
+
+
+/* microseconds on a clock which does not jump with the wall clock */
+static uint64_t
+gf_timer_now_us (void)
+{
+#ifdef CLOCK_MONOTONIC
+        struct timespec ts = {0, };
+
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+
+        return ((uint64_t) ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#else
+        struct timeval tv = {0, };
+
+        gettimeofday (&tv, NULL);
+
+        return TV_US (tv);
+#endif
+}
+
+
+static uint64_t
+gf_timer_now (void)
+{
+        return gf_timer_now_us () / 1000;
+}
+
+
+static void
+__gf_timer_add (gf_timer_registry_t *reg, gf_timer_t *event)
+{
+        uint64_t          expires = event->expires;
+        uint64_t          idx = expires - reg->clk;
+        struct list_head *vec = NULL;
+        int               level = 0;
+
+        if ((int64_t) idx < 0) {
+                /* already due, run on the next tick */
+                vec = &reg->tv1[reg->clk & GF_TIMER_TVR_MASK];
+        } else if (idx < GF_TIMER_TVR_SIZE) {
+                vec = &reg->tv1[expires & GF_TIMER_TVR_MASK];
+        } else {
+                for (level = 0; level < GF_TIMER_TVN_LEVELS - 1; level++) {
+                        if (idx < (1ULL << (GF_TIMER_TVR_BITS +
+                                            (level + 1) * GF_TIMER_TVN_BITS)))
+                                break;
+                }
+
+                if (level == GF_TIMER_TVN_LEVELS - 1) {
+                        /* clamp to what the top level can hold, the
+                           timer is re-placed when it cascades down */
+                        if (idx >= (1ULL << (GF_TIMER_TVR_BITS +
+                                             GF_TIMER_TVN_LEVELS *
+                                             GF_TIMER_TVN_BITS)))
+                                expires = reg->clk +
+                                        (1ULL << (GF_TIMER_TVR_BITS +
+                                                  GF_TIMER_TVN_LEVELS *
+                                                  GF_TIMER_TVN_BITS)) - 1;
+                }
+
+                vec = &reg->tvn[level][GF_TIMER_INDEX (expires, level)];
+        }
+
+        list_add_tail (&event->list, vec);
+}
+
+
+static int
+__gf_timer_cascade (gf_timer_registry_t *reg, int level, int index)
+{
+        gf_timer_t       *event = NULL;
+        gf_timer_t       *tmp = NULL;
+        struct list_head  head;
+
+        INIT_LIST_HEAD (&head);
+        list_splice_init (&reg->tvn[level][index], &head);
+
+        list_for_each_entry_safe (event, tmp, &head, list) {
+                list_del (&event->list);
+                __gf_timer_add (reg, event);
+        }
+
+        return index;
+}
+
+
+/* returns the first tick at which the wheel has work to do */
+static uint64_t
+__gf_timer_next_expiry (gf_timer_registry_t *reg)
+{
+        uint64_t clk = reg->clk;
+        int      index = 0;
+
+        if (!reg->pending)
+                return GF_TIMER_NEVER;
+
+        for (index = clk & GF_TIMER_TVR_MASK; index < GF_TIMER_TVR_SIZE;
+             index++, clk++) {
+                if (!list_empty (&reg->tv1[index]))
+                        return clk;
+        }
+
+        /* nothing in the first level before it wraps, wake up to cascade */
+        return clk;
+}
+
+
+static void
+gf_timer_arm (gf_timer_registry_t *reg, uint64_t expires)
+{
+#ifdef HAVE_SYS_TIMERFD_H
+        struct itimerspec its = {{0, }, };
+
+        if (reg->fd != -1) {
+                if (expires != GF_TIMER_NEVER) {
+                        /* an all zero it_value would disarm the timer */
+                        its.it_value.tv_sec = expires / 1000;
+                        its.it_value.tv_nsec = (expires % 1000) * 1000000 + 1;
+                }
+
+                if (timerfd_settime (reg->fd, TFD_TIMER_ABSTIME, &its,
+                                     NULL) == 0)
+                        return;
+
+                gf_log ("timer", GF_LOG_WARNING,
+                        "timerfd_settime failed (%s)", strerror (errno));
+        }
+#endif
+        pthread_cond_signal (&reg->cond);
+}
+
+
+/* called with reg->lock held, returns with it held */
+static void
+__gf_timer_wait (gf_timer_registry_t *reg, uint64_t expires)
+{
+        struct timeval  tv = {0, };
+        struct timespec ts = {0, };
+        uint64_t        now = 0;
+        uint64_t        delta = 0;
+#ifdef HAVE_SYS_TIMERFD_H
+        uint64_t        expirations = 0;
+        ssize_t         ret = 0;
+
+        if (reg->fd != -1) {
+                pthread_mutex_unlock (&reg->lock);
+                {
+                        ret = read (reg->fd, &expirations,
+                                    sizeof (expirations));
+                        if (ret == -1 && errno != EINTR && errno != EAGAIN)
+                                gf_log ("timer", GF_LOG_WARNING,
+                                        "timerfd read failed (%s)",
+                                        strerror (errno));
+                }
+                pthread_mutex_lock (&reg->lock);
+                return;
+        }
+#endif
+        if (expires == GF_TIMER_NEVER) {
+                pthread_cond_wait (&reg->cond, &reg->lock);
+                return;
+        }
+
+        now = gf_timer_now ();
+        if (expires <= now)
+                return;
+        delta = expires - now;
+
+        gettimeofday (&tv, NULL);
+        ts.tv_sec = tv.tv_sec + delta / 1000;
+        ts.tv_nsec = tv.tv_usec * 1000 + (delta % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+        }
+
+        pthread_cond_timedwait (&reg->cond, &reg->lock, &ts);
+}
+
 
 gf_timer_t *
 gf_timer_call_after (glusterfs_ctx_t *ctx,
@@ -28,8 +219,7 @@ gf_timer_call_after (glusterfs_ctx_t *ctx,
 {
         gf_timer_registry_t *reg = NULL;
         gf_timer_t *event = NULL;
-        gf_timer_t *trav = NULL;
-        unsigned long long at = 0L;
+        uint64_t    now = 0;
 
         if (ctx == NULL)
         {
@@ -48,51 +238,32 @@ gf_timer_call_after (glusterfs_ctx_t *ctx,
         if (!event) {
                 return NULL;
         }
-        gettimeofday (&event->at, NULL);
-        event->at.tv_usec = ((event->at.tv_usec + delta.tv_usec) % 1000000);
-        event->at.tv_sec += ((event->at.tv_usec + delta.tv_usec) / 1000000);
-        event->at.tv_sec += delta.tv_sec;
-        at = TS (event->at);
+        INIT_LIST_HEAD (&event->list);
+        now = gf_timer_now_us ();
+        /* round up, a timer must never fire early */
+        event->expires = (now + TV_US (delta) + 999) / 1000;
         event->callbk = callbk;
         event->data = data;
         event->xl = THIS;
         pthread_mutex_lock (&reg->lock);
         {
-                trav = reg->active.prev;
-                while (trav != &reg->active) {
-                        if (TS (trav->at) < at)
-                                break;
-                        trav = trav->prev;
+                /* the wheel does not turn while it is empty, catch it up
+                   instead of placing the timer from a stale clock */
+                if (!reg->pending && (now / 1000 > reg->clk))
+                        reg->clk = now / 1000;
+
+                __gf_timer_add (reg, event);
+                reg->pending++;
+
+                if (event->expires < reg->armed) {
+                        reg->armed = event->expires;
+                        gf_timer_arm (reg, reg->armed);
                 }
-                event->prev = trav;
-                event->next = event->prev->next;
-                event->prev->next = event;
-                event->next->prev = event;
         }
         pthread_mutex_unlock (&reg->lock);
         return event;
 }
 
-int32_t
-gf_timer_call_stale (gf_timer_registry_t *reg,
-                     gf_timer_t *event)
-{
-        if (reg == NULL || event == NULL)
-        {
-                gf_log_callingfn ("timer", GF_LOG_ERROR, "invalid argument");
-                return 0;
-        }
-
-        event->next->prev = event->prev;
-        event->prev->next = event->next;
-        event->next = &reg->stale;
-        event->prev = event->next->prev;
-        event->next->prev = event;
-        event->prev->next = event;
-
-        return 0;
-}
-
 int32_t
 gf_timer_call_cancel (glusterfs_ctx_t *ctx,
                       gf_timer_t *event)
@@ -114,8 +285,11 @@ gf_timer_call_cancel (glusterfs_ctx_t *ctx,
 
         pthread_mutex_lock (&reg->lock);
         {
-                event->next->prev = event->prev;
-                event->prev->next = event->next;
+                /* a timer which has fired sits on the stale list and no
+                   longer counts as pending */
+                if (!event->fired)
+                        reg->pending--;
+                list_del (&event->list);
         }
         pthread_mutex_unlock (&reg->lock);
 
@@ -123,11 +297,71 @@ gf_timer_call_cancel (glusterfs_ctx_t *ctx,
         return 0;
 }
 
+/* called with reg->lock held, drops it around each callback */
+static void
+__gf_timer_run (gf_timer_registry_t *reg, uint64_t now)
+{
+        gf_timer_t       *event = NULL;
+        gf_timer_cbk_t    callbk = NULL;
+        void             *data = NULL;
+        struct list_head  work;
+        int               index = 0;
+        int               level = 0;
+
+        if (!reg->pending) {
+                /* nothing to cascade, just catch the clock up */
+                if (now >= reg->clk)
+                        reg->clk = now + 1;
+                return;
+        }
+
+        INIT_LIST_HEAD (&work);
+
+        while (now >= reg->clk) {
+                index = reg->clk & GF_TIMER_TVR_MASK;
+
+                for (level = 0; !index && level < GF_TIMER_TVN_LEVELS;
+                     level++) {
+                        if (__gf_timer_cascade (reg, level,
+                                                GF_TIMER_INDEX (reg->clk,
+                                                                level)))
+                                break;
+                }
+
+                reg->clk++;
+
+                list_splice_init (&reg->tv1[index], &work);
+
+                while (!list_empty (&work)) {
+                        event = list_entry (work.next, gf_timer_t, list);
+
+                        list_move_tail (&event->list, &reg->stale);
+                        reg->pending--;
+
+                        callbk = event->callbk;
+                        data = event->data;
+                        event->fired = 1;
+
+                        if (event->xl)
+                                THIS = event->xl;
+
+                        pthread_mutex_unlock (&reg->lock);
+                        {
+                                callbk (data);
+                        }
+                        pthread_mutex_lock (&reg->lock);
+                }
+        }
+}
+
 void *
 gf_timer_proc (void *ctx)
 {
         gf_timer_registry_t *reg = NULL;
-	const struct timespec sleepts = {.tv_sec = 1, .tv_nsec = 0, };
+        gf_timer_t          *event = NULL;
+        gf_timer_t          *tmp = NULL;
+        int                  i = 0;
+        int                  j = 0;
 
         if (ctx == NULL)
         {
@@ -141,49 +375,42 @@ gf_timer_proc (void *ctx)
                 return NULL;
         }
 
+        pthread_mutex_lock (&reg->lock);
         while (!reg->fin) {
-                unsigned long long now;
-                struct timeval now_tv;
-                gf_timer_t *event = NULL;
+                __gf_timer_run (reg, gf_timer_now ());
 
-                gettimeofday (&now_tv, NULL);
-                now = TS (now_tv);
-                while (1) {
-                        unsigned long long at;
-                        char need_cbk = 0;
+                reg->armed = __gf_timer_next_expiry (reg);
+                gf_timer_arm (reg, reg->armed);
 
-                        pthread_mutex_lock (&reg->lock);
-                        {
-                                event = reg->active.next;
-                                at = TS (event->at);
-                                if (event != &reg->active && now >= at) {
-                                        need_cbk = 1;
-                                        gf_timer_call_stale (reg, event);
-                                }
-                        }
-                        pthread_mutex_unlock (&reg->lock);
-                        if (event->xl)
-                                THIS = event->xl;
-                        if (need_cbk)
-                                event->callbk  (event->data);
+                __gf_timer_wait (reg, reg->armed);
+        }
 
-                        else
-                                break;
+        for (i = 0; i < GF_TIMER_TVR_SIZE; i++) {
+                list_for_each_entry_safe (event, tmp, &reg->tv1[i], list) {
+                        list_del (&event->list);
+                        GF_FREE (event);
                 }
-                nanosleep (&sleepts, NULL);
         }
 
-        pthread_mutex_lock (&reg->lock);
-        {
-                while (reg->active.next != &reg->active) {
-                        gf_timer_call_cancel (ctx, reg->active.next);
+        for (i = 0; i < GF_TIMER_TVN_LEVELS; i++) {
+                for (j = 0; j < GF_TIMER_TVN_SIZE; j++) {
+                        list_for_each_entry_safe (event, tmp,
+                                                  &reg->tvn[i][j], list) {
+                                list_del (&event->list);
+                                GF_FREE (event);
+                        }
                 }
+        }
 
-                while (reg->stale.next != &reg->stale) {
-                        gf_timer_call_cancel (ctx, reg->stale.next);
-                }
+        list_for_each_entry_safe (event, tmp, &reg->stale, list) {
+                list_del (&event->list);
+                GF_FREE (event);
         }
         pthread_mutex_unlock (&reg->lock);
+
+        if (reg->fd != -1)
+                close (reg->fd);
+        pthread_cond_destroy (&reg->cond);
         pthread_mutex_destroy (&reg->lock);
         GF_FREE (((glusterfs_ctx_t *)ctx)->timer);
 
@@ -193,6 +420,9 @@ gf_timer_proc (void *ctx)
 gf_timer_registry_t *
 gf_timer_registry_init (glusterfs_ctx_t *ctx)
 {
+        int i = 0;
+        int j = 0;
+
         if (ctx == NULL) {
                 gf_log_callingfn ("timer", GF_LOG_ERROR, "invalid argument");
                 return NULL;
@@ -207,10 +437,27 @@ gf_timer_registry_init (glusterfs_ctx_t *ctx)
                         goto out;
 
                 pthread_mutex_init (&reg->lock, NULL);
-                reg->active.next = &reg->active;
-                reg->active.prev = &reg->active;
-                reg->stale.next = &reg->stale;
-                reg->stale.prev = &reg->stale;
+                pthread_cond_init (&reg->cond, NULL);
+                INIT_LIST_HEAD (&reg->stale);
+
+                for (i = 0; i < GF_TIMER_TVR_SIZE; i++)
+                        INIT_LIST_HEAD (&reg->tv1[i]);
+
+                for (i = 0; i < GF_TIMER_TVN_LEVELS; i++)
+                        for (j = 0; j < GF_TIMER_TVN_SIZE; j++)
+                                INIT_LIST_HEAD (&reg->tvn[i][j]);
+
+                reg->clk = gf_timer_now ();
+                reg->armed = GF_TIMER_NEVER;
+
+                reg->fd = -1;
+#ifdef HAVE_SYS_TIMERFD_H
+                reg->fd = timerfd_create (CLOCK_MONOTONIC, 0);
+                if (reg->fd == -1)
+                        gf_log ("timer", GF_LOG_WARNING,
+                                "timerfd_create failed (%s), falling back "
+                                "to condition variable", strerror (errno));
+#endif
 
                 ctx->timer = reg;
                 pthread_create (&reg->th, NULL, gf_timer_proc, ctx);
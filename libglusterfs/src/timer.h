@@ -18,24 +18,46 @@
 
 #include "glusterfs.h"
 #include "xlator.h"
+#include "list.h"
 #include <sys/time.h>
 #include <pthread.h>
 
+/* Hierarchical timing wheel with a resolution of one millisecond: the
+ * first level holds the next GF_TIMER_TVR_SIZE ticks, each of the
+ * GF_TIMER_TVN_LEVELS upper levels covers GF_TIMER_TVN_SIZE times the
+ * range of the one below and is cascaded down when the level below
+ * wraps around.
+ */
+#define GF_TIMER_TVR_BITS   8
+#define GF_TIMER_TVN_BITS   6
+#define GF_TIMER_TVR_SIZE   (1 << GF_TIMER_TVR_BITS)
+#define GF_TIMER_TVN_SIZE   (1 << GF_TIMER_TVN_BITS)
+#define GF_TIMER_TVR_MASK   (GF_TIMER_TVR_SIZE - 1)
+#define GF_TIMER_TVN_MASK   (GF_TIMER_TVN_SIZE - 1)
+#define GF_TIMER_TVN_LEVELS 4
+
 typedef void (*gf_timer_cbk_t) (void *);
 
 struct _gf_timer {
-        struct _gf_timer *next, *prev;
-        struct timeval    at;
+        struct list_head  list;
+        uint64_t          expires; /* in ms, on the registry clock */
         gf_timer_cbk_t    callbk;
         void             *data;
         xlator_t         *xl;
+        char              fired;   /* moved to the stale list */
 };
 
 struct _gf_timer_registry {
         pthread_t        th;
         char             fin;
-        struct _gf_timer stale;
-        struct _gf_timer active;
+        struct list_head stale;
+        struct list_head tv1[GF_TIMER_TVR_SIZE];
+        struct list_head tvn[GF_TIMER_TVN_LEVELS][GF_TIMER_TVN_SIZE];
+        uint64_t         clk;     /* next tick to be processed */
+        uint64_t         armed;   /* tick the timer thread sleeps until */
+        uint64_t         pending; /* timers in the wheel */
+        int              fd;      /* timerfd, -1 if not available */
+        pthread_cond_t   cond;
         pthread_mutex_t  lock;
 };
 
@@ -0,0 +1,39 @@
+/*
+  Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+  This file is part of GlusterFS.
+
+  This file is licensed to you under your choice of the GNU Lesser
+  General Public License, version 3 or any later version (LGPLv3 or
+  later), or the GNU General Public License, version 2 (GPLv2), in all
+  cases as published by the Free Software Foundation.
+*/
+
+#ifndef __UPCALL_UTILS_H__
+#define __UPCALL_UTILS_H__
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "uuid.h"
+
+/* what changed on the inode, sent along with a cache invalidation */
+#define UP_ATTR    0x01   /* attributes (size, times, mode ...) */
+#define UP_DATA    0x02   /* contents */
+#define UP_XATTR   0x04   /* extended attributes */
+#define UP_ENTRY   0x08   /* entries of a directory */
+#define UP_FORGET  0x10   /* the inode is gone */
+
+/*
+ * Data of GF_EVENT_UPCALL. Notified up the brick graph by features/upcall
+ * for protocol/server to send to @client, the connection (frame->root->trans)
+ * of the client holding cached state of @gfid.
+ */
+struct gf_upcall {
+        void      *client;
+        uuid_t     gfid;
+        uint32_t   flags;
+};
+
+#endif /* __UPCALL_UTILS_H__ */
@@ -112,6 +112,7 @@ enum gf_cbk_procnum {
         GF_CBK_FETCHSPEC,
         GF_CBK_INO_FLUSH,
         GF_CBK_EVENT_NOTIFY,
+        GF_CBK_CACHE_INVALIDATION,
         GF_CBK_MAXVALUE,
 };
 
@@ -54,6 +54,7 @@ __saved_frames_get_timedout (struct saved_frames *frames, uint32_t timeout,
 		if ((tmp->saved_at.tv_sec + timeout) < current->tv_sec) {
 			bailout_frame = tmp;
 			list_del_init (&bailout_frame->list);
+			list_del_init (&bailout_frame->hash);
 			frames->count--;
 		}
 	}
@@ -77,6 +78,50 @@ _is_lock_fop (struct saved_frame *sframe)
                 (fop == GFS3_OP_FENTRYLK));
 }
 
+static inline struct list_head *
+__saved_frames_bucket (struct saved_frames *frames, uint32_t xid)
+{
+        /* xids are handed out sequentially, the low bits spread well */
+        return &frames->hash[xid & (frames->hash_size - 1)];
+}
+
+
+static void
+__saved_frames_rehash (struct saved_frames *frames, uint32_t hash_size)
+{
+        struct list_head   *old       = NULL;
+        uint32_t            old_size  = 0;
+        struct saved_frame *trav      = NULL;
+        struct saved_frame *tmp       = NULL;
+        uint32_t            i         = 0;
+
+        old = frames->hash;
+        old_size = frames->hash_size;
+
+        frames->hash = GF_CALLOC (hash_size, sizeof (*frames->hash),
+                                  gf_common_mt_list_head);
+        if (!frames->hash) {
+                /* keep the longer chains */
+                frames->hash = old;
+                return;
+        }
+
+        frames->hash_size = hash_size;
+        for (i = 0; i < hash_size; i++)
+                INIT_LIST_HEAD (&frames->hash[i]);
+
+        for (i = 0; i < old_size; i++) {
+                list_for_each_entry_safe (trav, tmp, &old[i], hash) {
+                        list_move (&trav->hash,
+                                   __saved_frames_bucket (frames,
+                                                          trav->rpcreq->xid));
+                }
+        }
+
+        GF_FREE (old);
+}
+
+
 struct saved_frame *
 __saved_frames_put (struct saved_frames *frames, void *frame,
                     struct rpc_req *rpcreq)
@@ -91,6 +136,7 @@ __saved_frames_put (struct saved_frames *frames, void *frame,
 
         memset (saved_frame, 0, sizeof (*saved_frame));
 	INIT_LIST_HEAD (&saved_frame->list);
+	INIT_LIST_HEAD (&saved_frame->hash);
 
 	saved_frame->capital_this = THIS;
 	saved_frame->frame        = frame;
@@ -102,8 +148,14 @@ __saved_frames_put (struct saved_frames *frames, void *frame,
         else
                 list_add_tail (&saved_frame->list, &frames->sf.list);
 
+        list_add (&saved_frame->hash,
+                  __saved_frames_bucket (frames, rpcreq->xid));
+
 	frames->count++;
 
+        if (frames->count > 2 * frames->hash_size)
+                __saved_frames_rehash (frames, 2 * frames->hash_size);
+
 out:
 	return saved_frame;
 }
@@ -119,6 +171,7 @@ saved_frames_delete (struct saved_frame *saved_frame,
         pthread_mutex_lock (&conn->lock);
         {
                 list_del_init (&saved_frame->list);
+                list_del_init (&saved_frame->hash);
                 conn->saved_frames->count--;
         }
         pthread_mutex_unlock (&conn->lock);
@@ -256,6 +309,7 @@ struct saved_frames *
 saved_frames_new (void)
 {
 	struct saved_frames *saved_frames = NULL;
+        uint32_t             i            = 0;
 
 	saved_frames = GF_CALLOC (1, sizeof (*saved_frames),
                                   gf_common_mt_rpcclnt_savedframe_t);
@@ -263,6 +317,18 @@ saved_frames_new (void)
 		return NULL;
 	}
 
+        saved_frames->hash = GF_CALLOC (SAVED_FRAMES_HASH_SIZE,
+                                        sizeof (*saved_frames->hash),
+                                        gf_common_mt_list_head);
+        if (!saved_frames->hash) {
+                GF_FREE (saved_frames);
+                return NULL;
+        }
+
+        saved_frames->hash_size = SAVED_FRAMES_HASH_SIZE;
+        for (i = 0; i < SAVED_FRAMES_HASH_SIZE; i++)
+                INIT_LIST_HEAD (&saved_frames->hash[i]);
+
 	INIT_LIST_HEAD (&saved_frames->sf.list);
 	INIT_LIST_HEAD (&saved_frames->lk_sf.list);
 
@@ -270,6 +336,21 @@ saved_frames_new (void)
 }
 
 
+static struct saved_frame *
+__saved_frames_lookup (struct saved_frames *frames, int64_t callid)
+{
+	struct saved_frame *tmp = NULL;
+
+	list_for_each_entry (tmp, __saved_frames_bucket (frames, callid),
+                             hash) {
+		if (tmp->rpcreq->xid == callid)
+			return tmp;
+	}
+
+        return NULL;
+}
+
+
 int
 __saved_frame_copy (struct saved_frames *frames, int64_t callid,
                     struct saved_frame *saved_frame)
@@ -282,21 +363,11 @@ __saved_frame_copy (struct saved_frames *frames, int64_t callid,
                 goto out;
         }
 
-	list_for_each_entry (tmp, &frames->sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			*saved_frame = *tmp;
-                        ret = 0;
-			goto out;
-		}
-	}
-
-	list_for_each_entry (tmp, &frames->lk_sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			*saved_frame = *tmp;
-                        ret = 0;
-			goto out;
-		}
-	}
+        tmp = __saved_frames_lookup (frames, callid);
+        if (tmp) {
+                *saved_frame = *tmp;
+                ret = 0;
+        }
 
 out:
 	return ret;
@@ -307,28 +378,12 @@ struct saved_frame *
 __saved_frame_get (struct saved_frames *frames, int64_t callid)
 {
 	struct saved_frame *saved_frame = NULL;
-	struct saved_frame *tmp = NULL;
-
-	list_for_each_entry (tmp, &frames->sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			list_del_init (&tmp->list);
-			frames->count--;
-			saved_frame = tmp;
-			goto out;
-		}
-	}
 
-	list_for_each_entry (tmp, &frames->lk_sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			list_del_init (&tmp->list);
-			frames->count--;
-			saved_frame = tmp;
-			goto out;
-		}
-	}
-
-out:
+        saved_frame = __saved_frames_lookup (frames, callid);
 	if (saved_frame) {
+                list_del_init (&saved_frame->list);
+                list_del_init (&saved_frame->hash);
+                frames->count--;
                 THIS  = saved_frame->capital_this;
         }
 
@@ -379,6 +434,7 @@ saved_frames_unwind (struct saved_frames *saved_frames)
 
                 clnt = rpc_clnt_unref (clnt);
 		list_del_init (&trav->list);
+		list_del_init (&trav->hash);
                 mem_put (trav);
 	}
 }
@@ -392,6 +448,7 @@ saved_frames_destroy (struct saved_frames *frames)
 
 	saved_frames_unwind (frames);
 
+        GF_FREE (frames->hash);
 	GF_FREE (frames);
 }
 
@@ -54,12 +54,21 @@ struct saved_frame {
 	struct timeval           saved_at;
         struct rpc_req          *rpcreq;
         rpc_transport_rsp_t      rsp;
+        struct list_head         hash;     /* saved_frames->hash chain */
 };
 
+/* Replies are matched to frames through @hash, indexed by xid, which
+ * grows with the number of frames in flight. @sf keeps the other frames
+ * in the order they were sent, so that call_bail () only looks at its
+ * head; lock fops wait in @lk_sf and are never bailed out. */
+#define SAVED_FRAMES_HASH_SIZE 64
+
 struct saved_frames {
 	int64_t            count;
 	struct saved_frame sf;
 	struct saved_frame lk_sf;
+        struct list_head  *hash;
+        uint32_t           hash_size;      /* a power of two */
 };
 
 
@@ -1937,3 +1937,16 @@ xdr_gf_event_notify_rsp (XDR *xdrs, gf_event_notify_rsp *objp)
 		 return FALSE;
 	return TRUE;
 }
+
+bool_t
+xdr_gfs3_cbk_cache_invalidation_req (XDR *xdrs, gfs3_cbk_cache_invalidation_req *objp)
+{
+	register int32_t *buf;
+        buf = NULL;
+
+	 if (!xdr_opaque (xdrs, objp->gfid, 16))
+		 return FALSE;
+	 if (!xdr_u_int (xdrs, &objp->flags))
+		 return FALSE;
+	return TRUE;
+}
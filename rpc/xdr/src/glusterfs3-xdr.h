@@ -1109,6 +1109,12 @@ struct gf_event_notify_rsp {
 };
 typedef struct gf_event_notify_rsp gf_event_notify_rsp;
 
+struct gfs3_cbk_cache_invalidation_req {
+	char gfid[16];
+	u_int flags;
+};
+typedef struct gfs3_cbk_cache_invalidation_req gfs3_cbk_cache_invalidation_req;
+
 /* the xdr functions */
 
 #if defined(__STDC__) || defined(__cplusplus)
@@ -1204,6 +1210,7 @@ extern  bool_t xdr_gf_set_lk_ver_rsp (XDR *, gf_set_lk_ver_rsp*);
 extern  bool_t xdr_gf_set_lk_ver_req (XDR *, gf_set_lk_ver_req*);
 extern  bool_t xdr_gf_event_notify_req (XDR *, gf_event_notify_req*);
 extern  bool_t xdr_gf_event_notify_rsp (XDR *, gf_event_notify_rsp*);
+extern  bool_t xdr_gfs3_cbk_cache_invalidation_req (XDR *, gfs3_cbk_cache_invalidation_req*);
 
 #else /* K&R C */
 extern bool_t xdr_gf_statfs ();
@@ -1298,6 +1305,7 @@ extern bool_t xdr_gf_set_lk_ver_rsp ();
 extern bool_t xdr_gf_set_lk_ver_req ();
 extern bool_t xdr_gf_event_notify_req ();
 extern bool_t xdr_gf_event_notify_rsp ();
+extern bool_t xdr_gfs3_cbk_cache_invalidation_req ();
 
 #endif /* K&R C */
 
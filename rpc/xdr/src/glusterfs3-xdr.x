@@ -704,3 +704,8 @@ struct gf_event_notify_rsp {
 	int op_errno;
 	opaque dict<>;
 };
+
+struct gfs3_cbk_cache_invalidation_req {
+	opaque gfid[16];
+	unsigned int flags;
+};
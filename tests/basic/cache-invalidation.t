@@ -0,0 +1,41 @@
+#!/bin/bash
+
+. $(dirname $0)/../include.rc
+
+cleanup;
+
+
+## Start and create a volume
+TEST glusterd
+TEST pidof glusterd
+TEST $CLI volume create $V0 $H0:$B0/${V0}1;
+
+## Cache attributes long enough for a stale one to show, and have the
+## bricks invalidate them
+TEST $CLI volume set $V0 performance.md-cache-timeout 600;
+TEST $CLI volume set $V0 features.cache-invalidation on;
+TEST $CLI volume start $V0;
+
+## Two clients, the kernel caching nothing
+TEST glusterfs --entry-timeout=0 --attribute-timeout=0 -s $H0 --volfile-id $V0 $M0;
+TEST glusterfs --entry-timeout=0 --attribute-timeout=0 -s $H0 --volfile-id $V0 $M1;
+
+## The second client caches the file
+TEST 'echo abc > $M0/file';
+TEST chmod 644 $M0/file;
+EXPECT '4' stat -c %s $M1/file;
+EXPECT '644' stat -c %a $M1/file;
+EXPECT 'abc' cat $M1/file;
+
+## and sees the changes made through the first one
+TEST 'echo abcdefg > $M0/file';
+TEST chmod 600 $M0/file;
+sleep 1;
+EXPECT '8' stat -c %s $M1/file;
+EXPECT '600' stat -c %a $M1/file;
+EXPECT 'abcdefg' cat $M1/file;
+
+TEST umount $M0;
+TEST umount $M1;
+
+cleanup;
@@ -0,0 +1,51 @@
+#!/bin/bash
+
+. $(dirname $0)/../include.rc
+
+cleanup;
+
+## The path the brick resolved the inode to, from its cached inode table
+function brick_path {
+        getfattr --only-values -n trusted.glusterfs.pathinfo $1 2>/dev/null |
+                sed -e "s|.*:$B0/${V0}1\([^>]*\)>.*|\1|"
+}
+
+## Start and create a volume
+TEST glusterd
+TEST pidof glusterd
+TEST $CLI volume create $V0 $H0:$B0/${V0}1;
+TEST $CLI volume start $V0;
+
+TEST glusterfs --entry-timeout=0 --attribute-timeout=0 -s $H0 --volfile-id $V0 $M0;
+
+## Resolve, and so cache, the paths of a tree of descendants
+TEST mkdir -p $M0/dir/sub/deep;
+TEST touch $M0/dir/sub/deep/file $M0/dir/file;
+EXPECT '/dir/sub/deep/file' brick_path $M0/dir/sub/deep/file;
+EXPECT '/dir/sub/deep' brick_path $M0/dir/sub/deep;
+EXPECT '/dir/file' brick_path $M0/dir/file;
+
+## Renaming the top directory changes the path of all of them
+TEST mv $M0/dir $M0/top;
+EXPECT '/top/sub/deep/file' brick_path $M0/top/sub/deep/file;
+EXPECT '/top/sub/deep' brick_path $M0/top/sub/deep;
+EXPECT '/top/file' brick_path $M0/top/file;
+
+## as does renaming a directory in the middle, into another one
+TEST mkdir $M0/other;
+TEST mv $M0/top/sub $M0/other/moved;
+EXPECT '/other/moved/deep/file' brick_path $M0/other/moved/deep/file;
+EXPECT '/other/moved/deep' brick_path $M0/other/moved/deep;
+EXPECT '/top/file' brick_path $M0/top/file;
+
+## and a file still open under the old name follows the rename too
+exec 5>>$M0/other/moved/deep/file;
+TEST mv $M0/other $M0/last;
+TEST 'echo data >&5';
+exec 5>&-;
+EXPECT 'data' cat $M0/last/moved/deep/file;
+EXPECT '/last/moved/deep/file' brick_path $M0/last/moved/deep/file;
+
+TEST umount $M0;
+
+cleanup;
@@ -0,0 +1,45 @@
+#!/bin/bash
+
+. $(dirname $0)/../include.rc
+
+cleanup;
+
+function get_xattr {
+        getfattr --only-values -n $1 $2 2>/dev/null
+}
+
+## Start and create a volume
+TEST glusterd
+TEST pidof glusterd
+TEST $CLI volume create $V0 $H0:$B0/${V0}1;
+
+## Prefetch and cache user.foo, including its absence
+TEST $CLI volume set $V0 performance.md-cache-timeout 2;
+TEST $CLI volume set $V0 performance.md-cache-xattrs user.foo;
+TEST $CLI volume start $V0;
+
+## Two clients, the kernel caching nothing
+TEST glusterfs --entry-timeout=0 --attribute-timeout=0 -s $H0 --volfile-id $V0 $M0;
+TEST glusterfs --entry-timeout=0 --attribute-timeout=0 -s $H0 --volfile-id $V0 $M1;
+
+TEST touch $M0/file;
+
+## The first client caches the absence of the key
+TEST ! getfattr -n user.foo $M0/file;
+TEST ! getfattr -n user.foo $M0/file;
+
+## and sees it set through the second one once the cache times out
+TEST setfattr -n user.foo -v bar $M1/file;
+sleep 3;
+EXPECT 'bar' get_xattr user.foo $M0/file;
+
+## A key removed and set again locally is seen right away
+TEST setfattr -x user.foo $M0/file;
+TEST ! getfattr -n user.foo $M0/file;
+TEST setfattr -n user.foo -v baz $M0/file;
+EXPECT 'baz' get_xattr user.foo $M0/file;
+
+TEST umount $M0;
+TEST umount $M1;
+
+cleanup;
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+/*
+ * Test description, every lock a write lock:
+ *
+ * disjoint: A holds (0,10) and (100,10), B waits for (100,10).
+ *           A unlocking (0,10) must not grant B, unlocking (100,10) must.
+ *
+ * queued:   A holds (0,100), B waits for (50,50), then C for (0,60).
+ *           A unlocking must grant B, which was first, C then waits for
+ *           B, and is granted once B unlocks.
+ *
+ * merge:    A locks (0,10) then (5,15). GETLK of (15,1) must report the
+ *           merged (0,20), and once A unlocks (0,20) B can lock it.
+ */
+
+#define WAIT_BLOCKED_MS  1000
+#define WAIT_GRANTED_MS  10000
+
+struct waiter {
+        pid_t pid;
+        int   granted;  /* child writes a byte here once granted */
+        int   release;  /* and unlocks once it reads one here */
+};
+
+static void
+flock_init (struct flock *f, short int type, off_t start, off_t len)
+{
+        memset (f, 0, sizeof (*f));
+        f->l_type = type;
+        f->l_whence = SEEK_SET;
+        f->l_start = start;
+        f->l_len = len;
+}
+
+static int
+lock (int fd, int cmd, short int type, off_t start, off_t len)
+{
+        struct flock f;
+
+        flock_init (&f, type, start, len);
+        return fcntl (fd, cmd, &f);
+}
+
+/* a process of its own, and so a lock owner of its own, blocking on
+   (start,len) */
+static int
+waiter_start (struct waiter *w, const char *fname, off_t start, off_t len)
+{
+        int  granted[2];
+        int  release[2];
+        int  fd = -1;
+        char c = 0;
+
+        if (pipe (granted) || pipe (release))
+                return -1;
+
+        w->pid = fork ();
+        if (w->pid < 0)
+                return -1;
+
+        if (w->pid == 0) {
+                close (granted[0]);
+                close (release[1]);
+
+                fd = open (fname, O_RDWR);
+                if (fd < 0)
+                        _exit (1);
+                if (lock (fd, F_SETLKW, F_WRLCK, start, len))
+                        _exit (1);
+                if (write (granted[1], "g", 1) != 1)
+                        _exit (1);
+                if (read (release[0], &c, 1) != 1)
+                        _exit (1);
+                if (lock (fd, F_SETLK, F_UNLCK, start, len))
+                        _exit (1);
+                _exit (0);
+        }
+
+        close (granted[1]);
+        close (release[0]);
+        w->granted = granted[0];
+        w->release = release[1];
+
+        return 0;
+}
+
+static int
+waiter_granted (struct waiter *w, int timeout)
+{
+        struct pollfd pfd = {w->granted, POLLIN, 0};
+        char          c = 0;
+
+        if (poll (&pfd, 1, timeout) != 1)
+                return 0;
+
+        return (read (w->granted, &c, 1) == 1);
+}
+
+static int
+waiter_finish (struct waiter *w)
+{
+        int status = 0;
+
+        if (write (w->release, "u", 1) != 1)
+                kill (w->pid, SIGKILL);
+        if (waitpid (w->pid, &status, 0) != w->pid)
+                return -1;
+
+        return (WIFEXITED (status) && !WEXITSTATUS (status)) ? 0 : -1;
+}
+
+static int
+test_disjoint (int fd, const char *fname)
+{
+        struct waiter b;
+
+        if (lock (fd, F_SETLK, F_WRLCK, 0, 10) ||
+            lock (fd, F_SETLK, F_WRLCK, 100, 10))
+                return 1;
+
+        if (waiter_start (&b, fname, 100, 10))
+                return 1;
+        if (waiter_granted (&b, WAIT_BLOCKED_MS))
+                return 1;
+
+        if (lock (fd, F_SETLK, F_UNLCK, 0, 10))
+                return 1;
+        if (waiter_granted (&b, WAIT_BLOCKED_MS))
+                return 1;
+
+        if (lock (fd, F_SETLK, F_UNLCK, 100, 10))
+                return 1;
+        if (!waiter_granted (&b, WAIT_GRANTED_MS))
+                return 1;
+
+        return waiter_finish (&b) ? 1 : 0;
+}
+
+static int
+test_queued (int fd, const char *fname)
+{
+        struct waiter b;
+        struct waiter c;
+
+        if (lock (fd, F_SETLK, F_WRLCK, 0, 100))
+                return 1;
+
+        if (waiter_start (&b, fname, 50, 50))
+                return 1;
+        if (waiter_granted (&b, WAIT_BLOCKED_MS))
+                return 1;
+
+        if (waiter_start (&c, fname, 0, 60))
+                return 1;
+        if (waiter_granted (&c, WAIT_BLOCKED_MS))
+                return 1;
+
+        if (lock (fd, F_SETLK, F_UNLCK, 0, 100))
+                return 1;
+        if (!waiter_granted (&b, WAIT_GRANTED_MS))
+                return 1;
+        if (waiter_granted (&c, WAIT_BLOCKED_MS))
+                return 1;
+
+        if (waiter_finish (&b))
+                return 1;
+        if (!waiter_granted (&c, WAIT_GRANTED_MS))
+                return 1;
+
+        return waiter_finish (&c) ? 1 : 0;
+}
+
+static int
+test_merge (int fd, const char *fname)
+{
+        struct flock f;
+        pid_t        pid = -1;
+        int          status = 0;
+        int          other = -1;
+
+        if (lock (fd, F_SETLK, F_WRLCK, 0, 10) ||
+            lock (fd, F_SETLK, F_WRLCK, 5, 15))
+                return 1;
+
+        pid = fork ();
+        if (pid < 0)
+                return 1;
+
+        if (pid == 0) {
+                other = open (fname, O_RDWR);
+                if (other < 0)
+                        _exit (1);
+
+                flock_init (&f, F_WRLCK, 15, 1);
+                if (fcntl (other, F_GETLK, &f))
+                        _exit (1);
+                if ((f.l_type != F_WRLCK) || (f.l_start != 0) ||
+                    (f.l_len != 20))
+                        _exit (1);
+
+                if (!lock (other, F_SETLK, F_WRLCK, 0, 20))
+                        _exit (1);
+                _exit (0);
+        }
+
+        if ((waitpid (pid, &status, 0) != pid) || !WIFEXITED (status) ||
+            WEXITSTATUS (status))
+                return 1;
+
+        if (lock (fd, F_SETLK, F_UNLCK, 0, 20))
+                return 1;
+
+        pid = fork ();
+        if (pid < 0)
+                return 1;
+
+        if (pid == 0) {
+                other = open (fname, O_RDWR);
+                if (other < 0)
+                        _exit (1);
+                if (lock (other, F_SETLK, F_WRLCK, 0, 20))
+                        _exit (1);
+                _exit (0);
+        }
+
+        if ((waitpid (pid, &status, 0) != pid) || !WIFEXITED (status) ||
+            WEXITSTATUS (status))
+                return 1;
+
+        return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+        int fd = -1;
+        int ret = 1;
+
+        if (argc != 3) {
+                fprintf (stderr, "usage: %s <file> disjoint|queued|merge\n",
+                         argv[0]);
+                return 1;
+        }
+
+        fd = open (argv[1], O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+                perror ("open");
+                return 1;
+        }
+
+        if (!strcmp (argv[2], "disjoint"))
+                ret = test_disjoint (fd, argv[1]);
+        else if (!strcmp (argv[2], "queued"))
+                ret = test_queued (fd, argv[1]);
+        else if (!strcmp (argv[2], "merge"))
+                ret = test_merge (fd, argv[1]);
+
+        close (fd);
+        return ret;
+}
@@ -0,0 +1,30 @@
+#!/bin/bash
+
+. $(dirname $0)/../include.rc
+
+cleanup;
+
+## Start and create a volume
+TEST glusterd
+TEST pidof glusterd
+TEST $CLI volume create $V0 $H0:$B0/${V0}1;
+TEST $CLI volume start $V0;
+
+TEST glusterfs --entry-timeout=0 --attribute-timeout=0 -s $H0 --volfile-id $V0 $M0;
+
+TEST gcc -g -o $(dirname $0)/range-locks $(dirname $0)/range-locks.c;
+
+## Releasing a lock retries only the waiters on its range
+TEST $(dirname $0)/range-locks $M0/disjoint disjoint;
+
+## Waiters are granted in the order they blocked in, not of their offsets
+TEST $(dirname $0)/range-locks $M0/queued queued;
+
+## Overlapping locks of an owner are merged into one
+TEST $(dirname $0)/range-locks $M0/merge merge;
+
+rm -f $(dirname $0)/range-locks;
+
+TEST umount $M0;
+
+cleanup;
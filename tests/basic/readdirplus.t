@@ -0,0 +1,58 @@
+#!/bin/bash
+
+. $(dirname $0)/../include.rc
+
+cleanup;
+
+## Attributes of the entries of $M0/dir as listed, and as on the brick
+function listed_attrs()
+{
+    ls -ln --time-style=+%s $M0/dir |
+        awk 'NR > 1 {print substr($1, 1, 10), $3, $4, $5, $7}';
+}
+
+function brick_attrs()
+{
+    (cd $B0/${V0}1/dir && stat -c '%A %u %g %s %n' *);
+}
+
+function listing_matches()
+{
+    [ "`listed_attrs`" = "`brick_attrs`" ] && echo "Y";
+}
+
+
+## Start and create a volume
+TEST glusterd
+TEST pidof glusterd
+TEST $CLI volume create $V0 $H0:$B0/${V0}1;
+TEST $CLI volume start $V0;
+
+## Mount FUSE with READDIRPLUS, the kernel caching what it returns
+TEST glusterfs --use-readdirp=yes -s $H0 --volfile-id $V0 $M0;
+
+## Populate a directory with different sizes, modes and owners
+TEST mkdir $M0/dir;
+for i in `seq 1 20`; do
+    dd if=/dev/zero of=$M0/dir/file$i bs=1k count=$i 2>/dev/null;
+    chmod 6$((i % 8))$((i % 5)) $M0/dir/file$i;
+    chown $i:$((i * 2)) $M0/dir/file$i;
+done
+TEST mkdir $M0/dir/subdir;
+TEST ln -s file1 $M0/dir/link;
+
+EXPECT 'Y' listing_matches;
+
+## Rename within the listing, and change the renamed entry
+TEST mv $M0/dir/file5 $M0/dir/renamed;
+TEST 'echo more >> $M0/dir/renamed';
+TEST chmod 600 $M0/dir/renamed;
+TEST mv $M0/dir/file6 $M0/dir/file7;
+
+EXPECT 'Y' listing_matches;
+EXPECT '1' echo `ls $M0/dir | grep -c '^renamed$'`;
+EXPECT '0' echo `ls $M0/dir | grep -c '^file5$'`;
+
+TEST umount $M0;
+
+cleanup;
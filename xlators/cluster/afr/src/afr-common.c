@@ -203,12 +203,25 @@ out:
         return ret;
 }
 
+static void
+afr_inode_ctx_free (afr_inode_ctx_t *ctx)
+{
+        if (!ctx)
+                return;
+
+        GF_FREE (ctx->fresh_children);
+        GF_FREE (ctx->pre_op_done);
+        GF_FREE (ctx->pre_op_piggyback);
+        GF_FREE (ctx);
+}
+
 afr_inode_ctx_t*
 afr_inode_ctx_get_from_addr (uint64_t addr, int32_t child_count)
 {
         int             ret  = -1;
         afr_inode_ctx_t *ctx = NULL;
         size_t          size = 0;
+        int             i    = 0;
 
         GF_ASSERT (child_count > 0);
 
@@ -222,19 +235,60 @@ afr_inode_ctx_get_from_addr (uint64_t addr, int32_t child_count)
                                                  gf_afr_mt_int32_t);
                 if (!ctx->fresh_children)
                         goto out;
+                for (i = 0; i < child_count; i++)
+                        ctx->fresh_children[i] = -1;
+
+                ctx->pre_op_done = GF_CALLOC (child_count,
+                                              sizeof (*ctx->pre_op_done),
+                                              gf_afr_mt_int32_t);
+                if (!ctx->pre_op_done)
+                        goto out;
+                ctx->pre_op_piggyback = GF_CALLOC (child_count,
+                                                   sizeof (*ctx->pre_op_piggyback),
+                                                   gf_afr_mt_int32_t);
+                if (!ctx->pre_op_piggyback)
+                        goto out;
         } else {
                 ctx = (afr_inode_ctx_t*) (long) addr;
         }
         ret = 0;
 out:
         if (ret && ctx) {
-                GF_FREE (ctx->fresh_children);
-                GF_FREE (ctx);
+                afr_inode_ctx_free (ctx);
                 ctx = NULL;
         }
         return ctx;
 }
 
+/* Returns the ctx of @inode, setting a new one if it has none yet. To be
+ * called with inode->lock held. */
+afr_inode_ctx_t *
+__afr_inode_ctx_get (xlator_t *this, inode_t *inode)
+{
+        afr_inode_ctx_t *ctx      = NULL;
+        afr_private_t   *priv     = NULL;
+        uint64_t        ctx_addr  = 0;
+        int             ret       = 0;
+
+        priv = this->private;
+
+        ret = __inode_ctx_get (inode, this, &ctx_addr);
+        if (ret < 0)
+                ctx_addr = 0;
+
+        ctx = afr_inode_ctx_get_from_addr (ctx_addr, priv->child_count);
+        if (!ctx || ctx_addr)
+                goto out;
+
+        ret = __inode_ctx_put (inode, this, (uint64_t)(long)ctx);
+        if (ret) {
+                afr_inode_ctx_free (ctx);
+                ctx = NULL;
+        }
+out:
+        return ctx;
+}
+
 void
 afr_inode_get_ctx (xlator_t *this, inode_t *inode, afr_inode_params_t *params)
 {
@@ -749,6 +803,137 @@ out:
         return ret;
 }
 
+/* the cost of a read on a child: its moving average latency, times the
+ * reads already queued on it. A child not read from yet costs nothing */
+static double
+__afr_read_cost (afr_read_stats_t *stats)
+{
+        double latency = stats->latency;
+
+        if (latency < 1)
+                latency = 1;
+
+        return (stats->outstanding + 1) * latency;
+}
+
+/* With read-hash-mode 3 and no read-subvolume configured, reads go to
+ * the up fresh child with the lowest read cost. Every
+ * AFR_READ_PROBE_INTERVAL'th read instead goes to the up fresh child read
+ * from the least, so that the latency of a child which once was slow is
+ * measured again. Anything else is left to afr_get_call_child.
+ */
+int32_t
+afr_get_read_call_child (xlator_t *this, unsigned char *child_up,
+                         int32_t read_child, int32_t *fresh_children,
+                         int32_t *call_child, int32_t *last_index)
+{
+        afr_private_t    *priv  = NULL;
+        afr_read_stats_t *stats = NULL;
+        gf_boolean_t      probe = _gf_false;
+        double            cost  = 0;
+        double            best  = 0;
+        int32_t           child = -1;
+        int               i     = 0;
+
+        priv = this->private;
+
+        if ((priv->hash_mode != AFR_READ_HASH_LEAST_LOADED) ||
+            (priv->read_child >= 0) || !priv->read_stats || (read_child < 0))
+                return afr_get_call_child (this, child_up, read_child,
+                                           fresh_children, call_child,
+                                           last_index);
+
+        LOCK (&priv->read_child_lock);
+        {
+                probe = ((++priv->read_child_rr %
+                          AFR_READ_PROBE_INTERVAL) == 0);
+
+                for (i = 0; i < priv->child_count; i++) {
+                        if (fresh_children[i] == -1)
+                                break;
+                        if (!child_up[fresh_children[i]])
+                                continue;
+
+                        stats = &priv->read_stats[fresh_children[i]];
+                        cost = probe ? stats->reads : __afr_read_cost (stats);
+                        if ((child == -1) || (cost < best)) {
+                                child = fresh_children[i];
+                                best = cost;
+                        }
+                }
+        }
+        UNLOCK (&priv->read_child_lock);
+
+        if (child == -1)
+                return afr_get_call_child (this, child_up, read_child,
+                                           fresh_children, call_child,
+                                           last_index);
+
+        /* failover walks the fresh children, skipping this one */
+        *call_child = child;
+        *last_index = -1;
+
+        return 0;
+}
+
+/* Account a read wound to @child, until the matching afr_read_unwind() */
+void
+afr_read_wind (xlator_t *this, afr_local_t *local, int child)
+{
+        afr_private_t *priv = this->private;
+
+        if (!priv->read_stats || (child < 0))
+                return;
+
+        afr_read_unwind (this, local);
+
+        gettimeofday (&local->read_timed_start, NULL);
+
+        LOCK (&priv->read_child_lock);
+        {
+                priv->read_stats[child].outstanding++;
+        }
+        UNLOCK (&priv->read_child_lock);
+
+        local->read_timed_child = child;
+        local->read_timed = _gf_true;
+}
+
+/* Called first thing in the callback of a read, and from
+ * afr_local_cleanup() in case a read is unwound without one */
+void
+afr_read_unwind (xlator_t *this, afr_local_t *local)
+{
+        afr_private_t    *priv  = this->private;
+        afr_read_stats_t *stats = NULL;
+        struct timeval    now   = {0,};
+        double            usecs = 0;
+
+        if (!local || !local->read_timed)
+                return;
+
+        gettimeofday (&now, NULL);
+        usecs = (now.tv_sec - local->read_timed_start.tv_sec) * 1e6 +
+                (now.tv_usec - local->read_timed_start.tv_usec);
+
+        stats = &priv->read_stats[local->read_timed_child];
+
+        LOCK (&priv->read_child_lock);
+        {
+                if (stats->outstanding)
+                        stats->outstanding--;
+
+                /* weight 1/8, the first reply sets the average */
+                if (!stats->reads++)
+                        stats->latency = usecs;
+                else
+                        stats->latency += (usecs - stats->latency) / 8;
+        }
+        UNLOCK (&priv->read_child_lock);
+
+        local->read_timed = _gf_false;
+}
+
 void
 afr_reset_xattr (dict_t **xattr, unsigned int child_count)
 {
@@ -815,8 +1000,10 @@ afr_local_sh_cleanup (afr_local_t *local, xlator_t *this)
         loc_wipe (&sh->lookup_loc);
 
         GF_FREE (sh->checksum);
+        GF_FREE (sh->checksum_type);
 
         GF_FREE (sh->write_needed);
+        GF_FREE (sh->dirty_blocks);
         if (sh->healing_fd)
                 fd_unref (sh->healing_fd);
 }
@@ -843,6 +1030,7 @@ afr_local_transaction_cleanup (afr_local_t *local, xlator_t *this)
 
 
         GF_FREE (local->transaction.pre_op);
+        GF_FREE (local->transaction.dirty_blocks_failed);
         GF_FREE (local->transaction.eager_lock);
 
         GF_FREE (local->transaction.basename);
@@ -861,6 +1049,8 @@ afr_local_cleanup (afr_local_t *local, xlator_t *this)
         if (!local)
                 return;
 
+        afr_read_unwind (this, local);
+
         afr_local_sh_cleanup (local, this);
 
         afr_local_transaction_cleanup (local, this);
@@ -1019,6 +1209,43 @@ afr_set_elem_count_get (unsigned char *elems, int child_count)
         return ret;
 }
 
+/* the bit of AFR_DIRTY_BLOCKS_KEY covering offset; files larger than
+   the map fold onto it, which can only make self-heal look at more */
+static inline int
+afr_dirty_blocks_bit (off_t offset)
+{
+        return (offset / AFR_DIRTY_BLOCKS_CHUNK) % (AFR_DIRTY_BLOCKS_SIZE * 8);
+}
+
+void
+afr_dirty_blocks_mark (unsigned char *map, off_t start, off_t len)
+{
+        off_t chunk = 0;
+        int   bit   = 0;
+
+        /* a zero len is up to the end of the file: truncate and O_APPEND
+           writes do not know where they end */
+        if (len <= 0 || (len / AFR_DIRTY_BLOCKS_CHUNK) >=
+            (AFR_DIRTY_BLOCKS_SIZE * 8)) {
+                memset (map, 0xff, AFR_DIRTY_BLOCKS_SIZE);
+                return;
+        }
+
+        for (chunk = start - (start % AFR_DIRTY_BLOCKS_CHUNK);
+             chunk < start + len; chunk += AFR_DIRTY_BLOCKS_CHUNK) {
+                bit = afr_dirty_blocks_bit (chunk);
+                map[bit / 8] |= 1 << (bit % 8);
+        }
+}
+
+gf_boolean_t
+afr_dirty_blocks_test (unsigned char *map, off_t offset)
+{
+        int bit = afr_dirty_blocks_bit (offset);
+
+        return (map[bit / 8] & (1 << (bit % 8))) ? _gf_true : _gf_false;
+}
+
 /**
  * up_children_count - return the number of children that are up
  */
@@ -2369,22 +2596,6 @@ __afr_fd_ctx_set (xlator_t *this, fd_t *fd)
                 goto out;
         }
 
-        fd_ctx->pre_op_done = GF_CALLOC (sizeof (*fd_ctx->pre_op_done),
-                                         priv->child_count,
-                                         gf_afr_mt_char);
-        if (!fd_ctx->pre_op_done) {
-                ret = -ENOMEM;
-                goto out;
-        }
-
-        fd_ctx->pre_op_piggyback = GF_CALLOC (sizeof (*fd_ctx->pre_op_piggyback),
-                                              priv->child_count,
-                                              gf_afr_mt_char);
-        if (!fd_ctx->pre_op_piggyback) {
-                ret = -ENOMEM;
-                goto out;
-        }
-
         fd_ctx->opened_on = GF_CALLOC (sizeof (*fd_ctx->opened_on),
                                        priv->child_count,
                                        gf_afr_mt_int32_t);
@@ -2655,13 +2866,10 @@ afr_cleanup_fd_ctx (xlator_t *this, fd_t *fd)
         fd_ctx = (afr_fd_ctx_t *)(long) ctx;
 
         if (fd_ctx) {
-                GF_FREE (fd_ctx->pre_op_done);
-
                 GF_FREE (fd_ctx->opened_on);
 
                 GF_FREE (fd_ctx->locked_on);
 
-                GF_FREE (fd_ctx->pre_op_piggyback);
                 list_for_each_entry_safe (paused_call, tmp, &fd_ctx->paused_calls,
                                           call_list) {
                         list_del_init (&paused_call->call_list);
@@ -3632,8 +3840,7 @@ afr_forget (xlator_t *this, inode_t *inode)
                 goto out;
 
         ctx = (afr_inode_ctx_t *)(long)ctx_addr;
-        GF_FREE (ctx->fresh_children);
-        GF_FREE (ctx);
+        afr_inode_ctx_free (ctx);
 out:
         return 0;
 }
@@ -3661,6 +3868,22 @@ afr_priv_dump (xlator_t *this)
                 sprintf (key, "pending_key[%d]", i);
                 gf_proc_dump_write(key, "%s", priv->pending_key[i]);
         }
+        if (priv->read_stats) {
+                gf_proc_dump_write("read_hash_mode", "%u", priv->hash_mode);
+                LOCK (&priv->read_child_lock);
+                for (i = 0; i < priv->child_count; i++) {
+                        sprintf (key, "read_latency_usecs[%d]", i);
+                        gf_proc_dump_write(key, "%.1f",
+                                           priv->read_stats[i].latency);
+                        sprintf (key, "read_outstanding[%d]", i);
+                        gf_proc_dump_write(key, "%u",
+                                           priv->read_stats[i].outstanding);
+                        sprintf (key, "reads[%d]", i);
+                        gf_proc_dump_write(key, "%"PRIu64,
+                                           priv->read_stats[i].reads);
+                }
+                UNLOCK (&priv->read_child_lock);
+        }
         gf_proc_dump_write("data_self_heal", "%s", priv->data_self_heal);
         gf_proc_dump_write("metadata_self_heal", "%d", priv->metadata_self_heal);
         gf_proc_dump_write("entry_self_heal", "%d", priv->entry_self_heal);
@@ -4073,6 +4296,12 @@ afr_transaction_local_init (afr_local_t *local, xlator_t *this)
         if (!local->transaction.pre_op)
                 goto out;
 
+        local->transaction.dirty_blocks_failed =
+                GF_CALLOC (sizeof (*local->transaction.dirty_blocks_failed),
+                           priv->child_count, gf_afr_mt_char);
+        if (!local->transaction.dirty_blocks_failed)
+                goto out;
+
         local->pending = afr_matrix_create (priv->child_count,
                                             AFR_NUM_CHANGE_LOGS);
         if (!local->pending)
@@ -4259,6 +4488,8 @@ afr_priv_destroy (afr_private_t *priv)
 //                if (priv->shd.timer && priv->shd.timer[i])
 //                        gf_timer_call_cancel (this->ctx, priv->shd.timer[i]);
         GF_FREE (priv->shd.timer);
+        GF_FREE (priv->shd.stats);
+        GF_FREE (priv->read_stats);
 
         if (priv->shd.healed)
                 eh_destroy (priv->shd.healed);
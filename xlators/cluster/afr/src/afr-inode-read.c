@@ -65,6 +65,8 @@ afr_access_cbk (call_frame_t *frame, void *cookie,
 
         local = frame->local;
 
+        afr_read_unwind (this, local);
+
         read_child = (long) cookie;
 
         if (op_ret == -1) {
@@ -79,6 +81,8 @@ afr_access_cbk (call_frame_t *frame, void *cookie,
 
                 unwind = 0;
 
+                afr_read_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_access_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -133,10 +137,10 @@ afr_access (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t mask,
 
         read_child = afr_inode_get_read_ctx (this, loc->inode,
                                              local->fresh_children);
-        ret = afr_get_call_child (this, local->child_up, read_child,
-                                     local->fresh_children,
-                                     &call_child,
-                                     &local->cont.access.last_index);
+        ret = afr_get_read_call_child (this, local->child_up, read_child,
+                                       local->fresh_children,
+                                       &call_child,
+                                       &local->cont.access.last_index);
         if (ret < 0) {
                 op_errno = -ret;
                 goto out;
@@ -145,6 +149,8 @@ afr_access (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t mask,
         loc_copy (&local->loc, loc);
         local->cont.access.mask = mask;
 
+        afr_read_wind (this, local, call_child);
+
         STACK_WIND_COOKIE (frame, afr_access_cbk,
                            (void *) (long) call_child,
                            children[call_child],
@@ -184,6 +190,8 @@ afr_stat_cbk (call_frame_t *frame, void *cookie,
 
         local = frame->local;
 
+        afr_read_unwind (this, local);
+
         if (op_ret == -1) {
                 last_index = &local->cont.stat.last_index;
                 fresh_children = local->fresh_children;
@@ -196,6 +204,8 @@ afr_stat_cbk (call_frame_t *frame, void *cookie,
 
                 unwind = 0;
 
+                afr_read_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_stat_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -247,16 +257,18 @@ afr_stat (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xdata)
 
         read_child = afr_inode_get_read_ctx (this, loc->inode,
                                              local->fresh_children);
-        ret = afr_get_call_child (this, local->child_up, read_child,
-                                     local->fresh_children,
-                                     &call_child,
-                                     &local->cont.stat.last_index);
+        ret = afr_get_read_call_child (this, local->child_up, read_child,
+                                       local->fresh_children,
+                                       &call_child,
+                                       &local->cont.stat.last_index);
         if (ret < 0) {
                 op_errno = -ret;
                 goto out;
         }
         loc_copy (&local->loc, loc);
 
+        afr_read_wind (this, local, call_child);
+
         STACK_WIND_COOKIE (frame, afr_stat_cbk, (void *) (long) call_child,
                            children[call_child],
                            children[call_child]->fops->stat,
@@ -294,6 +306,8 @@ afr_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         local = frame->local;
 
+        afr_read_unwind (this, local);
+
         read_child = (long) cookie;
 
         if (op_ret == -1) {
@@ -308,6 +322,8 @@ afr_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
                 unwind = 0;
 
+                afr_read_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_fstat_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -366,10 +382,10 @@ afr_fstat (call_frame_t *frame, xlator_t *this,
 
 
 
-        ret = afr_get_call_child (this, local->child_up, read_child,
-                                     local->fresh_children,
-                                     &call_child,
-                                     &local->cont.fstat.last_index);
+        ret = afr_get_read_call_child (this, local->child_up, read_child,
+                                       local->fresh_children,
+                                       &call_child,
+                                       &local->cont.fstat.last_index);
         if (ret < 0) {
                 op_errno = -ret;
                 goto out;
@@ -382,6 +398,9 @@ afr_fstat (call_frame_t *frame, xlator_t *this,
                 op_errno = -ret;
                 goto out;
         }
+
+        afr_read_wind (this, local, call_child);
+
         STACK_WIND_COOKIE (frame, afr_fstat_cbk, (void *) (long) call_child,
                            children[call_child],
                            children[call_child]->fops->fstat,
@@ -418,6 +437,8 @@ afr_readlink_cbk (call_frame_t *frame, void *cookie,
 
         local = frame->local;
 
+        afr_read_unwind (this, local);
+
         read_child = (long) cookie;
 
         if (op_ret == -1) {
@@ -431,6 +452,8 @@ afr_readlink_cbk (call_frame_t *frame, void *cookie,
                         goto out;
 
                 unwind = 0;
+                afr_read_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_readlink_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -484,10 +507,10 @@ afr_readlink (call_frame_t *frame, xlator_t *this,
         }
         read_child = afr_inode_get_read_ctx (this, loc->inode,
                                              local->fresh_children);
-        ret = afr_get_call_child (this, local->child_up, read_child,
-                                     local->fresh_children,
-                                     &call_child,
-                                     &local->cont.readlink.last_index);
+        ret = afr_get_read_call_child (this, local->child_up, read_child,
+                                       local->fresh_children,
+                                       &call_child,
+                                       &local->cont.readlink.last_index);
         if (ret < 0) {
                 op_errno = -ret;
                 goto out;
@@ -497,6 +520,8 @@ afr_readlink (call_frame_t *frame, xlator_t *this,
 
         local->cont.readlink.size       = size;
 
+        afr_read_wind (this, local, call_child);
+
         STACK_WIND_COOKIE (frame, afr_readlink_cbk,
                            (void *) (long) call_child,
                            children[call_child],
@@ -586,6 +611,8 @@ afr_getxattr_cbk (call_frame_t *frame, void *cookie,
 
         local = frame->local;
 
+        afr_read_unwind (this, local);
+
         read_child = (long) cookie;
 
         if (op_ret == -1) {
@@ -599,6 +626,8 @@ afr_getxattr_cbk (call_frame_t *frame, void *cookie,
                         goto out;
 
                 unwind = 0;
+                afr_read_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_getxattr_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -1063,15 +1092,17 @@ no_name:
         }
 
         read_child = afr_inode_get_read_ctx (this, loc->inode, local->fresh_children);
-        ret = afr_get_call_child (this, local->child_up, read_child,
-                                     local->fresh_children,
-                                     &call_child,
-                                     &local->cont.getxattr.last_index);
+        ret = afr_get_read_call_child (this, local->child_up, read_child,
+                                       local->fresh_children,
+                                       &call_child,
+                                       &local->cont.getxattr.last_index);
         if (ret < 0) {
                 op_errno = -ret;
                 goto out;
         }
 
+        afr_read_wind (this, local, call_child);
+
         STACK_WIND_COOKIE (frame, afr_getxattr_cbk,
                            (void *) (long) call_child,
                            children[call_child],
@@ -1107,6 +1138,8 @@ afr_fgetxattr_cbk (call_frame_t *frame, void *cookie,
 
         local = frame->local;
 
+        afr_read_unwind (this, local);
+
         read_child = (long) cookie;
 
         if (op_ret == -1) {
@@ -1120,6 +1153,8 @@ afr_fgetxattr_cbk (call_frame_t *frame, void *cookie,
                         goto out;
 
                 unwind = 0;
+                afr_read_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_fgetxattr_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -1194,16 +1229,18 @@ afr_fgetxattr (call_frame_t *frame, xlator_t *this,
         }
 
         read_child = afr_inode_get_read_ctx (this, fd->inode, local->fresh_children);
-        op_ret = afr_get_call_child (this, local->child_up, read_child,
-                                     local->fresh_children,
-                                     &call_child,
-                                     &local->cont.getxattr.last_index);
+        op_ret = afr_get_read_call_child (this, local->child_up, read_child,
+                                          local->fresh_children,
+                                          &call_child,
+                                          &local->cont.getxattr.last_index);
         if (op_ret < 0) {
                 op_errno = -op_ret;
                 op_ret = -1;
                 goto out;
         }
 
+        afr_read_wind (this, local, call_child);
+
         STACK_WIND_COOKIE (frame, afr_fgetxattr_cbk,
                            (void *) (long) call_child,
                            children[call_child],
@@ -1261,6 +1298,8 @@ afr_readv_cbk (call_frame_t *frame, void *cookie,
 
         local = frame->local;
 
+        afr_read_unwind (this, local);
+
         read_child = (long) cookie;
 
         if (op_ret == -1) {
@@ -1275,6 +1314,8 @@ afr_readv_cbk (call_frame_t *frame, void *cookie,
 
                 unwind = 0;
 
+                afr_read_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_readv_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -1329,10 +1370,10 @@ afr_readv (call_frame_t *frame, xlator_t *this,
         }
 
         read_child = afr_inode_get_read_ctx (this, fd->inode, local->fresh_children);
-        ret = afr_get_call_child (this, local->child_up, read_child,
-                                     local->fresh_children,
-                                     &call_child,
-                                     &local->cont.readv.last_index);
+        ret = afr_get_read_call_child (this, local->child_up, read_child,
+                                       local->fresh_children,
+                                       &call_child,
+                                       &local->cont.readv.last_index);
         if (ret < 0) {
                 op_errno = -ret;
                 goto out;
@@ -1349,6 +1390,9 @@ afr_readv (call_frame_t *frame, xlator_t *this,
                 op_errno = -ret;
                 goto out;
         }
+
+        afr_read_wind (this, local, call_child);
+
         STACK_WIND_COOKIE (frame, afr_readv_cbk,
                            (void *) (long) call_child,
                            children[call_child],
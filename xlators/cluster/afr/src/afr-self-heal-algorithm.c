@@ -25,6 +25,7 @@
 #include "compat-errno.h"
 #include "compat.h"
 #include "byte-order.h"
+#include "checksum.h"
 
 #include "afr-transaction.h"
 #include "afr-self-heal.h"
@@ -229,10 +230,16 @@ sh_loop_frame_create (call_frame_t *sh_frame, xlator_t *this,
                                                gf_afr_mt_char);
         if (!new_loop_sh->write_needed)
                 goto out;
-        new_loop_sh->checksum = GF_CALLOC (priv->child_count, MD5_DIGEST_LENGTH,
+        new_loop_sh->checksum = GF_CALLOC (priv->child_count,
+                                           GF_RSYNC_STRONG_CHECKSUM_MAXLEN,
                                            gf_afr_mt_uint8_t);
         if (!new_loop_sh->checksum)
                 goto out;
+        new_loop_sh->checksum_type = GF_CALLOC (priv->child_count,
+                                                sizeof (*new_loop_sh->checksum_type),
+                                                gf_afr_mt_int);
+        if (!new_loop_sh->checksum_type)
+                goto out;
         new_loop_sh->inode      = inode_ref (sh->inode);
         new_loop_sh->sh_data_algo_start = sh->sh_data_algo_start;
         new_loop_sh->source = sh->source;
@@ -283,6 +290,22 @@ out:
         return 0;
 }
 
+/* whether the block at offset has a chunk marked in the dirty blocks */
+static gf_boolean_t
+sh_block_dirty (afr_self_heal_t *sh, off_t offset)
+{
+        off_t chunk = 0;
+
+        for (chunk = offset - (offset % AFR_DIRTY_BLOCKS_CHUNK);
+             chunk < offset + sh->block_size;
+             chunk += AFR_DIRTY_BLOCKS_CHUNK) {
+                if (afr_dirty_blocks_test (sh->dirty_blocks, chunk))
+                        return _gf_true;
+        }
+
+        return _gf_false;
+}
+
 static int
 sh_loop_driver (call_frame_t *sh_frame, xlator_t *this,
                 gf_boolean_t is_first_call, call_frame_t *old_loop_frame)
@@ -293,7 +316,9 @@ sh_loop_driver (call_frame_t *sh_frame, xlator_t *this,
         gf_boolean_t                is_driver_done = _gf_false;
         blksize_t                   block_size     = 0;
         int                         loop           = 0;
-        off_t                       offset         = 0;
+        int                         i              = 0;
+        unsigned int                window         = 0;
+        off_t                       *offsets       = NULL;
         afr_private_t               *priv          = NULL;
 
         priv    = this->private;
@@ -301,17 +326,31 @@ sh_loop_driver (call_frame_t *sh_frame, xlator_t *this,
         sh      = &local->self_heal;
         sh_priv = sh->private;
 
+        /* checksums of the clean blocks are not needed, the few blocks
+           left can all be in flight */
+        window = priv->data_self_heal_window_size;
+        if (sh->dirty_blocks && window < AFR_DIRTY_BLOCKS_WINDOW)
+                window = AFR_DIRTY_BLOCKS_WINDOW;
+
+        offsets = alloca (window * sizeof (*offsets));
+
         LOCK (&sh_priv->lock);
         {
                 if (!is_first_call)
                         sh_priv->loops_running--;
-                offset = sh_priv->offset;
                 block_size = sh->block_size;
                 while ((!sh->eof_reached) && (0 == sh->op_failed) &&
-                       (sh_priv->loops_running < priv->data_self_heal_window_size)
-                       && (sh_priv->offset < sh->file_size)) {
+                       (sh_priv->loops_running < window)) {
+
+                        while (sh->dirty_blocks &&
+                               (sh_priv->offset < sh->file_size) &&
+                               !sh_block_dirty (sh, sh_priv->offset))
+                                sh_priv->offset += block_size;
+
+                        if (sh_priv->offset >= sh->file_size)
+                                break;
 
-                        loop++;
+                        offsets[loop++] = sh_priv->offset;
                         sh_priv->offset += block_size;
                         sh_priv->loops_running++;
 
@@ -337,7 +376,7 @@ sh_loop_driver (call_frame_t *sh_frame, xlator_t *this,
 
         //If we have more loops to form we should finish previous loop after
         //the next loop lock
-        while (loop--) {
+        for (i = 0; i < loop; i++) {
                 if (sh->op_failed) {
                         // op failed in other loop, stop spawning more loops
                         if (old_loop_frame) {
@@ -347,11 +386,11 @@ sh_loop_driver (call_frame_t *sh_frame, xlator_t *this,
                         sh_loop_driver (sh_frame, this, _gf_false, NULL);
                 } else {
                         gf_log (this->name, GF_LOG_TRACE, "spawning a loop "
-                                "for offset %"PRId64, offset);
+                                "for offset %"PRId64, offsets[i]);
 
-                        sh_loop_start (sh_frame, this, offset, old_loop_frame);
+                        sh_loop_start (sh_frame, this, offsets[i],
+                                       old_loop_frame);
                         old_loop_frame = NULL;
-                        offset += block_size;
                 }
         }
 
@@ -587,6 +626,10 @@ sh_diff_checksum_cbk (call_frame_t *loop_frame, void *cookie, xlator_t *this,
         int                           call_count   = 0;
         int                           i            = 0;
         int                           write_needed = 0;
+        int                           type         = GF_RSYNC_STRONG_MD5;
+        int                           source_type  = 0;
+        size_t                        len          = 0;
+        char                          *type_name   = NULL;
 
         priv  = this->private;
 
@@ -608,23 +651,46 @@ sh_diff_checksum_cbk (call_frame_t *loop_frame, void *cookie, xlator_t *this,
                         strerror (op_errno));
                 sh->op_failed = 1;
         } else {
-                memcpy (loop_sh->checksum + child_index * MD5_DIGEST_LENGTH,
-                        strong_checksum, MD5_DIGEST_LENGTH);
+                /* bricks which do not know the key reply without it */
+                if (xdata && !dict_get_str (xdata, GF_RCHECKSUM_TYPE_KEY,
+                                            &type_name))
+                        type = gf_rsync_strong_type_from_name (type_name);
+                if (type < 0)
+                        type = GF_RSYNC_STRONG_MD5;
+
+                LOCK (&sh_priv->lock);
+                {
+                        if (type != sh_priv->strong_type)
+                                sh_priv->strong_type = GF_RSYNC_STRONG_MD5;
+                }
+                UNLOCK (&sh_priv->lock);
+
+                loop_sh->checksum_type[child_index] = type;
+                memcpy (loop_sh->checksum +
+                        child_index * GF_RSYNC_STRONG_CHECKSUM_MAXLEN,
+                        strong_checksum, gf_rsync_strong_checksum_len (type));
         }
 
         call_count = afr_frame_return (loop_frame);
 
         if (call_count == 0) {
+                source_type = loop_sh->checksum_type[sh->source];
+                len = gf_rsync_strong_checksum_len (source_type);
+
                 for (i = 0; i < priv->child_count; i++) {
                         if (sh->sources[i] || !sh_local->child_up[i])
                                 continue;
 
-                        if (memcmp (loop_sh->checksum + (i * MD5_DIGEST_LENGTH),
-                                    loop_sh->checksum + (sh->source * MD5_DIGEST_LENGTH),
-                                    MD5_DIGEST_LENGTH)) {
+                        if ((loop_sh->checksum_type[i] != source_type) ||
+                            memcmp (loop_sh->checksum +
+                                    (i * GF_RSYNC_STRONG_CHECKSUM_MAXLEN),
+                                    loop_sh->checksum +
+                                    (sh->source * GF_RSYNC_STRONG_CHECKSUM_MAXLEN),
+                                    len)) {
                                 /*
-                                  Checksums differ, so this block
-                                  must be written to this sink
+                                  Checksums differ (or could not be
+                                  compared), so this block must be
+                                  written to this sink
                                 */
 
                                 gf_log (this->name, GF_LOG_DEBUG,
@@ -661,12 +727,36 @@ sh_diff_checksum (call_frame_t *loop_frame, xlator_t *this)
         afr_private_t           *priv         = NULL;
         afr_local_t             *loop_local   = NULL;
         afr_self_heal_t         *loop_sh      = NULL;
+        afr_local_t             *sh_local     = NULL;
+        afr_sh_algo_private_t   *sh_priv      = NULL;
+        dict_t                  *xdata        = NULL;
+        int                     type          = 0;
         int                     call_count    = 0;
         int                     i             = 0;
 
         priv         = this->private;
         loop_local   = loop_frame->local;
         loop_sh      = &loop_local->self_heal;
+        sh_local     = loop_sh->sh_frame->local;
+        sh_priv      = sh_local->self_heal.private;
+
+        LOCK (&sh_priv->lock);
+        {
+                type = sh_priv->strong_type;
+        }
+        UNLOCK (&sh_priv->lock);
+
+        /* MD5 is what bricks compute unasked; without the dict every
+           brick, old or new, replies with it */
+        if (type != GF_RSYNC_STRONG_MD5) {
+                xdata = dict_new ();
+                if (xdata &&
+                    dict_set_str (xdata, GF_RCHECKSUM_TYPE_KEY,
+                                  (char *) gf_rsync_strong_type_name (type))) {
+                        dict_unref (xdata);
+                        xdata = NULL;
+                }
+        }
 
         call_count = loop_sh->active_sinks + 1;  /* sinks and source */
 
@@ -677,7 +767,7 @@ sh_diff_checksum (call_frame_t *loop_frame, xlator_t *this)
                            priv->children[loop_sh->source],
                            priv->children[loop_sh->source]->fops->rchecksum,
                            loop_sh->healing_fd,
-                           loop_sh->offset, loop_sh->block_size, NULL);
+                           loop_sh->offset, loop_sh->block_size, xdata);
 
         for (i = 0; i < priv->child_count; i++) {
                 if (loop_sh->sources[i] || !loop_local->child_up[i])
@@ -688,12 +778,16 @@ sh_diff_checksum (call_frame_t *loop_frame, xlator_t *this)
                                    priv->children[i],
                                    priv->children[i]->fops->rchecksum,
                                    loop_sh->healing_fd,
-                                   loop_sh->offset, loop_sh->block_size, NULL);
+                                   loop_sh->offset, loop_sh->block_size,
+                                   xdata);
 
                 if (!--call_count)
                         break;
         }
 
+        if (xdata)
+                dict_unref (xdata);
+
         return 0;
 }
 
@@ -719,16 +813,24 @@ sh_full_read_write_to_sinks (call_frame_t *loop_frame, xlator_t *this)
 }
 
 afr_sh_algo_private_t*
-afr_sh_priv_init ()
+afr_sh_priv_init (xlator_t *this)
 {
+        afr_private_t           *priv    = NULL;
         afr_sh_algo_private_t   *sh_priv = NULL;
 
+        priv = this->private;
+
         sh_priv = GF_CALLOC (1, sizeof (*sh_priv),
                              gf_afr_mt_afr_private_t);
         if (!sh_priv)
                 goto out;
 
         LOCK_INIT (&sh_priv->lock);
+
+        sh_priv->strong_type = gf_rsync_strong_type_from_name (
+                                        priv->data_self_heal_checksum);
+        if (sh_priv->strong_type < 0)
+                sh_priv->strong_type = GF_RSYNC_STRONG_MD5;
 out:
         return sh_priv;
 }
@@ -773,7 +875,7 @@ afr_sh_start_loops (call_frame_t *sh_frame, xlator_t *this,
         if (ret)
                 goto out;
         afr_sh_transfer_lock (first_loop_frame, sh_frame, priv->child_count);
-        sh->private = afr_sh_priv_init ();
+        sh->private = afr_sh_priv_init (this);
         if (!sh->private) {
                 ret = -1;
                 goto out;
@@ -27,6 +27,9 @@ typedef struct {
 
         int32_t total_blocks;
         int32_t diff_blocks;
+
+        int strong_type;        /* checksum requested from the bricks,
+                                   MD5 once any of them did not honour it */
 } afr_sh_algo_private_t;
 
 #endif /* __AFR_SELF_HEAL_ALGORITHM_H__ */
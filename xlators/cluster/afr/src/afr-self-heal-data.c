@@ -489,15 +489,196 @@ afr_sh_data_pick_algo (call_frame_t *frame, xlator_t *this)
 }
 
 
+/* ORs the given dirty blocks, or all of them, into the map of each child
+ * in children[] (-1 terminated) */
+static int
+afr_sh_data_dirty_blocks_or (call_frame_t *frame, xlator_t *this,
+                             unsigned char *dirty_blocks, int32_t *children,
+                             int call_count, fop_fxattrop_cbk_t cbk)
+{
+        afr_local_t     *local = NULL;
+        afr_self_heal_t *sh    = NULL;
+        afr_private_t   *priv  = NULL;
+        dict_t          *xattr = NULL;
+        unsigned char   *map   = NULL;
+        int              i     = 0;
+        int              ret   = -1;
+
+        local = frame->local;
+        sh    = &local->self_heal;
+        priv  = this->private;
+
+        xattr = dict_new ();
+        map = GF_CALLOC (1, AFR_DIRTY_BLOCKS_SIZE, gf_afr_mt_char);
+        if (!xattr || !map)
+                goto out;
+
+        if (dirty_blocks)
+                memcpy (map, dirty_blocks, AFR_DIRTY_BLOCKS_SIZE);
+        else
+                memset (map, 0xff, AFR_DIRTY_BLOCKS_SIZE);
+
+        ret = dict_set_dynptr (xattr, AFR_DIRTY_BLOCKS_KEY, map,
+                               AFR_DIRTY_BLOCKS_SIZE);
+        if (ret)
+                goto out;
+        map = NULL;
+
+        local->call_count = call_count;
+        for (i = 0; i < priv->child_count; i++) {
+                if (children[i] == -1)
+                        break;
+                STACK_WIND_COOKIE (frame, cbk, (void *) (long) children[i],
+                                   priv->children[children[i]],
+                                   priv->children[children[i]]->fops->fxattrop,
+                                   sh->healing_fd, GF_XATTROP_OR_ARRAY, xattr,
+                                   NULL);
+                if (!--call_count)
+                        break;
+        }
+out:
+        if (xattr)
+                dict_unref (xattr);
+        GF_FREE (map);
+        return ret;
+}
+
+int
+afr_sh_data_sync_start (call_frame_t *frame, xlator_t *this)
+{
+        afr_local_t     *local = NULL;
+        afr_self_heal_t *sh = NULL;
+
+        local = frame->local;
+        sh = &local->self_heal;
+
+        sh->algo->fn (frame, this);
+        return 0;
+}
+
+int
+afr_sh_data_dirty_blocks_all_cbk (call_frame_t *frame, void *cookie,
+                                  xlator_t *this, int32_t op_ret,
+                                  int32_t op_errno, dict_t *xattr,
+                                  dict_t *xdata)
+{
+        afr_local_t     *local = NULL;
+        afr_private_t   *priv  = NULL;
+
+        local = frame->local;
+        priv  = this->private;
+
+        if (op_ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR, "marking all blocks of %s "
+                        "dirty failed on %s (%s)", local->loc.path,
+                        priv->children[(long) cookie]->name,
+                        strerror (op_errno));
+                afr_sh_data_fail (frame, this);
+                return 0;
+        }
+
+        afr_sh_data_sync_start (frame, this);
+        return 0;
+}
+
+/* The sync is not guided by the dirty blocks of the source. The sinks
+ * may have differences it does not record, from before the map, or from
+ * an entry self-heal, and a sync which stops half way leaves them behind;
+ * so the whole map is set first. */
+int
+afr_sh_data_dirty_blocks_all (call_frame_t *frame, xlator_t *this)
+{
+        afr_local_t     *local       = NULL;
+        afr_self_heal_t *sh          = NULL;
+        int32_t          children[2] = {-1, -1};
+
+        local = frame->local;
+        sh = &local->self_heal;
+
+        children[0] = sh->source;
+        if (afr_sh_data_dirty_blocks_or (frame, this, NULL, children, 1,
+                                         afr_sh_data_dirty_blocks_all_cbk))
+                afr_sh_data_fail (frame, this);
+
+        return 0;
+}
+
+/* The map of the source covers what the sinks miss when every sink is
+ * behind it only by writes it recorded: the source finished all its
+ * transactions and blames each sink for some. */
+static gf_boolean_t
+afr_sh_data_dirty_blocks_usable (call_frame_t *frame, xlator_t *this)
+{
+        afr_local_t     *local = NULL;
+        afr_self_heal_t *sh    = NULL;
+        afr_private_t   *priv  = NULL;
+        int              i     = 0;
+
+        local = frame->local;
+        sh    = &local->self_heal;
+        priv  = this->private;
+
+        if (strcmp (sh->algo->name, "diff"))
+                return _gf_false;
+
+        if (sh->pending_matrix[sh->source][sh->source])
+                return _gf_false;
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (sh->sources[i] || !local->child_up[i])
+                        continue;
+                if ((sh->pending_matrix[sh->source][i] <= 0) ||
+                    (sh->buf[i].ia_size == 0))
+                        return _gf_false;
+        }
+
+        return _gf_true;
+}
+
+int
+afr_sh_data_dirty_blocks_get_cbk (call_frame_t *frame, void *cookie,
+                                  xlator_t *this, int32_t op_ret,
+                                  int32_t op_errno, dict_t *dict,
+                                  dict_t *xdata)
+{
+        afr_local_t     *local = NULL;
+        afr_self_heal_t *sh    = NULL;
+        data_t          *data  = NULL;
+
+        local = frame->local;
+        sh    = &local->self_heal;
+
+        if (op_ret == 0)
+                data = dict_get (dict, AFR_DIRTY_BLOCKS_KEY);
+
+        if (!data || (data->len != AFR_DIRTY_BLOCKS_SIZE)) {
+                afr_sh_data_dirty_blocks_all (frame, this);
+                return 0;
+        }
+
+        sh->dirty_blocks = memdup (data->data, AFR_DIRTY_BLOCKS_SIZE);
+        if (!sh->dirty_blocks) {
+                afr_sh_data_dirty_blocks_all (frame, this);
+                return 0;
+        }
+
+        gf_log (this->name, GF_LOG_DEBUG, "self-healing the dirty blocks "
+                "of %s only", local->loc.path);
+        afr_sh_data_sync_start (frame, this);
+        return 0;
+}
+
 int
 afr_sh_data_sync_prepare (call_frame_t *frame, xlator_t *this)
 {
         afr_local_t     *local = NULL;
         afr_self_heal_t *sh = NULL;
+        afr_private_t   *priv = NULL;
         struct afr_sh_algorithm *sh_algo = NULL;
 
         local = frame->local;
         sh = &local->self_heal;
+        priv = this->private;
 
         sh->algo_completion_cbk = afr_sh_data_erase_pending;
         sh->algo_abort_cbk      = afr_sh_data_fail;
@@ -505,8 +686,27 @@ afr_sh_data_sync_prepare (call_frame_t *frame, xlator_t *this)
         sh_algo = afr_sh_data_pick_algo (frame, this);
 
         sh->algo = sh_algo;
-        sh_algo->fn (frame, this);
 
+        GF_FREE (sh->dirty_blocks);
+        sh->dirty_blocks = NULL;
+
+        /* clients without the map do not record their writes, so unless
+           enabled the map is neither read nor kept */
+        if (!priv->data_self_heal_dirty_blocks) {
+                afr_sh_data_sync_start (frame, this);
+                return 0;
+        }
+
+        if (!afr_sh_data_dirty_blocks_usable (frame, this)) {
+                afr_sh_data_dirty_blocks_all (frame, this);
+                return 0;
+        }
+
+        STACK_WIND_COOKIE (frame, afr_sh_data_dirty_blocks_get_cbk,
+                           (void *) (long) sh->source,
+                           priv->children[sh->source],
+                           priv->children[sh->source]->fops->fgetxattr,
+                           sh->healing_fd, AFR_DIRTY_BLOCKS_KEY, NULL);
         return 0;
 }
 
@@ -669,6 +869,97 @@ afr_sh_data_fix (call_frame_t *frame, xlator_t *this)
         afr_sh_data_trim_sinks (frame, this);
 }
 
+int
+afr_sh_data_dirty_blocks_done_cbk (call_frame_t *frame, void *cookie,
+                                   xlator_t *this, int32_t op_ret,
+                                   int32_t op_errno, dict_t *xattr,
+                                   dict_t *xdata)
+{
+        afr_local_t     *local = NULL;
+        afr_private_t   *priv  = NULL;
+        int              call_count = 0;
+
+        local = frame->local;
+        priv  = this->private;
+
+        if (op_ret < 0)
+                gf_log (this->name, GF_LOG_WARNING, "updating dirty blocks of "
+                        "%s failed on %s (%s)", local->loc.path,
+                        priv->children[(long) cookie]->name,
+                        strerror (op_errno));
+
+        call_count = afr_frame_return (frame);
+        if (call_count == 0)
+                afr_sh_data_setattr (frame, this);
+
+        return 0;
+}
+
+int
+afr_sh_data_dirty_blocks_clear_cbk (call_frame_t *frame, void *cookie,
+                                    xlator_t *this, int32_t op_ret,
+                                    int32_t op_errno, dict_t *xdata)
+{
+        /* a child without a map has nothing to clear */
+        if ((op_ret < 0) && (op_errno == ENODATA))
+                op_ret = 0;
+
+        return afr_sh_data_dirty_blocks_done_cbk (frame, cookie, this,
+                                                  op_ret, op_errno, NULL,
+                                                  xdata);
+}
+
+/* After the sync, under the lock of the whole file. If nothing is pending
+ * any more the copies are the same and the maps go. Otherwise some child
+ * is still behind, and any of the others may be picked as the source for
+ * it: they all get the map of this sync, or all blocks if it had none. */
+int
+afr_sh_data_dirty_blocks_done (call_frame_t *frame, xlator_t *this,
+                               int nsources)
+{
+        afr_local_t     *local = NULL;
+        afr_self_heal_t *sh    = NULL;
+        afr_private_t   *priv  = NULL;
+        int              call_count = 0;
+        int              child = 0;
+        int              i     = 0;
+
+        local = frame->local;
+        sh    = &local->self_heal;
+        priv  = this->private;
+
+        call_count = sh->success_count;
+        if (!call_count || !priv->data_self_heal_dirty_blocks) {
+                afr_sh_data_setattr (frame, this);
+                return 0;
+        }
+
+        if (nsources) {
+                if (afr_sh_data_dirty_blocks_or (frame, this, sh->dirty_blocks,
+                                                 sh->success_children,
+                                                 call_count,
+                                                 afr_sh_data_dirty_blocks_done_cbk))
+                        afr_sh_data_setattr (frame, this);
+                return 0;
+        }
+
+        local->call_count = call_count;
+        for (i = 0; i < priv->child_count; i++) {
+                child = sh->success_children[i];
+                if (child == -1)
+                        break;
+                STACK_WIND_COOKIE (frame, afr_sh_data_dirty_blocks_clear_cbk,
+                                   (void *) (long) child,
+                                   priv->children[child],
+                                   priv->children[child]->fops->fremovexattr,
+                                   sh->healing_fd, AFR_DIRTY_BLOCKS_KEY, NULL);
+                if (!--call_count)
+                        break;
+        }
+
+        return 0;
+}
+
 int
 afr_sh_data_fxattrop_fstat_done (call_frame_t *frame, xlator_t *this)
 {
@@ -726,7 +1017,7 @@ afr_sh_data_fxattrop_fstat_done (call_frame_t *frame, xlator_t *this)
         }
 
         if (sh->sync_done) {
-                afr_sh_data_setattr (frame, this);
+                afr_sh_data_dirty_blocks_done (frame, this, nsources);
         } else {
                 if (nsources == 0) {
                         gf_log (this->name, GF_LOG_DEBUG,
@@ -20,7 +20,8 @@
 #include "event-history.h"
 
 typedef enum {
-        STOP_CRAWL_ON_SINGLE_SUBVOL = 1
+        STOP_CRAWL_ON_SINGLE_SUBVOL = 1,
+        HEAL_IN_PARALLEL = 2
 } afr_crawl_flags_t;
 
 typedef enum {
@@ -45,6 +46,14 @@ typedef struct shd_pos_ {
         afr_child_pos_t pos;
 } shd_pos_t;
 
+/* an entry healed in a synctask of its own while the crawl goes on */
+typedef struct shd_heal_ {
+        afr_crawl_data_t *crawl_data;
+        gf_dirent_t      *entry;
+        loc_t            child;
+        loc_t            parent;
+} shd_heal_t;
+
 typedef int
 (*afr_crawl_done_cbk_t)  (int ret, call_frame_t *sync_frame, void *crawl_data);
 
@@ -378,6 +387,9 @@ _self_heal_entry (xlator_t *this, afr_crawl_data_t *crawl_data, gf_dirent_t *ent
 static int
 afr_crawl_done  (int ret, call_frame_t *sync_frame, void *data)
 {
+        afr_crawl_data_t *crawl_data = data;
+
+        LOCK_DESTROY (&crawl_data->lock);
         GF_FREE (data);
         STACK_DESTROY (sync_frame->root);
         return 0;
@@ -387,7 +399,8 @@ void
 _do_self_heal_on_subvol (xlator_t *this, int child, afr_crawl_type_t crawl)
 {
         afr_start_crawl (this, child, crawl, _self_heal_entry,
-                         NULL, _gf_true, STOP_CRAWL_ON_SINGLE_SUBVOL,
+                         NULL, _gf_true,
+                         STOP_CRAWL_ON_SINGLE_SUBVOL | HEAL_IN_PARALLEL,
                          afr_crawl_done);
 }
 
@@ -429,6 +442,51 @@ out:
         return proceed;
 }
 
+static void
+_add_heal_stats_to_dict (xlator_t *this, dict_t *output, int xl_id, int child)
+{
+        afr_private_t    *priv = NULL;
+        afr_shd_stats_t  stats = {0};
+        struct timeval   end = {0};
+        char             key[256] = {0};
+        double           elapsed = 0;
+        int              ret = 0;
+
+        priv = this->private;
+
+        LOCK (&priv->lock);
+        {
+                stats = priv->shd.stats[child];
+        }
+        UNLOCK (&priv->lock);
+
+        if (!stats.start.tv_sec)
+                goto out;
+
+        end = stats.end;
+        if (!end.tv_sec)
+                gettimeofday (&end, NULL);
+        elapsed = (end.tv_sec - stats.start.tv_sec) +
+                  (end.tv_usec - stats.start.tv_usec) / 1e6;
+
+        snprintf (key, sizeof (key), "%d-%d-heal-count", xl_id, child);
+        ret = dict_set_uint64 (output, key, stats.entries);
+        if (ret)
+                goto out;
+
+        snprintf (key, sizeof (key), "%d-%d-heal-time", xl_id, child);
+        ret = dict_set_double (output, key, elapsed);
+        if (ret)
+                goto out;
+
+        snprintf (key, sizeof (key), "%d-%d-heal-running", xl_id, child);
+        ret = dict_set_int32 (output, key, !stats.end.tv_sec);
+out:
+        if (ret)
+                gf_log (this->name, GF_LOG_WARNING, "Could not add heal "
+                        "statistics of %s", priv->children[child]->name);
+}
+
 int
 _do_crawl_op_on_local_subvols (xlator_t *this, afr_crawl_type_t crawl,
                                shd_crawl_op op, dict_t *output)
@@ -486,6 +544,8 @@ _do_crawl_op_on_local_subvols (xlator_t *this, afr_crawl_type_t crawl,
                                                          _add_summary_to_dict,
                                                          output, _gf_false, 0,
                                                          NULL);
+                                        _add_heal_stats_to_dict (this, output,
+                                                                 xl_id, i);
                                 }
                         }
                         if (output) {
@@ -889,6 +949,226 @@ out:
         return ret;
 }
 
+/* called with crawl_data->lock held, returns once fewer than @limit heals
+ * of the crawl are in flight */
+static void
+__crawl_heals_wait (afr_crawl_data_t *crawl_data, int limit)
+{
+        struct synctask *task = NULL;
+
+        task = synctask_get ();
+
+        while (crawl_data->heals >= limit) {
+                crawl_data->waiter = task;
+                UNLOCK (&crawl_data->lock);
+                {
+                        task->state = SYNCTASK_SUSPEND;
+                        synctask_yield (task);
+                }
+                LOCK (&crawl_data->lock);
+        }
+}
+
+static void
+_crawl_heals_wait (afr_crawl_data_t *crawl_data, int limit)
+{
+        LOCK (&crawl_data->lock);
+        {
+                __crawl_heals_wait (crawl_data, limit);
+        }
+        UNLOCK (&crawl_data->lock);
+}
+
+static void
+_crawl_heal_slot_get (afr_crawl_data_t *crawl_data, int limit)
+{
+        LOCK (&crawl_data->lock);
+        {
+                __crawl_heals_wait (crawl_data, limit);
+                crawl_data->heals++;
+        }
+        UNLOCK (&crawl_data->lock);
+}
+
+static void
+_crawl_heal_slot_put (afr_crawl_data_t *crawl_data)
+{
+        struct synctask *waiter = NULL;
+
+        LOCK (&crawl_data->lock);
+        {
+                crawl_data->heals--;
+                waiter = crawl_data->waiter;
+                crawl_data->waiter = NULL;
+        }
+        UNLOCK (&crawl_data->lock);
+
+        if (waiter)
+                synctask_wake (waiter);
+}
+
+/* heal statistics are kept for the crawls which heal */
+static afr_shd_stats_t *
+_crawl_stats_get (xlator_t *this, afr_crawl_data_t *crawl_data)
+{
+        afr_private_t   *priv = NULL;
+
+        if (!(crawl_data->crawl_flags & HEAL_IN_PARALLEL))
+                return NULL;
+
+        priv = this->private;
+        return &priv->shd.stats[crawl_data->child];
+}
+
+static void
+_crawl_stats_start (xlator_t *this, afr_crawl_data_t *crawl_data)
+{
+        afr_private_t   *priv = this->private;
+        afr_shd_stats_t *stats = NULL;
+
+        stats = _crawl_stats_get (this, crawl_data);
+        if (!stats)
+                return;
+
+        LOCK (&priv->lock);
+        {
+                stats->entries = 0;
+                gettimeofday (&stats->start, NULL);
+                timerclear (&stats->end);
+        }
+        UNLOCK (&priv->lock);
+}
+
+static void
+_crawl_stats_end (xlator_t *this, afr_crawl_data_t *crawl_data)
+{
+        afr_private_t   *priv = this->private;
+        afr_shd_stats_t *stats = NULL;
+
+        stats = _crawl_stats_get (this, crawl_data);
+        if (!stats)
+                return;
+
+        LOCK (&priv->lock);
+        {
+                gettimeofday (&stats->end, NULL);
+        }
+        UNLOCK (&priv->lock);
+}
+
+static void
+_crawl_stats_entry (xlator_t *this, afr_crawl_data_t *crawl_data)
+{
+        afr_private_t   *priv = this->private;
+        afr_shd_stats_t *stats = NULL;
+
+        stats = _crawl_stats_get (this, crawl_data);
+        if (!stats)
+                return;
+
+        LOCK (&priv->lock);
+        {
+                stats->entries++;
+        }
+        UNLOCK (&priv->lock);
+}
+
+static void
+_shd_heal_free (shd_heal_t *heal)
+{
+        loc_wipe (&heal->child);
+        loc_wipe (&heal->parent);
+        GF_FREE (heal->entry);
+        GF_FREE (heal);
+}
+
+static int
+_shd_heal_entry (void *data)
+{
+        shd_heal_t       *heal = data;
+        afr_crawl_data_t *crawl_data = heal->crawl_data;
+        xlator_t         *this = THIS;
+        struct iatt      iattr = {0};
+        int              ret = 0;
+
+        ret = crawl_data->process_entry (this, crawl_data, heal->entry,
+                                         &heal->child, &heal->parent, &iattr);
+        if (ret)
+                goto out;
+
+        ret = _link_inode_update_loc (this, &heal->child, &iattr);
+out:
+        return ret;
+}
+
+static int
+_shd_heal_done (int ret, call_frame_t *sync_frame, void *data)
+{
+        shd_heal_t       *heal = data;
+        afr_crawl_data_t *crawl_data = heal->crawl_data;
+
+        _crawl_stats_entry (THIS, crawl_data);
+        _shd_heal_free (heal);
+
+        /* the crawl may be gone once the slot is given back */
+        _crawl_heal_slot_put (crawl_data);
+        return 0;
+}
+
+/* Heals @entry in a synctask of its own, once fewer than shd-max-heals
+ * entries of the crawl are being healed. Readdir of the next batch goes
+ * on meanwhile. */
+static int
+_crawl_heal_in_parallel (xlator_t *this, loc_t *parentloc, gf_dirent_t *entry,
+                         afr_crawl_data_t *crawl_data)
+{
+        afr_private_t    *priv = NULL;
+        shd_heal_t       *heal = NULL;
+        struct synctask  *task = NULL;
+        int              ret = -1;
+
+        priv = this->private;
+        task = synctask_get ();
+
+        heal = GF_CALLOC (1, sizeof (*heal), gf_afr_mt_shd_heal_t);
+        if (!heal)
+                goto out;
+        heal->crawl_data = crawl_data;
+
+        heal->entry = gf_dirent_for_name (entry->d_name);
+        if (!heal->entry)
+                goto out;
+        heal->entry->d_ino = entry->d_ino;
+        heal->entry->d_off = entry->d_off;
+        heal->entry->d_type = entry->d_type;
+        heal->entry->d_stat = entry->d_stat;
+
+        ret = loc_copy (&heal->parent, parentloc);
+        if (ret)
+                goto out;
+
+        ret = afr_crawl_build_child_loc (this, &heal->child, parentloc,
+                                         entry, crawl_data);
+        if (ret)
+                goto out;
+
+        _crawl_heal_slot_get (crawl_data, priv->shd.max_heals);
+
+        ret = synctask_new (this->ctx->env, _shd_heal_entry, _shd_heal_done,
+                            task->frame, heal);
+        if (ret) {
+                gf_log (this->name, GF_LOG_ERROR, "Could not create the "
+                        "task to heal %s", heal->child.path);
+                _crawl_heal_slot_put (crawl_data);
+                goto out;
+        }
+        heal = NULL;
+out:
+        if (heal)
+                _shd_heal_free (heal);
+        return ret;
+}
+
 static int
 _process_entries (xlator_t *this, loc_t *parentloc, gf_dirent_t *entries,
                   off_t *offset, afr_crawl_data_t *crawl_data)
@@ -918,6 +1198,18 @@ _process_entries (xlator_t *this, loc_t *parentloc, gf_dirent_t *entries,
                         continue;
                 }
 
+                /* directories of a full crawl are crawled right after
+                   their heal, which is done in line */
+                if ((crawl_data->crawl_flags & HEAL_IN_PARALLEL) &&
+                    ((crawl_data->crawl == INDEX) ||
+                     !IA_ISDIR (entry->d_stat.ia_type))) {
+                        ret = _crawl_heal_in_parallel (this, parentloc, entry,
+                                                       crawl_data);
+                        if (ret)
+                                goto out;
+                        continue;
+                }
+
                 loc_wipe (&entry_loc);
                 ret = afr_crawl_build_child_loc (this, &entry_loc, parentloc,
                                                  entry, crawl_data);
@@ -926,6 +1218,7 @@ _process_entries (xlator_t *this, loc_t *parentloc, gf_dirent_t *entries,
 
                 ret = crawl_data->process_entry (this, crawl_data, entry,
                                                  &entry_loc, parentloc, &iattr);
+                _crawl_stats_entry (this, crawl_data);
 
                 if (ret)
                         continue;
@@ -1103,7 +1396,10 @@ afr_dir_crawl (void *data)
         if (ret)
                 goto out;
 
+        _crawl_stats_start (this, crawl_data);
         ret = _crawl_directory (fd, &dirloc, crawl_data);
+        _crawl_heals_wait (crawl_data, 1);
+        _crawl_stats_end (this, crawl_data);
         if (ret)
                 gf_log (this->name, GF_LOG_ERROR, "Crawl failed on %s",
                         readdir_xl->name);
@@ -1203,6 +1499,7 @@ afr_start_crawl (xlator_t *this, int idx, afr_crawl_type_t crawl,
         crawl_data->crawl = crawl;
         crawl_data->op_data = op_data;
         crawl_data->crawl_flags = crawl_flags;
+        LOCK_INIT (&crawl_data->lock);
         gf_log (this->name, GF_LOG_DEBUG, "starting crawl %d for %s",
                 crawl_data->crawl, priv->children[idx]->name);
 
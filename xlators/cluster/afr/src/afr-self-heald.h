@@ -24,6 +24,9 @@ typedef struct afr_crawl_data_ {
         xlator_t            *readdir_xl;
         void                *op_data;
         int                 crawl_flags;
+        gf_lock_t           lock;
+        int                 heals;      /* entries being healed in parallel */
+        struct synctask     *waiter;    /* crawl waiting on them */
         int (*process_entry) (xlator_t *this, struct afr_crawl_data_ *crawl_data,
                               gf_dirent_t *entry, loc_t *child, loc_t *parent,
                               struct iatt *iattr);
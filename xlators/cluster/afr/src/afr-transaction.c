@@ -120,57 +120,138 @@ __mark_child_dead (int32_t *pending[], int child_count, int child,
 }
 
 
-static void
-__mark_pre_op_done_on_fd (call_frame_t *frame, xlator_t *this, int child_index)
+/*
+ * Changelog piggybacking
+ *
+ * The pre-op of a transaction raises the pending counts on a child and
+ * its post-op lowers them again. While a pre-op done on a child is not
+ * undone, the inode is marked dirty there already: transactions on the
+ * same inode which come in meanwhile, through whichever fd, skip their
+ * own pre-op on that child, and all but the last one to finish skip the
+ * post-op as well, unless the fop failed somewhere and that needs to be
+ * recorded.
+ *
+ * The counts are kept in the inode ctx. Renames change two directories
+ * and are left out.
+ */
+static inode_t *
+afr_changelog_shared_inode (afr_local_t *local)
 {
-        afr_local_t   *local = NULL;
-        afr_fd_ctx_t  *fd_ctx = NULL;
+        switch (local->transaction.type) {
+        case AFR_DATA_TRANSACTION:
+                break;
 
-        local = frame->local;
+        case AFR_METADATA_TRANSACTION:
+        case AFR_ENTRY_TRANSACTION:
+                /* no pre-op, nothing to share */
+                if (local->optimistic_change_log)
+                        return NULL;
+                break;
 
-        if (!local->fd)
-                return;
+        case AFR_ENTRY_RENAME_TRANSACTION:
+                return NULL;
+        }
 
-        fd_ctx = afr_fd_ctx_get (local->fd, this);
+        if (local->fd)
+                return local->fd->inode;
 
-        if (!fd_ctx)
-                goto out;
+        if (local->transaction.type == AFR_ENTRY_TRANSACTION)
+                return local->transaction.parent_loc.inode;
+
+        return local->loc.inode;
+}
+
+
+/* Returns 1 if the pre-op on @child can be skipped: another transaction
+ * has done it, or the changelog is optimistic */
+static int
+afr_changelog_pre_op_piggyback (xlator_t *this, afr_local_t *local, int child)
+{
+        afr_inode_ctx_t *ctx       = NULL;
+        inode_t         *inode     = NULL;
+        int              idx       = 0;
+        int              piggyback = 0;
 
-        LOCK (&local->fd->lock);
+        inode = afr_changelog_shared_inode (local);
+        if (!inode)
+                return ((local->transaction.type != AFR_DATA_TRANSACTION) &&
+                        local->optimistic_change_log);
+
+        idx = afr_index_for_transaction_type (local->transaction.type);
+
+        LOCK (&inode->lock);
         {
-                if (local->transaction.type == AFR_DATA_TRANSACTION)
-                        fd_ctx->pre_op_done[child_index]++;
+                ctx = __afr_inode_ctx_get (this, inode);
+                if (ctx && ctx->pre_op_done[child][idx]) {
+                        ctx->pre_op_piggyback[child][idx]++;
+                        piggyback = 1;
+                }
         }
-        UNLOCK (&local->fd->lock);
-out:
-        return;
+        UNLOCK (&inode->lock);
+
+        return piggyback;
 }
 
 
 static void
-__mark_pre_op_undone_on_fd (call_frame_t *frame, xlator_t *this, int child_index)
+afr_changelog_pre_op_done (xlator_t *this, afr_local_t *local, int child)
 {
-        afr_local_t   *local = NULL;
-        afr_fd_ctx_t  *fd_ctx = NULL;
-
-        local = frame->local;
+        afr_inode_ctx_t *ctx   = NULL;
+        inode_t         *inode = NULL;
+        int              idx   = 0;
 
-        if (!local->fd)
+        inode = afr_changelog_shared_inode (local);
+        if (!inode)
                 return;
 
-        fd_ctx = afr_fd_ctx_get (local->fd, this);
+        idx = afr_index_for_transaction_type (local->transaction.type);
+
+        LOCK (&inode->lock);
+        {
+                ctx = __afr_inode_ctx_get (this, inode);
+                if (ctx)
+                        ctx->pre_op_done[child][idx]++;
+        }
+        UNLOCK (&inode->lock);
+}
 
-        if (!fd_ctx)
-                goto out;
 
-        LOCK (&local->fd->lock);
+/* Returns 1 if the post-op on @child is only to record failures: another
+ * transaction still relies on the pre-op done there and undoes it later,
+ * or the changelog is optimistic. Otherwise the pre-op is undone by the
+ * caller. */
+static int
+afr_changelog_post_op_piggyback (xlator_t *this, afr_local_t *local, int child)
+{
+        afr_inode_ctx_t *ctx       = NULL;
+        inode_t         *inode     = NULL;
+        int              idx       = 0;
+        int              piggyback = 0;
+
+        inode = afr_changelog_shared_inode (local);
+        if (!inode)
+                return ((local->transaction.type != AFR_DATA_TRANSACTION) &&
+                        local->optimistic_change_log);
+
+        idx = afr_index_for_transaction_type (local->transaction.type);
+
+        LOCK (&inode->lock);
         {
-                if (local->transaction.type == AFR_DATA_TRANSACTION)
-                        fd_ctx->pre_op_done[child_index]--;
+                ctx = __afr_inode_ctx_get (this, inode);
+                if (!ctx)
+                        goto unlock;
+
+                if (ctx->pre_op_piggyback[child][idx]) {
+                        ctx->pre_op_piggyback[child][idx]--;
+                        piggyback = 1;
+                } else if (ctx->pre_op_done[child][idx]) {
+                        ctx->pre_op_done[child][idx]--;
+                }
         }
-        UNLOCK (&local->fd->lock);
-out:
-        return;
+unlock:
+        UNLOCK (&inode->lock);
+
+        return piggyback;
 }
 
 
@@ -522,8 +603,40 @@ afr_set_postop_dict (afr_local_t *local, xlator_t *this, dict_t *xattr,
                         "failed to set pending entry");
 }
 
-int
-afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
+/* A child whose dirty blocks could not be updated keeps one count of its
+ * own pending, so that self-heal does not trust its map */
+static void
+afr_changelog_keep_dirty (xlator_t *this, afr_local_t *local, dict_t *xattr,
+                          int optimized, int child)
+{
+        afr_private_t *priv      = NULL;
+        int32_t      **changelog = NULL;
+        int32_t       *own       = NULL;
+        int            index     = 0;
+
+        priv  = this->private;
+        index = afr_index_for_transaction_type (local->transaction.type);
+
+        if (optimized)
+                changelog = local->transaction.txn_changelog;
+        else
+                changelog = local->pending;
+
+        own = GF_CALLOC (AFR_NUM_CHANGE_LOGS, sizeof (*own),
+                         gf_afr_mt_int32_t);
+        if (!own)
+                return;
+
+        memcpy (own, changelog[child], AFR_NUM_CHANGE_LOGS * sizeof (*own));
+        own[index] = hton32 (ntoh32 (own[index]) + 1);
+
+        if (dict_set_dynptr (xattr, priv->pending_key[child], own,
+                             AFR_NUM_CHANGE_LOGS * sizeof (*own)))
+                GF_FREE (own);
+}
+
+static int
+afr_changelog_post_op_do (call_frame_t *frame, xlator_t *this)
 {
         afr_private_t * priv = this->private;
         afr_internal_lock_t *int_lock = NULL;
@@ -531,7 +644,6 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
         int call_count = 0;
 
         afr_local_t *  local = NULL;
-        afr_fd_ctx_t  *fdctx = NULL;
         dict_t        **xattr = NULL;
         int            piggyback = 0;
         int            index = 0;
@@ -560,9 +672,6 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
                                                        priv->child_count);
         local->call_count = call_count;
 
-        if (local->fd)
-                fdctx = afr_fd_ctx_get (local->fd, this);
-
         if (call_count == 0) {
                 /* no child is up */
                 int_lock->lock_cbk = local->transaction.done;
@@ -586,42 +695,26 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
                 if (!local->transaction.pre_op[i])
                         continue;
 
-                if (local->transaction.type != AFR_DATA_TRANSACTION)
-                        afr_set_postop_dict (local, this, xattr[i],
-                                             local->optimistic_change_log, i);
+                piggyback = afr_changelog_post_op_piggyback (this, local, i);
+
+                afr_set_postop_dict (local, this, xattr[i], piggyback, i);
+
+                if (local->transaction.dirty_blocks_failed[i])
+                        afr_changelog_keep_dirty (this, local, xattr[i],
+                                                  piggyback, i);
+
                 switch (local->transaction.type) {
                 case AFR_DATA_TRANSACTION:
+                case AFR_METADATA_TRANSACTION:
                 {
-                        if (!fdctx) {
-                                afr_set_postop_dict (local, this, xattr[i],
-                                                     0, i);
-                                STACK_WIND (frame, afr_changelog_post_op_cbk,
-                                            priv->children[i],
-                                            priv->children[i]->fops->xattrop,
-                                            &local->loc,
-                                            GF_XATTROP_ADD_ARRAY, xattr[i],
-                                            NULL);
+                        if (nothing_failed && piggyback) {
+                                afr_changelog_post_op_cbk (frame, (void *)(long)i,
+                                                           this, 1, 0, xattr[i],
+                                                           NULL);
                                 break;
                         }
 
-                        LOCK (&local->fd->lock);
-                        {
-                                piggyback = 0;
-                                if (fdctx->pre_op_piggyback[i]) {
-                                        fdctx->pre_op_piggyback[i]--;
-                                        piggyback = 1;
-                                }
-                        }
-                        UNLOCK (&local->fd->lock);
-
-                        afr_set_postop_dict (local, this, xattr[i],
-                                             piggyback, i);
-
-                        if (nothing_failed && piggyback) {
-                                afr_changelog_post_op_cbk (frame, (void *)(long)i,
-                                                           this, 1, 0, xattr[i], NULL);
-                        } else {
-                                __mark_pre_op_undone_on_fd (frame, this, i);
+                        if (local->fd)
                                 STACK_WIND_COOKIE (frame,
                                                    afr_changelog_post_op_cbk,
                                                    (void *) (long) i,
@@ -630,38 +723,21 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
                                                    local->fd,
                                                    GF_XATTROP_ADD_ARRAY, xattr[i],
                                                    NULL);
-                        }
-                }
-                break;
-                case AFR_METADATA_TRANSACTION:
-                {
-                        if (nothing_failed && local->optimistic_change_log) {
-                                afr_changelog_post_op_cbk (frame, (void *)(long)i,
-                                                           this, 1, 0, xattr[i],
-                                                           NULL);
-                                break;
-                        }
-
-                        if (local->fd)
-                                STACK_WIND (frame, afr_changelog_post_op_cbk,
-                                            priv->children[i],
-                                            priv->children[i]->fops->fxattrop,
-                                            local->fd,
-                                            GF_XATTROP_ADD_ARRAY, xattr[i],
-                                            NULL);
                         else
-                                STACK_WIND (frame, afr_changelog_post_op_cbk,
-                                            priv->children[i],
-                                            priv->children[i]->fops->xattrop,
-                                            &local->loc,
-                                            GF_XATTROP_ADD_ARRAY, xattr[i],
-                                            NULL);
+                                STACK_WIND_COOKIE (frame,
+                                                   afr_changelog_post_op_cbk,
+                                                   (void *) (long) i,
+                                                   priv->children[i],
+                                                   priv->children[i]->fops->xattrop,
+                                                   &local->loc,
+                                                   GF_XATTROP_ADD_ARRAY, xattr[i],
+                                                   NULL);
                 }
                 break;
 
                 case AFR_ENTRY_RENAME_TRANSACTION:
                 {
-                        if (nothing_failed && local->optimistic_change_log) {
+                        if (nothing_failed && piggyback) {
                                 afr_changelog_post_op_cbk (frame, (void *)(long)i,
                                                            this, 1, 0, xattr[i],
                                                            NULL);
@@ -685,14 +761,13 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
                   value
                 */
 
-                afr_set_postop_dict (local, this, xattr[i],
-                                     local->optimistic_change_log, i);
+                afr_set_postop_dict (local, this, xattr[i], piggyback, i);
 
                 /* fall through */
 
                 case AFR_ENTRY_TRANSACTION:
                 {
-                        if (nothing_failed && local->optimistic_change_log) {
+                        if (nothing_failed && piggyback) {
                                 afr_changelog_post_op_cbk (frame, (void *)(long)i,
                                                            this, 1, 0, xattr[i],
                                                            NULL);
@@ -730,6 +805,176 @@ out:
 }
 
 
+static gf_boolean_t
+afr_changelog_dirty_blocks_needed (afr_local_t *local, afr_private_t *priv)
+{
+        int index = 0;
+        int i     = 0;
+
+        if (!priv->data_self_heal_dirty_blocks)
+                return _gf_false;
+
+        if (local->transaction.type != AFR_DATA_TRANSACTION)
+                return _gf_false;
+
+        /* flush and empty writes change no data; their zero length is not
+           the "up to the end" of truncates and appending writes */
+        if (local->op == GF_FOP_FLUSH)
+                return _gf_false;
+
+        if ((local->op == GF_FOP_WRITE) &&
+            !iov_length (local->cont.writev.vector, local->cont.writev.count))
+                return _gf_false;
+
+        index = afr_index_for_transaction_type (local->transaction.type);
+        for (i = 0; i < priv->child_count; i++) {
+                if (!local->transaction.pre_op[i] ||
+                    !local->pending[i][index])
+                        return _gf_true;
+        }
+
+        return _gf_false;
+}
+
+
+static int32_t
+afr_changelog_dirty_blocks_cbk (call_frame_t *frame, void *cookie,
+                                xlator_t *this, int32_t op_ret,
+                                int32_t op_errno, dict_t *xattr,
+                                dict_t *xdata)
+{
+        afr_private_t *priv        = NULL;
+        afr_local_t   *local       = NULL;
+        int            child_index = (long) cookie;
+        int            call_count  = 0;
+
+        priv  = this->private;
+        local = frame->local;
+
+        if (op_ret < 0) {
+                gf_log (this->name, GF_LOG_WARNING, "marking dirty blocks "
+                        "of %s failed on %s (%s)", local->loc.path,
+                        priv->children[child_index]->name,
+                        strerror (op_errno));
+                local->transaction.dirty_blocks_failed[child_index] = 1;
+        }
+
+        call_count = afr_frame_return (frame);
+        if (call_count == 0)
+                afr_changelog_post_op_do (frame, this);
+
+        return 0;
+}
+
+
+/* Record the range of a data transaction which missed some child in the
+ * dirty blocks of the children it reached, before their changelog says
+ * they have it, so that diff self-heal can look at just those blocks. */
+static int
+afr_changelog_dirty_blocks (call_frame_t *frame, xlator_t *this)
+{
+        afr_private_t *priv       = NULL;
+        afr_local_t   *local      = NULL;
+        dict_t        *xattr      = NULL;
+        unsigned char *map        = NULL;
+        int            index      = 0;
+        int            call_count = 0;
+        int            wound      = 0;
+        int            i          = 0;
+        int            ret        = -1;
+
+        priv  = this->private;
+        local = frame->local;
+
+        index = afr_index_for_transaction_type (local->transaction.type);
+        for (i = 0; i < priv->child_count; i++) {
+                if (local->transaction.pre_op[i] && local->pending[i][index])
+                        call_count++;
+        }
+
+        if (call_count == 0) {
+                ret = 0;
+                goto out;
+        }
+
+        xattr = dict_new ();
+        map = GF_CALLOC (1, AFR_DIRTY_BLOCKS_SIZE, gf_afr_mt_char);
+        if (!xattr || !map)
+                goto out;
+
+        afr_dirty_blocks_mark (map, local->transaction.start,
+                               local->transaction.len);
+
+        ret = dict_set_dynptr (xattr, AFR_DIRTY_BLOCKS_KEY, map,
+                               AFR_DIRTY_BLOCKS_SIZE);
+        if (ret)
+                goto out;
+        map = NULL;
+
+        local->call_count = call_count;
+        wound = 1;
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (!local->transaction.pre_op[i] ||
+                    !local->pending[i][index])
+                        continue;
+
+                if (local->fd)
+                        STACK_WIND_COOKIE (frame,
+                                           afr_changelog_dirty_blocks_cbk,
+                                           (void *) (long) i,
+                                           priv->children[i],
+                                           priv->children[i]->fops->fxattrop,
+                                           local->fd, GF_XATTROP_OR_ARRAY,
+                                           xattr, NULL);
+                else
+                        STACK_WIND_COOKIE (frame,
+                                           afr_changelog_dirty_blocks_cbk,
+                                           (void *) (long) i,
+                                           priv->children[i],
+                                           priv->children[i]->fops->xattrop,
+                                           &local->loc, GF_XATTROP_OR_ARRAY,
+                                           xattr, NULL);
+
+                if (!--call_count)
+                        break;
+        }
+
+out:
+        if (xattr)
+                dict_unref (xattr);
+        GF_FREE (map);
+
+        if (ret) {
+                for (i = 0; i < priv->child_count; i++)
+                        local->transaction.dirty_blocks_failed[i] = 1;
+        }
+
+        if (!wound)
+                afr_changelog_post_op_do (frame, this);
+
+        return 0;
+}
+
+
+int
+afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
+{
+        afr_private_t *priv  = NULL;
+        afr_local_t   *local = NULL;
+
+        priv  = this->private;
+        local = frame->local;
+
+        if (afr_changelog_dirty_blocks_needed (local, priv))
+                afr_changelog_dirty_blocks (frame, this);
+        else
+                afr_changelog_post_op_do (frame, this);
+
+        return 0;
+}
+
+
 int32_t
 afr_changelog_pre_op_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                           int32_t op_ret, int32_t op_errno, dict_t *xattr,
@@ -746,7 +991,7 @@ afr_changelog_pre_op_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         {
                 switch (op_ret) {
                 case 0:
-                        __mark_pre_op_done_on_fd (frame, this, child_index);
+                        afr_changelog_pre_op_done (this, local, child_index);
                         //fallthrough we need to mark the pre_op
                 case 1:
                         local->transaction.pre_op[child_index] = 1;
@@ -804,7 +1049,6 @@ afr_changelog_pre_op (call_frame_t *frame, xlator_t *this)
         int ret = 0;
         int call_count = 0;
         dict_t **xattr = NULL;
-        afr_fd_ctx_t *fdctx = NULL;
         afr_local_t *local = NULL;
         int          piggyback = 0;
         afr_internal_lock_t *int_lock = NULL;
@@ -835,9 +1079,6 @@ afr_changelog_pre_op (call_frame_t *frame, xlator_t *this)
         __mark_all_pending (local->pending, priv->child_count,
                             local->transaction.type);
 
-        if (local->fd)
-                fdctx = afr_fd_ctx_get (local->fd, this);
-
         locked_nodes = afr_locked_nodes_get (local->transaction.type, int_lock);
         for (i = 0; i < priv->child_count; i++) {
                 if (!locked_nodes[i])
@@ -850,54 +1091,16 @@ afr_changelog_pre_op (call_frame_t *frame, xlator_t *this)
                                 "failed to set pending entry");
 
 
+                piggyback = afr_changelog_pre_op_piggyback (this, local, i);
+
                 switch (local->transaction.type) {
                 case AFR_DATA_TRANSACTION:
-                {
-                        if (!fdctx) {
-                                STACK_WIND_COOKIE (frame,
-                                                   afr_changelog_pre_op_cbk,
-                                                   (void *) (long) i,
-                                                   priv->children[i],
-                                                   priv->children[i]->fops->xattrop,
-                                                   &(local->loc),
-                                                   GF_XATTROP_ADD_ARRAY, xattr[i],
-                                                   NULL);
-                                break;
-                        }
-
-                        LOCK (&local->fd->lock);
-                        {
-                                piggyback = 0;
-                                if (fdctx->pre_op_done[i]) {
-                                        fdctx->pre_op_piggyback[i]++;
-                                        piggyback = 1;
-                                        fdctx->hit++;
-                                } else {
-                                        fdctx->miss++;
-                                }
-                        }
-                        UNLOCK (&local->fd->lock);
-
 			afr_set_delayed_post_op (frame, this);
 
-                        if (piggyback)
-                                afr_changelog_pre_op_cbk (frame, (void *)(long)i,
-                                                          this, 1, 0, xattr[i],
-                                                          NULL);
-                        else
-                                STACK_WIND_COOKIE (frame,
-                                                   afr_changelog_pre_op_cbk,
-                                                   (void *) (long) i,
-                                                   priv->children[i],
-                                                   priv->children[i]->fops->fxattrop,
-                                                   local->fd,
-                                                   GF_XATTROP_ADD_ARRAY, xattr[i],
-                                                   NULL);
-                }
-                break;
+                        /* fall through */
                 case AFR_METADATA_TRANSACTION:
                 {
-                        if (local->optimistic_change_log) {
+                        if (piggyback) {
                                 afr_changelog_pre_op_cbk (frame, (void *)(long)i,
                                                           this, 1, 0, xattr[i],
                                                           NULL);
@@ -927,7 +1130,7 @@ afr_changelog_pre_op (call_frame_t *frame, xlator_t *this)
 
                 case AFR_ENTRY_RENAME_TRANSACTION:
                 {
-                        if (local->optimistic_change_log) {
+                        if (piggyback) {
                                 afr_changelog_pre_op_cbk (frame, (void *)(long)i,
                                                           this, 1, 0, xattr[i],
                                                           NULL);
@@ -965,7 +1168,7 @@ afr_changelog_pre_op (call_frame_t *frame, xlator_t *this)
 
                 case AFR_ENTRY_TRANSACTION:
                 {
-                        if (local->optimistic_change_log) {
+                        if (piggyback) {
                                 afr_changelog_pre_op_cbk (frame, (void *)(long)i,
                                                           this, 1, 0, xattr[i],
                                                           NULL);
@@ -146,6 +146,13 @@ reconfigure (xlator_t *this, dict_t *options)
         GF_OPTION_RECONF ("data-self-heal-algorithm",
                           priv->data_self_heal_algorithm, options, str, out);
 
+        GF_OPTION_RECONF ("data-self-heal-checksum",
+                          priv->data_self_heal_checksum, options, str, out);
+
+        GF_OPTION_RECONF ("data-self-heal-dirty-blocks",
+                          priv->data_self_heal_dirty_blocks, options, bool,
+                          out);
+
         GF_OPTION_RECONF ("self-heal-daemon", priv->shd.enabled, options, bool, out);
 
         GF_OPTION_RECONF ("read-subvolume", read_subvol, options, xlator, out);
@@ -183,6 +190,9 @@ reconfigure (xlator_t *this, dict_t *options)
         GF_OPTION_RECONF ("heal-timeout", priv->shd.timeout, options,
                           int32, out);
 
+        GF_OPTION_RECONF ("shd-max-heals", priv->shd.max_heals, options,
+                          int32, out);
+
 	GF_OPTION_RECONF ("post-op-delay-secs", priv->post_op_delay_secs, options,
 			  uint32, out);
 
@@ -296,6 +306,12 @@ init (xlator_t *this)
         GF_OPTION_INIT ("data-self-heal-algorithm",
                         priv->data_self_heal_algorithm, str, out);
 
+        GF_OPTION_INIT ("data-self-heal-checksum",
+                        priv->data_self_heal_checksum, str, out);
+
+        GF_OPTION_INIT ("data-self-heal-dirty-blocks",
+                        priv->data_self_heal_dirty_blocks, bool, out);
+
         GF_OPTION_INIT ("data-self-heal-window-size",
                         priv->data_self_heal_window_size, uint32, out);
 
@@ -390,6 +406,13 @@ init (xlator_t *this)
                 goto out;
         }
 
+        priv->read_stats = GF_CALLOC (child_count, sizeof (*priv->read_stats),
+                                      gf_afr_mt_read_stats_t);
+        if (!priv->read_stats) {
+                ret = -ENOMEM;
+                goto out;
+        }
+
         /* keep more local here as we may need them for self-heal etc */
         this->local_pool = mem_pool_new (afr_local_t, 512);
         if (!this->local_pool) {
@@ -427,6 +450,11 @@ init (xlator_t *this)
         if (!priv->shd.timer)
                 goto out;
 
+        priv->shd.stats = GF_CALLOC (sizeof (*priv->shd.stats), child_count,
+                                     gf_afr_mt_shd_stats_t);
+        if (!priv->shd.stats)
+                goto out;
+
         priv->shd.healed = eh_new (AFR_EH_HEALED_LIMIT, _gf_false);
         if (!priv->shd.healed)
                 goto out;
@@ -445,6 +473,7 @@ init (xlator_t *this)
         priv->root_inode = inode_ref (this->itable->root);
         GF_OPTION_INIT ("node-uuid", priv->shd.node_uuid, str, out);
         GF_OPTION_INIT ("heal-timeout", priv->shd.timeout, int32, out);
+        GF_OPTION_INIT ("shd-max-heals", priv->shd.max_heals, int32, out);
 
         ret = 0;
 out:
@@ -541,11 +570,13 @@ struct volume_options options[] = {
         { .key = {"read-hash-mode" },
           .type = GF_OPTION_TYPE_INT,
           .min = 0,
-          .max = 2,
+          .max = 3,
           .default_value = "0",
           .description = "0 = first responder, "
                          "1 = hash by GFID (all clients use same subvolume), "
-                         "2 = hash by GFID and client PID",
+                         "2 = hash by GFID and client PID, "
+                         "3 = least loaded subvolume, by the latency and "
+                         "number of the reads in flight on it",
         },
         { .key  = {"choose-local" },
           .type = GF_OPTION_TYPE_BOOL,
@@ -581,6 +612,26 @@ struct volume_options options[] = {
                            "with those of source.",
           .value = { "diff", "full", "" }
         },
+        { .key  = {"data-self-heal-checksum"},
+          .type = GF_OPTION_TYPE_STR,
+          .default_value = "xxh64",
+          .description   = "Strong checksum the \"diff\" algorithm asks "
+                           "the bricks to compare blocks with. Bricks that "
+                           "do not support it answer with \"md5\", and the "
+                           "rest of that heal then uses \"md5\" too.",
+          .value = { "xxh64", "md5" }
+        },
+        { .key  = {"data-self-heal-dirty-blocks"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description   = "Have the \"diff\" algorithm look only at the "
+                           "blocks the writes which missed a sink recorded "
+                           "on the source. Writes are only recorded while "
+                           "this is on, and clients older than this option "
+                           "never record them: only turn it on once no such "
+                           "client writes to the volume and no file needs "
+                           "self-heal."
+        },
         { .key  = {"data-self-heal-window-size"},
           .type = GF_OPTION_TYPE_INT,
           .min  = 1,
@@ -667,6 +718,14 @@ struct volume_options options[] = {
           .default_value = "600",
           .description = "Poll timeout for checking the need to self-heal"
         },
+        { .key  = {"shd-max-heals"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = 64,
+          .default_value = "4",
+          .description = "Maximum number of entries the self-heal daemon "
+                         "heals in parallel on each local brick"
+        },
         { .key  = {"post-op-delay-secs"},
           .type = GF_OPTION_TYPE_INT,
           .min  = 0,
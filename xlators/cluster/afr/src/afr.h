@@ -29,6 +29,19 @@
 #define AFR_PATHINFO_HEADER "REPLICATE:"
 #define AFR_SH_READDIR_SIZE_KEY "self-heal-readdir-size"
 
+#define AFR_READ_HASH_LEAST_LOADED 3    /* read-hash-mode */
+#define AFR_READ_PROBE_INTERVAL    64
+
+#define AFR_NUM_CHANGE_LOGS            3 /*data + metadata + entry*/
+
+/* regions of a file written while a copy missed the write: one bit per
+   chunk, folded modulo the size of the map, ORed in by the post-op of
+   data transactions that failed somewhere and read by diff self-heal */
+#define AFR_DIRTY_BLOCKS_KEY           AFR_XATTR_PREFIX".dirty-blocks"
+#define AFR_DIRTY_BLOCKS_SIZE          1024    /* bytes */
+#define AFR_DIRTY_BLOCKS_CHUNK         1048576
+#define AFR_DIRTY_BLOCKS_WINDOW        64      /* blocks healed in parallel */
+
 struct _pump_private;
 
 typedef int (*afr_expunge_done_cbk_t) (call_frame_t *frame, xlator_t *this,
@@ -78,6 +91,13 @@ typedef struct afr_inode_params_ {
 typedef struct afr_inode_ctx_ {
         uint64_t masks;
         int32_t  *fresh_children;//increasing order of latency
+
+        /* changelog pre-ops shared by the transactions on this inode, per
+         * child and per changelog type, under inode->lock: the pre-ops
+         * done on the brick and not yet undone by a post-op, and the
+         * transactions which piggybacked on them */
+        unsigned int (*pre_op_done)[AFR_NUM_CHANGE_LOGS];
+        unsigned int (*pre_op_piggyback)[AFR_NUM_CHANGE_LOGS];
 } afr_inode_ctx_t;
 
 typedef enum {
@@ -86,6 +106,20 @@ typedef enum {
         FULL,
 } afr_crawl_type_t;
 
+/* progress of the current or last heal crawl of a local child */
+typedef struct afr_shd_stats_ {
+        uint64_t         entries;       /* entries healed, or attempted */
+        struct timeval   start;
+        struct timeval   end;           /* zero while the crawl runs */
+} afr_shd_stats_t;
+
+/* load of a child as seen by the reads wound to it */
+typedef struct afr_read_stats_ {
+        uint32_t         outstanding;   /* reads wound, not yet unwound */
+        double           latency;       /* moving average, in usecs */
+        uint64_t         reads;
+} afr_read_stats_t;
+
 typedef struct afr_self_heald_ {
         gf_boolean_t     enabled;
         gf_boolean_t     iamshd;
@@ -98,6 +132,8 @@ typedef struct afr_self_heald_ {
         eh_t             *split_brain;
         char             *node_uuid;
         int              timeout;
+        int              max_heals;     /* in flight, per crawl */
+        afr_shd_stats_t  *stats;
 } afr_self_heald_t;
 
 typedef struct _afr_private {
@@ -118,6 +154,10 @@ typedef struct _afr_private {
 
         char         *data_self_heal;              /* on/off/open */
         char *       data_self_heal_algorithm;    /* name of algorithm */
+        char *       data_self_heal_checksum;     /* strong checksum "diff"
+                                                     asks the bricks for */
+        gf_boolean_t data_self_heal_dirty_blocks; /* "diff" trusts the
+                                                     dirty blocks map */
         unsigned int data_self_heal_window_size;  /* max number of pipelined
                                                      read/writes */
 
@@ -161,6 +201,8 @@ typedef struct _afr_private {
         gf_boolean_t           choose_local;
         gf_boolean_t           did_discovery;
         uint64_t               sh_readdir_size;
+        afr_read_stats_t       *read_stats;  /* per child, under
+                                                read_child_lock */
 } afr_private_t;
 
 typedef struct {
@@ -252,6 +294,8 @@ typedef struct {
         off_t offset;
         unsigned char *write_needed;
         uint8_t *checksum;
+        int     *checksum_type;         /* gf_rsync_strong_type_t per child */
+        unsigned char *dirty_blocks;    /* map of the source, if trusted */
         afr_post_remove_call_t post_remove_call;
 
         loc_t parent_loc;
@@ -640,6 +684,7 @@ typedef struct _afr_local {
 
                 int32_t         **txn_changelog;//changelog after pre+post ops
                 unsigned char   *pre_op;
+                unsigned char   *dirty_blocks_failed;
 
                 call_frame_t *main_frame;
 
@@ -665,6 +710,11 @@ typedef struct _afr_local {
         mode_t          umask;
         int             xflag;
         gf_boolean_t    do_discovery;
+
+        /* the read in flight, for read_stats */
+        gf_boolean_t    read_timed;
+        int             read_timed_child;
+        struct timeval  read_timed_start;
 } afr_local_t;
 
 typedef enum {
@@ -679,9 +729,7 @@ typedef struct {
 } afr_fd_paused_call_t;
 
 typedef struct {
-        unsigned int *pre_op_done;
         afr_fd_open_status_t *opened_on; /* which subvolumes the fd is open on */
-        unsigned int *pre_op_piggyback;
 
         unsigned int *lock_piggyback;
         unsigned int *lock_acquired;
@@ -692,7 +740,6 @@ typedef struct {
 
         int32_t last_tried;
 
-        int  hit, miss;
         gf_boolean_t failed_over;
         struct list_head entries; /* needed for readdir failover */
 
@@ -784,6 +831,9 @@ __afr_fd_ctx_set (xlator_t *this, fd_t *fd);
 int
 afr_fd_ctx_set (xlator_t *this, fd_t *fd);
 
+afr_inode_ctx_t *
+__afr_inode_ctx_get (xlator_t *this, inode_t *inode);
+
 int32_t
 afr_inode_get_read_ctx (xlator_t *this, inode_t *inode, int32_t *fresh_children);
 
@@ -874,7 +924,6 @@ afr_launch_openfd_self_heal (call_frame_t *frame, xlator_t *this, fd_t *fd);
                 }                                               \
         } while (0);
 
-#define AFR_NUM_CHANGE_LOGS            3 /*data + metadata + entry*/
 /* allocate and return a string that is the basename of argument */
 static inline char *
 AFR_BASENAME (const char *str)
@@ -923,10 +972,21 @@ afr_get_call_child (xlator_t *this, unsigned char *child_up, int32_t read_child,
                     int32_t *fresh_children,
                     int32_t *call_child, int32_t *last_index);
 
+int32_t
+afr_get_read_call_child (xlator_t *this, unsigned char *child_up,
+                         int32_t read_child, int32_t *fresh_children,
+                         int32_t *call_child, int32_t *last_index);
+
 int32_t
 afr_next_call_child (int32_t *fresh_children, unsigned char *child_up,
                      size_t child_count, int32_t *last_index,
                      int32_t read_child);
+
+void
+afr_read_wind (xlator_t *this, afr_local_t *local, int child);
+
+void
+afr_read_unwind (xlator_t *this, afr_local_t *local);
 void
 afr_get_fresh_children (int32_t *success_children, int32_t *sources,
                         int32_t *children, unsigned int child_count);
@@ -990,6 +1050,12 @@ afr_open_fd_fix (call_frame_t *frame, xlator_t *this, gf_boolean_t pause_fop);
 int
 afr_set_elem_count_get (unsigned char *elems, int child_count);
 
+void
+afr_dirty_blocks_mark (unsigned char *map, off_t start, off_t len);
+
+gf_boolean_t
+afr_dirty_blocks_test (unsigned char *map, off_t offset);
+
 afr_fd_ctx_t *
 afr_fd_ctx_get (fd_t *fd, xlator_t *this);
 
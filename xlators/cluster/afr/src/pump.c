@@ -2438,6 +2438,7 @@ init (xlator_t *this)
 	priv->entry_self_heal    = 1;
 
         priv->data_self_heal_algorithm = "";
+        priv->data_self_heal_checksum  = "xxh64";
 
         priv->data_self_heal_window_size = 16;
 
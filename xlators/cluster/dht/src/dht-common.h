@@ -35,6 +35,13 @@ typedef int (*dht_defrag_cbk_fn_t) (xlator_t        *this, call_frame_t *frame,
                                     int              ret);
 
 
+/* entry of the sorted index dht_layout_search() bisects */
+struct dht_layout_search_entry {
+        uint32_t   start;
+        uint32_t   stop;
+        int        idx;   /* into dht_layout_t->list */
+};
+
 struct dht_layout {
         int                spread_cnt;  /* layout spread count per directory,
                                            is controlled by 'setxattr()' with
@@ -45,6 +52,9 @@ struct dht_layout {
         int                type;
         int                ref; /* use with dht_conf_t->layout_lock */
         int                search_unhashed;
+        int                search_cnt; /* valid entries in ->search, 0 makes
+                                          dht_layout_search() scan ->list */
+        struct dht_layout_search_entry *search; /* after ->list[cnt] */
         struct {
                 int        err;   /* 0 = normal
                                      -1 = dir exists and no xattr
@@ -210,6 +220,28 @@ enum gf_defrag_status_t {
 typedef enum gf_defrag_status_t gf_defrag_status_t;
 
 
+/* files waiting to be migrated off one source subvolume, and the
+ * migration statistics of that subvolume */
+struct gf_defrag_queue {
+        struct list_head             entries;
+        int                          count;
+        int                          workers;
+        xlator_t                    *subvol;
+        uint64_t                     files;
+        uint64_t                     size;
+        uint64_t                     failures;
+        struct timeval               first_start;
+        struct timeval               last_end;
+};
+typedef struct gf_defrag_queue gf_defrag_queue_t;
+
+struct gf_defrag_entry {
+        struct list_head             list;
+        loc_t                        loc;
+        struct iatt                  iatt;
+};
+typedef struct gf_defrag_entry gf_defrag_entry_t;
+
 struct gf_defrag_info_ {
         uint64_t                     total_files;
         uint64_t                     total_data;
@@ -228,6 +260,18 @@ struct gf_defrag_info_ {
         struct timeval               start_time;
         gf_boolean_t                 stats;
 
+        /* parallel migration, all guarded by 'lock' */
+        dict_t                      *migrate_data;
+        gf_defrag_queue_t           *queues;
+        int                          queue_cnt;
+        struct list_head             waiters;
+        int                          workers;
+        gf_boolean_t                 crawl_done;
+        uint32_t                     worker_cnt;
+        uint64_t                     rate_limit;
+        uint64_t                     rate_next;
+        uint64_t                     inflight_limit;
+        uint64_t                     inflight;
 };
 
 typedef struct gf_defrag_info_ gf_defrag_info_t;
@@ -375,6 +419,7 @@ dht_layout_t                            *dht_layout_get (xlator_t *this, inode_t
 dht_layout_t                            *dht_layout_for_subvol (xlator_t *this, xlator_t *subvol);
 xlator_t *dht_layout_search (xlator_t   *this, dht_layout_t *layout,
                              const char *name);
+void dht_layout_search_prepare (dht_layout_t *layout);
 int                                      dht_layout_normalize (xlator_t *this, loc_t *loc, dht_layout_t *layout);
 int dht_layout_anomalies (xlator_t      *this, loc_t *loc, dht_layout_t *layout,
                           uint32_t      *holes_p, uint32_t *overlaps_p,
@@ -697,6 +742,9 @@ gf_defrag_stop (gf_defrag_info_t *defrag, dict_t *output);
 void*
 gf_defrag_start (void *this);
 
+int
+gf_defrag_workers_spawn (xlator_t *this, gf_defrag_info_t *defrag);
+
 int32_t
 gf_defrag_handle_hardlink (xlator_t *this, loc_t *loc, dict_t  *xattrs,
                            struct iatt *stbuf);
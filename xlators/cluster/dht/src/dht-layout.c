@@ -23,7 +23,10 @@
 
 #define layout_entry_size (sizeof ((dht_layout_t *)NULL)->list[0])
 
-#define layout_size(cnt) (layout_base_size + (cnt * layout_entry_size))
+#define layout_search_size (sizeof (struct dht_layout_search_entry))
+
+#define layout_size(cnt) (layout_base_size + (cnt * layout_entry_size) \
+                          + (cnt * layout_search_size))
 
 
 dht_layout_t *
@@ -43,6 +46,7 @@ dht_layout_new (xlator_t *this, int cnt)
 
         layout->type = DHT_HASH_TYPE_DM;
         layout->cnt = cnt;
+        layout->search = (void *)&layout->list[cnt];
 
         if (conf) {
                 layout->spread_cnt = conf->dir_spread_cnt;
@@ -91,6 +95,8 @@ dht_layout_set (xlator_t *this, inode_t *inode, dht_layout_t *layout)
         if (!conf)
                 goto out;
 
+        dht_layout_search_prepare (layout);
+
         LOCK (&conf->layout_lock);
         {
                 oldret = dht_inode_ctx_layout_get (inode, this, &old_layout);
@@ -149,6 +155,61 @@ dht_layout_ref (xlator_t *this, dht_layout_t *layout)
 }
 
 
+static int
+dht_layout_search_entry_cmp (const void *a, const void *b)
+{
+        const struct dht_layout_search_entry *x = a;
+        const struct dht_layout_search_entry *y = b;
+
+        if (x->start < y->start)
+                return -1;
+
+        return (x->start > y->start);
+}
+
+
+/* Build the index of ->list sorted by start which dht_layout_search()
+ * bisects. Ranges which can only hold hash 0 are left out (that hash is
+ * always looked up linearly), and a layout with overlapping ranges is not
+ * indexed at all, so that the first match in ->list keeps winning.
+ */
+void
+dht_layout_search_prepare (dht_layout_t *layout)
+{
+        struct dht_layout_search_entry *search = NULL;
+        int                             cnt = 0;
+        int                             i = 0;
+
+        search = layout->search;
+        if (!search)
+                return;
+
+        layout->search_cnt = 0;
+        __sync_synchronize ();
+
+        for (i = 0; i < layout->cnt; i++) {
+                if (layout->list[i].start > layout->list[i].stop
+                    || layout->list[i].stop == 0)
+                        continue;
+
+                search[cnt].start = layout->list[i].start;
+                search[cnt].stop  = layout->list[i].stop;
+                search[cnt].idx   = i;
+                cnt++;
+        }
+
+        qsort (search, cnt, sizeof (*search), dht_layout_search_entry_cmp);
+
+        for (i = 1; i < cnt; i++) {
+                if (search[i].start <= search[i - 1].stop)
+                        return;
+        }
+
+        __sync_synchronize ();
+        layout->search_cnt = cnt;
+}
+
+
 xlator_t *
 dht_layout_search (xlator_t *this, dht_layout_t *layout, const char *name)
 {
@@ -156,6 +217,10 @@ dht_layout_search (xlator_t *this, dht_layout_t *layout, const char *name)
         xlator_t  *subvol = NULL;
         int        i = 0;
         int        ret = 0;
+        int        lo = 0;
+        int        hi = 0;
+        int        mid = 0;
+        int        idx = -1;
 
 
         ret = dht_hash_compute (layout->type, name, &hash);
@@ -166,6 +231,29 @@ dht_layout_search (xlator_t *this, dht_layout_t *layout, const char *name)
                 goto out;
         }
 
+        hi = layout->search_cnt - 1;
+        while (hash && lo <= hi) {
+                mid = lo + (hi - lo) / 2;
+
+                if (hash < layout->search[mid].start) {
+                        hi = mid - 1;
+                } else if (hash > layout->search[mid].stop) {
+                        lo = mid + 1;
+                } else {
+                        idx = layout->search[mid].idx;
+                        break;
+                }
+        }
+
+        /* the index is only a hint: ->list may have been changed in place
+           since it was built, so the entry found is checked again */
+        if (idx >= 0 && idx < layout->cnt
+            && layout->list[idx].start <= hash
+            && layout->list[idx].stop >= hash) {
+                subvol = layout->list[idx].xlator;
+                goto found;
+        }
+
         for (i = 0; i < layout->cnt; i++) {
                 if (layout->list[i].start <= hash
                     && layout->list[i].stop >= hash) {
@@ -174,6 +262,7 @@ dht_layout_search (xlator_t *this, dht_layout_t *layout, const char *name)
                 }
         }
 
+found:
         if (!subvol) {
                 gf_log (this->name, GF_LOG_WARNING,
                         "no subvolume for hash (value) = %u", hash);
@@ -569,6 +658,8 @@ dht_layout_normalize (xlator_t *this, loc_t *loc, dht_layout_t *layout)
                 goto out;
         }
 
+        dht_layout_search_prepare (layout);
+
         ret = dht_layout_anomalies (this, loc, layout,
                                     &holes, &overlaps,
                                     &missing, &down, &misc);
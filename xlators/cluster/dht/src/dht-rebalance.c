@@ -16,72 +16,104 @@
 
 #include "dht-common.h"
 #include "xlator.h"
+#include "timer.h"
 
 #define GF_DISK_SECTOR_SIZE             512
 #define DHT_REBALANCE_PID               4242 /* Change it if required */
 #define DHT_REBALANCE_BLKSIZE           (128 * 1024)
+#define DHT_REBALANCE_HOLE_MIN          (4 * 1024)
 
+/* write bytes [start, end) of the buffer in @vec, which was read from
+ * file offset @offset */
+static int
+dht_write_extent (xlator_t *to, fd_t *fd, struct iovec *vec, int count,
+                  off_t start, off_t end, off_t offset, struct iobref *iobref)
+{
+        struct iovec    *extent = NULL;
+        int              cnt    = 0;
+        int              ret    = -1;
+
+        extent = GF_CALLOC (count, sizeof (*extent), gf_common_mt_iovec);
+        if (!extent) {
+                errno = ENOMEM;
+                goto out;
+        }
+
+        cnt = iov_subset (vec, count, start, end, extent);
+
+        ret = syncop_writev (to, fd, extent, cnt, offset + start, iobref, 0);
+        /* 'path' will be logged in calling function */
+        if (ret < 0)
+                gf_log (THIS->name, GF_LOG_WARNING, "failed to write (%s)",
+                        strerror (errno));
+out:
+        GF_FREE (extent);
+        return ret;
+}
+
+/* Skip the zero filled sectors of a block read from the source, writing
+ * the data in between with one writev per extent. Zero runs shorter than
+ * DHT_REBALANCE_HOLE_MIN are written along with the data around them. */
 static int
 dht_write_with_holes (xlator_t *to, fd_t *fd, struct iovec *vec, int count,
                       int32_t size, off_t offset, struct iobref *iobref)
 {
-        int i            = 0;
-        int ret          = -1;
-        int start_idx    = 0;
-        int tmp_offset   = 0;
-        int write_needed = 0;
-        int buf_len      = 0;
-        int size_pending = 0;
-        char *buf        = NULL;
-
-        /* loop through each vector */
+        int      i          = 0;
+        int      ret        = -1;
+        char    *buf        = NULL;
+        size_t   buf_len    = 0;
+        size_t   idx        = 0;
+        size_t   blk        = 0;
+        int      zero_vec   = 0;
+        int      data       = 0;
+        off_t    pos        = 0;
+        off_t    data_start = -1;
+        off_t    data_end   = 0;
+        size_t   zero_run   = 0;
+
         for (i = 0; i < count; i++) {
                 buf = vec[i].iov_base;
                 buf_len = vec[i].iov_len;
 
-                for (start_idx = 0; (start_idx + GF_DISK_SECTOR_SIZE) <= buf_len;
-                     start_idx += GF_DISK_SECTOR_SIZE) {
+                /* most of a sparse image is holes, take them in one go */
+                zero_vec = !mem_0filled (buf, buf_len);
 
-                        if (mem_0filled (buf + start_idx, GF_DISK_SECTOR_SIZE) != 0) {
-                                write_needed = 1;
-                                continue;
+                for (idx = 0; idx < buf_len; idx += blk) {
+                        if (zero_vec) {
+                                blk = buf_len;
+                                data = 0;
+                        } else {
+                                blk = min (GF_DISK_SECTOR_SIZE, buf_len - idx);
+                                data = mem_0filled (buf + idx, blk);
                         }
 
-                        if (write_needed) {
-                                ret = syncop_write (to, fd, (buf + tmp_offset),
-                                                    (start_idx - tmp_offset),
-                                                    (offset + tmp_offset),
-                                                    iobref, 0);
-                                /* 'path' will be logged in calling function */
-                                if (ret < 0) {
-                                        gf_log (THIS->name, GF_LOG_WARNING,
-                                                "failed to write (%s)",
-                                                strerror (errno));
-                                        goto out;
-                                }
-
-                                write_needed = 0;
+                        if (data) {
+                                if (data_start < 0)
+                                        data_start = pos;
+                                data_end = pos + blk;
+                                zero_run = 0;
+                        } else {
+                                zero_run += blk;
                         }
-                        tmp_offset = start_idx + GF_DISK_SECTOR_SIZE;
-                }
+                        pos += blk;
 
-                if ((start_idx < buf_len) || write_needed) {
-                        /* This means, last chunk is not yet written.. write it */
-                        ret = syncop_write (to, fd, (buf + tmp_offset),
-                                            (buf_len - tmp_offset),
-                                            (offset + tmp_offset), iobref, 0);
-                        if (ret < 0) {
-                                /* 'path' will be logged in calling function */
-                                gf_log (THIS->name, GF_LOG_WARNING,
-                                        "failed to write (%s)",
-                                        strerror (errno));
+                        if ((data_start < 0) ||
+                            (zero_run < DHT_REBALANCE_HOLE_MIN))
+                                continue;
+
+                        ret = dht_write_extent (to, fd, vec, count, data_start,
+                                                data_end, offset, iobref);
+                        if (ret < 0)
                                 goto out;
-                        }
+                        data_start = -1;
                 }
+        }
 
-                size_pending = (size - buf_len);
-                if (!size_pending)
-                        break;
+        if (data_start >= 0) {
+                ret = dht_write_extent (to, fd, vec, count, data_start,
+                                        data_end, offset, iobref);
+                if (ret < 0)
+                        goto out;
         }
 
         ret = size;
@@ -382,6 +414,45 @@ out:
         return ret;
 }
 
+/* Find the next extent of data at or after @offset in the source through
+ * SEEK_DATA/SEEK_HOLE on the brick. Returns -1 with ENXIO when only a hole
+ * is left. */
+static int
+dht_rebalance_seek_data (xlator_t *from, fd_t *fd, off_t offset,
+                         off_t *data_start, off_t *data_end)
+{
+        char      key[64] = {0,};
+        dict_t   *dict    = NULL;
+        char     *value   = NULL;
+        int64_t   start   = 0;
+        int64_t   end     = 0;
+        int       ret     = -1;
+
+        snprintf (key, sizeof (key), "%s.%"PRId64, GF_SEEK_DATA_KEY,
+                  (int64_t) offset);
+
+        ret = syncop_fgetxattr (from, fd, &dict, key);
+        if (ret)
+                goto out;
+
+        ret = dict_get_str (dict, key, &value);
+        if (!ret && (sscanf (value, "%"SCNd64":%"SCNd64, &start, &end) != 2))
+                ret = -1;
+        if (ret || (start < offset) || (end <= start)) {
+                errno = EINVAL;
+                ret = -1;
+                goto out;
+        }
+
+        *data_start = start;
+        *data_end = end;
+out:
+        if (dict)
+                dict_unref (dict);
+
+        return ret;
+}
+
 static inline int
 __dht_rebalance_migrate_data (xlator_t *from, xlator_t *to, fd_t *src, fd_t *dst,
                              uint64_t ia_size, int hole_exists)
@@ -389,15 +460,39 @@ __dht_rebalance_migrate_data (xlator_t *from, xlator_t *to, fd_t *src, fd_t *dst
         int            ret    = 0;
         int            count  = 0;
         off_t          offset = 0;
+        off_t          data_end = 0;
         struct iovec  *vector = NULL;
         struct iobref *iobref = NULL;
-        uint64_t       total  = 0;
         size_t         read_size = 0;
+        int            seek_data = 0;
+
+        /* a sparse source is only read where it has data, when the brick
+           can tell where that is */
+        seek_data = hole_exists;
 
         /* if file size is '0', no need to enter this loop */
-        while (total < ia_size) {
-                read_size = (((ia_size - total) > DHT_REBALANCE_BLKSIZE) ?
-                             DHT_REBALANCE_BLKSIZE : (ia_size - total));
+        while (offset < ia_size) {
+                if (seek_data && (offset >= data_end)) {
+                        ret = dht_rebalance_seek_data (from, src, offset,
+                                                       &offset, &data_end);
+                        if (ret && (errno == ENXIO)) {
+                                ret = 0;
+                                break;
+                        }
+                        if (ret) {
+                                gf_log (THIS->name, GF_LOG_DEBUG, "seek for "
+                                        "data failed (%s), reading the holes",
+                                        strerror (errno));
+                                seek_data = 0;
+                                ret = 0;
+                        }
+                        if (offset >= ia_size)
+                                break;
+                }
+
+                read_size = min (DHT_REBALANCE_BLKSIZE,
+                                 (seek_data ? min (data_end, ia_size) :
+                                  ia_size) - offset);
                 ret = syncop_readv (from, src, read_size,
                                     offset, 0, &vector, &count, &iobref);
                 if (!ret || (ret < 0)) {
@@ -414,7 +509,6 @@ __dht_rebalance_migrate_data (xlator_t *from, xlator_t *to, fd_t *src, fd_t *dst
                         break;
                 }
                 offset += ret;
-                total += ret;
 
                 GF_FREE (vector);
                 if (iobref)
@@ -426,6 +520,15 @@ __dht_rebalance_migrate_data (xlator_t *from, xlator_t *to, fd_t *src, fd_t *dst
                 iobref_unref (iobref);
         GF_FREE (vector);
 
+        /* holes at the end are not written, restore the size */
+        if ((ret >= 0) && hole_exists) {
+                ret = syncop_ftruncate (to, dst, ia_size);
+                if (ret)
+                        gf_log (THIS->name, GF_LOG_WARNING, "failed to set "
+                                "the size of the destination (%s)",
+                                strerror (errno));
+        }
+
         if (ret >= 0)
                 ret = 0;
 
@@ -1031,9 +1134,567 @@ gf_defrag_handle_migrate_error (int32_t op_errno, gf_defrag_info_t *defrag)
         return 0;
 }
 
+/* A synctask parked on 'waiters' until the migration state it is
+ * interested in changes. 'queue' is the queue it waits on, NULL for
+ * the in-flight limit and for the count of running workers. */
+struct gf_defrag_waiter {
+        struct list_head         list;
+        struct synctask         *task;
+        gf_defrag_queue_t       *queue;
+};
+
+#define GF_DEFRAG_QUEUE_DEPTH    32     /* queued files per worker */
+#define GF_DEFRAG_MAX_SLEEP      1000000
+
+static uint64_t
+gf_defrag_now (void)
+{
+        struct timeval  tv = {0,};
+
+        gettimeofday (&tv, NULL);
+
+        return ((uint64_t) tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+/* called and returns with defrag->lock held */
+static void
+__gf_defrag_wait (gf_defrag_info_t *defrag, gf_defrag_queue_t *queue)
+{
+        struct gf_defrag_waiter  waiter = {{0,},};
+        struct synctask         *task   = NULL;
+
+        task = synctask_get ();
+
+        waiter.task = task;
+        waiter.queue = queue;
+        list_add_tail (&waiter.list, &defrag->waiters);
+
+        UNLOCK (&defrag->lock);
+        {
+                task->state = SYNCTASK_SUSPEND;
+                synctask_yield (task);
+        }
+        LOCK (&defrag->lock);
+
+        list_del_init (&waiter.list);
+}
+
+static void
+__gf_defrag_wake (gf_defrag_info_t *defrag, gf_defrag_queue_t *queue)
+{
+        struct gf_defrag_waiter *waiter = NULL;
+        struct gf_defrag_waiter *tmp    = NULL;
+
+        list_for_each_entry_safe (waiter, tmp, &defrag->waiters, list) {
+                if (waiter->queue != queue)
+                        continue;
+                list_del_init (&waiter->list);
+                synctask_wake (waiter->task);
+        }
+}
+
+static void
+__gf_defrag_wake_all (gf_defrag_info_t *defrag)
+{
+        struct gf_defrag_waiter *waiter = NULL;
+        struct gf_defrag_waiter *tmp    = NULL;
+
+        list_for_each_entry_safe (waiter, tmp, &defrag->waiters, list) {
+                list_del_init (&waiter->list);
+                synctask_wake (waiter->task);
+        }
+}
+
+static void
+gf_defrag_sleep_cbk (void *data)
+{
+        synctask_wake (data);
+}
+
+static void
+gf_defrag_sleep (xlator_t *this, uint64_t usec)
+{
+        struct synctask *task  = NULL;
+        gf_timer_t      *timer = NULL;
+        struct timeval   delta = {0,};
+
+        task = synctask_get ();
+
+        delta.tv_sec = usec / 1000000;
+        delta.tv_usec = usec % 1000000;
+
+        timer = gf_timer_call_after (this->ctx, delta, gf_defrag_sleep_cbk,
+                                     task);
+        if (!timer)
+                return;
+
+        task->state = SYNCTASK_SUSPEND;
+        synctask_yield (task);
+
+        /* the timer has fired, free it */
+        gf_timer_call_cancel (this->ctx, timer);
+}
+
+/* Wait until the rate limit and the in-flight limit allow a migration of
+ * @size bytes to start, and account for it. A file bigger than the
+ * in-flight limit is migrated once nothing else is in flight. Sleeps are
+ * cut short so that a reconfigured rate takes effect promptly. */
+static int
+gf_defrag_throttle (xlator_t *this, gf_defrag_info_t *defrag, uint64_t size)
+{
+        uint64_t  now   = 0;
+        uint64_t  delay = 0;
+        int       ret   = -1;
+
+        LOCK (&defrag->lock);
+        for (;;) {
+                if (defrag->defrag_status != GF_DEFRAG_STATUS_STARTED)
+                        goto unlock;
+
+                now = gf_defrag_now ();
+                if (defrag->rate_limit && (defrag->rate_next > now)) {
+                        delay = min (defrag->rate_next - now,
+                                     GF_DEFRAG_MAX_SLEEP);
+                        UNLOCK (&defrag->lock);
+                        {
+                                gf_defrag_sleep (this, delay);
+                        }
+                        LOCK (&defrag->lock);
+                        continue;
+                }
+
+                if (defrag->inflight_limit && defrag->inflight &&
+                    (defrag->inflight + size > defrag->inflight_limit)) {
+                        __gf_defrag_wait (defrag, NULL);
+                        continue;
+                }
+
+                break;
+        }
+
+        if (defrag->rate_limit)
+                defrag->rate_next = max (defrag->rate_next, now) +
+                        (uint64_t) ((double) size * 1e6 / defrag->rate_limit);
+
+        defrag->inflight += size;
+        ret = 0;
+unlock:
+        UNLOCK (&defrag->lock);
+
+        return ret;
+}
+
+static void
+gf_defrag_unthrottle (gf_defrag_info_t *defrag, uint64_t size)
+{
+        LOCK (&defrag->lock);
+        {
+                defrag->inflight -= size;
+                __gf_defrag_wake (defrag, NULL);
+        }
+        UNLOCK (&defrag->lock);
+}
+
+/* return values: 0 -> migrated or skipped, continue
+                 -1 -> rebalance has to stop */
+static int
+gf_defrag_migrate_entry (xlator_t *this, gf_defrag_info_t *defrag,
+                         gf_defrag_queue_t *queue, gf_defrag_entry_t *entry)
+{
+        int                      ret            = -1;
+        dict_t                  *dict           = NULL;
+        char                    *uuid_str       = NULL;
+        uuid_t                   node_uuid      = {0,};
+        int32_t                  op_errno       = 0;
+        uint64_t                 size           = 0;
+        struct timeval           start          = {0,};
+        struct timeval           end            = {0,};
+        double                   elapsed        = 0;
+        loc_t                   *loc            = NULL;
+
+        loc = &entry->loc;
+        size = entry->iatt.ia_size;
+
+        ret = syncop_getxattr (this, loc, &dict, GF_XATTR_NODE_UUID_KEY);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR, "Failed to "
+                        "get node-uuid for %s", loc->path);
+                ret = 0;
+                goto out;
+        }
+
+        ret = dict_get_str (dict, GF_XATTR_NODE_UUID_KEY, &uuid_str);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR, "Failed to "
+                        "get node-uuid from dict for %s", loc->path);
+                ret = 0;
+                goto out;
+        }
+
+        if (uuid_parse (uuid_str, node_uuid)) {
+                gf_log (this->name, GF_LOG_ERROR, "uuid_parse "
+                        "failed for %s", loc->path);
+                ret = 0;
+                goto out;
+        }
+
+        /* if file belongs to different node, skip migration
+         * the other node will take responsibility of migration
+         */
+        if (uuid_compare (node_uuid, defrag->node_uuid)) {
+                gf_log (this->name, GF_LOG_TRACE, "%s does not"
+                        "belong to this node", loc->path);
+                ret = 0;
+                goto out;
+        }
+
+        dict_unref (dict);
+        dict = NULL;
+
+        /* if distribute is present, it will honor this key.
+         * -1 is returned if distribute is not present or file
+         * doesn't have a link-file. If file has link-file, the
+         * path of link-file will be the value, and also that
+         * guarantees that file has to be mostly migrated */
+
+        ret = syncop_getxattr (this, loc, &dict, GF_XATTR_LINKINFO_KEY);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_TRACE, "failed to "
+                        "get link-to key for %s", loc->path);
+                ret = 0;
+                goto out;
+        }
+
+        ret = gf_defrag_throttle (this, defrag, size);
+        if (ret)
+                goto out;
+
+        gettimeofday (&start, NULL);
+
+        ret = syncop_setxattr (this, loc, defrag->migrate_data, 0);
+        if (ret)
+                op_errno = errno;
+
+        gettimeofday (&end, NULL);
+
+        gf_defrag_unthrottle (defrag, size);
+
+        LOCK (&defrag->lock);
+        {
+                if (!queue->first_start.tv_sec)
+                        queue->first_start = start;
+                if (timercmp (&end, &queue->last_end, >))
+                        queue->last_end = end;
+                if (ret) {
+                        defrag->total_failures += 1;
+                        queue->failures += 1;
+                }
+        }
+        UNLOCK (&defrag->lock);
+
+        if (ret) {
+                gf_log (this->name, GF_LOG_ERROR, "migrate-data"
+                        " failed for %s", loc->path);
+        }
+
+        if (ret == -1) {
+                ret = gf_defrag_handle_migrate_error (op_errno, defrag);
+
+                if (!ret)
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "migrate-data on %s failed: %s",
+                                loc->path, strerror (op_errno));
+                else if (ret == 1) {
+                        ret = 0;
+                        goto out;
+                } else if (ret == -1)
+                        goto out;
+        }
+
+        LOCK (&defrag->lock);
+        {
+                defrag->total_files += 1;
+                defrag->total_data += size;
+                queue->files += 1;
+                queue->size += size;
+        }
+        UNLOCK (&defrag->lock);
+
+        if (defrag->stats == _gf_true) {
+                elapsed = (end.tv_sec - start.tv_sec) * 1e6 +
+                          (end.tv_usec - start.tv_usec);
+                gf_log (this->name, GF_LOG_INFO, "Migration of "
+                        "file:%s size:%"PRIu64" bytes took %.2f"
+                        "secs", loc->path, size, elapsed/1e6);
+        }
+
+        ret = 0;
+out:
+        if (dict)
+                dict_unref (dict);
+
+        return ret;
+}
+
+static void
+gf_defrag_entry_free (gf_defrag_entry_t *entry)
+{
+        loc_wipe (&entry->loc);
+        GF_FREE (entry);
+}
+
+/* One of the synctasks migrating files off a source subvolume. It exits
+ * once the crawl is over and its queue drained, when rebalance stops, or
+ * when rebalance-workers was lowered below the number of its peers. */
+static int
+gf_defrag_worker (void *data)
+{
+        xlator_t                *this   = NULL;
+        dht_conf_t              *conf   = NULL;
+        gf_defrag_info_t        *defrag = NULL;
+        gf_defrag_queue_t       *queue  = NULL;
+        gf_defrag_entry_t       *entry  = NULL;
+        int                      ret    = 0;
+
+        this = THIS;
+        conf = this->private;
+        defrag = conf->defrag;
+        queue = data;
+
+        LOCK (&defrag->lock);
+        for (;;) {
+                if (defrag->defrag_status != GF_DEFRAG_STATUS_STARTED)
+                        break;
+
+                if (queue->workers > defrag->worker_cnt)
+                        break;
+
+                if (list_empty (&queue->entries)) {
+                        if (defrag->crawl_done)
+                                break;
+                        __gf_defrag_wait (defrag, queue);
+                        continue;
+                }
+
+                entry = list_entry (queue->entries.next, gf_defrag_entry_t,
+                                    list);
+                list_del_init (&entry->list);
+                queue->count--;
+
+                /* the crawler may be waiting for room in this queue */
+                __gf_defrag_wake (defrag, queue);
+                UNLOCK (&defrag->lock);
+                {
+                        ret = gf_defrag_migrate_entry (this, defrag, queue,
+                                                       entry);
+                        gf_defrag_entry_free (entry);
+                }
+                LOCK (&defrag->lock);
+
+                if (ret)
+                        break;
+        }
+
+        queue->workers--;
+        defrag->workers--;
+        __gf_defrag_wake (defrag, queue);
+        __gf_defrag_wake (defrag, NULL);
+        UNLOCK (&defrag->lock);
+
+        return 0;
+}
+
+static int
+gf_defrag_worker_done (int ret, call_frame_t *sync_frame, void *data)
+{
+        STACK_DESTROY (sync_frame->root);
+        return 0;
+}
+
+/* Bring every source subvolume up to rebalance-workers migration tasks.
+ * Called when the crawl starts and again whenever the option grows. A
+ * subvolume left without any task fails the rebalance, its files could
+ * not be migrated. */
+int
+gf_defrag_workers_spawn (xlator_t *this, gf_defrag_info_t *defrag)
+{
+        gf_defrag_queue_t       *queue    = NULL;
+        call_frame_t            *frame    = NULL;
+        xlator_t                *old_THIS = NULL;
+        int                      i        = 0;
+        int                      ret      = 0;
+        int                      failed   = 0;
+
+        old_THIS = THIS;
+        THIS = this;
+
+        for (i = 0; i < defrag->queue_cnt; i++) {
+                queue = &defrag->queues[i];
+
+                LOCK (&defrag->lock);
+                while ((defrag->defrag_status == GF_DEFRAG_STATUS_STARTED) &&
+                       !defrag->crawl_done &&
+                       (queue->workers < defrag->worker_cnt)) {
+                        queue->workers++;
+                        defrag->workers++;
+                        UNLOCK (&defrag->lock);
+
+                        ret = -1;
+                        frame = create_frame (this, this->ctx->pool);
+                        if (frame) {
+                                frame->root->pid = defrag->pid;
+                                ret = synctask_new (this->ctx->env,
+                                                    gf_defrag_worker,
+                                                    gf_defrag_worker_done,
+                                                    frame, queue);
+                        }
+
+                        LOCK (&defrag->lock);
+                        if (ret) {
+                                gf_log (this->name, GF_LOG_ERROR, "Could not "
+                                        "create migration task for %s",
+                                        queue->subvol->name);
+                                if (frame)
+                                        STACK_DESTROY (frame->root);
+                                queue->workers--;
+                                defrag->workers--;
+                                failed = 1;
+                                if (!queue->workers &&
+                                    (defrag->defrag_status ==
+                                     GF_DEFRAG_STATUS_STARTED))
+                                        defrag->defrag_status =
+                                                GF_DEFRAG_STATUS_FAILED;
+                                __gf_defrag_wake_all (defrag);
+                                break;
+                        }
+                }
+                UNLOCK (&defrag->lock);
+
+                if (defrag->defrag_status != GF_DEFRAG_STATUS_STARTED)
+                        break;
+        }
+
+        THIS = old_THIS;
+
+        return failed ? -1 : 0;
+}
+
+/* hand a looked up file over to the workers of its cached subvolume,
+ * waiting while that queue is full */
+static int
+gf_defrag_queue_entry (xlator_t *this, gf_defrag_info_t *defrag, loc_t *loc,
+                       struct iatt *iatt)
+{
+        xlator_t                *subvol = NULL;
+        gf_defrag_queue_t       *queue  = NULL;
+        gf_defrag_entry_t       *entry  = NULL;
+        int                      i      = 0;
+        int                      ret    = -1;
+
+        subvol = dht_subvol_get_cached (this, loc->inode);
+        for (i = 0; subvol && (i < defrag->queue_cnt); i++) {
+                if (defrag->queues[i].subvol == subvol) {
+                        queue = &defrag->queues[i];
+                        break;
+                }
+        }
+
+        if (!queue) {
+                gf_log (this->name, GF_LOG_ERROR, "%s: no cached subvolume",
+                        loc->path);
+                ret = 0;
+                goto out;
+        }
+
+        entry = GF_CALLOC (1, sizeof (*entry), gf_defrag_entry_mt);
+        if (!entry)
+                goto out;
+
+        INIT_LIST_HEAD (&entry->list);
+        entry->iatt = *iatt;
+
+        ret = loc_copy (&entry->loc, loc);
+        if (ret)
+                goto out;
+
+        LOCK (&defrag->lock);
+        {
+                while ((defrag->defrag_status == GF_DEFRAG_STATUS_STARTED) &&
+                       (queue->workers > 0) &&
+                       (queue->count >= (GF_DEFRAG_QUEUE_DEPTH *
+                                         defrag->worker_cnt)))
+                        __gf_defrag_wait (defrag, queue);
+
+                if ((defrag->defrag_status != GF_DEFRAG_STATUS_STARTED) ||
+                    !queue->workers) {
+                        ret = 1;
+                } else {
+                        list_add_tail (&entry->list, &queue->entries);
+                        queue->count++;
+                        __gf_defrag_wake (defrag, queue);
+                        entry = NULL;
+                }
+        }
+        UNLOCK (&defrag->lock);
+
+        if (ret == 1)
+                gf_log (this->name, GF_LOG_ERROR, "%s: no migration task "
+                        "left for %s", loc->path, queue->subvol->name);
+out:
+        if (entry)
+                gf_defrag_entry_free (entry);
+
+        /* the crawl stops here, which must not look like a completed
+           rebalance unless it was stopped */
+        if (ret) {
+                LOCK (&defrag->lock);
+                {
+                        if (defrag->defrag_status == GF_DEFRAG_STATUS_STARTED)
+                                defrag->defrag_status =
+                                        GF_DEFRAG_STATUS_FAILED;
+                        __gf_defrag_wake_all (defrag);
+                }
+                UNLOCK (&defrag->lock);
+        }
+
+        return ret;
+}
+
+/* end of the crawl: let the workers drain their queues, wait for all of
+ * them to exit and drop whatever they left behind */
+static void
+gf_defrag_workers_wait (gf_defrag_info_t *defrag)
+{
+        gf_defrag_queue_t       *queue = NULL;
+        gf_defrag_entry_t       *entry = NULL;
+        gf_defrag_entry_t       *tmp   = NULL;
+        int                      i     = 0;
+
+        LOCK (&defrag->lock);
+        {
+                defrag->crawl_done = _gf_true;
+                __gf_defrag_wake_all (defrag);
+
+                while (defrag->workers)
+                        __gf_defrag_wait (defrag, NULL);
+
+                for (i = 0; i < defrag->queue_cnt; i++) {
+                        queue = &defrag->queues[i];
+                        list_for_each_entry_safe (entry, tmp, &queue->entries,
+                                                  list) {
+                                list_del_init (&entry->list);
+                                gf_defrag_entry_free (entry);
+                        }
+                        queue->count = 0;
+                }
+        }
+        UNLOCK (&defrag->lock);
+}
+
 /* We do a depth first traversal of directories. But before we move into
  * subdirs, we complete the data migration of those directories whose layouts
- * have been fixed
+ * have been fixed. Files are looked up here and migrated by the workers of
+ * their cached subvolume, several at a time.
  */
 
 int
@@ -1048,16 +1709,11 @@ gf_defrag_migrate_data (xlator_t *this, gf_defrag_info_t *defrag, loc_t *loc,
         gf_dirent_t             *entry          = NULL;
         gf_boolean_t             free_entries   = _gf_false;
         off_t                    offset         = 0;
-        dict_t                  *dict           = NULL;
         struct iatt              iatt           = {0,};
-        int32_t                  op_errno       = 0;
-        char                    *uuid_str       = NULL;
-        uuid_t                   node_uuid      = {0,};
         int                      readdir_operrno = 0;
         struct timeval           dir_start      = {0,};
         struct timeval           end            = {0,};
         double                   elapsed        = {0,};
-        struct timeval           start          = {0,};
 
         gf_log (this->name, GF_LOG_INFO, "migrate data called on %s",
                 loc->path);
@@ -1107,9 +1763,6 @@ gf_defrag_migrate_data (xlator_t *this, gf_defrag_info_t *defrag, loc_t *loc,
                                 continue;
 
                         defrag->num_files_lookedup++;
-                        if (defrag->stats == _gf_true) {
-                                gettimeofday (&start, NULL);
-                        }
                         loc_wipe (&entry_loc);
                         ret =dht_build_child_loc (this, &entry_loc, loc,
                                                   entry->d_name);
@@ -1147,97 +1800,10 @@ gf_defrag_migrate_data (xlator_t *this, gf_defrag_info_t *defrag, loc_t *loc,
                                 continue;
                         }
 
-                        ret = syncop_getxattr (this, &entry_loc, &dict,
-                                               GF_XATTR_NODE_UUID_KEY);
-                        if(ret < 0) {
-                                gf_log (this->name, GF_LOG_ERROR, "Failed to "
-                                        "get node-uuid for %s", entry_loc.path);
-                                continue;
-                        }
-
-                        ret = dict_get_str (dict, GF_XATTR_NODE_UUID_KEY,
-                                            &uuid_str);
-                        if(ret < 0) {
-                                gf_log (this->name, GF_LOG_ERROR, "Failed to "
-                                        "get node-uuid from dict for %s",
-                                        entry_loc.path);
-                                continue;
-                        }
-
-                        if (uuid_parse (uuid_str, node_uuid)) {
-                                gf_log (this->name, GF_LOG_ERROR, "uuid_parse "
-                                        "failed for %s", entry_loc.path);
-                                continue;
-                        }
-
-                        /* if file belongs to different node, skip migration
-                         * the other node will take responsibility of migration
-                         */
-                        if (uuid_compare (node_uuid, defrag->node_uuid)) {
-                                gf_log (this->name, GF_LOG_TRACE, "%s does not"
-                                        "belong to this node", entry_loc.path);
-                                continue;
-                        }
-
-                        uuid_str = NULL;
-
-                        dict_del (dict, GF_XATTR_NODE_UUID_KEY);
-
-
-                        /* if distribute is present, it will honor this key.
-                         * -1 is returned if distribute is not present or file
-                         * doesn't have a link-file. If file has link-file, the
-                         * path of link-file will be the value, and also that
-                         * guarantees that file has to be mostly migrated */
-
-                        ret = syncop_getxattr (this, &entry_loc, &dict,
-                                               GF_XATTR_LINKINFO_KEY);
-                        if (ret < 0) {
-                                gf_log (this->name, GF_LOG_TRACE, "failed to "
-                                        "get link-to key for %s",
-                                        entry_loc.path);
-                                continue;
-                        }
-
-                        ret = syncop_setxattr (this, &entry_loc, migrate_data,
-                                               0);
-                        if (ret) {
-                                gf_log (this->name, GF_LOG_ERROR, "migrate-data"
-                                        " failed for %s", entry_loc.path);
-                                defrag->total_failures +=1;
-                        }
-
-                        if (ret == -1) {
-                                op_errno = errno;
-                                ret = gf_defrag_handle_migrate_error (op_errno,
-                                                                      defrag);
-
-                                if (!ret)
-                                        gf_log (this->name, GF_LOG_DEBUG,
-                                                "migrate-data on %s failed: %s",
-                                                entry_loc.path,
-                                                strerror (op_errno));
-                                else if (ret == 1)
-                                        continue;
-                                else if (ret == -1)
-                                        goto out;
-                        }
-
-                        LOCK (&defrag->lock);
-                        {
-                                defrag->total_files += 1;
-                                defrag->total_data += iatt.ia_size;
-                        }
-                        UNLOCK (&defrag->lock);
-                        if (defrag->stats == _gf_true) {
-                                gettimeofday (&end, NULL);
-                                elapsed = (end.tv_sec - start.tv_sec) * 1e6 +
-                                          (end.tv_usec - start.tv_usec);
-                                gf_log (this->name, GF_LOG_INFO, "Migration of "
-                                        "file:%s size:%"PRIu64" bytes took %.2f"
-                                        "secs", entry_loc.path, iatt.ia_size,
-                                         elapsed/1e6);
-                        }
+                        ret = gf_defrag_queue_entry (this, defrag, &entry_loc,
+                                                     &iatt);
+                        if (ret)
+                                goto out;
                 }
 
                 gf_dirent_free (&entries);
@@ -1251,7 +1817,7 @@ gf_defrag_migrate_data (xlator_t *this, gf_defrag_info_t *defrag, loc_t *loc,
         gettimeofday (&end, NULL);
         elapsed = (end.tv_sec - dir_start.tv_sec) * 1e6 +
                   (end.tv_usec - dir_start.tv_usec);
-        gf_log (this->name, GF_LOG_INFO, "Migration operation on dir %s took "
+        gf_log (this->name, GF_LOG_INFO, "Crawling dir %s for migration took "
                 "%.2f secs", loc->path, elapsed/1e6);
         ret = 0;
 out:
@@ -1260,9 +1826,6 @@ out:
 
         loc_wipe (&entry_loc);
 
-        if (dict)
-                dict_unref(dict);
-
         if (fd)
                 fd_unref (fd);
         return ret;
@@ -1499,9 +2062,18 @@ gf_defrag_start_crawl (void *data)
                                             "non-force");
                 if (ret)
                         goto out;
+
+                defrag->migrate_data = migrate_data;
+                ret = gf_defrag_workers_spawn (this, defrag);
         }
-        ret = gf_defrag_fix_layout (this, defrag, &loc, fix_layout,
-                                    migrate_data);
+
+        if (defrag->defrag_status == GF_DEFRAG_STATUS_STARTED)
+                ret = gf_defrag_fix_layout (this, defrag, &loc, fix_layout,
+                                            migrate_data);
+
+        /* files queued by the crawl are still being migrated */
+        gf_defrag_workers_wait (defrag);
+
         if ((defrag->defrag_status != GF_DEFRAG_STATUS_STOPPED) &&
             (defrag->defrag_status != GF_DEFRAG_STATUS_FAILED)) {
                 defrag->defrag_status = GF_DEFRAG_STATUS_COMPLETE;
@@ -1523,10 +2095,17 @@ out:
         UNLOCK (&defrag->lock);
 
         if (defrag) {
+                GF_FREE (defrag->queues);
                 GF_FREE (defrag);
                 conf->defrag = NULL;
         }
 
+        if (migrate_data)
+                dict_unref (migrate_data);
+
+        if (fix_layout)
+                dict_unref (fix_layout);
+
         return ret;
 }
 
@@ -1549,6 +2128,7 @@ gf_defrag_start (void *data)
         dht_conf_t              *conf   = NULL;
         gf_defrag_info_t        *defrag = NULL;
         xlator_t                *this  = NULL;
+        int                      i      = 0;
 
         this = data;
         conf = this->private;
@@ -1559,6 +2139,18 @@ gf_defrag_start (void *data)
         if (!defrag)
                 goto out;
 
+        defrag->queues = GF_CALLOC (conf->subvolume_cnt,
+                                    sizeof (*defrag->queues),
+                                    gf_defrag_queue_mt);
+        if (!defrag->queues)
+                goto out;
+
+        for (i = 0; i < conf->subvolume_cnt; i++) {
+                INIT_LIST_HEAD (&defrag->queues[i].entries);
+                defrag->queues[i].subvol = conf->subvolumes[i];
+        }
+        defrag->queue_cnt = conf->subvolume_cnt;
+
         frame = create_frame (this, this->ctx->pool);
         if (!frame)
                 goto out;
@@ -1579,6 +2171,71 @@ out:
         return NULL;
 }
 
+/* per source subvolume counters, as subvol-<key>-<index>; called with
+ * defrag->lock held, the workers update them under it */
+static void
+__gf_defrag_queues_status_get (gf_defrag_info_t *defrag, dict_t *dict)
+{
+        gf_defrag_queue_t *queue   = NULL;
+        char               key[64] = {0,};
+        double             elapsed = 0;
+        int                i       = 0;
+        int                ret     = 0;
+
+        for (i = 0; i < defrag->queue_cnt; i++) {
+                queue = &defrag->queues[i];
+
+                elapsed = 0;
+                if (queue->first_start.tv_sec)
+                        elapsed = (queue->last_end.tv_sec -
+                                   queue->first_start.tv_sec) +
+                                  (queue->last_end.tv_usec -
+                                   queue->first_start.tv_usec) / 1e6;
+
+                snprintf (key, sizeof (key), "subvol-name-%d", i);
+                ret = dict_set_str (dict, key, queue->subvol->name);
+                if (ret)
+                        break;
+
+                snprintf (key, sizeof (key), "subvol-files-%d", i);
+                ret = dict_set_uint64 (dict, key, queue->files);
+                if (ret)
+                        break;
+
+                snprintf (key, sizeof (key), "subvol-size-%d", i);
+                ret = dict_set_uint64 (dict, key, queue->size);
+                if (ret)
+                        break;
+
+                snprintf (key, sizeof (key), "subvol-failures-%d", i);
+                ret = dict_set_uint64 (dict, key, queue->failures);
+                if (ret)
+                        break;
+
+                snprintf (key, sizeof (key), "subvol-run-time-%d", i);
+                ret = dict_set_double (dict, key, elapsed);
+                if (ret)
+                        break;
+
+                gf_log (THIS->name, GF_LOG_DEBUG, "%s: files migrated: %"
+                        PRIu64", size: %"PRIu64", failures: %"PRIu64
+                        ", run-time: %.2f secs", queue->subvol->name,
+                        queue->files, queue->size, queue->failures, elapsed);
+        }
+
+        if (ret) {
+                gf_log (THIS->name, GF_LOG_WARNING,
+                        "failed to set per subvolume status");
+                return;
+        }
+
+        ret = dict_set_int32 (dict, "subvol-count", defrag->queue_cnt);
+        if (ret)
+                gf_log (THIS->name, GF_LOG_WARNING,
+                        "failed to set subvolume count");
+}
+
+/* called with defrag->lock held */
 int
 gf_defrag_status_get (gf_defrag_info_t *defrag, dict_t *dict)
 {
@@ -1611,6 +2268,8 @@ gf_defrag_status_get (gf_defrag_info_t *defrag, dict_t *dict)
         if (!dict)
                 goto log;
 
+        __gf_defrag_queues_status_get (defrag, dict);
+
         ret = dict_set_uint64 (dict, "files", files);
         if (ret)
                 gf_log (THIS->name, GF_LOG_WARNING,
@@ -283,6 +283,44 @@ out:
         return ret;
 }
 
+/* migration workers and throttling can be changed while rebalance runs */
+static int
+dht_reconfigure_defrag (xlator_t *this, gf_defrag_info_t *defrag,
+                        dict_t *options)
+{
+        uint32_t         worker_cnt     = 0;
+        uint64_t         rate_limit     = 0;
+        uint64_t         inflight_limit = 0;
+        gf_boolean_t     spawn          = _gf_false;
+        int              ret            = -1;
+
+        GF_OPTION_RECONF ("rebalance-workers", worker_cnt, options, uint32,
+                          out);
+        GF_OPTION_RECONF ("rebalance-rate-limit", rate_limit, options, size,
+                          out);
+        GF_OPTION_RECONF ("rebalance-inflight-limit", inflight_limit, options,
+                          size, out);
+
+        LOCK (&defrag->lock);
+        {
+                spawn = (worker_cnt > defrag->worker_cnt);
+                defrag->worker_cnt = worker_cnt;
+
+                if (rate_limit != defrag->rate_limit)
+                        defrag->rate_next = 0;
+                defrag->rate_limit = rate_limit;
+                defrag->inflight_limit = inflight_limit;
+        }
+        UNLOCK (&defrag->lock);
+
+        if (spawn && defrag->queues)
+                gf_defrag_workers_spawn (this, defrag);
+
+        ret = 0;
+out:
+        return ret;
+}
+
 int
 reconfigure (xlator_t *this, dict_t *options)
 {
@@ -340,6 +378,9 @@ reconfigure (xlator_t *this, dict_t *options)
         if (conf->defrag) {
                 GF_OPTION_RECONF ("rebalance-stats", conf->defrag->stats,
                                   options, bool, out);
+                ret = dht_reconfigure_defrag (this, conf->defrag, options);
+                if (ret)
+                        goto out;
         }
 
         if (dict_get_str (options, "decommissioned-bricks", &temp_str) == 0) {
@@ -393,6 +434,7 @@ init (xlator_t *this)
                 GF_VALIDATE_OR_GOTO (this->name, defrag, err);
 
                 LOCK_INIT (&defrag->lock);
+                INIT_LIST_HEAD (&defrag->waiters);
 
                 defrag->is_exiting = 0;
 
@@ -447,6 +489,12 @@ init (xlator_t *this)
 
         if (defrag) {
                 GF_OPTION_INIT ("rebalance-stats", defrag->stats, bool, err);
+                GF_OPTION_INIT ("rebalance-workers", defrag->worker_cnt,
+                                uint32, err);
+                GF_OPTION_INIT ("rebalance-rate-limit", defrag->rate_limit,
+                                size, err);
+                GF_OPTION_INIT ("rebalance-inflight-limit",
+                                defrag->inflight_limit, size, err);
         }
 
         /* option can be any one of percent or bytes */
@@ -622,6 +670,26 @@ struct volume_options options[] = {
           .type = GF_OPTION_TYPE_BOOL,
           .default_value = "off",
         },
+        { .key = {"rebalance-workers"},
+          .type = GF_OPTION_TYPE_INT,
+          .min = 1,
+          .max = 64,
+          .default_value = "4",
+          .description = "Number of files migrated in parallel off each "
+                         "subvolume during rebalance."
+        },
+        { .key = {"rebalance-rate-limit"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .default_value = "0",
+          .description = "Bytes per second rebalance may migrate, across "
+                         "all subvolumes. 0 means no limit."
+        },
+        { .key = {"rebalance-inflight-limit"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .default_value = "256MB",
+          .description = "Size of the files being migrated at once by "
+                         "rebalance. 0 means no limit."
+        },
 
         { .key  = {NULL} },
 };
@@ -2769,6 +2769,10 @@ notify (xlator_t *this, int32_t event, void *data, ...)
                         ret = io_stats_dump (this, &args);
                 }
                 break;
+        case GF_EVENT_UPCALL:
+                /* data is the gf_upcall of features/upcall, not a dict */
+                default_notify (this, event, data);
+                break;
         default:
                 default_notify (this, event, data);
                 break;
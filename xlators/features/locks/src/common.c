@@ -57,6 +57,8 @@ __allocate_domain (const char *volume)
         INIT_LIST_HEAD (&dom->blocked_entrylks);
         INIT_LIST_HEAD (&dom->inodelk_list);
         INIT_LIST_HEAD (&dom->blocked_inodelks);
+        itree_init (&dom->inodelk_tree);
+        itree_init (&dom->blocked_tree);
 
 out:
         if (dom && (NULL == dom->domain)) {
@@ -450,6 +452,8 @@ pl_inode_get (xlator_t *this, inode_t *inode)
                 INIT_LIST_HEAD (&pl_inode->reservelk_list);
                 INIT_LIST_HEAD (&pl_inode->blocked_reservelks);
                 INIT_LIST_HEAD (&pl_inode->blocked_calls);
+                itree_init (&pl_inode->ext_granted);
+                itree_init (&pl_inode->ext_blocked);
 
                 __inode_ctx_put (inode, this, (uint64_t)(long)(pl_inode));
         }
@@ -503,6 +507,11 @@ void
 __delete_lock (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
         list_del_init (&lock->list);
+
+        if (lock->blocked)
+                itree_remove (&pl_inode->ext_blocked, &lock->node);
+        else
+                itree_remove (&pl_inode->ext_granted, &lock->node);
 }
 
 
@@ -533,10 +542,18 @@ posix_lock_to_flock (posix_lock_t *lock, struct gf_flock *flock)
 static void
 __insert_lock (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
-        if (lock->blocked)
+        itree_node_init (&lock->node, lock->fl_start, lock->fl_end);
+
+        if (lock->blocked) {
                 gettimeofday (&lock->blkd_time, NULL);
-        else
+                /* a waiter put back keeps its place in the queue */
+                if (!lock->blkd_seq)
+                        lock->blkd_seq = ++pl_inode->ext_blkd_seq;
+                itree_insert (&pl_inode->ext_blocked, &lock->node);
+        } else {
                 gettimeofday (&lock->granted_time, NULL);
+                itree_insert (&pl_inode->ext_granted, &lock->node);
+        }
 
         list_add_tail (&lock->list, &pl_inode->ext_list);
 
@@ -570,18 +587,61 @@ same_owner (posix_lock_t *l1, posix_lock_t *l2)
 }
 
 
-/* Delete all F_UNLCK locks */
+struct pl_ext_walk {
+        posix_lock_t     *lock;
+        posix_lock_t     *found;
+        pl_inode_t       *pl_inode;
+        struct list_head *list;
+        int               count;
+};
+
+
+static posix_lock_t *
+__ext_find (struct itree_root *root, posix_lock_t *lock, itree_fn_t fn)
+{
+        struct pl_ext_walk walk = {0, };
+
+        walk.lock = lock;
+
+        itree_foreach_overlap (root, lock->fl_start, lock->fl_end, fn, &walk);
+
+        return walk.found;
+}
+
+
+static int
+__ext_collect_unlck (struct itree_node *node, void *data)
+{
+        struct pl_ext_walk *walk = data;
+        posix_lock_t       *l = NULL;
+
+        l = itree_entry (node, posix_lock_t, node);
+
+        if (l->fl_type == F_UNLCK)
+                list_move_tail (&l->list, walk->list);
+
+        return 0;
+}
+
+
+/* Delete all F_UNLCK locks in [start, end] */
 void
-__delete_unlck_locks (pl_inode_t *pl_inode)
+__delete_unlck_locks (pl_inode_t *pl_inode, off_t start, off_t end)
 {
-        posix_lock_t *l = NULL;
-        posix_lock_t *tmp = NULL;
+        struct pl_ext_walk  walk = {0, };
+        struct list_head    unlck;
+        posix_lock_t       *l = NULL;
+        posix_lock_t       *tmp = NULL;
 
-        list_for_each_entry_safe (l, tmp, &pl_inode->ext_list, list) {
-                if (l->fl_type == F_UNLCK) {
-                        __delete_lock (pl_inode, l);
-                        __destroy_lock (l);
-                }
+        INIT_LIST_HEAD (&unlck);
+        walk.list = &unlck;
+
+        itree_foreach_overlap (&pl_inode->ext_granted, start, end,
+                               __ext_collect_unlck, &walk);
+
+        list_for_each_entry_safe (l, tmp, &unlck, list) {
+                __delete_lock (pl_inode, l);
+                __destroy_lock (l);
         }
 }
 
@@ -714,47 +774,50 @@ done:
         return v;
 }
 
-static posix_lock_t *
-first_conflicting_overlap (pl_inode_t *pl_inode, posix_lock_t *lock)
+static int
+__ext_conflicts (struct itree_node *node, void *data)
 {
-        posix_lock_t *l = NULL;
+        struct pl_ext_walk *walk = data;
+        posix_lock_t       *l = NULL;
 
-        list_for_each_entry (l, &pl_inode->ext_list, list) {
-                if (l->blocked)
-                        continue;
+        l = itree_entry (node, posix_lock_t, node);
 
-                if (locks_overlap (l, lock)) {
-                        if (same_owner (l, lock))
-                                continue;
+        if (same_owner (l, walk->lock))
+                return 0;
 
-                        if ((l->fl_type == F_WRLCK) ||
-                            (lock->fl_type == F_WRLCK))
-                                return l;
-                }
+        if ((l->fl_type == F_WRLCK) || (walk->lock->fl_type == F_WRLCK)) {
+                walk->found = l;
+                return 1;
         }
 
-        return NULL;
+        return 0;
+}
+
+
+static int
+__ext_overlaps (struct itree_node *node, void *data)
+{
+        struct pl_ext_walk *walk = data;
+
+        walk->found = itree_entry (node, posix_lock_t, node);
+
+        return 1;
+}
+
+
+static posix_lock_t *
+first_conflicting_overlap (pl_inode_t *pl_inode, posix_lock_t *lock)
+{
+        return __ext_find (&pl_inode->ext_granted, lock, __ext_conflicts);
 }
 
 /*
-  Start searching from {begin}, and return the first lock that
-  conflicts, NULL if no conflict
-  If {begin} is NULL, then start from the beginning of the list
+  Return a granted lock overlapping {lock}, NULL if there is none
 */
 static posix_lock_t *
 first_overlap (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
-        posix_lock_t *l = NULL;
-
-        list_for_each_entry (l, &pl_inode->ext_list, list) {
-                if (l->blocked)
-                        continue;
-
-                if (locks_overlap (l, lock))
-                        return l;
-        }
-
-        return NULL;
+        return __ext_find (&pl_inode->ext_granted, lock, __ext_overlaps);
 }
 
 
@@ -763,107 +826,105 @@ first_overlap (pl_inode_t *pl_inode, posix_lock_t *lock)
 static int
 __is_lock_grantable (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
-        posix_lock_t *l = NULL;
-        int           ret = 1;
-
-        list_for_each_entry (l, &pl_inode->ext_list, list) {
-                if (!l->blocked && locks_overlap (lock, l)) {
-                        if (((l->fl_type == F_WRLCK)
-                             || (lock->fl_type == F_WRLCK))
-                            && (lock->fl_type != F_UNLCK)
-                            && !same_owner (l, lock)) {
-                                ret = 0;
-                                break;
-                        }
-                }
-        }
-        return ret;
+        if (lock->fl_type == F_UNLCK)
+                return 1;
+
+        return (first_conflicting_overlap (pl_inode, lock) == NULL);
 }
 
 
 extern void do_blocked_rw (pl_inode_t *);
 
 
+/* Stops at the first granted lock of the same owner, which {lock} has to
+   be merged with. Locks of other owners never change on an insert, as it
+   was checked to be grantable. */
+static int
+__ext_same_owner (struct itree_node *node, void *data)
+{
+        struct pl_ext_walk *walk = data;
+        posix_lock_t       *l = NULL;
+
+        l = itree_entry (node, posix_lock_t, node);
+
+        if (same_owner (l, walk->lock)) {
+                walk->found = l;
+                return 1;
+        }
+
+        return 0;
+}
+
+
 static void
 __insert_and_merge (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
         posix_lock_t  *conf = NULL;
-        posix_lock_t  *t = NULL;
         posix_lock_t  *sum = NULL;
+        off_t          start = 0;
+        off_t          end = 0;
         int            i = 0;
         struct _values v = { .locks = {0, 0, 0} };
 
-        list_for_each_entry_safe (conf, t, &pl_inode->ext_list, list) {
-                if (conf->blocked)
-                        continue;
-                if (!locks_overlap (conf, lock))
-                        continue;
-
-                if (same_owner (conf, lock)) {
-                        if (conf->fl_type == lock->fl_type) {
-                                sum = add_locks (lock, conf);
+        conf = __ext_find (&pl_inode->ext_granted, lock, __ext_same_owner);
+        if (conf) {
+                if (conf->fl_type == lock->fl_type) {
+                        sum = add_locks (lock, conf);
 
-                                sum->fl_type    = lock->fl_type;
-                                sum->transport  = lock->transport;
-                                sum->fd_num     = lock->fd_num;
-                                sum->client_pid = lock->client_pid;
-                                sum->owner      = lock->owner;
+                        sum->fl_type    = lock->fl_type;
+                        sum->transport  = lock->transport;
+                        sum->fd_num     = lock->fd_num;
+                        sum->client_pid = lock->client_pid;
+                        sum->owner      = lock->owner;
 
-                                __delete_lock (pl_inode, conf);
-                                __destroy_lock (conf);
+                        __delete_lock (pl_inode, conf);
+                        __destroy_lock (conf);
 
-                                __destroy_lock (lock);
-                                INIT_LIST_HEAD (&sum->list);
-                                posix_lock_to_flock (sum, &sum->user_flock);
-                                __insert_and_merge (pl_inode, sum);
+                        __destroy_lock (lock);
+                        INIT_LIST_HEAD (&sum->list);
+                        posix_lock_to_flock (sum, &sum->user_flock);
+                        __insert_and_merge (pl_inode, sum);
 
-                                return;
-                        } else {
-                                sum = add_locks (lock, conf);
-
-                                sum->fl_type    = conf->fl_type;
-                                sum->transport  = conf->transport;
-                                sum->fd_num     = conf->fd_num;
-                                sum->client_pid = conf->client_pid;
-                                sum->owner      = conf->owner;
+                        return;
+                } else {
+                        sum = add_locks (lock, conf);
 
-                                v = subtract_locks (sum, lock);
+                        sum->fl_type    = conf->fl_type;
+                        sum->transport  = conf->transport;
+                        sum->fd_num     = conf->fd_num;
+                        sum->client_pid = conf->client_pid;
+                        sum->owner      = conf->owner;
 
-                                __delete_lock (pl_inode, conf);
-                                __destroy_lock (conf);
+                        v = subtract_locks (sum, lock);
 
-                                __delete_lock (pl_inode, lock);
-                                __destroy_lock (lock);
+                        __delete_lock (pl_inode, conf);
+                        __destroy_lock (conf);
 
-                                __destroy_lock (sum);
+                        __delete_lock (pl_inode, lock);
+                        __destroy_lock (lock);
 
-                                for (i = 0; i < 3; i++) {
-                                        if (!v.locks[i])
-                                                continue;
+                        start = sum->fl_start;
+                        end   = sum->fl_end;
+                        __destroy_lock (sum);
 
-                                        INIT_LIST_HEAD (&v.locks[i]->list);
-                                        posix_lock_to_flock (v.locks[i],
-                                                       &v.locks[i]->user_flock);
-                                        __insert_and_merge (pl_inode,
-                                                            v.locks[i]);
-                                }
+                        for (i = 0; i < 3; i++) {
+                                if (!v.locks[i])
+                                        continue;
 
-                                __delete_unlck_locks (pl_inode);
-                                return;
+                                /* copied from a lock which was in a tree */
+                                INIT_LIST_HEAD (&v.locks[i]->list);
+                                itree_node_init (&v.locks[i]->node, 0, 0);
+                                posix_lock_to_flock (v.locks[i],
+                                                     &v.locks[i]->user_flock);
+                                __insert_and_merge (pl_inode, v.locks[i]);
                         }
-                }
-
-                if (lock->fl_type == F_UNLCK) {
-                        continue;
-                }
 
-                if ((conf->fl_type == F_RDLCK) && (lock->fl_type == F_RDLCK)) {
-                        __insert_lock (pl_inode, lock);
+                        __delete_unlck_locks (pl_inode, start, end);
                         return;
                 }
         }
 
-        /* no conflicts, so just insert */
+        /* nothing of the same owner to merge with, so just insert */
         if (lock->fl_type != F_UNLCK) {
                 __insert_lock (pl_inode, lock);
         } else {
@@ -872,25 +933,106 @@ __insert_and_merge (pl_inode_t *pl_inode, posix_lock_t *lock)
 }
 
 
+/* Collects the blocked locks no granted lock stands in the way of */
+static int
+__ext_collect_unblocked (struct itree_node *node, void *data)
+{
+        struct pl_ext_walk *walk = data;
+        posix_lock_t       *l = NULL;
+
+        l = itree_entry (node, posix_lock_t, node);
+
+        if (first_overlap (walk->pl_inode, l))
+                return 0;
+
+        list_move_tail (&l->list, walk->list);
+        walk->count++;
+
+        return 0;
+}
+
+
+struct pl_blkd_entry {
+        uint64_t          seq;
+        struct list_head *head;
+};
+
+static int
+__pl_blkd_seq_cmp (const void *p1, const void *p2)
+{
+        const struct pl_blkd_entry *e1 = p1;
+        const struct pl_blkd_entry *e2 = p2;
+
+        if (e1->seq == e2->seq)
+                return 0;
+
+        return (e1->seq < e2->seq) ? -1 : 1;
+}
+
+
+/* The trees hand out the waiters in the order of their offsets, put the
+   @count ones on @list back in the order they were blocked in. The
+   blkd_seq of each lock is @seq_offset bytes from its list_head on @list.
+   Without memory they are retried in the order of their offsets. */
 void
-__grant_blocked_locks (xlator_t *this, pl_inode_t *pl_inode, struct list_head *granted)
+__pl_sort_blocked (struct list_head *list, int count, ptrdiff_t seq_offset)
 {
-        struct list_head  tmp_list;
-        posix_lock_t     *l = NULL;
-        posix_lock_t     *tmp = NULL;
-        posix_lock_t     *conf = NULL;
+        struct pl_blkd_entry *entries = NULL;
+        struct list_head     *head = NULL;
+        int                   i = 0;
+
+        if (count < 2)
+                return;
+
+        entries = GF_MALLOC (count * sizeof (*entries),
+                             gf_locks_mt_lock_array);
+        if (!entries)
+                return;
+
+        for (i = 0; (i < count) && !list_empty (list); i++) {
+                head = list->next;
+                list_del_init (head);
+                entries[i].seq = *(uint64_t *)((char *)head + seq_offset);
+                entries[i].head = head;
+        }
+        count = i;
+
+        qsort (entries, count, sizeof (*entries), __pl_blkd_seq_cmp);
+
+        for (i = 0; i < count; i++)
+                list_add_tail (entries[i].head, list);
+
+        GF_FREE (entries);
+}
+
+
+/* Grants the blocked locks overlapping [start, end], the range of the
+   locks just released or changed. Waiters elsewhere in the file are still
+   blocked by whatever blocked them before and are not looked at. */
+static void
+__grant_blocked_locks (xlator_t *this, pl_inode_t *pl_inode,
+                       struct list_head *granted, off_t start, off_t end)
+{
+        struct pl_ext_walk  walk = {0, };
+        struct list_head    tmp_list;
+        posix_lock_t       *l = NULL;
+        posix_lock_t       *tmp = NULL;
+        posix_lock_t       *conf = NULL;
 
         INIT_LIST_HEAD (&tmp_list);
 
-        list_for_each_entry_safe (l, tmp, &pl_inode->ext_list, list) {
-                if (l->blocked) {
-                        conf = first_overlap (pl_inode, l);
-                        if (conf)
-                                continue;
+        walk.pl_inode = pl_inode;
+        walk.list = &tmp_list;
 
-                        l->blocked = 0;
-                        list_move_tail (&l->list, &tmp_list);
-                }
+        itree_foreach_overlap (&pl_inode->ext_blocked, start, end,
+                               __ext_collect_unblocked, &walk);
+
+        __pl_sort_blocked (&tmp_list, walk.count,
+                           PL_BLKD_SEQ_OFFSET (posix_lock_t, list));
+
+        list_for_each_entry (l, &tmp_list, list) {
+                itree_remove (&pl_inode->ext_blocked, &l->node);
+                l->blocked = 0;
         }
 
         list_for_each_entry_safe (l, tmp, &tmp_list, list) {
@@ -929,8 +1071,9 @@ __grant_blocked_locks (xlator_t *this, pl_inode_t *pl_inode, struct list_head *g
 }
 
 
-void
-grant_blocked_locks (xlator_t *this, pl_inode_t *pl_inode)
+static void
+grant_blocked_locks_range (xlator_t *this, pl_inode_t *pl_inode, off_t start,
+                           off_t end)
 {
         struct list_head granted_list;
         posix_lock_t     *tmp = NULL;
@@ -940,7 +1083,8 @@ grant_blocked_locks (xlator_t *this, pl_inode_t *pl_inode)
 
         pthread_mutex_lock (&pl_inode->mutex);
         {
-                __grant_blocked_locks (this, pl_inode, &granted_list);
+                __grant_blocked_locks (this, pl_inode, &granted_list, start,
+                                       end);
         }
         pthread_mutex_unlock (&pl_inode->mutex);
 
@@ -959,6 +1103,13 @@ grant_blocked_locks (xlator_t *this, pl_inode_t *pl_inode)
         return;
 }
 
+
+void
+grant_blocked_locks (xlator_t *this, pl_inode_t *pl_inode)
+{
+        grant_blocked_locks_range (this, pl_inode, 0, LLONG_MAX);
+}
+
 static int
 pl_send_prelock_unlock (xlator_t *this, pl_inode_t *pl_inode,
                         posix_lock_t *old_lock)
@@ -988,7 +1139,8 @@ pl_send_prelock_unlock (xlator_t *this, pl_inode_t *pl_inode,
 
         __insert_and_merge (pl_inode, unlock_lock);
 
-        __grant_blocked_locks (this, pl_inode, &granted_list);
+        __grant_blocked_locks (this, pl_inode, &granted_list,
+                               old_lock->fl_start, old_lock->fl_end);
 
         list_for_each_entry_safe (lock, tmp, &granted_list, list) {
                 list_del_init (&lock->list);
@@ -1011,9 +1163,15 @@ pl_setlk (xlator_t *this, pl_inode_t *pl_inode, posix_lock_t *lock,
           int can_block)
 {
         int              ret = 0;
+        off_t            start = 0;
+        off_t            end = 0;
 
         errno = 0;
 
+        /* {lock} may be merged away below */
+        start = lock->fl_start;
+        end   = lock->fl_end;
+
         pthread_mutex_lock (&pl_inode->mutex);
         {
                 /* Send unlock before the actual lock to
@@ -1067,7 +1225,7 @@ pl_setlk (xlator_t *this, pl_inode_t *pl_inode, posix_lock_t *lock,
         }
         pthread_mutex_unlock (&pl_inode->mutex);
 
-        grant_blocked_locks (this, pl_inode);
+        grant_blocked_locks_range (this, pl_inode, start, end);
 
         do_blocked_rw (pl_inode);
 
@@ -10,6 +10,8 @@
 #ifndef __COMMON_H__
 #define __COMMON_H__
 
+#include <stddef.h>
+
 #include "lkowner.h"
 /*dump locks format strings */
 #define RANGE_FMT               "type=%s, whence=%hd, start=%llu, len=%llu"
@@ -29,6 +31,11 @@
 #define RANGE_BLKD_GRNTD_FMT    RANGE_FMT", "DUMP_BLKD_GRNTD_FMT
 
 #define SET_FLOCK_PID(flock, lock) ((flock)->l_pid = lock->client_pid)
+
+/* where the blkd_seq of a lock is, seen from its list_head @member */
+#define PL_BLKD_SEQ_OFFSET(type, member)                                \
+        ((ptrdiff_t) offsetof (type, blkd_seq) -                        \
+         (ptrdiff_t) offsetof (type, member))
 posix_lock_t *
 new_posix_lock (struct gf_flock *flock, void *transport, pid_t client_pid,
                 gf_lkowner_t *owner, fd_t *fd);
@@ -66,7 +73,10 @@ void
 grant_blocked_inode_locks (xlator_t *this, pl_inode_t *pl_inode, pl_dom_list_t *dom);
 
 void
-__delete_inode_lock (pl_inode_lock_t *lock);
+__delete_inode_lock (pl_dom_list_t *dom, pl_inode_lock_t *lock);
+
+void
+__delete_blocked_inode_lock (pl_dom_list_t *dom, pl_inode_lock_t *lock);
 
 void
 __pl_inodelk_unref (pl_inode_lock_t *lock);
@@ -145,4 +155,7 @@ int
 pl_reserve_unlock (xlator_t *this, pl_inode_t *pl_inode, posix_lock_t *reqlock);
 uint32_t
 check_entrylk_on_basename (xlator_t *this, inode_t *parent, char *basename);
+
+void
+__pl_sort_blocked (struct list_head *list, int count, ptrdiff_t seq_offset);
 #endif /* __COMMON_H__ */
@@ -456,9 +456,14 @@ out:
         return entrylk;
 }
 
+/* Retries the blocked locks on names conflicting with @basename, the name
+ * just unlocked (NULL for all of them). The others stay queued in their
+ * order without being retried, nothing they wait for has changed.
+ */
 void
 __grant_blocked_entry_locks (xlator_t *this, pl_inode_t *pl_inode,
-                             pl_dom_list_t *dom, struct list_head *granted)
+                             pl_dom_list_t *dom, const char *basename,
+                             struct list_head *granted)
 {
         int              bl_ret = 0;
         pl_entry_lock_t *bl   = NULL;
@@ -472,6 +477,12 @@ __grant_blocked_entry_locks (xlator_t *this, pl_inode_t *pl_inode,
         list_for_each_entry_safe (bl, tmp, &blocked_list,
                                   blocked_locks) {
 
+                if (!names_conflict (bl->basename, basename)) {
+                        list_move_tail (&bl->blocked_locks,
+                                        &dom->blocked_entrylks);
+                        continue;
+                }
+
                 list_del_init (&bl->blocked_locks);
 
 
@@ -507,7 +518,9 @@ grant_blocked_entry_locks (xlator_t *this, pl_inode_t *pl_inode,
 
         pthread_mutex_lock (&pl_inode->mutex);
         {
-                __grant_blocked_entry_locks (this, pl_inode, dom, &granted_list);
+                __grant_blocked_entry_locks (this, pl_inode, dom,
+                                             unlocked->basename,
+                                             &granted_list);
         }
         pthread_mutex_unlock (&pl_inode->mutex);
 
@@ -577,7 +590,8 @@ release_entry_locks_for_transport (xlator_t *this, pl_inode_t *pinode,
                         GF_FREE (lock);
                 }
 
-                __grant_blocked_entry_locks (this, pinode, dom, &granted);
+                __grant_blocked_entry_locks (this, pinode, dom, NULL,
+                                             &granted);
 
         }
 
@@ -24,9 +24,17 @@
 #include "common.h"
 
 inline void
-__delete_inode_lock (pl_inode_lock_t *lock)
+__delete_inode_lock (pl_dom_list_t *dom, pl_inode_lock_t *lock)
 {
         list_del (&lock->list);
+        itree_remove (&dom->inodelk_tree, &lock->node);
+}
+
+inline void
+__delete_blocked_inode_lock (pl_dom_list_t *dom, pl_inode_lock_t *lock)
+{
+        list_del_init (&lock->blocked_locks);
+        itree_remove (&dom->blocked_tree, &lock->node);
 }
 
 static inline void
@@ -109,14 +117,6 @@ pl_print_inodelk (char *str, int size, int cmd, struct gf_flock *flock, const ch
                   (unsigned long long) flock->l_pid);
 }
 
-/* Determine if the two inodelks overlap reach other's lock regions */
-static int
-inodelk_overlap (pl_inode_lock_t *l1, pl_inode_lock_t *l2)
-{
-        return ((l1->fl_end >= l2->fl_start) &&
-                (l2->fl_end >= l1->fl_start));
-}
-
 /* Returns true if the 2 inodelks have the same owner */
 static inline int
 same_inodelk_owner (pl_inode_lock_t *l1, pl_inode_lock_t *l2)
@@ -125,51 +125,75 @@ same_inodelk_owner (pl_inode_lock_t *l1, pl_inode_lock_t *l2)
                 (l1->transport  == l2->transport));
 }
 
-/* Returns true if the 2 inodelks conflict with each other */
+struct inodelk_walk {
+        pl_inode_lock_t  *lock;
+        pl_inode_lock_t  *found;
+        struct list_head *list;
+        int               count;
+};
+
+static pl_inode_lock_t *
+__inodelk_find (struct itree_root *root, pl_inode_lock_t *lock, itree_fn_t fn)
+{
+        struct inodelk_walk walk = {0, };
+
+        walk.lock = lock;
+
+        itree_foreach_overlap (root, lock->fl_start, lock->fl_end, fn, &walk);
+
+        return walk.found;
+}
+
 static int
-inodelk_conflict (pl_inode_lock_t *l1, pl_inode_lock_t *l2)
+__inodelk_granted_conflict (struct itree_node *node, void *data)
 {
-        return (inodelk_overlap (l1, l2) &&
-                inodelk_type_conflict (l1, l2));
+        struct inodelk_walk *walk = data;
+        pl_inode_lock_t     *l = NULL;
+
+        l = itree_entry (node, pl_inode_lock_t, node);
+
+        if (inodelk_type_conflict (walk->lock, l) &&
+            !same_inodelk_owner (walk->lock, l)) {
+                walk->found = l;
+                return 1;
+        }
+
+        return 0;
 }
 
 /* Determine if lock is grantable or not */
 static pl_inode_lock_t *
 __inodelk_grantable (pl_dom_list_t *dom, pl_inode_lock_t *lock)
 {
-        pl_inode_lock_t *l = NULL;
-        pl_inode_lock_t *ret = NULL;
-        if (list_empty (&dom->inodelk_list))
-                goto out;
-        list_for_each_entry (l, &dom->inodelk_list, list){
-                if (inodelk_conflict (lock, l) &&
-                    !same_inodelk_owner (lock, l)) {
-                        ret = l;
-                        goto out;
-                }
-        }
-out:
-        return ret;
+        return __inodelk_find (&dom->inodelk_tree, lock,
+                               __inodelk_granted_conflict);
 }
 
-static pl_inode_lock_t *
-__blocked_lock_conflict (pl_dom_list_t *dom, pl_inode_lock_t *lock)
+/* A waiter being retried only gives way to the ones queued before it */
+static int
+__inodelk_blocked_conflict (struct itree_node *node, void *data)
 {
-        pl_inode_lock_t *l   = NULL;
-        pl_inode_lock_t *ret = NULL;
+        struct inodelk_walk *walk = data;
+        pl_inode_lock_t     *l = NULL;
 
-        if (list_empty (&dom->blocked_inodelks))
-                return NULL;
+        l = itree_entry (node, pl_inode_lock_t, node);
 
-        list_for_each_entry (l, &dom->blocked_inodelks, blocked_locks) {
-                if (inodelk_conflict (lock, l)) {
-                        ret = l;
-                        goto out;
-                }
+        if (walk->lock->blkd_seq && (l->blkd_seq > walk->lock->blkd_seq))
+                return 0;
+
+        if (inodelk_type_conflict (walk->lock, l)) {
+                walk->found = l;
+                return 1;
         }
 
-out:
-        return ret;
+        return 0;
+}
+
+static pl_inode_lock_t *
+__blocked_lock_conflict (pl_dom_list_t *dom, pl_inode_lock_t *lock)
+{
+        return __inodelk_find (&dom->blocked_tree, lock,
+                               __inodelk_blocked_conflict);
 }
 
 static int
@@ -191,6 +215,21 @@ __owner_has_lock (pl_dom_list_t *dom, pl_inode_lock_t *newlock)
 }
 
 
+static void
+__insert_blocked_inode_lock (pl_dom_list_t *dom, pl_inode_lock_t *lock)
+{
+        gettimeofday (&lock->blkd_time, NULL);
+
+        /* a waiter put back keeps its place in the queue */
+        if (!lock->blkd_seq)
+                lock->blkd_seq = ++dom->blkd_seq;
+
+        list_add_tail (&lock->blocked_locks, &dom->blocked_inodelks);
+
+        itree_node_init (&lock->node, lock->fl_start, lock->fl_end);
+        itree_insert (&dom->blocked_tree, &lock->node);
+}
+
 /* Determines if lock can be granted and adds the lock. If the lock
  * is blocking, adds it to the blocked_inodelks list of the domain.
  */
@@ -207,8 +246,7 @@ __lock_inodelk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
                 if (can_block == 0)
                         goto out;
 
-                gettimeofday (&lock->blkd_time, NULL);
-                list_add_tail (&lock->blocked_locks, &dom->blocked_inodelks);
+                __insert_blocked_inode_lock (dom, lock);
 
                 gf_log (this->name, GF_LOG_TRACE,
                         "%s (pid=%d) lk-owner:%s %"PRId64" - %"PRId64" => Blocked",
@@ -227,8 +265,7 @@ __lock_inodelk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
                 if (can_block == 0)
                         goto out;
 
-                gettimeofday (&lock->blkd_time, NULL);
-                list_add_tail (&lock->blocked_locks, &dom->blocked_inodelks);
+                __insert_blocked_inode_lock (dom, lock);
 
                 gf_log (this->name, GF_LOG_TRACE,
                         "Lock is grantable, but blocking to prevent starvation");
@@ -247,6 +284,9 @@ __lock_inodelk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
         gettimeofday (&lock->granted_time, NULL);
         list_add (&lock->list, &dom->inodelk_list);
 
+        itree_node_init (&lock->node, lock->fl_start, lock->fl_end);
+        itree_insert (&dom->inodelk_tree, &lock->node);
+
         ret = 0;
 
 out:
@@ -265,16 +305,27 @@ inodelks_equal (pl_inode_lock_t *l1, pl_inode_lock_t *l2)
 }
 
 
+static int
+__inodelk_matches (struct itree_node *node, void *data)
+{
+        struct inodelk_walk *walk = data;
+        pl_inode_lock_t     *l = NULL;
+
+        l = itree_entry (node, pl_inode_lock_t, node);
+
+        if (inodelks_equal (l, walk->lock) &&
+            same_inodelk_owner (l, walk->lock)) {
+                walk->found = l;
+                return 1;
+        }
+
+        return 0;
+}
+
 static pl_inode_lock_t *
 find_matching_inodelk (pl_inode_lock_t *lock, pl_dom_list_t *dom)
 {
-        pl_inode_lock_t *l = NULL;
-        list_for_each_entry (l, &dom->inodelk_list, list) {
-                if (inodelks_equal (l, lock) &&
-                    same_inodelk_owner (l, lock))
-                        return l;
-        }
-        return NULL;
+        return __inodelk_find (&dom->inodelk_tree, lock, __inodelk_matches);
 }
 
 /* Set F_UNLCK removes a lock which has the exact same lock boundaries
@@ -295,7 +346,7 @@ __inode_unlock_lock (xlator_t *this, pl_inode_lock_t *lock, pl_dom_list_t *dom)
                         lkowner_utoa (&lock->owner), lock->transport);
                 goto out;
         }
-        __delete_inode_lock (conf);
+        __delete_inode_lock (dom, conf);
         gf_log (this->name, GF_LOG_DEBUG,
                 " Matching lock found for unlock %llu-%llu, by %s on %p",
                 (unsigned long long)lock->fl_start,
@@ -305,18 +356,48 @@ __inode_unlock_lock (xlator_t *this, pl_inode_lock_t *lock, pl_dom_list_t *dom)
 out:
         return conf;
 }
+
+static int
+__inodelk_collect (struct itree_node *node, void *data)
+{
+        struct inodelk_walk *walk = data;
+        pl_inode_lock_t     *l = NULL;
+
+        l = itree_entry (node, pl_inode_lock_t, node);
+
+        list_move_tail (&l->blocked_locks, walk->list);
+        walk->count++;
+
+        return 0;
+}
+
+/* Retries the blocked inodelks overlapping [start, end], the range of the
+ * lock just released. Waiters elsewhere are not affected by it.
+ */
 static void
 __grant_blocked_inode_locks (xlator_t *this, pl_inode_t *pl_inode,
-                             struct list_head *granted, pl_dom_list_t *dom)
+                             struct list_head *granted, pl_dom_list_t *dom,
+                             off_t start, off_t end)
 {
-        int              bl_ret = 0;
-        pl_inode_lock_t *bl = NULL;
-        pl_inode_lock_t *tmp = NULL;
+        int                  bl_ret = 0;
+        pl_inode_lock_t     *bl = NULL;
+        pl_inode_lock_t     *tmp = NULL;
+        struct inodelk_walk  walk = {0, };
 
         struct list_head blocked_list;
 
         INIT_LIST_HEAD (&blocked_list);
-        list_splice_init (&dom->blocked_inodelks, &blocked_list);
+        walk.list = &blocked_list;
+
+        itree_foreach_overlap (&dom->blocked_tree, start, end,
+                               __inodelk_collect, &walk);
+
+        list_for_each_entry (bl, &blocked_list, blocked_locks)
+                itree_remove (&dom->blocked_tree, &bl->node);
+
+        __pl_sort_blocked (&blocked_list, walk.count,
+                           PL_BLKD_SEQ_OFFSET (pl_inode_lock_t,
+                                               blocked_locks));
 
         list_for_each_entry_safe (bl, tmp, &blocked_list, blocked_locks) {
 
@@ -331,9 +412,9 @@ __grant_blocked_inode_locks (xlator_t *this, pl_inode_t *pl_inode,
         return;
 }
 
-/* Grant all inodelks blocked on a lock */
-void
-grant_blocked_inode_locks (xlator_t *this, pl_inode_t *pl_inode, pl_dom_list_t *dom)
+static void
+grant_blocked_inode_locks_range (xlator_t *this, pl_inode_t *pl_inode,
+                                 pl_dom_list_t *dom, off_t start, off_t end)
 {
         struct list_head granted;
         pl_inode_lock_t *lock;
@@ -343,7 +424,8 @@ grant_blocked_inode_locks (xlator_t *this, pl_inode_t *pl_inode, pl_dom_list_t *
 
         pthread_mutex_lock (&pl_inode->mutex);
         {
-                __grant_blocked_inode_locks (this, pl_inode, &granted, dom);
+                __grant_blocked_inode_locks (this, pl_inode, &granted, dom,
+                                             start, end);
         }
         pthread_mutex_unlock (&pl_inode->mutex);
 
@@ -372,6 +454,13 @@ grant_blocked_inode_locks (xlator_t *this, pl_inode_t *pl_inode, pl_dom_list_t *
         pthread_mutex_unlock (&pl_inode->mutex);
 }
 
+/* Grant all inodelks blocked on a lock */
+void
+grant_blocked_inode_locks (xlator_t *this, pl_inode_t *pl_inode, pl_dom_list_t *dom)
+{
+        grant_blocked_inode_locks_range (this, pl_inode, dom, 0, LLONG_MAX);
+}
+
 /* Release all inodelks from this transport */
 static int
 release_inode_locks_of_transport (xlator_t *this, pl_dom_list_t *dom,
@@ -398,7 +487,7 @@ release_inode_locks_of_transport (xlator_t *this, pl_dom_list_t *dom,
                         if (l->transport != trans)
                                 continue;
 
-                        list_del_init (&l->blocked_locks);
+                        __delete_blocked_inode_lock (dom, l);
 
                         inode_path (inode, NULL, &path);
                         if (path)
@@ -440,7 +529,7 @@ release_inode_locks_of_transport (xlator_t *this, pl_dom_list_t *dom,
                                 path = NULL;
                         }
 
-                        __delete_inode_lock (l);
+                        __delete_inode_lock (dom, l);
                         __pl_inodelk_unref (l);
                 }
         }
@@ -468,6 +557,8 @@ pl_inode_setlk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
         int ret = -EINVAL;
         pl_inode_lock_t *retlock = NULL;
         gf_boolean_t    unref = _gf_true;
+        off_t           start = lock->fl_start;
+        off_t           end = lock->fl_end;
 
         pthread_mutex_lock (&pl_inode->mutex);
         {
@@ -509,7 +600,7 @@ out:
         if (unref)
                 __pl_inodelk_unref (lock);
         pthread_mutex_unlock (&pl_inode->mutex);
-        grant_blocked_inode_locks (this, pl_inode, dom);
+        grant_blocked_inode_locks_range (this, pl_inode, dom, start, end);
         return ret;
 }
 
@@ -21,6 +21,7 @@
 #include "locks-mem-types.h"
 
 #include "lkowner.h"
+#include "interval-tree.h"
 
 #define POSIX_LOCKS "posix-locks"
 struct __pl_fd;
@@ -37,6 +38,10 @@ struct __posix_lock {
         xlator_t          *this;       /* required for blocked locks */
         unsigned long      fd_num;
 
+        struct itree_node  node;        /* in ext_granted or ext_blocked of
+                                           the pl_inode, as per @blocked */
+        uint64_t           blkd_seq;    /* order among the blocked locks */
+
         fd_t              *fd;
         call_frame_t      *frame;
 
@@ -57,6 +62,11 @@ struct __pl_inode_lock {
         struct list_head   blocked_locks; /* list_head pointing to blocked_inodelks */
         int                ref;
 
+        struct itree_node  node;          /* in inodelk_tree of the domain
+                                             while granted, in blocked_tree
+                                             while blocked */
+        uint64_t           blkd_seq;      /* order among the blocked locks */
+
         short              fl_type;
         off_t              fl_start;
         off_t              fl_end;
@@ -95,6 +105,9 @@ struct __pl_dom_list_t {
         struct list_head   blocked_entrylks; /* List of all blocked entrylks */
         struct list_head   inodelk_list;     /* List of inode locks */
         struct list_head   blocked_inodelks; /* List of all blocked inodelks */
+        struct itree_root  inodelk_tree;     /* inodelk_list on the ranges */
+        struct itree_root  blocked_tree;     /* blocked_inodelks on the ranges */
+        uint64_t           blkd_seq;         /* last blkd_seq handed out */
 };
 typedef struct __pl_dom_list_t pl_dom_list_t;
 
@@ -128,6 +141,11 @@ struct __pl_inode {
 
         struct list_head dom_list;       /* list of domains */
         struct list_head ext_list;       /* list of fcntl locks */
+        struct itree_root ext_granted;   /* granted ext_list locks on the
+                                            ranges */
+        struct itree_root ext_blocked;   /* blocked ext_list locks on the
+                                            ranges */
+        uint64_t         ext_blkd_seq;   /* last blkd_seq handed out */
         struct list_head rw_list;        /* list of waiting r/w requests */
         struct list_head reservelk_list;        /* list of reservelks */
         struct list_head blocked_reservelks;        /* list of blocked reservelks */
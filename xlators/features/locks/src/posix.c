@@ -315,11 +315,11 @@ delete_locks_of_fd (xlator_t *this, pl_inode_t *pl_inode, fd_t *fd)
 
                list_for_each_entry_safe (l, tmp, &pl_inode->ext_list, list) {
                        if ((l->fd_num == fd_to_fdnum(fd))) {
+                               __delete_lock (pl_inode, l);
                                if (l->blocked) {
-                                       list_move_tail (&l->list, &blocked_list);
+                                       list_add_tail (&l->list, &blocked_list);
                                        continue;
                                }
-                               __delete_lock (pl_inode, l);
                                __destroy_lock (l);
                        }
                }
@@ -1325,7 +1325,7 @@ pl_forget (xlator_t *this,
                                         "Pending inode locks found, releasing.");
 
                                 list_for_each_entry_safe (ino_l, ino_tmp, &dom->inodelk_list, list) {
-                                        __delete_inode_lock (ino_l);
+                                        __delete_inode_lock (dom, ino_l);
                                         __pl_inodelk_unref (ino_l);
                                 }
 
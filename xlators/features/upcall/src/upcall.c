@@ -0,0 +1,1338 @@
+/*
+   Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <time.h>
+
+#include "glusterfs.h"
+#include "xlator.h"
+#include "logging.h"
+#include "statedump.h"
+#include "upcall.h"
+
+
+static void
+upcall_local_wipe (upcall_local_t *local)
+{
+        if (!local)
+                return;
+
+        if (local->inode)
+                inode_unref (local->inode);
+        if (local->parent)
+                inode_unref (local->parent);
+        if (local->newparent)
+                inode_unref (local->newparent);
+        if (local->target)
+                inode_unref (local->target);
+
+        mem_put (local);
+}
+
+
+/* Remember the inodes a modifying fop touches, for its callback. Nothing is
+   kept with cache-invalidation off. */
+static int
+upcall_local_init (xlator_t *this, call_frame_t *frame, inode_t *inode,
+                   inode_t *parent, inode_t *newparent, inode_t *target)
+{
+        upcall_private_t *priv  = NULL;
+        upcall_local_t   *local = NULL;
+
+        priv = this->private;
+
+        if (!priv->cache_invalidation || !frame->root->trans)
+                return 0;
+
+        local = mem_get0 (this->local_pool);
+        if (!local)
+                return -1;
+
+        if (inode)
+                local->inode = inode_ref (inode);
+        if (parent)
+                local->parent = inode_ref (parent);
+        if (newparent)
+                local->newparent = inode_ref (newparent);
+        if (target)
+                local->target = inode_ref (target);
+
+        frame->local = local;
+
+        return 0;
+}
+
+
+static upcall_inode_ctx_t *
+upcall_inode_ctx_get (xlator_t *this, inode_t *inode, gf_boolean_t create)
+{
+        upcall_private_t   *priv  = NULL;
+        upcall_inode_ctx_t *ctx   = NULL;
+        uint64_t            value = 0;
+
+        priv = this->private;
+
+        LOCK (&inode->lock);
+        {
+                if (__inode_ctx_get (inode, this, &value) == 0) {
+                        ctx = (upcall_inode_ctx_t *)(long) value;
+                        goto unlock;
+                }
+
+                if (!create)
+                        goto unlock;
+
+                ctx = GF_CALLOC (1, sizeof (*ctx), gf_upcall_mt_inode_ctx_t);
+                if (!ctx)
+                        goto unlock;
+
+                INIT_LIST_HEAD (&ctx->inode_ctxs);
+                INIT_LIST_HEAD (&ctx->clients);
+                LOCK_INIT (&ctx->lock);
+
+                if (__inode_ctx_put (inode, this, (uint64_t)(long) ctx)) {
+                        LOCK_DESTROY (&ctx->lock);
+                        GF_FREE (ctx);
+                        ctx = NULL;
+                        goto unlock;
+                }
+
+                LOCK (&priv->lock);
+                {
+                        list_add_tail (&ctx->inode_ctxs, &priv->inode_ctxs);
+                }
+                UNLOCK (&priv->lock);
+        }
+unlock:
+        UNLOCK (&inode->lock);
+
+        return ctx;
+}
+
+
+/* find @client among the clients of @ctx, forgetting those idle for longer
+   than the timeout on the way */
+static upcall_client_t *
+__upcall_client_find (upcall_private_t *priv, upcall_inode_ctx_t *ctx,
+                      void *client, time_t now)
+{
+        upcall_client_t *each  = NULL;
+        upcall_client_t *tmp   = NULL;
+        upcall_client_t *found = NULL;
+
+        list_for_each_entry_safe (each, tmp, &ctx->clients, list) {
+                if (each->client == client) {
+                        found = each;
+                        continue;
+                }
+
+                if ((now - each->access_time) > priv->timeout) {
+                        list_del (&each->list);
+                        GF_FREE (each);
+                }
+        }
+
+        return found;
+}
+
+
+/* the client of @frame is (about to be) caching state of @inode */
+static void
+upcall_cache_access (xlator_t *this, call_frame_t *frame, inode_t *inode)
+{
+        upcall_private_t   *priv   = NULL;
+        upcall_inode_ctx_t *ctx    = NULL;
+        upcall_client_t    *client = NULL;
+        time_t              now    = 0;
+
+        priv = this->private;
+
+        if (!priv->cache_invalidation || !inode || !frame->root->trans)
+                return;
+
+        ctx = upcall_inode_ctx_get (this, inode, _gf_true);
+        if (!ctx)
+                return;
+
+        time (&now);
+
+        LOCK (&ctx->lock);
+        {
+                client = __upcall_client_find (priv, ctx, frame->root->trans,
+                                               now);
+                if (client) {
+                        client->access_time = now;
+                        goto unlock;
+                }
+
+                client = GF_CALLOC (1, sizeof (*client),
+                                    gf_upcall_mt_client_t);
+                if (!client)
+                        goto unlock;
+
+                client->client = frame->root->trans;
+                client->access_time = now;
+                list_add_tail (&client->list, &ctx->clients);
+        }
+unlock:
+        UNLOCK (&ctx->lock);
+}
+
+
+/* @inode was modified by the client of @frame: every other client which
+   accessed it within the timeout is sent an invalidation and forgotten,
+   those idle for longer are forgotten only */
+static void
+upcall_cache_invalidate (xlator_t *this, call_frame_t *frame, inode_t *inode,
+                         uint32_t flags)
+{
+        upcall_private_t   *priv    = NULL;
+        upcall_inode_ctx_t *ctx     = NULL;
+        upcall_client_t    *each    = NULL;
+        upcall_client_t    *tmp     = NULL;
+        struct gf_upcall    upcall  = {0, };
+        struct list_head    notify;
+        time_t              now     = 0;
+
+        priv = this->private;
+
+        if (!inode || uuid_is_null (inode->gfid))
+                goto out;
+
+        INIT_LIST_HEAD (&notify);
+
+        ctx = upcall_inode_ctx_get (this, inode, _gf_false);
+        if (!ctx)
+                goto out;
+
+        time (&now);
+
+        LOCK (&ctx->lock);
+        {
+                list_for_each_entry_safe (each, tmp, &ctx->clients, list) {
+                        if (each->client == frame->root->trans)
+                                continue;
+
+                        list_del_init (&each->list);
+
+                        if ((now - each->access_time) > priv->timeout)
+                                GF_FREE (each);
+                        else
+                                list_add_tail (&each->list, &notify);
+                }
+        }
+        UNLOCK (&ctx->lock);
+
+        uuid_copy (upcall.gfid, inode->gfid);
+        upcall.flags = flags;
+
+        list_for_each_entry_safe (each, tmp, &notify, list) {
+                upcall.client = each->client;
+
+                default_notify (this, GF_EVENT_UPCALL, &upcall);
+                __sync_fetch_and_add (&priv->notifications, 1);
+
+                list_del (&each->list);
+                GF_FREE (each);
+        }
+
+out:
+        /* the modifying client has the new state cached now */
+        upcall_cache_access (this, frame, inode);
+}
+
+
+int32_t
+upcall_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, inode_t *inode,
+                   struct iatt *buf, dict_t *xdata, struct iatt *postparent)
+{
+        inode_t *linked = NULL;
+
+        if ((op_ret < 0) || !inode)
+                goto unwind;
+
+        /* protocol/server links the inode after us, and keeps the one
+           already in the table if any: account the access there */
+        linked = inode_find (inode->table, buf->ia_gfid);
+
+        upcall_cache_access (this, frame, linked ? linked : inode);
+
+        if (linked)
+                inode_unref (linked);
+unwind:
+        UPCALL_STACK_UNWIND (lookup, frame, op_ret, op_errno, inode, buf,
+                             xdata, postparent);
+        return 0;
+}
+
+
+int32_t
+upcall_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xdata)
+{
+        STACK_WIND (frame, upcall_lookup_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->lookup, loc, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_stat (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xdata)
+{
+        upcall_cache_access (this, frame, loc->inode);
+
+        STACK_WIND (frame, default_stat_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->stat, loc, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_fstat (call_frame_t *frame, xlator_t *this, fd_t *fd, dict_t *xdata)
+{
+        upcall_cache_access (this, frame, fd->inode);
+
+        STACK_WIND (frame, default_fstat_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->fstat, fd, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_access (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t mask,
+               dict_t *xdata)
+{
+        upcall_cache_access (this, frame, loc->inode);
+
+        STACK_WIND (frame, default_access_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->access, loc, mask, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_readlink (call_frame_t *frame, xlator_t *this, loc_t *loc, size_t size,
+                 dict_t *xdata)
+{
+        upcall_cache_access (this, frame, loc->inode);
+
+        STACK_WIND (frame, default_readlink_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->readlink, loc, size, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_open (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
+             fd_t *fd, dict_t *xdata)
+{
+        upcall_cache_access (this, frame, loc->inode);
+
+        STACK_WIND (frame, default_open_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->open, loc, flags, fd, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
+              off_t offset, uint32_t flags, dict_t *xdata)
+{
+        upcall_cache_access (this, frame, fd->inode);
+
+        STACK_WIND (frame, default_readv_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->readv, fd, size, offset, flags,
+                    xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_getxattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                 const char *name, dict_t *xdata)
+{
+        upcall_cache_access (this, frame, loc->inode);
+
+        STACK_WIND (frame, default_getxattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->getxattr, loc, name, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_fgetxattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                  const char *name, dict_t *xdata)
+{
+        upcall_cache_access (this, frame, fd->inode);
+
+        STACK_WIND (frame, default_fgetxattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->fgetxattr, fd, name, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_readdir (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
+                off_t off, dict_t *xdata)
+{
+        upcall_cache_access (this, frame, fd->inode);
+
+        STACK_WIND (frame, default_readdir_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->readdir, fd, size, off, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_readdirp_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, gf_dirent_t *entries,
+                     dict_t *xdata)
+{
+        gf_dirent_t *entry = NULL;
+
+        if (op_ret <= 0)
+                goto unwind;
+
+        /* the attributes of the entries get cached too */
+        list_for_each_entry (entry, &entries->list, list) {
+                if (entry->inode)
+                        upcall_cache_access (this, frame, entry->inode);
+        }
+unwind:
+        UPCALL_STACK_UNWIND (readdirp, frame, op_ret, op_errno, entries,
+                             xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_readdirp (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
+                 off_t off, dict_t *xdata)
+{
+        upcall_cache_access (this, frame, fd->inode);
+
+        STACK_WIND (frame, upcall_readdirp_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->readdirp, fd, size, off, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                   struct iatt *postbuf, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local)
+                upcall_cache_invalidate (this, frame, local->inode,
+                                         UP_DATA | UP_ATTR);
+
+        UPCALL_STACK_UNWIND (writev, frame, op_ret, op_errno, prebuf, postbuf,
+                             xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
+               struct iovec *vector, int32_t count, off_t offset,
+               uint32_t flags, struct iobref *iobref, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, fd->inode, NULL, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_writev_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->writev, fd, vector, count,
+                    offset, flags, iobref, xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (writev, frame, -1, ENOMEM, NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                     struct iatt *postbuf, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local)
+                upcall_cache_invalidate (this, frame, local->inode,
+                                         UP_DATA | UP_ATTR);
+
+        UPCALL_STACK_UNWIND (truncate, frame, op_ret, op_errno, prebuf,
+                             postbuf, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                 off_t offset, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, loc->inode, NULL, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_truncate_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->truncate, loc, offset, xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (truncate, frame, -1, ENOMEM, NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                      struct iatt *postbuf, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local)
+                upcall_cache_invalidate (this, frame, local->inode,
+                                         UP_DATA | UP_ATTR);
+
+        UPCALL_STACK_UNWIND (ftruncate, frame, op_ret, op_errno, prebuf,
+                             postbuf, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                  off_t offset, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, fd->inode, NULL, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_ftruncate_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->ftruncate, fd, offset, xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (ftruncate, frame, -1, ENOMEM, NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_setattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, struct iatt *statpre,
+                    struct iatt *statpost, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local)
+                upcall_cache_invalidate (this, frame, local->inode, UP_ATTR);
+
+        UPCALL_STACK_UNWIND (setattr, frame, op_ret, op_errno, statpre,
+                             statpost, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_setattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                struct iatt *stbuf, int32_t valid, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, loc->inode, NULL, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_setattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->setattr, loc, stbuf, valid,
+                    xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (setattr, frame, -1, ENOMEM, NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_fsetattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, struct iatt *statpre,
+                     struct iatt *statpost, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local)
+                upcall_cache_invalidate (this, frame, local->inode, UP_ATTR);
+
+        UPCALL_STACK_UNWIND (fsetattr, frame, op_ret, op_errno, statpre,
+                             statpost, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_fsetattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                 struct iatt *stbuf, int32_t valid, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, fd->inode, NULL, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_fsetattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->fsetattr, fd, stbuf, valid,
+                    xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (fsetattr, frame, -1, ENOMEM, NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local)
+                upcall_cache_invalidate (this, frame, local->inode,
+                                         UP_XATTR | UP_ATTR);
+
+        UPCALL_STACK_UNWIND (setxattr, frame, op_ret, op_errno, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_setxattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                 dict_t *dict, int32_t flags, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, loc->inode, NULL, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_setxattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->setxattr, loc, dict, flags,
+                    xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (setxattr, frame, -1, ENOMEM, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_fsetxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local)
+                upcall_cache_invalidate (this, frame, local->inode,
+                                         UP_XATTR | UP_ATTR);
+
+        UPCALL_STACK_UNWIND (fsetxattr, frame, op_ret, op_errno, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_fsetxattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                  dict_t *dict, int32_t flags, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, fd->inode, NULL, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_fsetxattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->fsetxattr, fd, dict, flags,
+                    xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (fsetxattr, frame, -1, ENOMEM, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_removexattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local)
+                upcall_cache_invalidate (this, frame, local->inode,
+                                         UP_XATTR | UP_ATTR);
+
+        UPCALL_STACK_UNWIND (removexattr, frame, op_ret, op_errno, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_removexattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                    const char *name, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, loc->inode, NULL, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_removexattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->removexattr, loc, name, xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (removexattr, frame, -1, ENOMEM, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_fremovexattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local)
+                upcall_cache_invalidate (this, frame, local->inode,
+                                         UP_XATTR | UP_ATTR);
+
+        UPCALL_STACK_UNWIND (fremovexattr, frame, op_ret, op_errno, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_fremovexattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                     const char *name, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, fd->inode, NULL, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_fremovexattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->fremovexattr, fd, name, xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (fremovexattr, frame, -1, ENOMEM, NULL);
+        return 0;
+}
+
+
+/* a new entry: the parent changed, the creator caches the new inode */
+static void
+upcall_cache_entry_created (xlator_t *this, call_frame_t *frame,
+                            inode_t *inode)
+{
+        upcall_local_t *local = frame->local;
+
+        if (!local)
+                return;
+
+        upcall_cache_invalidate (this, frame, local->parent,
+                                 UP_ENTRY | UP_ATTR);
+        upcall_cache_access (this, frame, inode);
+}
+
+
+int32_t
+upcall_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, fd_t *fd, inode_t *inode,
+                   struct iatt *buf, struct iatt *preparent,
+                   struct iatt *postparent, dict_t *xdata)
+{
+        if (op_ret >= 0)
+                upcall_cache_entry_created (this, frame, inode);
+
+        UPCALL_STACK_UNWIND (create, frame, op_ret, op_errno, fd, inode, buf,
+                             preparent, postparent, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_create (call_frame_t *frame, xlator_t *this, loc_t *loc,
+               int32_t flags, mode_t mode, mode_t umask, fd_t *fd,
+               dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, NULL, loc->parent, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_create_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->create, loc, flags, mode, umask,
+                    fd, xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (create, frame, -1, ENOMEM, NULL, NULL, NULL,
+                             NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, inode_t *inode,
+                  struct iatt *buf, struct iatt *preparent,
+                  struct iatt *postparent, dict_t *xdata)
+{
+        if (op_ret >= 0)
+                upcall_cache_entry_created (this, frame, inode);
+
+        UPCALL_STACK_UNWIND (mknod, frame, op_ret, op_errno, inode, buf,
+                             preparent, postparent, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_mknod (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
+              dev_t rdev, mode_t umask, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, NULL, loc->parent, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_mknod_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->mknod, loc, mode, rdev, umask,
+                    xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (mknod, frame, -1, ENOMEM, NULL, NULL, NULL, NULL,
+                             NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, inode_t *inode,
+                  struct iatt *buf, struct iatt *preparent,
+                  struct iatt *postparent, dict_t *xdata)
+{
+        if (op_ret >= 0)
+                upcall_cache_entry_created (this, frame, inode);
+
+        UPCALL_STACK_UNWIND (mkdir, frame, op_ret, op_errno, inode, buf,
+                             preparent, postparent, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
+              mode_t umask, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, NULL, loc->parent, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_mkdir_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->mkdir, loc, mode, umask, xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (mkdir, frame, -1, ENOMEM, NULL, NULL, NULL, NULL,
+                             NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_symlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, inode_t *inode,
+                    struct iatt *buf, struct iatt *preparent,
+                    struct iatt *postparent, dict_t *xdata)
+{
+        if (op_ret >= 0)
+                upcall_cache_entry_created (this, frame, inode);
+
+        UPCALL_STACK_UNWIND (symlink, frame, op_ret, op_errno, inode, buf,
+                             preparent, postparent, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_symlink (call_frame_t *frame, xlator_t *this, const char *linkpath,
+                loc_t *loc, mode_t umask, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, NULL, loc->parent, NULL, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_symlink_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->symlink, linkpath, loc, umask,
+                    xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (symlink, frame, -1, ENOMEM, NULL, NULL, NULL,
+                             NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_link_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                 int32_t op_ret, int32_t op_errno, inode_t *inode,
+                 struct iatt *buf, struct iatt *preparent,
+                 struct iatt *postparent, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local) {
+                /* one more link to the inode */
+                upcall_cache_invalidate (this, frame, local->inode, UP_ATTR);
+                upcall_cache_invalidate (this, frame, local->newparent,
+                                         UP_ENTRY | UP_ATTR);
+        }
+
+        UPCALL_STACK_UNWIND (link, frame, op_ret, op_errno, inode, buf,
+                             preparent, postparent, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_link (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+             loc_t *newloc, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, oldloc->inode, NULL,
+                               newloc->parent, NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_link_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->link, oldloc, newloc, xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (link, frame, -1, ENOMEM, NULL, NULL, NULL, NULL,
+                             NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, struct iatt *preparent,
+                   struct iatt *postparent, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local) {
+                /* the link count of the inode changed, it may be gone */
+                upcall_cache_invalidate (this, frame, local->inode, UP_ATTR);
+                upcall_cache_invalidate (this, frame, local->parent,
+                                         UP_ENTRY | UP_ATTR);
+        }
+
+        UPCALL_STACK_UNWIND (unlink, frame, op_ret, op_errno, preparent,
+                             postparent, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc, int xflag,
+               dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, loc->inode, loc->parent, NULL,
+                               NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_unlink_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->unlink, loc, xflag, xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (unlink, frame, -1, ENOMEM, NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_rmdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, struct iatt *preparent,
+                  struct iatt *postparent, dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local) {
+                upcall_cache_invalidate (this, frame, local->inode,
+                                         UP_FORGET);
+                upcall_cache_invalidate (this, frame, local->parent,
+                                         UP_ENTRY | UP_ATTR);
+        }
+
+        UPCALL_STACK_UNWIND (rmdir, frame, op_ret, op_errno, preparent,
+                             postparent, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc, int xflag,
+              dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, loc->inode, loc->parent, NULL,
+                               NULL))
+                goto err;
+
+        STACK_WIND (frame, upcall_rmdir_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->rmdir, loc, xflag, xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (rmdir, frame, -1, ENOMEM, NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, struct iatt *buf,
+                   struct iatt *preoldparent, struct iatt *postoldparent,
+                   struct iatt *prenewparent, struct iatt *postnewparent,
+                   dict_t *xdata)
+{
+        upcall_local_t *local = frame->local;
+
+        if ((op_ret >= 0) && local) {
+                upcall_cache_invalidate (this, frame, local->inode, UP_ATTR);
+                upcall_cache_invalidate (this, frame, local->parent,
+                                         UP_ENTRY | UP_ATTR);
+                if (local->newparent != local->parent)
+                        upcall_cache_invalidate (this, frame,
+                                                 local->newparent,
+                                                 UP_ENTRY | UP_ATTR);
+                if (local->target)
+                        upcall_cache_invalidate (this, frame, local->target,
+                                                 UP_ATTR);
+        }
+
+        UPCALL_STACK_UNWIND (rename, frame, op_ret, op_errno, buf,
+                             preoldparent, postoldparent, prenewparent,
+                             postnewparent, xdata);
+        return 0;
+}
+
+
+int32_t
+upcall_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+               loc_t *newloc, dict_t *xdata)
+{
+        if (upcall_local_init (this, frame, oldloc->inode, oldloc->parent,
+                               newloc->parent, newloc->inode))
+                goto err;
+
+        STACK_WIND (frame, upcall_rename_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->rename, oldloc, newloc, xdata);
+        return 0;
+err:
+        UPCALL_STACK_UNWIND (rename, frame, -1, ENOMEM, NULL, NULL, NULL,
+                             NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+upcall_forget (xlator_t *this, inode_t *inode)
+{
+        upcall_private_t   *priv  = NULL;
+        upcall_inode_ctx_t *ctx   = NULL;
+        upcall_client_t    *each  = NULL;
+        upcall_client_t    *tmp   = NULL;
+        uint64_t            value = 0;
+
+        priv = this->private;
+
+        if (inode_ctx_del (inode, this, &value))
+                goto out;
+
+        ctx = (upcall_inode_ctx_t *)(long) value;
+        if (!ctx)
+                goto out;
+
+        LOCK (&priv->lock);
+        {
+                list_del_init (&ctx->inode_ctxs);
+        }
+        UNLOCK (&priv->lock);
+
+        list_for_each_entry_safe (each, tmp, &ctx->clients, list) {
+                list_del (&each->list);
+                GF_FREE (each);
+        }
+
+        LOCK_DESTROY (&ctx->lock);
+        GF_FREE (ctx);
+out:
+        return 0;
+}
+
+
+/* protocol/server destroyed the connection @client, forget it on every
+   inode before its address gets reused */
+static void
+upcall_client_destroy (xlator_t *this, void *client)
+{
+        upcall_private_t   *priv = NULL;
+        upcall_inode_ctx_t *ctx  = NULL;
+        upcall_client_t    *each = NULL;
+        upcall_client_t    *tmp  = NULL;
+
+        priv = this->private;
+
+        LOCK (&priv->lock);
+        {
+                list_for_each_entry (ctx, &priv->inode_ctxs, inode_ctxs) {
+                        LOCK (&ctx->lock);
+                        {
+                                list_for_each_entry_safe (each, tmp,
+                                                          &ctx->clients,
+                                                          list) {
+                                        if (each->client != client)
+                                                continue;
+
+                                        list_del (&each->list);
+                                        GF_FREE (each);
+                                }
+                        }
+                        UNLOCK (&ctx->lock);
+                }
+        }
+        UNLOCK (&priv->lock);
+}
+
+
+int32_t
+upcall_priv_dump (xlator_t *this)
+{
+        upcall_private_t *priv = NULL;
+        char              key_prefix[GF_DUMP_MAX_BUF_LEN];
+
+        priv = this->private;
+        if (!priv)
+                return 0;
+
+        gf_proc_dump_build_key (key_prefix, "xlator.features.upcall",
+                                "priv");
+
+        gf_proc_dump_add_section (key_prefix);
+
+        gf_proc_dump_write ("cache_invalidation", "%d",
+                            priv->cache_invalidation);
+        gf_proc_dump_write ("cache_invalidation_timeout", "%d",
+                            priv->timeout);
+        gf_proc_dump_write ("notifications", "%"PRIu64,
+                            priv->notifications);
+
+        return 0;
+}
+
+
+int32_t
+upcall_inodectx_dump (xlator_t *this, inode_t *inode)
+{
+        upcall_inode_ctx_t *ctx   = NULL;
+        upcall_client_t    *each  = NULL;
+        char                key_prefix[GF_DUMP_MAX_BUF_LEN];
+        char                key[GF_DUMP_MAX_BUF_LEN];
+        int                 count = 0;
+
+        ctx = upcall_inode_ctx_get (this, inode, _gf_false);
+        if (!ctx)
+                return 0;
+
+        gf_proc_dump_build_key (key_prefix, "xlator.features.upcall",
+                                "inode");
+
+        gf_proc_dump_add_section (key_prefix);
+
+        LOCK (&ctx->lock);
+        {
+                list_for_each_entry (each, &ctx->clients, list) {
+                        snprintf (key, sizeof (key), "client.%d", count++);
+                        gf_proc_dump_write (key, "%p (accessed at %ld)",
+                                            each->client,
+                                            (long) each->access_time);
+                }
+        }
+        UNLOCK (&ctx->lock);
+
+        return 0;
+}
+
+
+int32_t
+mem_acct_init (xlator_t *this)
+{
+        int ret = -1;
+
+        if (!this)
+                return ret;
+
+        ret = xlator_mem_acct_init (this, gf_upcall_mt_end + 1);
+
+        if (ret != 0)
+                gf_log (this->name, GF_LOG_ERROR, "Memory accounting init "
+                        "failed");
+
+        return ret;
+}
+
+
+int
+notify (xlator_t *this, int32_t event, void *data, ...)
+{
+        if ((event == GF_EVENT_CLIENT_DESTROY) && this->private)
+                upcall_client_destroy (this, data);
+
+        return default_notify (this, event, data);
+}
+
+
+int
+reconfigure (xlator_t *this, dict_t *options)
+{
+        upcall_private_t *priv = NULL;
+        int               ret  = -1;
+
+        priv = this->private;
+
+        GF_OPTION_RECONF ("cache-invalidation", priv->cache_invalidation,
+                          options, bool, out);
+
+        GF_OPTION_RECONF ("cache-invalidation-timeout", priv->timeout,
+                          options, int32, out);
+
+        ret = 0;
+out:
+        return ret;
+}
+
+
+int
+init (xlator_t *this)
+{
+        upcall_private_t *priv = NULL;
+        int               ret  = -1;
+
+        if (!this->children || this->children->next) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "'upcall' not configured with exactly one child");
+                goto out;
+        }
+
+        if (!this->parents) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "dangling volume. check volfile ");
+        }
+
+        priv = GF_CALLOC (1, sizeof (*priv), gf_upcall_mt_private_t);
+        if (!priv)
+                goto out;
+
+        GF_OPTION_INIT ("cache-invalidation", priv->cache_invalidation, bool,
+                        out);
+
+        GF_OPTION_INIT ("cache-invalidation-timeout", priv->timeout, int32,
+                        out);
+
+        INIT_LIST_HEAD (&priv->inode_ctxs);
+        LOCK_INIT (&priv->lock);
+
+        this->local_pool = mem_pool_new (upcall_local_t, 512);
+        if (!this->local_pool) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "failed to create local_t's memory pool");
+                goto out;
+        }
+
+        this->private = priv;
+        ret = 0;
+out:
+        if (ret)
+                GF_FREE (priv);
+
+        return ret;
+}
+
+
+void
+fini (xlator_t *this)
+{
+        upcall_private_t *priv = NULL;
+
+        priv = this->private;
+        if (!priv)
+                return;
+
+        this->private = NULL;
+        LOCK_DESTROY (&priv->lock);
+        GF_FREE (priv);
+
+        if (this->local_pool) {
+                mem_pool_destroy (this->local_pool);
+                this->local_pool = NULL;
+        }
+}
+
+
+struct xlator_fops fops = {
+        .lookup       = upcall_lookup,
+        .stat         = upcall_stat,
+        .fstat        = upcall_fstat,
+        .access       = upcall_access,
+        .readlink     = upcall_readlink,
+        .open         = upcall_open,
+        .readv        = upcall_readv,
+        .getxattr     = upcall_getxattr,
+        .fgetxattr    = upcall_fgetxattr,
+        .readdir      = upcall_readdir,
+        .readdirp     = upcall_readdirp,
+        .writev       = upcall_writev,
+        .truncate     = upcall_truncate,
+        .ftruncate    = upcall_ftruncate,
+        .setattr      = upcall_setattr,
+        .fsetattr     = upcall_fsetattr,
+        .setxattr     = upcall_setxattr,
+        .fsetxattr    = upcall_fsetxattr,
+        .removexattr  = upcall_removexattr,
+        .fremovexattr = upcall_fremovexattr,
+        .create       = upcall_create,
+        .mknod        = upcall_mknod,
+        .mkdir        = upcall_mkdir,
+        .symlink      = upcall_symlink,
+        .link         = upcall_link,
+        .unlink       = upcall_unlink,
+        .rmdir        = upcall_rmdir,
+        .rename       = upcall_rename,
+};
+
+
+struct xlator_cbks cbks = {
+        .forget       = upcall_forget,
+};
+
+
+struct xlator_dumpops dumpops = {
+        .priv         = upcall_priv_dump,
+        .inodectx     = upcall_inodectx_dump,
+};
+
+
+struct volume_options options[] = {
+        { .key  = {"cache-invalidation"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Send cache invalidation notifications to the "
+                         "clients which accessed a file or directory when "
+                         "another client modifies it."
+        },
+        { .key  = {"cache-invalidation-timeout"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 0,
+          .max  = 600,
+          .default_value = "60",
+          .description = "Clients which did not access a file or directory "
+                         "for longer than this many seconds are not sent "
+                         "its invalidations any more. The cache timeouts "
+                         "of the clients should not be above it."
+        },
+        { .key  = {NULL} },
+};
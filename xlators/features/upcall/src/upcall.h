@@ -0,0 +1,72 @@
+/*
+   Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+
+#ifndef __UPCALL_H__
+#define __UPCALL_H__
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "xlator.h"
+#include "defaults.h"
+#include "upcall-utils.h"
+#include "upcall-mem-types.h"
+
+/*
+ * features/upcall sits on the bricks and remembers, per inode, which
+ * clients looked at it lately. When the inode is modified, every other
+ * such client is sent a cache invalidation (GF_EVENT_UPCALL, turned into
+ * a GF_CBK_CACHE_INVALIDATION callback by protocol/server) and forgotten
+ * until it looks at the inode again. The clients are forgotten everywhere
+ * when protocol/server destroys their connection (GF_EVENT_CLIENT_DESTROY).
+ */
+
+typedef struct upcall_client {
+        struct list_head  list;
+        void             *client;       /* frame->root->trans, valid until
+                                           GF_EVENT_CLIENT_DESTROY */
+        time_t            access_time;
+} upcall_client_t;
+
+typedef struct upcall_inode_ctx {
+        struct list_head  inode_ctxs;   /* in upcall_private_t */
+        struct list_head  clients;
+        gf_lock_t         lock;
+} upcall_inode_ctx_t;
+
+typedef struct upcall_private {
+        gf_boolean_t      cache_invalidation;
+        int32_t           timeout;      /* clients idle for longer than
+                                           this are forgotten */
+        uint64_t          notifications;
+        struct list_head  inode_ctxs;   /* to forget destroyed clients */
+        gf_lock_t         lock;
+} upcall_private_t;
+
+typedef struct upcall_local {
+        inode_t          *inode;
+        inode_t          *parent;
+        inode_t          *newparent;
+        inode_t          *target;       /* replaced by a rename */
+} upcall_local_t;
+
+#define UPCALL_STACK_UNWIND(fop, frame, params ...) do {                \
+                upcall_local_t *__local = NULL;                         \
+                if (frame) {                                            \
+                        __local = frame->local;                         \
+                        frame->local = NULL;                            \
+                }                                                       \
+                STACK_UNWIND_STRICT (fop, frame, params);               \
+                upcall_local_wipe (__local);                            \
+        } while (0)
+
+#endif /* __UPCALL_H__ */
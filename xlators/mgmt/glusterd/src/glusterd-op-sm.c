@@ -3524,6 +3524,10 @@ glusterd_defrag_volume_node_rsp (dict_t *req_dict, dict_t *rsp_dict,
                 gf_log (THIS->name, GF_LOG_ERROR,
                         "failed to set run-time");
 
+        if (volinfo->rebalance_subvols)
+                glusterd_defrag_subvols_copy (op_ctx, i,
+                                              volinfo->rebalance_subvols, 0);
+
 out:
         return ret;
 }
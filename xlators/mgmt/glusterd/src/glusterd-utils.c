@@ -673,6 +673,8 @@ glusterd_volinfo_delete (glusterd_volinfo_t *volinfo)
                 dict_unref (volinfo->dict);
         if (volinfo->gsync_slaves)
                 dict_unref (volinfo->gsync_slaves);
+        if (volinfo->rebalance_subvols)
+                dict_unref (volinfo->rebalance_subvols);
         GF_FREE (volinfo->logdir);
 
         glusterd_auth_cleanup (volinfo);
@@ -5488,6 +5490,10 @@ glusterd_volinfo_reset_defrag_stats (glusterd_volinfo_t *volinfo)
         volinfo->rebalance_failures = 0;
         volinfo->rebalance_time = 0;
 
+        if (volinfo->rebalance_subvols) {
+                dict_unref (volinfo->rebalance_subvols);
+                volinfo->rebalance_subvols = NULL;
+        }
 }
 
 /* Return hostname for given uuid if it exists
@@ -5577,6 +5583,7 @@ glusterd_defrag_volume_status_update (glusterd_volinfo_t *volinfo,
         uint64_t                        failures = 0;
         xlator_t                       *this = NULL;
         double                          run_time = 0;
+        dict_t                         *subvols = NULL;
 
         this = THIS;
 
@@ -5623,6 +5630,105 @@ glusterd_defrag_volume_status_update (glusterd_volinfo_t *volinfo,
         if (run_time)
                 volinfo->rebalance_time = run_time;
 
+        if (dict_get (rsp_dict, "subvol-count")) {
+                subvols = dict_new ();
+                if (subvols &&
+                    !glusterd_defrag_subvols_copy (subvols, 0, rsp_dict, 0)) {
+                        if (volinfo->rebalance_subvols)
+                                dict_unref (volinfo->rebalance_subvols);
+                        volinfo->rebalance_subvols = subvols;
+                        subvols = NULL;
+                }
+                if (subvols)
+                        dict_unref (subvols);
+        }
+
+        return ret;
+}
+
+static void
+glusterd_defrag_subvol_key (char *key, size_t len, char *name, int32_t node,
+                            int32_t subvol)
+{
+        if (node)
+                snprintf (key, len, "subvol-%s-%d-%d", name, node, subvol);
+        else
+                snprintf (key, len, "subvol-%s-%d", name, subvol);
+}
+
+/* Copy the per subvolume rebalance counters of one node. A node index
+ * of 0 stands for the keys of a rebalance process status, which carry
+ * no node index. */
+int
+glusterd_defrag_subvols_copy (dict_t *dst, int32_t dst_node, dict_t *src,
+                              int32_t src_node)
+{
+        char            *uint64_keys[] = {"files", "size", "failures", NULL};
+        char             key[256]      = {0,};
+        char            *name          = NULL;
+        uint64_t         value         = 0;
+        double           run_time      = 0;
+        int32_t          count         = 0;
+        int32_t          i             = 0;
+        int              j             = 0;
+        int              ret           = -1;
+
+        if (src_node)
+                snprintf (key, sizeof (key), "subvol-count-%d", src_node);
+        else
+                snprintf (key, sizeof (key), "subvol-count");
+        ret = dict_get_int32 (src, key, &count);
+        if (ret)
+                goto out;
+
+        for (i = 0; i < count; i++) {
+                glusterd_defrag_subvol_key (key, sizeof (key), "name",
+                                            src_node, i);
+                ret = dict_get_str (src, key, &name);
+                if (ret)
+                        goto out;
+                glusterd_defrag_subvol_key (key, sizeof (key), "name",
+                                            dst_node, i);
+                ret = dict_set_dynstr (dst, key, gf_strdup (name));
+                if (ret)
+                        goto out;
+
+                for (j = 0; uint64_keys[j]; j++) {
+                        glusterd_defrag_subvol_key (key, sizeof (key),
+                                                    uint64_keys[j], src_node,
+                                                    i);
+                        ret = dict_get_uint64 (src, key, &value);
+                        if (ret)
+                                goto out;
+                        glusterd_defrag_subvol_key (key, sizeof (key),
+                                                    uint64_keys[j], dst_node,
+                                                    i);
+                        ret = dict_set_uint64 (dst, key, value);
+                        if (ret)
+                                goto out;
+                }
+
+                glusterd_defrag_subvol_key (key, sizeof (key), "run-time",
+                                            src_node, i);
+                ret = dict_get_double (src, key, &run_time);
+                if (ret)
+                        goto out;
+                glusterd_defrag_subvol_key (key, sizeof (key), "run-time",
+                                            dst_node, i);
+                ret = dict_set_double (dst, key, run_time);
+                if (ret)
+                        goto out;
+        }
+
+        if (dst_node)
+                snprintf (key, sizeof (key), "subvol-count-%d", dst_node);
+        else
+                snprintf (key, sizeof (key), "subvol-count");
+        ret = dict_set_int32 (dst, key, count);
+out:
+        if (ret)
+                gf_log (THIS->name, GF_LOG_DEBUG, "failed to copy per "
+                        "subvolume rebalance status");
         return ret;
 }
 
@@ -6300,6 +6406,11 @@ glusterd_volume_rebalance_use_rsp_dict (dict_t *aggr, dict_t *rsp_dict)
                 }
         }
 
+        memset (key, 0, 256);
+        snprintf (key, 256, "subvol-count-%d", index);
+        if (dict_get (rsp_dict, key))
+                glusterd_defrag_subvols_copy (ctx_dict, i, rsp_dict, index);
+
         ret = 0;
 
 out:
@@ -435,6 +435,10 @@ int
 glusterd_defrag_volume_status_update (glusterd_volinfo_t *volinfo,
                                       dict_t *rsp_dict);
 
+int
+glusterd_defrag_subvols_copy (dict_t *dst, int32_t dst_node, dict_t *src,
+                              int32_t src_node);
+
 int
 glusterd_check_files_identical (char *filename1, char *filename2,
                                 gf_boolean_t *identical);
@@ -108,6 +108,9 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"cluster.rebalance-stats",              "cluster/distribute", NULL, NULL, NO_DOC, 0, 2},
         {"cluster.subvols-per-directory",        "cluster/distribute", "directory-layout-spread", NULL, NO_DOC, 0, 2},
         {"cluster.readdir-optimize",             "cluster/distribute", NULL, NULL, NO_DOC, 0, 2},
+        {"cluster.rebalance-workers",            "cluster/distribute", NULL, NULL, DOC, 0, 2},
+        {"cluster.rebalance-rate-limit",         "cluster/distribute", NULL, NULL, DOC, 0, 2},
+        {"cluster.rebalance-inflight-limit",     "cluster/distribute", NULL, NULL, DOC, 0, 2},
 
         /* AFR xlator options */
         {"cluster.entry-change-log",             "cluster/replicate",  NULL, NULL, NO_DOC, 0, 1},
@@ -120,11 +123,14 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"cluster.entry-self-heal",              "cluster/replicate",  NULL, NULL, NO_DOC, 0, 1},
         {"cluster.self-heal-daemon",             "cluster/replicate",  "!self-heal-daemon" , NULL, NO_DOC, 0, 1},
         {"cluster.heal-timeout",                 "cluster/replicate",  "!heal-timeout" , NULL, NO_DOC, 0, 2},
+        {"cluster.shd-max-heals",                "cluster/replicate",  "!shd-max-heals" , NULL, DOC, 0, 2},
         {"cluster.strict-readdir",               "cluster/replicate",  NULL, NULL, NO_DOC, 0, 1},
         {"cluster.self-heal-window-size",        "cluster/replicate",  "data-self-heal-window-size", NULL, DOC, 0, 1},
         {"cluster.data-change-log",              "cluster/replicate",  NULL, NULL, NO_DOC, 0, 1},
         {"cluster.metadata-change-log",          "cluster/replicate",  NULL, NULL, NO_DOC, 0, 1},
         {"cluster.data-self-heal-algorithm",     "cluster/replicate",  "data-self-heal-algorithm", NULL, DOC, 0, 1},
+        {"cluster.data-self-heal-checksum",      "cluster/replicate",  "data-self-heal-checksum", NULL, DOC, 0, 2},
+        {"cluster.data-self-heal-dirty-blocks",  "cluster/replicate",  "data-self-heal-dirty-blocks", NULL, DOC, 0, 2},
         {"cluster.eager-lock",                   "cluster/replicate",  NULL, NULL, NO_DOC, 0, 1},
         {"cluster.quorum-type",                  "cluster/replicate",  "quorum-type", NULL, NO_DOC, 0, 1},
         {"cluster.quorum-count",                 "cluster/replicate",  "quorum-count", NULL, NO_DOC, 0, 1},
@@ -165,11 +171,13 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
 
         {"performance.flush-behind",             "performance/write-behind",  "flush-behind", NULL, DOC, 0, 1},
         {"performance.write-behind-window-size", "performance/write-behind",  "cache-size", NULL, DOC, 1},
+        {"performance.write-behind-aggregate-size", "performance/write-behind", "aggregate-size", NULL, DOC, 0, 2},
         {"performance.strict-o-direct",          "performance/write-behind",  "strict-O_DIRECT", NULL, DOC, 2},
         {"performance.strict-write-ordering",    "performance/write-behind",  "strict-write-ordering", NULL, DOC, 2},
 
         {"performance.read-ahead-page-count",    "performance/read-ahead",    "page-count", NULL, DOC, 1},
         {"performance.md-cache-timeout",         "performance/md-cache",      "md-cache-timeout", NULL, DOC, 0, 2},
+        {"performance.md-cache-xattrs",          "performance/md-cache",      "cache-xattrs", NULL, DOC, 0, 2},
 
         /* Client xlator options */
         {"network.frame-timeout",                "protocol/client",           NULL, NULL, NO_DOC, 0, 1},
@@ -178,6 +186,7 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"features.lock-heal",                   "protocol/client",           "lk-heal", NULL, DOC, 0, 1},
         {"features.grace-timeout",               "protocol/client",           "grace-timeout", NULL, DOC, 0, 1},
         {"client.ssl",                           "protocol/client",           "transport.socket.ssl-enabled", NULL, NO_DOC, 0, 2},
+        {"client.event-threads",                 "protocol/client",           "event-threads", NULL, DOC, 0, 2},
 
         /* Server xlator options */
         {"network.tcp-window-size",              "protocol/server",           NULL, NULL, NO_DOC, 0, 1},
@@ -190,6 +199,7 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"features.lock-heal",                   "protocol/server",           "lk-heal", NULL, NO_DOC, 0, 1},
         {"features.grace-timeout",               "protocol/server",           "grace-timeout", NULL, NO_DOC, 0, 1},
         {"server.ssl",                           "protocol/server",           "transport.socket.ssl-enabled", NULL, NO_DOC, 0, 2},
+        {"server.event-threads",                 "protocol/server",           "event-threads", NULL, DOC, 0, 2},
 
         /* Performance xlators enable/disbable options */
         {"performance.write-behind",             "performance/write-behind",  "!perf", "on", NO_DOC, 0, 1},
@@ -246,6 +256,8 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         /* Other options which don't fit any place above */
         {"features.read-only",                   "features/read-only",        "!read-only", "off", DOC, 0, 2},
         {"features.worm",                        "features/worm",             "!worm", "off", DOC, 0, 2},
+        {"features.cache-invalidation",          "features/upcall",           "cache-invalidation", NULL, DOC, 0, 2},
+        {"features.cache-invalidation-timeout",  "features/upcall",           "cache-invalidation-timeout", NULL, DOC, 0, 2},
 
         {"storage.linux-aio",                    "storage/posix",             NULL, NULL, DOC, 0, 2},
         {"storage.owner-uid",                    "storage/posix",             "brick-uid", NULL, DOC, 0, 2},
@@ -1736,6 +1748,16 @@ server_graph_builder (volgen_graph_t *graph, glusterd_volinfo_t *volinfo,
                 }
         }
 
+        /* Check for cache-invalidation volume option, and add upcall to
+           the graph */
+        if (dict_get_str_boolean (set_dict, "features.cache-invalidation", 0)) {
+                xl = volgen_graph_add (graph, "features/upcall", volname);
+                if (!xl) {
+                        ret = -1;
+                        goto out;
+                }
+        }
+
         xl = volgen_graph_add_as (graph, "debug/io-stats", path);
         if (!xl)
                 return -1;
@@ -2558,6 +2580,7 @@ build_client_graph (volgen_graph_t *graph, glusterd_volinfo_t *volinfo,
 char *gd_shd_options[] = {
         "!self-heal-daemon",
         "!heal-timeout",
+        "!shd-max-heals",
         NULL
 };
 
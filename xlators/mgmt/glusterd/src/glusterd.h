@@ -244,6 +244,8 @@ struct glusterd_volinfo_ {
         gf_cli_defrag_type      defrag_cmd;
         uint64_t                rebalance_failures;
         double                  rebalance_time;
+        dict_t                 *rebalance_subvols; /* per subvolume counters
+                                                      of the last status */
 
         /* Replace brick status */
         gf_rb_status_t          rb_status;
@@ -529,34 +529,58 @@ fuse_lookup (xlator_t *this, fuse_in_header_t *finh, void *msg)
 }
 
 static void
-fuse_forget (xlator_t *this, fuse_in_header_t *finh, void *msg)
-
+do_forget (xlator_t *this, uint64_t unique, uint64_t nodeid, uint64_t nlookup)
 {
-        struct fuse_forget_in *ffi = msg;
-
         inode_t      *fuse_inode;
 
-        if (finh->nodeid == 1) {
-                GF_FREE (finh);
+        if (nodeid == 1)
                 return;
-        }
 
         gf_log ("glusterfs-fuse", GF_LOG_TRACE,
                 "%"PRIu64": FORGET %"PRIu64"/%"PRIu64,
-                finh->unique, finh->nodeid, ffi->nlookup);
+                unique, nodeid, nlookup);
 
-        fuse_inode = fuse_ino_to_inode (finh->nodeid, this);
+        fuse_inode = fuse_ino_to_inode (nodeid, this);
 
         fuse_log_eh (this, "%"PRIu64": FORGET %"PRIu64"/%"PRIu64" gfid: (%s)",
-                     finh->unique, finh->nodeid, ffi->nlookup,
-                     uuid_utoa (fuse_inode->gfid));
+                     unique, nodeid, nlookup, uuid_utoa (fuse_inode->gfid));
 
-        inode_forget (fuse_inode, ffi->nlookup);
+        inode_forget (fuse_inode, nlookup);
         inode_unref (fuse_inode);
+}
+
+static void
+fuse_forget (xlator_t *this, fuse_in_header_t *finh, void *msg)
+
+{
+        struct fuse_forget_in *ffi = msg;
+
+        do_forget (this, finh->unique, finh->nodeid, ffi->nlookup);
 
         GF_FREE (finh);
 }
 
+#if FUSE_KERNEL_MINOR_VERSION >= 16
+static void
+fuse_batch_forget (xlator_t *this, fuse_in_header_t *finh, void *msg)
+{
+        struct fuse_batch_forget_in *fbfi = msg;
+        struct fuse_forget_one      *ffo  = (struct fuse_forget_one *)
+                                              (fbfi + 1);
+        int                          i    = 0;
+
+        gf_log ("glusterfs-fuse", GF_LOG_TRACE,
+                "%"PRIu64": BATCH_FORGET %"PRIu64"/%"PRIu32,
+                finh->unique, finh->nodeid, fbfi->count);
+
+        for (i = 0; i < fbfi->count; i++)
+                do_forget (this, finh->unique, ffo[i].nodeid,
+                           ffo[i].nlookup);
+
+        GF_FREE (finh);
+}
+#endif
+
 static int
 fuse_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                    int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
@@ -2134,8 +2158,6 @@ void
 fuse_write_resume (fuse_state_t *state)
 {
         struct iobref *iobref = NULL;
-        struct iobuf  *iobuf = NULL;
-
 
         iobref = iobref_new ();
         if (!iobref) {
@@ -2148,8 +2170,7 @@ fuse_write_resume (fuse_state_t *state)
                 return;
         }
 
-        iobuf = ((fuse_private_t *) (state->this->private))->iobuf;
-        iobref_add (iobref, iobuf);
+        iobref_add (iobref, state->iobuf);
 
         gf_log ("glusterfs-fuse", GF_LOG_TRACE,
                 "%"PRIu64": WRITE (%p, size=%"PRId64", offset=%"PRId64")",
@@ -2172,12 +2193,19 @@ fuse_write (xlator_t *this, fuse_in_header_t *finh, void *msg)
                                       (finh + 1);
 
         fuse_private_t  *priv = NULL;
+        fuse_reader_t   *reader = NULL;
         fuse_state_t    *state = NULL;
         fd_t            *fd = NULL;
 
         priv = this->private;
 
         GET_STATE (this, finh, state);
+
+        /* msg points into the iobuf of the reader which got the request,
+         * hold on to it until the write is done */
+        reader = pthread_getspecific (priv->reader_key);
+        state->iobuf = iobuf_ref (reader->iobuf);
+
         fd          = FH_TO_FD (fwi->fh);
         state->fd   = fd;
         state->size = fwi->size;
@@ -2470,9 +2498,6 @@ fuse_readdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         send_fuse_data (this, finh, buf, size);
 
-        /* TODO: */
-        /* gf_link_inodes_from_dirent (this, state->fd->inode, entries); */
-
 out:
         free_fuse_state (state);
         STACK_DESTROY (frame->root);
@@ -2511,6 +2536,155 @@ fuse_readdir (xlator_t *this, fuse_in_header_t *finh, void *msg)
         fuse_resolve_and_resume (state, fuse_readdir_resume);
 }
 
+#if FUSE_KERNEL_MINOR_VERSION >= 21
+/* Fill in the entry part of a READDIRPLUS record and link the inode, so
+ * that the kernel can skip the LOOKUP it would otherwise send for the
+ * entry. Each record handed out this way counts as one lookup, which the
+ * kernel pays back with a FORGET. Entries we cannot link go out with a
+ * zero nodeid, which the kernel takes as a plain dirent.
+ */
+static void
+fuse_readdirp_fill_entry (xlator_t *this, fuse_state_t *state,
+                          gf_dirent_t *entry, struct fuse_entry_out *feo)
+{
+        fuse_private_t *priv         = NULL;
+        inode_t        *linked_inode = NULL;
+
+        priv = this->private;
+
+        if (!entry->inode || uuid_is_null (entry->d_stat.ia_gfid))
+                return;
+
+        if (!strcmp (entry->d_name, ".") || !strcmp (entry->d_name, ".."))
+                return;
+
+        linked_inode = inode_link (entry->inode, state->fd->inode,
+                                   entry->d_name, &entry->d_stat);
+        if (!linked_inode)
+                return;
+
+        inode_lookup (linked_inode);
+
+        entry->d_stat.ia_blksize = this->ctx->page_size;
+        gf_fuse_stat2attr (&entry->d_stat, &feo->attr, priv->enable_ino32);
+
+        feo->nodeid = inode_to_fuse_nodeid (linked_inode);
+
+        inode_unref (linked_inode);
+
+        feo->entry_valid = calc_timeout_sec (priv->entry_timeout);
+        feo->entry_valid_nsec = calc_timeout_nsec (priv->entry_timeout);
+        feo->attr_valid = calc_timeout_sec (priv->attribute_timeout);
+        feo->attr_valid_nsec = calc_timeout_nsec (priv->attribute_timeout);
+}
+
+static int
+fuse_readdirp_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, gf_dirent_t *entries,
+                   dict_t *xdata)
+{
+        fuse_state_t           *state = NULL;
+        fuse_in_header_t       *finh  = NULL;
+        size_t                  size  = 0;
+        size_t                  len   = 0;
+        char                   *buf   = NULL;
+        gf_dirent_t            *entry = NULL;
+        struct fuse_direntplus *fde   = NULL;
+        fuse_private_t         *priv  = NULL;
+
+        state = frame->root->state;
+        finh  = state->finh;
+        priv = state->this->private;
+
+        fuse_log_eh_fop(this, state, frame, op_ret, op_errno);
+
+        if (op_ret < 0) {
+                gf_log ("glusterfs-fuse", GF_LOG_WARNING,
+                        "%"PRIu64": READDIRP => -1 (%s)", frame->root->unique,
+                        strerror (op_errno));
+
+                send_fuse_err (this, finh, op_errno);
+                goto out;
+        }
+
+        gf_log ("glusterfs-fuse", GF_LOG_TRACE,
+                "%"PRIu64": READDIRP => %d/%"GF_PRI_SIZET",%"PRId64,
+                frame->root->unique, op_ret, state->size, state->off);
+
+        /* Records are larger than what the server sized its reply for,
+         * only send (and link) the entries which fit in the kernel's
+         * buffer. The rest are read again from the last offset sent. */
+        list_for_each_entry (entry, &entries->list, list) {
+                len = FUSE_DIRENT_ALIGN (FUSE_NAME_OFFSET_DIRENTPLUS +
+                                         strlen (entry->d_name));
+                if (size + len > state->size)
+                        break;
+                size += len;
+        }
+
+        buf = GF_CALLOC (1, size, gf_fuse_mt_char);
+        if (size && !buf) {
+                gf_log ("glusterfs-fuse", GF_LOG_DEBUG,
+                        "%"PRIu64": READDIRP => -1 (%s)", frame->root->unique,
+                        strerror (ENOMEM));
+                send_fuse_err (this, finh, ENOMEM);
+                goto out;
+        }
+
+        len = size;
+        size = 0;
+        list_for_each_entry (entry, &entries->list, list) {
+                if (size >= len)
+                        break;
+
+                fde = (struct fuse_direntplus *)(buf + size);
+                gf_fuse_fill_dirent (entry, &fde->dirent,
+                                     priv->enable_ino32);
+                fuse_readdirp_fill_entry (this, state, entry,
+                                          &fde->entry_out);
+                size += FUSE_DIRENTPLUS_SIZE (fde);
+        }
+
+        send_fuse_data (this, finh, buf, size);
+
+out:
+        free_fuse_state (state);
+        STACK_DESTROY (frame->root);
+        GF_FREE (buf);
+        return 0;
+}
+
+void
+fuse_readdirp_resume (fuse_state_t *state)
+{
+        gf_log ("glusterfs-fuse", GF_LOG_TRACE,
+                "%"PRIu64": READDIRP (%p, size=%zu, offset=%"PRId64")",
+                state->finh->unique, state->fd, state->size, state->off);
+
+        FUSE_FOP (state, fuse_readdirp_cbk, GF_FOP_READDIRP,
+                  readdirp, state->fd, state->size, state->off, state->xdata);
+}
+
+static void
+fuse_readdirp (xlator_t *this, fuse_in_header_t *finh, void *msg)
+{
+        struct fuse_read_in *fri = msg;
+
+        fuse_state_t *state = NULL;
+        fd_t         *fd = NULL;
+
+        GET_STATE (this, finh, state);
+        state->size = fri->size;
+        state->off = fri->offset;
+        fd = FH_TO_FD (fri->fh);
+        state->fd = fd;
+
+        fuse_resolve_fd_init (state, &state->resolve, fd);
+
+        fuse_resolve_and_resume (state, fuse_readdirp_resume);
+}
+#endif
+
 static void
 fuse_releasedir (xlator_t *this, fuse_in_header_t *finh, void *msg)
 {
@@ -3472,8 +3646,8 @@ fuse_init (xlator_t *this, fuse_in_header_t *finh, void *msg)
 
         fino.major = FUSE_KERNEL_VERSION;
         fino.minor = FUSE_KERNEL_MINOR_VERSION;
-        fino.max_readahead = 1 << 17;
-        fino.max_write = 1 << 17;
+        fino.max_readahead = priv->max_write;
+        fino.max_write = priv->max_write;
         fino.flags = FUSE_ASYNC_READ | FUSE_POSIX_LOCKS;
 #if FUSE_KERNEL_MINOR_VERSION >= 12
         if (fini->minor >= 12) {
@@ -3534,9 +3708,30 @@ fuse_init (xlator_t *this, fuse_in_header_t *finh, void *msg)
                 fino.congestion_threshold = priv->congestion_threshold;
         }
         if (fini->minor < 9)
-                *priv->msg0_len_p = sizeof(*finh) + FUSE_COMPAT_WRITE_IN_SIZE;
+                priv->msg0_len = sizeof(*finh) + FUSE_COMPAT_WRITE_IN_SIZE;
 #endif
+#if FUSE_KERNEL_MINOR_VERSION >= 21
+        if (priv->use_readdirp && (fini->flags & FUSE_DO_READDIRPLUS))
+                fino.flags |= FUSE_DO_READDIRPLUS;
+#endif
+#if FUSE_KERNEL_MINOR_VERSION >= 28
+        /* without this the kernel caps requests at 32 pages, whatever
+         * max_write says */
+        if (fini->minor >= 28 && (fini->flags & FUSE_MAX_PAGES)) {
+                fino.flags |= FUSE_MAX_PAGES;
+                fino.max_pages = (priv->max_write + getpagesize () - 1) /
+                                 getpagesize ();
+        }
+#endif
+#if FUSE_KERNEL_MINOR_VERSION >= 23
+        if (fini->minor < 23)
+                ret = send_fuse_data (this, finh, &fino,
+                                      FUSE_COMPAT_22_INIT_OUT_SIZE);
+        else
+                ret = send_fuse_obj (this, finh, &fino);
+#else
         ret = send_fuse_obj (this, finh, &fino);
+#endif
         if (ret == 0)
                 gf_log ("glusterfs-fuse", GF_LOG_INFO,
                         "FUSE inited with protocol versions:"
@@ -4140,12 +4335,60 @@ fuse_get_mount_status (xlator_t *this)
         return kid_status;
 }
 
+static uint64_t
+fuse_usec_since (struct timeval *start)
+{
+        struct timeval now  = {0,};
+        struct timeval diff = {0,};
+
+        gettimeofday (&now, NULL);
+        if (!timercmp (&now, start, >))
+                return 0;
+
+        timersub (&now, start, &diff);
+        return (uint64_t) diff.tv_sec * 1000000 + diff.tv_usec;
+}
+
+static void *fuse_thread_proc (void *data);
+
+/* Start the readers beyond the first one. This is done once INIT has been
+ * handled, so that every reader sizes its header buffer for the protocol
+ * version the kernel speaks.
+ */
+static void
+fuse_readers_start (xlator_t *this)
+{
+        fuse_private_t *priv  = NULL;
+        int             i     = 0;
+        int             ret   = 0;
+
+        priv = this->private;
+
+        for (i = 1; i < priv->reader_thread_count; i++) {
+                ret = pthread_create (&priv->readers[i].thread, NULL,
+                                      fuse_thread_proc, &priv->readers[i]);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "failed to start reader thread %d (%s), "
+                                "continuing with %d", i, strerror (ret), i);
+                        priv->reader_thread_count = i;
+                        break;
+                }
+        }
+
+        if (priv->reader_thread_count > 1)
+                gf_log (this->name, GF_LOG_INFO,
+                        "reading /dev/fuse with %d threads",
+                        priv->reader_thread_count);
+}
+
 static void *
 fuse_thread_proc (void *data)
 {
         char                     *mount_point = NULL;
         xlator_t                 *this = NULL;
         fuse_private_t           *priv = NULL;
+        fuse_reader_t            *reader = NULL;
         ssize_t                   res = 0;
         struct iobuf             *iobuf = NULL;
         fuse_in_header_t         *finh;
@@ -4154,18 +4397,27 @@ fuse_thread_proc (void *data)
         const size_t              msg0_size = sizeof (*finh) + 128;
         fuse_handler_t          **fuse_ops = NULL;
         struct pollfd             pfd[2] = {{0,}};
+        struct timeval            start = {0,};
         gf_boolean_t              mount_finished = _gf_false;
+        gf_boolean_t              readers_started = _gf_false;
 
-        this = data;
+        reader = data;
+        this = reader->this;
         priv = this->private;
         fuse_ops = priv->fuse_ops;
 
         THIS = this;
 
-        iov_in[0].iov_len = sizeof (*finh) + sizeof (struct fuse_write_in);
-        iov_in[1].iov_len = ((struct iobuf_pool *)this->ctx->iobuf_pool)
-                              ->default_page_size;
-        priv->msg0_len_p = &iov_in[0].iov_len;
+        pthread_setspecific (priv->reader_key, reader);
+
+        /* The first reader has waited for the mount and handled INIT by
+         * the time the others are started. */
+        if (reader->index > 0) {
+                mount_finished = _gf_true;
+                readers_started = _gf_true;
+        }
+
+        iov_in[1].iov_len = priv->max_write;
 
         for (;;) {
                 /* THIS has to be reset here */
@@ -4206,14 +4458,17 @@ fuse_thread_proc (void *data)
                  * make sure it's ready.
                  */
 
-                if (priv->init_recvd)
+                if (priv->init_recvd) {
+                        if (!readers_started) {
+                                fuse_readers_start (this);
+                                readers_started = _gf_true;
+                        }
                         fuse_graph_sync (this);
+                }
 
-                /* TODO: This place should always get maximum supported buffer
-                   size from 'fuse', which is as of today 128KB. If we bring in
-                   support for higher block sizes support, then we should be
-                   changing this one too */
-                iobuf = iobuf_get (this->ctx->iobuf_pool);
+                /* Big enough for the largest WRITE payload we offered the
+                   kernel in INIT */
+                iobuf = iobuf_get2 (this->ctx->iobuf_pool, priv->max_write);
 
                 /* Add extra 128 byte to the first iov so that it can
                  * accommodate "ordinary" non-write requests. It's not
@@ -4235,9 +4490,12 @@ fuse_thread_proc (void *data)
                         continue;
                 }
 
+                iov_in[0].iov_len = priv->msg0_len;
                 iov_in[1].iov_base = iobuf->ptr;
 
+                gettimeofday (&start, NULL);
                 res = readv (priv->fd, iov_in, 2);
+                reader->idle_usec += fuse_usec_since (&start);
 
                 if (res == -1) {
                         if (errno == ENODEV || errno == EBADF) {
@@ -4291,7 +4549,8 @@ fuse_thread_proc (void *data)
                         break;
                 }
 
-                priv->iobuf = iobuf;
+                reader->iobuf = iobuf;
+                gettimeofday (&start, NULL);
 
                 if (finh->opcode == FUSE_WRITE)
                         msg = iov_in[1].iov_base;
@@ -4329,10 +4588,14 @@ fuse_thread_proc (void *data)
                 else
                         fuse_ops[finh->opcode] (this, finh, msg);
 
+                reader->busy_usec += fuse_usec_since (&start);
+                reader->requests++;
+                reader->iobuf = NULL;
                 iobuf_unref (iobuf);
                 continue;
 
  cont_err:
+                reader->iobuf = NULL;
                 iobuf_unref (iobuf);
                 GF_FREE (iov_in[0].iov_base);
         }
@@ -4343,6 +4606,11 @@ fuse_thread_proc (void *data)
          * we're about to kill ourselves anyway.
          */
 
+        /* All readers see the device go away, one of them is enough to
+         * tear the process down. */
+        if (__sync_fetch_and_add (&priv->readers_exited, 1) > 0)
+                return NULL;
+
         if (dict_get (this->options, ZR_MOUNTPOINT_OPT))
                 mount_point = data_to_str (dict_get (this->options,
                                                      ZR_MOUNTPOINT_OPT));
@@ -4373,6 +4641,10 @@ int32_t
 fuse_priv_dump (xlator_t  *this)
 {
         fuse_private_t  *private = NULL;
+        fuse_reader_t   *reader  = NULL;
+        uint64_t         total   = 0;
+        int              i       = 0;
+        char             key[GF_DUMP_MAX_BUF_LEN] = {0,};
 
         if (!this)
                 return -1;
@@ -4393,10 +4665,10 @@ fuse_priv_dump (xlator_t  *this)
                             private->volfile_size);
         gf_proc_dump_write("mount_point", "%s",
                             private->mount_point);
-        gf_proc_dump_write("iobuf", "%u",
-                            private->iobuf);
         gf_proc_dump_write("fuse_thread_started", "%d",
                             (int)private->fuse_thread_started);
+        gf_proc_dump_write("reader_thread_count", "%d",
+                            private->reader_thread_count);
         gf_proc_dump_write("direct_io_mode", "%d",
                             private->direct_io_mode);
         gf_proc_dump_write("entry_timeout", "%lf",
@@ -4410,6 +4682,22 @@ fuse_priv_dump (xlator_t  *this)
         gf_proc_dump_write("reverse_thread_started", "%d",
                            (int)private->reverse_fuse_thread_started);
 
+        for (i = 0; private->readers && i < private->reader_thread_count;
+             i++) {
+                reader = &private->readers[i];
+                total = reader->busy_usec + reader->idle_usec;
+
+                gf_proc_dump_build_key (key, "reader", "%d.requests", i);
+                gf_proc_dump_write (key, "%"PRIu64, reader->requests);
+                gf_proc_dump_build_key (key, "reader", "%d.busy_usec", i);
+                gf_proc_dump_write (key, "%"PRIu64, reader->busy_usec);
+                gf_proc_dump_build_key (key, "reader", "%d.idle_usec", i);
+                gf_proc_dump_write (key, "%"PRIu64, reader->idle_usec);
+                gf_proc_dump_build_key (key, "reader", "%d.utilization", i);
+                gf_proc_dump_write (key, "%.2lf%%", total ?
+                                    (reader->busy_usec * 100.0) / total : 0);
+        }
+
         return 0;
 }
 
@@ -4537,8 +4825,9 @@ notify (xlator_t *this, int32_t event, void *data, ...)
                 if (!private->fuse_thread_started) {
                         private->fuse_thread_started = 1;
 
-                        ret = pthread_create (&private->fuse_thread, NULL,
-                                              fuse_thread_proc, this);
+                        ret = pthread_create (&private->readers[0].thread,
+                                              NULL, fuse_thread_proc,
+                                              &private->readers[0]);
                         if (ret != 0) {
                                 gf_log (this->name, GF_LOG_DEBUG,
                                         "pthread_create() failed (%s)",
@@ -4625,8 +4914,13 @@ static fuse_handler_t *fuse_std_ops[FUSE_OP_HIGH] = {
      /* [FUSE_IOCTL] */
      /* [FUSE_POLL] */
      /* [FUSE_NOTIFY_REPLY] */
-     /* [FUSE_BATCH_FORGET] */
+#if FUSE_KERNEL_MINOR_VERSION >= 16
+        [FUSE_BATCH_FORGET] = fuse_batch_forget,
+#endif
      /* [FUSE_FALLOCATE] */
+#if FUSE_KERNEL_MINOR_VERSION >= 21
+        [FUSE_READDIRPLUS] = fuse_readdirp,
+#endif
 };
 
 
@@ -4796,6 +5090,9 @@ init (xlator_t *this_xl)
 
         GF_OPTION_INIT ("enable-ino32", priv->enable_ino32, bool, cleanup_exit);
 
+        GF_OPTION_INIT ("use-readdirp", priv->use_readdirp, bool,
+                        cleanup_exit);
+
         priv->fuse_dump_fd = -1;
         ret = dict_get_str (options, "dump-fuse", &value_string);
         if (ret == 0) {
@@ -4861,6 +5158,33 @@ init (xlator_t *this_xl)
                 priv->congestion_threshold = priv->background_qlen;
         }
 
+        GF_OPTION_INIT ("reader-thread-count", priv->reader_thread_count,
+                        int32, cleanup_exit);
+
+        GF_OPTION_INIT ("max-write", priv->max_write, size, cleanup_exit);
+
+        priv->readers = GF_CALLOC (priv->reader_thread_count,
+                                   sizeof (*priv->readers),
+                                   gf_fuse_mt_reader_t);
+        if (!priv->readers) {
+                gf_log ("glusterfs-fuse", GF_LOG_ERROR, "Out of memory");
+                goto cleanup_exit;
+        }
+        for (i = 0; i < priv->reader_thread_count; i++) {
+                priv->readers[i].this  = this_xl;
+                priv->readers[i].index = i;
+        }
+
+        ret = pthread_key_create (&priv->reader_key, NULL);
+        if (ret != 0) {
+                gf_log ("glusterfs-fuse", GF_LOG_ERROR,
+                        "failed to create reader key (%s)", strerror (ret));
+                goto cleanup_exit;
+        }
+
+        priv->msg0_len = sizeof (fuse_in_header_t) +
+                         sizeof (struct fuse_write_in);
+
         cmd_args = &this_xl->ctx->cmd_args;
         fsname = cmd_args->volfile;
         if (!fsname && cmd_args->volfile_server) {
@@ -4892,10 +5216,10 @@ init (xlator_t *this_xl)
 
         if (priv->read_only)
                 mntflags |= MS_RDONLY;
-        gf_asprintf (&mnt_args, "%s%s%sallow_other,max_read=131072",
+        gf_asprintf (&mnt_args, "%s%s%sallow_other,max_read=%"PRIu64,
                      priv->acl ? "" : "default_permissions,",
                      priv->fuse_mountopts ? priv->fuse_mountopts : "",
-                     priv->fuse_mountopts ? "," : "");
+                     priv->fuse_mountopts ? "," : "", priv->max_write);
         if (!mnt_args)
                 goto cleanup_exit;
 
@@ -4949,6 +5273,7 @@ cleanup_exit:
                 GF_FREE (fsname);
         if (priv) {
                 GF_FREE (priv->mount_point);
+                GF_FREE (priv->readers);
                 if (priv->fd != -1)
                         close (priv->fd);
                 if (priv->fuse_dump_fd != -1)
@@ -5061,6 +5386,12 @@ struct volume_options options[] = {
           .type = GF_OPTION_TYPE_BOOL,
           .default_value = "false"
         },
+        { .key = {"use-readdirp"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "yes",
+          .description = "Answer directory reads with READDIRPLUS records "
+                         "when the kernel supports it."
+        },
         { .key  = {"background-qlen"},
           .type = GF_OPTION_TYPE_INT,
           .default_value = "64",
@@ -5076,5 +5407,22 @@ struct volume_options options[] = {
         { .key = {"fuse-mountopts"},
           .type = GF_OPTION_TYPE_STR
         },
+        { .key  = {"max-write"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .default_value = "128KB",
+          .min = 4 * GF_UNIT_KB,
+          .max = 1 * GF_UNIT_MB,
+          .description = "Largest READ and WRITE request the kernel is asked "
+                         "to send. Kernels which do not negotiate the number "
+                         "of pages per request stop at 128KB."
+        },
+        { .key  = {"reader-thread-count"},
+          .type = GF_OPTION_TYPE_INT,
+          .default_value = "1",
+          .min = 1,
+          .max = FUSE_READER_THREADS_MAX,
+          .description = "Number of threads reading and dispatching "
+                         "requests from /dev/fuse."
+        },
         { .key = {NULL} },
 };
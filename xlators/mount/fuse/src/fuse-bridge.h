@@ -48,7 +48,7 @@
 #include "gidcache.h"
 
 #if defined(GF_LINUX_HOST_OS) || defined(__NetBSD__)
-#define FUSE_OP_HIGH (FUSE_POLL + 1)
+#define FUSE_OP_HIGH (FUSE_READDIRPLUS + 1)
 #endif
 #ifdef GF_DARWIN_HOST_OS
 #define FUSE_OP_HIGH (FUSE_DESTROY + 1)
@@ -57,23 +57,48 @@
 
 #define MAX_FUSE_PROC_DELAY 1
 
+#define FUSE_READER_THREADS_MAX 64
+
 typedef struct fuse_in_header fuse_in_header_t;
 typedef void (fuse_handler_t) (xlator_t *this, fuse_in_header_t *finh,
                                void *msg);
 
+/* One thread reading and dispatching requests from /dev/fuse. The
+ * counters are only updated by the reader itself.
+ */
+struct fuse_reader {
+        xlator_t            *this;
+        pthread_t            thread;
+        int                  index;
+
+        /* buffer holding the payload of the request being dispatched */
+        struct iobuf        *iobuf;
+
+        uint64_t             requests;
+        uint64_t             busy_usec;   /* dispatching requests */
+        uint64_t             idle_usec;   /* blocked in readv (2) */
+};
+typedef struct fuse_reader fuse_reader_t;
+
 struct fuse_private {
         int                  fd;
         uint32_t             proto_minor;
         char                *volfile;
         size_t               volfile_size;
         char                *mount_point;
-        struct iobuf        *iobuf;
 
-        pthread_t            fuse_thread;
         char                 fuse_thread_started;
 
+        /* Pool of /dev/fuse readers. The first one waits for the mount
+         * status and handles INIT, the rest are started after that. */
+        fuse_reader_t       *readers;
+        int                  reader_thread_count;
+        pthread_key_t        reader_key;
+        int                  readers_exited;
+
         uint32_t             direct_io_mode;
-        size_t              *msg0_len_p;
+        size_t               msg0_len;
+        uint64_t             max_write;
 
         double               entry_timeout;
         double               negative_timeout;
@@ -104,6 +129,7 @@ struct fuse_private {
 	gf_boolean_t	     fopen_keep_cache;
 	int32_t		     gid_cache_timeout;
         gf_boolean_t         enable_ino32;
+        gf_boolean_t         use_readdirp;
         fdtable_t           *fdtable;
 	gid_cache_t	     gid_cache;
         char                *fuse_mountopts;
@@ -486,6 +512,9 @@ typedef struct {
         uuid_t         gfid;
         uint32_t       io_flags;
         int32_t        fd_no;
+
+        /* WRITE payload, owned by the state until the fop is done */
+        struct iobuf  *iobuf;
 } fuse_state_t;
 
 typedef struct {
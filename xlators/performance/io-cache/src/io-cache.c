@@ -2063,11 +2063,12 @@ struct volume_options options[] = {
         { .key  = {"cache-timeout", "force-revalidate-timeout"},
           .type = GF_OPTION_TYPE_INT,
           .min  = 0,
-          .max  = 60,
+          .max  = 600,
           .default_value = "1",
           .description = "The cached data for a file will be retained till "
           "'cache-refresh-timeout' seconds, after which data "
-          "re-validation is performed."
+          "re-validation is performed. Values above a few seconds are "
+          "only safe with features.cache-invalidation on the volume."
         },
         { .key  = {"cache-size"},
           .type = GF_OPTION_TYPE_SIZET,
@@ -29,26 +29,254 @@ int iot_workers_scale (iot_conf_t *conf);
 int __iot_workers_scale (iot_conf_t *conf);
 struct volume_options options[];
 
+static inline unsigned long
+iot_client_hash (void *key)
+{
+        unsigned long h = (unsigned long) key;
+
+        /* drop the allocator's alignment bits before folding */
+        h >>= 4;
+        return h ^ (h >> 7) ^ (h >> 15);
+}
+
+
+static struct iot_client *
+__iot_client_get (iot_conf_t *conf, void *key)
+{
+        struct iot_client *client = NULL;
+        struct list_head  *bucket = NULL;
+        int                i      = 0;
+
+        if (!key)
+                return &conf->default_client;
+
+        bucket = &conf->clients[iot_client_hash (key) % IOT_CLIENT_BUCKETS];
+
+        list_for_each_entry (client, bucket, hash) {
+                if (client->key == key)
+                        return client;
+        }
+
+        client = GF_CALLOC (1, sizeof (*client), gf_iot_mt_client_t);
+        if (!client)
+                return &conf->default_client;
+
+        client->key = key;
+        for (i = 0; i < IOT_PRI_MAX; i++) {
+                INIT_LIST_HEAD (&client->queues[i].reqs);
+                INIT_LIST_HEAD (&client->queues[i].active);
+                client->queues[i].client = client;
+        }
+        list_add (&client->hash, bucket);
+        conf->client_count++;
+
+        return client;
+}
+
+
+/* forget clients that had nothing queued for IOT_CLIENT_IDLE seconds */
+static void
+__iot_clients_sweep (iot_conf_t *conf, time_t now)
+{
+        struct iot_client *client = NULL;
+        struct iot_client *tmp    = NULL;
+        int                i      = 0;
+
+        if (now - conf->client_sweep < IOT_CLIENT_IDLE)
+                return;
+        conf->client_sweep = now;
+
+        for (i = 0; i < IOT_CLIENT_BUCKETS; i++) {
+                list_for_each_entry_safe (client, tmp, &conf->clients[i],
+                                          hash) {
+                        if (client->queue_size ||
+                            (now - client->last_active < IOT_CLIENT_IDLE))
+                                continue;
+
+                        list_del (&client->hash);
+                        conf->client_count--;
+                        GF_FREE (client);
+                }
+        }
+}
+
+
+void
+__iot_enqueue (iot_conf_t *conf, call_stub_t *stub, int pri)
+{
+        struct iot_client       *client = NULL;
+        struct iot_client_queue *queue  = NULL;
+
+        client = __iot_client_get (conf, stub->frame->root->trans);
+        queue = &client->queues[pri];
+
+        if (list_empty (&queue->reqs)) {
+                queue->deficit = 0;
+                list_add_tail (&queue->active, &conf->active[pri]);
+        }
+        list_add_tail (&stub->list, &queue->reqs);
+
+        queue->size++;
+        client->queue_size++;
+        conf->queue_size++;
+        conf->queue_sizes[pri]++;
+
+        return;
+}
+
+
+/* move whatever iot_schedule () left in the shards to the client queues */
+static void
+__iot_drain (iot_conf_t *conf)
+{
+        struct iot_shard *shard = NULL;
+        call_stub_t      *stub  = NULL;
+        call_stub_t      *tmp   = NULL;
+        struct list_head  reqs;
+        int               drained = 0;
+        int               i     = 0;
+        int               pri   = 0;
+
+        if (!conf->pending)
+                return;
+
+        for (i = 0; i < IOT_SHARDS; i++) {
+                shard = &conf->shards[i];
+
+                for (pri = 0; pri < IOT_PRI_MAX; pri++) {
+                        /* unlocked peek, a request added meanwhile keeps
+                           conf->pending up until the next drain */
+                        if (list_empty (&shard->reqs[pri]))
+                                continue;
+
+                        INIT_LIST_HEAD (&reqs);
+
+                        LOCK (&shard->lock);
+                        {
+                                list_splice_init (&shard->reqs[pri], &reqs);
+                        }
+                        UNLOCK (&shard->lock);
+
+                        list_for_each_entry_safe (stub, tmp, &reqs, list) {
+                                list_del_init (&stub->list);
+                                __iot_enqueue (conf, stub, pri);
+                                drained++;
+                        }
+                }
+        }
+
+        __sync_fetch_and_sub (&conf->pending, drained);
+}
+
+
+static int32_t
+iot_stub_cost (call_stub_t *stub)
+{
+        int32_t cost = 0;
+
+        switch (stub->fop) {
+        case GF_FOP_READ:
+                cost = stub->args.readv.size;
+                break;
+        case GF_FOP_WRITE:
+                cost = iov_length (stub->args.writev.vector,
+                                   stub->args.writev.count);
+                break;
+        default:
+                break;
+        }
+
+        if (cost < IOT_DRR_MIN_COST)
+                cost = IOT_DRR_MIN_COST;
+        if (cost > IOT_DRR_MAX_COST)
+                cost = IOT_DRR_MAX_COST;
+
+        return cost;
+}
+
+
+static void
+iot_queue_stats_update (struct iot_queue_stats *stats, uint64_t wait)
+{
+        stats->served++;
+        stats->wait_usec += wait;
+        if (wait > stats->max_wait_usec)
+                stats->max_wait_usec = wait;
+}
+
+
+/* deficit round robin over the clients with requests of class @pri */
+static call_stub_t *
+__iot_drr_dequeue (iot_conf_t *conf, int pri, struct timeval *now)
+{
+        struct iot_client_queue *queue = NULL;
+        struct iot_client       *client = NULL;
+        call_stub_t             *stub  = NULL;
+        struct timeval           wait  = {0,};
+        uint64_t                 wait_usec = 0;
+        int32_t                  cost  = 0;
+
+        for (;;) {
+                queue = list_entry (conf->active[pri].next,
+                                    struct iot_client_queue, active);
+                stub = list_entry (queue->reqs.next, call_stub_t, list);
+
+                cost = iot_stub_cost (stub);
+                if (queue->deficit >= cost)
+                        break;
+
+                queue->deficit += IOT_DRR_QUANTUM;
+                list_move_tail (&queue->active, &conf->active[pri]);
+        }
+
+        queue->deficit -= cost;
+        list_del_init (&stub->list);
+
+        client = queue->client;
+        queue->size--;
+        client->queue_size--;
+        if (list_empty (&queue->reqs)) {
+                queue->deficit = 0;
+                list_del_init (&queue->active);
+        }
+        if (!client->queue_size)
+                client->last_active = now->tv_sec;
+
+        if (timercmp (now, &stub->queued, >)) {
+                timersub (now, &stub->queued, &wait);
+                wait_usec = (uint64_t) wait.tv_sec * 1000000 + wait.tv_usec;
+        }
+        iot_queue_stats_update (&queue->stats, wait_usec);
+        iot_queue_stats_update (&conf->stats[pri], wait_usec);
+
+        return stub;
+}
+
+
+/* @now is read by the worker before it takes conf->mutex */
 call_stub_t *
-__iot_dequeue (iot_conf_t *conf, int *pri, struct timespec *sleep)
+__iot_dequeue (iot_conf_t *conf, int *pri, struct timespec *sleep,
+               struct timeval *now)
 {
         call_stub_t  *stub = NULL;
         int           i = 0;
-	struct timeval curtv = {0,}, difftv = {0,};
+	struct timeval difftv = {0,}, curtv = {0,};
 
         *pri = -1;
 	sleep->tv_sec = 0;
 	sleep->tv_nsec = 0;
+
+        __iot_drain (conf);
+
         for (i = 0; i < IOT_PRI_MAX; i++) {
-                if (list_empty (&conf->reqs[i]) ||
+                if (list_empty (&conf->active[i]) ||
                    (conf->ac_iot_count[i] >= conf->ac_iot_limit[i]))
                         continue;
 
 		if (i == IOT_PRI_LEAST) {
-			pthread_mutex_lock(&conf->throttle.lock);
 			if (!conf->throttle.sample_time.tv_sec) {
 				/* initialize */
-				gettimeofday(&conf->throttle.sample_time, NULL);
+				conf->throttle.sample_time = *now;
 			} else {
 				/*
 				 * Maintain a running count of least priority
@@ -57,14 +285,13 @@ __iot_dequeue (iot_conf_t *conf, int *pri, struct timespec *sleep)
 				 * state dump and is used as a measure against
 				 * least priority op throttling.
 				 */
-				gettimeofday(&curtv, NULL);
-				timersub(&curtv, &conf->throttle.sample_time,
+				timersub(now, &conf->throttle.sample_time,
 					 &difftv);
 				if (difftv.tv_sec >= IOT_LEAST_THROTTLE_DELAY) {
 					conf->throttle.cached_rate =
 						conf->throttle.sample_cnt;
 					conf->throttle.sample_cnt = 0;
-					conf->throttle.sample_time = curtv;
+					conf->throttle.sample_time = *now;
 				}
 
 				/*
@@ -83,17 +310,13 @@ __iot_dequeue (iot_conf_t *conf, int *pri, struct timespec *sleep)
 					timeradd(&conf->throttle.sample_time,
 						 &delay, &curtv);
 					TIMEVAL_TO_TIMESPEC(&curtv, sleep);
-
-					pthread_mutex_unlock(
-						&conf->throttle.lock);
 					break;
 				}
 			}
 			conf->throttle.sample_cnt++;
-			pthread_mutex_unlock(&conf->throttle.lock);
 		}
 
-                stub = list_entry (conf->reqs[i].next, call_stub_t, list);
+                stub = __iot_drr_dequeue (conf, i, now);
                 conf->ac_iot_count[i]++;
                 *pri = i;
                 break;
@@ -104,24 +327,10 @@ __iot_dequeue (iot_conf_t *conf, int *pri, struct timespec *sleep)
 
         conf->queue_size--;
         conf->queue_sizes[*pri]--;
-        list_del_init (&stub->list);
-
-        return stub;
-}
 
+        __iot_clients_sweep (conf, now->tv_sec);
 
-void
-__iot_enqueue (iot_conf_t *conf, call_stub_t *stub, int pri)
-{
-        if (pri < 0 || pri >= IOT_PRI_MAX)
-                pri = IOT_PRI_MAX-1;
-
-        list_add_tail (&stub->list, &conf->reqs[pri]);
-
-        conf->queue_size++;
-        conf->queue_sizes[pri]++;
-
-        return;
+        return stub;
 }
 
 
@@ -132,6 +341,7 @@ iot_worker (void *data)
         xlator_t         *this = NULL;
         call_stub_t      *stub = NULL;
         struct timespec   sleep_till = {0, };
+        struct timeval    now = {0, };
         int               ret = 0;
         int               pri = -1;
         char              timeout = 0;
@@ -143,7 +353,8 @@ iot_worker (void *data)
         THIS = this;
 
         for (;;) {
-                sleep_till.tv_sec = time (NULL) + conf->idle_time;
+                gettimeofday (&now, NULL);
+                sleep_till.tv_sec = now.tv_sec + conf->idle_time;
 
                 pthread_mutex_lock (&conf->mutex);
                 {
@@ -151,18 +362,30 @@ iot_worker (void *data)
                                 conf->ac_iot_count[pri]--;
                                 pri = -1;
                         }
+                        __iot_drain (conf);
                         while (conf->queue_size == 0) {
                                 conf->sleep_count++;
 
+                                /* pairs with do_iot_schedule (): either it
+                                   sees us sleeping or we see its request */
+                                __sync_synchronize ();
+                                if (conf->pending) {
+                                        conf->sleep_count--;
+                                        __iot_drain (conf);
+                                        continue;
+                                }
+
                                 ret = pthread_cond_timedwait (&conf->cond,
                                                               &conf->mutex,
                                                               &sleep_till);
                                 conf->sleep_count--;
+                                gettimeofday (&now, NULL);
 
                                 if (ret == ETIMEDOUT) {
                                         timeout = 1;
                                         break;
                                 }
+                                __iot_drain (conf);
                         }
 
                         if (timeout) {
@@ -177,10 +400,12 @@ iot_worker (void *data)
                                 }
                         }
 
-                        stub = __iot_dequeue (conf, &pri, &sleep);
+                        stub = __iot_dequeue (conf, &pri, &sleep, &now);
 			if (!stub && (sleep.tv_sec || sleep.tv_nsec)) {
+                                conf->sleep_count++;
 				pthread_cond_timedwait(&conf->cond,
 						       &conf->mutex, &sleep);
+                                conf->sleep_count--;
 				pthread_mutex_unlock(&conf->mutex);
 				continue;
 			}
@@ -208,12 +433,32 @@ iot_worker (void *data)
 int
 do_iot_schedule (iot_conf_t *conf, call_stub_t *stub, int pri)
 {
-        int   ret = 0;
+        struct iot_shard *shard = NULL;
+        int               ret   = 0;
 
-        pthread_mutex_lock (&conf->mutex);
+        if (pri < 0 || pri >= IOT_PRI_MAX)
+                pri = IOT_PRI_MAX-1;
+
+        gettimeofday (&stub->queued, NULL);
+
+        shard = &conf->shards[iot_client_hash (stub->frame->root->trans)
+                              % IOT_SHARDS];
+        LOCK (&shard->lock);
         {
-                __iot_enqueue (conf, stub, pri);
+                list_add_tail (&stub->list, &shard->reqs[pri]);
+        }
+        UNLOCK (&shard->lock);
 
+        /* a full barrier, see the sleep_count check in iot_worker () */
+        __sync_fetch_and_add (&conf->pending, 1);
+
+        /* with every worker busy and no room to add one, the next
+           dequeue picks the request up and conf->mutex is not needed */
+        if (!conf->sleep_count && (conf->curr_count >= conf->max_count))
+                return 0;
+
+        pthread_mutex_lock (&conf->mutex);
+        {
                 pthread_cond_signal (&conf->cond);
 
                 ret = __iot_workers_scale (conf);
@@ -2418,6 +2663,7 @@ __iot_workers_scale (iot_conf_t *conf)
 
         for (i = 0; i < IOT_PRI_MAX; i++)
                 scale += min (conf->queue_sizes[i], conf->ac_iot_limit[i]);
+        scale += conf->pending;
 
         if (scale < IOT_MIN_THREADS)
                 scale = IOT_MIN_THREADS;
@@ -2513,6 +2759,88 @@ mem_acct_init (xlator_t *this)
         return ret;
 }
 
+static char *iot_pri_names[IOT_PRI_MAX] = {
+        [IOT_PRI_HI]     = "high",
+        [IOT_PRI_NORMAL] = "normal",
+        [IOT_PRI_LO]     = "low",
+        [IOT_PRI_LEAST]  = "least",
+};
+
+
+static void
+iot_queue_stats_dump (char *prefix, int queued, struct iot_queue_stats *stats)
+{
+        char key[GF_DUMP_MAX_BUF_LEN];
+
+        gf_proc_dump_build_key (key, prefix, "queue_size");
+        gf_proc_dump_write (key, "%d", queued);
+        gf_proc_dump_build_key (key, prefix, "served");
+        gf_proc_dump_write (key, "%"PRIu64, stats->served);
+        gf_proc_dump_build_key (key, prefix, "avg_wait_usec");
+        gf_proc_dump_write (key, "%"PRIu64, stats->served ?
+                            stats->wait_usec / stats->served : 0);
+        gf_proc_dump_build_key (key, prefix, "max_wait_usec");
+        gf_proc_dump_write (key, "%"PRIu64, stats->max_wait_usec);
+}
+
+
+static void
+iot_client_dump (struct iot_client *client, char *key_prefix, int idx)
+{
+        char prefix[GF_DUMP_MAX_BUF_LEN];
+        char key[GF_DUMP_MAX_BUF_LEN];
+        int  i = 0;
+
+        gf_proc_dump_add_section ("%s.client.%d", key_prefix, idx);
+        gf_proc_dump_write ("key", "%p", client->key);
+        gf_proc_dump_write ("queue_size", "%d", client->queue_size);
+
+        for (i = 0; i < IOT_PRI_MAX; i++) {
+                if (!client->queues[i].stats.served &&
+                    !client->queues[i].size)
+                        continue;
+
+                snprintf (prefix, sizeof (prefix), "%s_priority",
+                          iot_pri_names[i]);
+                iot_queue_stats_dump (prefix, client->queues[i].size,
+                                      &client->queues[i].stats);
+                gf_proc_dump_build_key (key, prefix, "deficit");
+                gf_proc_dump_write (key, "%d", client->queues[i].deficit);
+        }
+}
+
+
+/* called with conf->mutex held */
+static void
+iot_queues_dump (iot_conf_t *conf, char *key_prefix)
+{
+        struct iot_client *client = NULL;
+        char               prefix[GF_DUMP_MAX_BUF_LEN];
+        int                i      = 0;
+        int                idx    = 0;
+
+        gf_proc_dump_write ("unsorted_requests", "%d", conf->pending);
+
+        for (i = 0; i < IOT_PRI_MAX; i++) {
+                snprintf (prefix, sizeof (prefix), "%s_priority",
+                          iot_pri_names[i]);
+                iot_queue_stats_dump (prefix, conf->queue_sizes[i],
+                                      &conf->stats[i]);
+        }
+
+        gf_proc_dump_write ("clients", "%d", conf->client_count);
+
+        if (conf->default_client.queue_size ||
+            conf->default_client.last_active)
+                iot_client_dump (&conf->default_client, key_prefix, idx++);
+
+        for (i = 0; i < IOT_CLIENT_BUCKETS; i++) {
+                list_for_each_entry (client, &conf->clients[i], hash)
+                        iot_client_dump (client, key_prefix, idx++);
+        }
+}
+
+
 int
 iot_priv_dump (xlator_t *this)
 {
@@ -2549,6 +2877,13 @@ iot_priv_dump (xlator_t *this)
 			   conf->throttle.cached_rate);
 	gf_proc_dump_write("least rate limit", "%u", conf->throttle.rate_limit);
 
+        if (pthread_mutex_trylock (&conf->mutex) != 0)
+                return 0;
+        {
+                iot_queues_dump (conf, key_prefix);
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
         return 0;
 }
 
@@ -2595,6 +2930,7 @@ init (xlator_t *this)
         iot_conf_t *conf = NULL;
         int         ret  = -1;
         int         i    = 0;
+        int         j    = 0;
 
 	if (!this->children || this->children->next) {
 		gf_log ("io-threads", GF_LOG_ERROR,
@@ -2649,16 +2985,23 @@ init (xlator_t *this)
 
 	GF_OPTION_INIT("least-rate-limit", conf->throttle.rate_limit, int32,
 		       out);
-        if ((ret = pthread_mutex_init(&conf->throttle.lock, NULL)) != 0) {
-                gf_log (this->name, GF_LOG_ERROR,
-                        "pthread_mutex_init failed (%d)", ret);
-                goto out;
-        }
 
         conf->this = this;
 
         for (i = 0; i < IOT_PRI_MAX; i++) {
-                INIT_LIST_HEAD (&conf->reqs[i]);
+                INIT_LIST_HEAD (&conf->active[i]);
+                INIT_LIST_HEAD (&conf->default_client.queues[i].reqs);
+                INIT_LIST_HEAD (&conf->default_client.queues[i].active);
+                conf->default_client.queues[i].client = &conf->default_client;
+        }
+
+        for (i = 0; i < IOT_CLIENT_BUCKETS; i++)
+                INIT_LIST_HEAD (&conf->clients[i]);
+
+        for (i = 0; i < IOT_SHARDS; i++) {
+                LOCK_INIT (&conf->shards[i].lock);
+                for (j = 0; j < IOT_PRI_MAX; j++)
+                        INIT_LIST_HEAD (&conf->shards[i].reqs[j]);
         }
 
 	ret = iot_workers_scale (conf);
@@ -2682,10 +3025,24 @@ out:
 void
 fini (xlator_t *this)
 {
-	iot_conf_t *conf = this->private;
+	iot_conf_t        *conf   = this->private;
+        struct iot_client *client = NULL;
+        struct iot_client *tmp    = NULL;
+        int                i      = 0;
 
-	GF_FREE (conf);
+        if (!conf)
+                goto out;
 
+        for (i = 0; i < IOT_CLIENT_BUCKETS; i++) {
+                list_for_each_entry_safe (client, tmp, &conf->clients[i],
+                                          hash) {
+                        list_del (&client->hash);
+                        GF_FREE (client);
+                }
+        }
+
+	GF_FREE (conf);
+out:
 	this->private = NULL;
 	return;
 }
@@ -59,7 +59,53 @@ struct iot_least_throttle {
 	uint32_t	sample_cnt;	/* sample count for active interval */
 	uint32_t	cached_rate;	/* the most recently measured rate */
 	int32_t		rate_limit;	/* user-specified rate limit */
-	pthread_mutex_t	lock;
+};
+
+/*
+ * Requests are first added to one of IOT_SHARDS inboxes, picked by
+ * client, under that inbox's lock only. Workers move them, under
+ * conf->mutex, into per-client queues of each priority class. Within a
+ * class the clients with queued requests are served by deficit round
+ * robin: a client whose turn comes gets IOT_DRR_QUANTUM bytes of credit,
+ * and a request costs its read or write size, IOT_DRR_MIN_COST at least.
+ */
+#define IOT_SHARDS              8
+#define IOT_CLIENT_BUCKETS      64
+#define IOT_DRR_QUANTUM         (64 * 1024)
+#define IOT_DRR_MIN_COST        (4 * 1024)
+#define IOT_DRR_MAX_COST        (16 * IOT_DRR_QUANTUM)
+#define IOT_CLIENT_IDLE         300     /* secs before an idle client's
+                                           queues and counters are freed */
+
+struct iot_client;
+
+struct iot_queue_stats {
+        uint64_t        served;
+        uint64_t        wait_usec;      /* total time spent queued */
+        uint64_t        max_wait_usec;
+};
+
+struct iot_client_queue {
+        struct list_head        reqs;
+        struct list_head        active;  /* in conf->active[pri] while
+                                            reqs is not empty */
+        struct iot_client      *client;
+        int32_t                 deficit;
+        int32_t                 size;
+        struct iot_queue_stats  stats;
+};
+
+struct iot_client {
+        struct list_head        hash;
+        void                   *key;            /* frame->root->trans */
+        int32_t                 queue_size;     /* across all classes */
+        time_t                  last_active;
+        struct iot_client_queue queues[IOT_PRI_MAX];
+};
+
+struct iot_shard {
+        gf_lock_t               lock;
+        struct list_head        reqs[IOT_PRI_MAX];
 };
 
 struct iot_conf {
@@ -72,12 +118,21 @@ struct iot_conf {
 
         int32_t              idle_time;   /* in seconds */
 
-        struct list_head     reqs[IOT_PRI_MAX];
+        struct list_head     active[IOT_PRI_MAX];  /* client queues, in
+                                                      round robin order */
+        struct list_head     clients[IOT_CLIENT_BUCKETS];
+        int32_t              client_count;
+        struct iot_client    default_client;  /* no client, or no memory */
+        time_t               client_sweep;
+
+        struct iot_shard     shards[IOT_SHARDS];
+        int32_t              pending;     /* in shards, updated atomically */
 
         int32_t              ac_iot_limit[IOT_PRI_MAX];
         int32_t              ac_iot_count[IOT_PRI_MAX];
         int                  queue_sizes[IOT_PRI_MAX];
         int                  queue_size;
+        struct iot_queue_stats stats[IOT_PRI_MAX];
         pthread_attr_t       w_attr;
         gf_boolean_t         least_priority; /*Enable/Disable least-priority */
 
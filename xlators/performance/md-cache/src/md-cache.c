@@ -16,6 +16,7 @@
 #include "glusterfs.h"
 #include "logging.h"
 #include "dict.h"
+#include "hashfn.h"
 #include "xlator.h"
 #include "md-cache-mem-types.h"
 #include <assert.h>
@@ -28,44 +29,53 @@
 */
 
 
+#define MDC_KEYS_BUCKETS  64
+#define MDC_KEYS_BITS     64    /* width of md_cache->xa_absent */
+
+
+struct mdc_key {
+	struct mdc_key *hash_next;
+	struct mdc_key *next;
+	char           *name;
+	uint32_t        hash;
+	int             load;   /* requested with lookup and readdirp */
+	int             check;  /* cached */
+	int             bit;    /* in md_cache->xa_absent, -1 if none */
+};
+
+
+/* The xattrs md-cache knows about, hashed on their name. Built from the
+   options and replaced as a whole on reconfigure, fops hold a ref on the
+   set they use. */
+struct mdc_keys {
+	int             refcount;
+	uint32_t        gen;
+	uint64_t        load_mask;
+	int             count;
+	struct mdc_key *keys;
+	struct mdc_key *table[MDC_KEYS_BUCKETS];
+};
+
+
 struct mdc_conf {
 	int  timeout;
 	gf_boolean_t cache_posix_acl;
 	gf_boolean_t cache_selinux;
+	char *cache_xattrs;
+	gf_lock_t lock;
+	struct mdc_keys *keys;
+	uint32_t keys_gen;
 };
 
 
-static struct mdc_key {
-	const char *name;
-	int         load;
-	int         check;
-} mdc_keys[] = {
-	{
-		.name = "system.posix_acl_access",
-		.load = 0,
-		.check = 1,
-	},
-	{
-		.name = "system.posix_acl_default",
-		.load = 0,
-		.check = 1,
-	},
-	{
-		.name = "security.selinux",
-		.load = 0,
-		.check = 1,
-	},
-	{
-		.name = "security.capability",
-		.load = 0,
-		.check = 1,
-	},
-	{
-		.name = "gfid-req",
-		.load = 0,
-		.check = 1,
-	},
-	{},
+/* always cached, loaded when enabled by the options */
+static const char *mdc_builtin_keys[] = {
+	"system.posix_acl_access",
+	"system.posix_acl_default",
+	"security.selinux",
+	"security.capability",
+	"gfid-req",
+	NULL,
 };
 
 
@@ -84,6 +94,199 @@ gfid_to_ino (uuid_t gfid)
 }
 
 
+static struct mdc_key *
+mdc_key_find (struct mdc_keys *keys, const char *name)
+{
+	struct mdc_key *key = NULL;
+	uint32_t        hash = 0;
+
+	if (!name)
+		return NULL;
+
+	hash = SuperFastHash (name, strlen (name));
+
+	for (key = keys->table[hash % MDC_KEYS_BUCKETS]; key;
+	     key = key->hash_next) {
+		if ((key->hash == hash) && (strcmp (key->name, name) == 0))
+			return key;
+	}
+
+	return NULL;
+}
+
+
+static int
+mdc_key_add (struct mdc_keys *keys, const char *name, int load)
+{
+	struct mdc_key *key = NULL;
+
+	key = mdc_key_find (keys, name);
+	if (key)
+		goto out;
+
+	key = GF_CALLOC (1, sizeof (*key), gf_mdc_mt_mdc_key_t);
+	if (!key)
+		return -1;
+
+	key->name = gf_strdup (name);
+	if (!key->name) {
+		GF_FREE (key);
+		return -1;
+	}
+
+	key->hash = SuperFastHash (name, strlen (name));
+	key->check = 1;
+	key->bit = (keys->count < MDC_KEYS_BITS) ? keys->count : -1;
+
+	key->hash_next = keys->table[key->hash % MDC_KEYS_BUCKETS];
+	keys->table[key->hash % MDC_KEYS_BUCKETS] = key;
+	key->next = keys->keys;
+	keys->keys = key;
+	keys->count++;
+out:
+	if (load) {
+		key->load = 1;
+		if (key->bit >= 0)
+			keys->load_mask |= (1ULL << key->bit);
+	}
+
+	return 0;
+}
+
+
+static void
+mdc_keys_free (struct mdc_keys *keys)
+{
+	struct mdc_key *key = NULL;
+
+	while ((key = keys->keys)) {
+		keys->keys = key->next;
+		GF_FREE (key->name);
+		GF_FREE (key);
+	}
+
+	GF_FREE (keys);
+}
+
+
+static struct mdc_keys *
+mdc_keys_new (struct mdc_conf *conf)
+{
+	struct mdc_keys *keys = NULL;
+	const char     **builtin = NULL;
+	char            *list = NULL;
+	char            *name = NULL;
+	char            *saveptr = NULL;
+	int              load = 0;
+	int              ret = -1;
+
+	keys = GF_CALLOC (1, sizeof (*keys), gf_mdc_mt_mdc_keys_t);
+	if (!keys)
+		return NULL;
+
+	keys->refcount = 1;
+
+	for (builtin = mdc_builtin_keys; *builtin; builtin++) {
+		load = 0;
+		if (!strncmp (*builtin, "security.", 9))
+			load = conf->cache_selinux;
+		else if (!strncmp (*builtin, "system.posix_acl_", 17))
+			load = conf->cache_posix_acl;
+
+		if (mdc_key_add (keys, *builtin, load))
+			goto out;
+	}
+
+	if (conf->cache_xattrs) {
+		list = gf_strdup (conf->cache_xattrs);
+		if (!list)
+			goto out;
+
+		for (name = strtok_r (list, ", ", &saveptr); name;
+		     name = strtok_r (NULL, ", ", &saveptr)) {
+			if (mdc_key_add (keys, name, 1))
+				goto out;
+		}
+	}
+
+	LOCK (&conf->lock);
+	{
+		keys->gen = ++conf->keys_gen;
+	}
+	UNLOCK (&conf->lock);
+
+	ret = 0;
+out:
+	GF_FREE (list);
+
+	if (ret) {
+		mdc_keys_free (keys);
+		keys = NULL;
+	}
+
+	return keys;
+}
+
+
+static struct mdc_keys *
+mdc_keys_get (xlator_t *this)
+{
+	struct mdc_conf *conf = NULL;
+	struct mdc_keys *keys = NULL;
+
+	conf = this->private;
+
+	LOCK (&conf->lock);
+	{
+		keys = conf->keys;
+		__sync_fetch_and_add (&keys->refcount, 1);
+	}
+	UNLOCK (&conf->lock);
+
+	return keys;
+}
+
+
+static void
+mdc_keys_put (struct mdc_keys *keys)
+{
+	if (!keys)
+		return;
+
+	if (__sync_sub_and_fetch (&keys->refcount, 1) == 0)
+		mdc_keys_free (keys);
+}
+
+
+static int
+mdc_keys_install (xlator_t *this)
+{
+	struct mdc_conf *conf = NULL;
+	struct mdc_keys *keys = NULL;
+	struct mdc_keys *old = NULL;
+
+	conf = this->private;
+
+	keys = mdc_keys_new (conf);
+	if (!keys) {
+		gf_log (this->name, GF_LOG_ERROR,
+			"failed to build the set of cached xattrs");
+		return -1;
+	}
+
+	LOCK (&conf->lock);
+	{
+		old = conf->keys;
+		conf->keys = keys;
+	}
+	UNLOCK (&conf->lock);
+
+	mdc_keys_put (old);
+
+	return 0;
+}
+
+
 struct mdc_local;
 typedef struct mdc_local mdc_local_t;
 
@@ -118,6 +321,8 @@ struct md_cache {
         char         *linkname;
 	time_t        ia_time;
 	time_t        xa_time;
+        uint64_t      xa_absent;  /* keys known not to exist, bits of */
+        uint32_t      xa_gen;     /* the mdc_keys of this generation */
         gf_lock_t     lock;
 };
 
@@ -128,6 +333,8 @@ struct mdc_local {
         fd_t   *fd;
         char   *linkname;
         dict_t *xattr;
+        char   *key;
+        struct mdc_keys *keys;
 };
 
 
@@ -227,6 +434,10 @@ mdc_local_wipe (xlator_t *this, mdc_local_t *local)
         if (local->xattr)
                 dict_unref (local->xattr);
 
+        GF_FREE (local->key);
+
+        mdc_keys_put (local->keys);
+
         GF_FREE (local);
         return;
 }
@@ -381,6 +592,7 @@ mdc_inode_iatt_set_validate(xlator_t *this, inode_t *inode, struct iatt *prebuf,
 {
         int              ret = -1;
         struct md_cache *mdc = NULL;
+        gf_boolean_t     changed = _gf_false;
 
         mdc = mdc_inode_prep (this, inode);
         if (!mdc)
@@ -404,14 +616,29 @@ mdc_inode_iatt_set_validate(xlator_t *this, inode_t *inode, struct iatt *prebuf,
 		    (iatt->ia_ctime != mdc->md_ctime)))
 			if (!prebuf || (prebuf->ia_ctime != mdc->md_ctime) ||
 			    (prebuf->ia_mtime != mdc->md_mtime))
-				inode_invalidate(inode);
-
-                mdc_from_iatt (mdc, iatt);
+				changed = _gf_true;
 
-                time (&mdc->ia_time);
+                if (!changed) {
+                        mdc_from_iatt (mdc, iatt);
+                        time (&mdc->ia_time);
+                }
         }
 unlock:
         UNLOCK (&mdc->lock);
+
+        /* invalidation reaches mdc_invalidate () as well, so it is done
+           without mdc->lock and before caching the new attributes */
+        if (changed) {
+                inode_invalidate (inode);
+
+                LOCK (&mdc->lock);
+                {
+                        mdc_from_iatt (mdc, iatt);
+                        time (&mdc->ia_time);
+                }
+                UNLOCK (&mdc->lock);
+        }
+
         ret = 0;
 out:
         return ret;
@@ -452,6 +679,8 @@ out:
 
 struct updatedict {
 	dict_t *dict;
+	struct mdc_keys *keys;
+	uint64_t present;
 	int ret;
 };
 
@@ -459,42 +688,46 @@ static int
 updatefn(dict_t *dict, char *key, data_t *value, void *data)
 {
 	struct updatedict *u = data;
-	const char *mdc_key;
-	int i = 0;
+	struct mdc_key *mdc_key = NULL;
 
-	for (mdc_key = mdc_keys[i].name; (mdc_key = mdc_keys[i].name); i++) {
-		if (!mdc_keys[i].check)
-			continue;
-		if (strcmp(mdc_key, key))
-			continue;
+	mdc_key = mdc_key_find (u->keys, key);
+	if (!mdc_key || !mdc_key->check)
+		return 0;
 
+	if (!u->dict) {
+		u->dict = dict_new();
 		if (!u->dict) {
-			u->dict = dict_new();
-			if (!u->dict) {
-				u->ret = -1;
-				return -1;
-			}
-		}
-
-		if (dict_set(u->dict, key, value) < 0) {
 			u->ret = -1;
 			return -1;
 		}
+	}
 
-		break;
+	if (dict_set(u->dict, key, value) < 0) {
+		u->ret = -1;
+		return -1;
 	}
+
+	if (mdc_key->bit >= 0)
+		u->present |= (1ULL << mdc_key->bit);
+
         return 0;
 }
 
 static int
-mdc_dict_update(dict_t **tgt, dict_t *src)
+mdc_dict_update(dict_t **tgt, dict_t *src, struct mdc_keys *keys,
+		uint64_t *present)
 {
 	struct updatedict u = {
 		.dict = *tgt,
+		.keys = keys,
+		.present = 0,
 		.ret = 0,
 	};
 
-	dict_foreach(src, updatefn, &u);
+	if (src)
+		dict_foreach(src, updatefn, &u);
+
+	*present = u.present;
 
 	if (*tgt)
 		return u.ret;
@@ -509,20 +742,27 @@ mdc_dict_update(dict_t **tgt, dict_t *src)
 	return u.ret;
 }
 
+/* @loaded is the key set requested along with the fop which returned
+   @dict, every key it loads and @dict lacks is known not to exist */
 int
-mdc_inode_xatt_set (xlator_t *this, inode_t *inode, dict_t *dict)
+mdc_inode_xatt_set (xlator_t *this, inode_t *inode, dict_t *dict,
+		    struct mdc_keys *loaded)
 {
         int              ret = -1;
         struct md_cache *mdc = NULL;
+	struct mdc_keys *keys = NULL;
 	dict_t		*newdict = NULL;
+	uint64_t         present = 0;
 
         mdc = mdc_inode_prep (this, inode);
         if (!mdc)
                 goto out;
 
-        if (!dict)
+        if (!dict && !loaded)
                 goto out;
 
+	keys = loaded ? loaded : mdc_keys_get (this);
+
         LOCK (&mdc->lock);
         {
                 if (mdc->xattr) {
@@ -530,20 +770,32 @@ mdc_inode_xatt_set (xlator_t *this, inode_t *inode, dict_t *dict)
 			mdc->xattr = NULL;
 		}
 
-		ret = mdc_dict_update(&newdict, dict);
+		ret = mdc_dict_update(&newdict, dict, keys, &present);
 		if (ret < 0) {
+			mdc->xa_absent = 0;
 			UNLOCK(&mdc->lock);
 			goto out;
 		}
 
+		/* an empty dict still answers lookups asking for absent
+		   keys */
+		if (!newdict && loaded)
+			newdict = dict_new ();
+
 		if (newdict)
 			mdc->xattr = newdict;
 
+		mdc->xa_absent = loaded ? (keys->load_mask & ~present) : 0;
+		mdc->xa_gen = keys->gen;
+
                 time (&mdc->xa_time);
         }
         UNLOCK (&mdc->lock);
         ret = 0;
 out:
+	if (keys && !loaded)
+		mdc_keys_put (keys);
+
         return ret;
 }
 
@@ -553,6 +805,8 @@ mdc_inode_xatt_update (xlator_t *this, inode_t *inode, dict_t *dict)
 {
         int              ret = -1;
         struct md_cache *mdc = NULL;
+	struct mdc_keys *keys = NULL;
+	uint64_t         present = 0;
 
         mdc = mdc_inode_prep (this, inode);
         if (!mdc)
@@ -561,20 +815,72 @@ mdc_inode_xatt_update (xlator_t *this, inode_t *inode, dict_t *dict)
         if (!dict)
                 goto out;
 
+	keys = mdc_keys_get (this);
+
         LOCK (&mdc->lock);
         {
-		ret = mdc_dict_update(&mdc->xattr, dict);
+		ret = mdc_dict_update(&mdc->xattr, dict, keys, &present);
 		if (ret < 0) {
 			UNLOCK(&mdc->lock);
 			goto out;
 		}
 
+		if (mdc->xa_gen == keys->gen) {
+			mdc->xa_absent &= ~present;
+		} else {
+			mdc->xa_absent = 0;
+			mdc->xa_gen = keys->gen;
+		}
+
                 time (&mdc->xa_time);
         }
         UNLOCK (&mdc->lock);
 
         ret = 0;
 out:
+	mdc_keys_put (keys);
+
+        return ret;
+}
+
+
+/* @name was removed, or found not to exist */
+int
+mdc_inode_xatt_unset (xlator_t *this, inode_t *inode, const char *name)
+{
+        int              ret = -1;
+        struct md_cache *mdc = NULL;
+	struct mdc_keys *keys = NULL;
+	struct mdc_key  *key = NULL;
+
+        if (mdc_inode_ctx_get (this, inode, &mdc) != 0)
+                goto out;
+
+	keys = mdc_keys_get (this);
+
+	key = mdc_key_find (keys, name);
+	if (!key)
+		goto out;
+
+        LOCK (&mdc->lock);
+        {
+		if (mdc->xattr)
+			dict_del (mdc->xattr, (char *)name);
+
+		if (mdc->xa_gen != keys->gen) {
+			mdc->xa_absent = 0;
+			mdc->xa_gen = keys->gen;
+		}
+
+		if (key->bit >= 0)
+			mdc->xa_absent |= (1ULL << key->bit);
+        }
+        UNLOCK (&mdc->lock);
+
+        ret = 0;
+out:
+	mdc_keys_put (keys);
+
         return ret;
 }
 
@@ -609,46 +915,67 @@ out:
 }
 
 
-void
-mdc_load_reqs (xlator_t *this, dict_t *dict)
+static gf_boolean_t
+mdc_inode_xatt_absent (xlator_t *this, inode_t *inode, struct mdc_keys *keys,
+		       struct mdc_key *key)
 {
-	const char *mdc_key = NULL;
-	int  i = 0;
+        struct md_cache *mdc = NULL;
+	gf_boolean_t     ret = _gf_false;
+
+	if (key->bit < 0)
+		goto out;
+
+        if (mdc_inode_ctx_get (this, inode, &mdc) != 0)
+                goto out;
+
+	if (!is_md_cache_xatt_valid (this, mdc))
+		goto out;
+
+        LOCK (&mdc->lock);
+        {
+		if ((mdc->xa_gen == keys->gen) &&
+		    (mdc->xa_absent & (1ULL << key->bit)))
+			ret = _gf_true;
+        }
+        UNLOCK (&mdc->lock);
+out:
+        return ret;
+}
+
+
+int
+mdc_load_reqs (struct mdc_keys *keys, dict_t *dict)
+{
+	struct mdc_key *key = NULL;
 	int  ret = 0;
 
-	for (mdc_key = mdc_keys[i].name; (mdc_key = mdc_keys[i].name); i++) {
-		if (!mdc_keys[i].load)
+	for (key = keys->keys; key; key = key->next) {
+		if (!key->load)
 			continue;
-		ret = dict_set_int8 (dict, (char *)mdc_key, 0);
+		ret = dict_set_int8 (dict, key->name, 0);
 		if (ret)
-			return;
+			return ret;
 	}
+
+	return 0;
 }
 
 
 struct checkpair {
 	int  ret;
 	dict_t *rsp;
+	struct mdc_keys *keys;
 };
 
 
 static int
-is_mdc_key_satisfied (const char *key)
+is_mdc_key_satisfied (struct mdc_keys *keys, const char *key)
 {
-	const char *mdc_key = NULL;
-	int  i = 0;
-
-	if (!key)
-		return 0;
+	struct mdc_key *mdc_key = NULL;
 
-	for (mdc_key = mdc_keys[i].name; (mdc_key = mdc_keys[i].name); i++) {
-		if (!mdc_keys[i].check)
-			continue;
-		if (strcmp (mdc_key, key) == 0)
-			return 1;
-	}
+	mdc_key = mdc_key_find (keys, key);
 
-	return 0;
+	return (mdc_key && mdc_key->check);
 }
 
 
@@ -657,7 +984,7 @@ checkfn (dict_t *this, char *key, data_t *value, void *data)
 {
         struct checkpair *pair = data;
 
-	if (!is_mdc_key_satisfied (key))
+	if (!is_mdc_key_satisfied (pair->keys, key))
 		pair->ret = 0;
 
         return 0;
@@ -672,8 +999,12 @@ mdc_xattr_satisfied (xlator_t *this, dict_t *req, dict_t *rsp)
                 .rsp = rsp,
         };
 
+	pair.keys = mdc_keys_get (this);
+
         dict_foreach (req, checkfn, &pair);
 
+	mdc_keys_put (pair.keys);
+
         return pair.ret;
 }
 
@@ -699,7 +1030,8 @@ mdc_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         if (local->loc.inode) {
                 mdc_inode_iatt_set (this, local->loc.inode, stbuf);
-                mdc_inode_xatt_set (this, local->loc.inode, dict);
+                mdc_inode_xatt_set (this, local->loc.inode, dict,
+                                    local->keys);
         }
 out:
         MDC_STACK_UNWIND (lookup, frame, op_ret, op_errno, inode, stbuf,
@@ -717,6 +1049,7 @@ mdc_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc,
         struct iatt  postparent = {0, };
         dict_t      *xattr_rsp = NULL;
         mdc_local_t *local = NULL;
+        int          need_unref = 0;
 
 
         local = mdc_local_get (frame);
@@ -747,8 +1080,20 @@ mdc_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc,
         return 0;
 
 uncached:
-	if (xdata)
-		mdc_load_reqs (this, xdata);
+        if (!xdata) {
+                xdata = dict_new ();
+                need_unref = 1;
+        }
+
+        /* ask for the cached xattrs along, the keys missing from the
+           reply are remembered as absent */
+        if (local && xdata) {
+                local->keys = mdc_keys_get (this);
+                if (mdc_load_reqs (local->keys, xdata)) {
+                        mdc_keys_put (local->keys);
+                        local->keys = NULL;
+                }
+        }
 
         STACK_WIND (frame, mdc_lookup_cbk, FIRST_CHILD (this),
                     FIRST_CHILD (this)->fops->lookup, loc, xdata);
@@ -756,6 +1101,9 @@ uncached:
         if (xattr_rsp)
                 dict_unref (xattr_rsp);
 
+        if (need_unref && xdata)
+                dict_unref (xdata);
+
         return 0;
 }
 
@@ -969,7 +1317,8 @@ mdc_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         if (local->loc.inode) {
                 mdc_inode_iatt_set (this, local->loc.inode, buf);
-                mdc_inode_xatt_set (this, local->loc.inode, local->xattr);
+                mdc_inode_xatt_set (this, local->loc.inode, local->xattr,
+                                    NULL);
         }
 out:
         MDC_STACK_UNWIND (mknod, frame, op_ret, op_errno, inode, buf,
@@ -1018,7 +1367,8 @@ mdc_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         if (local->loc.inode) {
                 mdc_inode_iatt_set (this, local->loc.inode, buf);
-                mdc_inode_xatt_set (this, local->loc.inode, local->xattr);
+                mdc_inode_xatt_set (this, local->loc.inode, local->xattr,
+                                    NULL);
         }
 out:
         MDC_STACK_UNWIND (mkdir, frame, op_ret, op_errno, inode, buf,
@@ -1311,7 +1661,8 @@ mdc_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         if (local->loc.inode) {
                 mdc_inode_iatt_set (this, inode, buf);
-                mdc_inode_xatt_set (this, local->loc.inode, local->xattr);
+                mdc_inode_xatt_set (this, local->loc.inode, local->xattr,
+                                    NULL);
         }
 out:
         MDC_STACK_UNWIND (create, frame, op_ret, op_errno, fd, inode, buf,
@@ -1640,13 +1991,18 @@ mdc_getxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         mdc_local_t  *local = NULL;
 
-        if (op_ret != 0)
-                goto out;
-
         local = frame->local;
         if (!local)
                 goto out;
 
+        if ((op_ret < 0) && (op_errno == ENODATA) && local->key) {
+                mdc_inode_xatt_unset (this, local->loc.inode, local->key);
+                goto out;
+        }
+
+        if (op_ret < 0)
+                goto out;
+
         mdc_inode_xatt_update (this, local->loc.inode, xattr);
 
 out:
@@ -1660,9 +2016,11 @@ int
 mdc_getxattr (call_frame_t *frame, xlator_t *this, loc_t *loc, const char *key,
               dict_t *xdata)
 {
-        int           ret;
-        mdc_local_t  *local = NULL;
-	dict_t       *xattr = NULL;
+        int              ret;
+        mdc_local_t     *local = NULL;
+	dict_t          *xattr = NULL;
+	struct mdc_keys *keys = NULL;
+	struct mdc_key  *mdc_key = NULL;
 
         local = mdc_local_get (frame);
         if (!local)
@@ -1670,24 +2028,35 @@ mdc_getxattr (call_frame_t *frame, xlator_t *this, loc_t *loc, const char *key,
 
         loc_copy (&local->loc, loc);
 
-	if (!is_mdc_key_satisfied (key))
-		goto uncached;
+	keys = mdc_keys_get (this);
 
-	ret = mdc_inode_xatt_get (this, loc->inode, &xattr);
-	if (ret != 0)
+	mdc_key = mdc_key_find (keys, key);
+	if (!mdc_key || !mdc_key->check)
 		goto uncached;
 
-	if (!dict_get (xattr, (char *)key))
-		goto uncached;
+	local->key = gf_strdup (key);
 
-        MDC_STACK_UNWIND (getxattr, frame, 0, 0, xattr, xdata);
+	ret = mdc_inode_xatt_get (this, loc->inode, &xattr);
+	if ((ret == 0) && dict_get (xattr, (char *)key)) {
+		MDC_STACK_UNWIND (getxattr, frame, 0, 0, xattr, xdata);
+		goto out;
+	}
 
-        return 0;
+	if (mdc_inode_xatt_absent (this, loc->inode, keys, mdc_key)) {
+		MDC_STACK_UNWIND (getxattr, frame, -1, ENODATA, NULL, xdata);
+		goto out;
+	}
 
 uncached:
         STACK_WIND (frame, mdc_getxattr_cbk,
                     FIRST_CHILD(this), FIRST_CHILD(this)->fops->getxattr,
                     loc, key, xdata);
+out:
+	mdc_keys_put (keys);
+
+	if (xattr)
+		dict_unref (xattr);
+
         return 0;
 }
 
@@ -1699,13 +2068,18 @@ mdc_fgetxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         mdc_local_t  *local = NULL;
 
-        if (op_ret != 0)
-                goto out;
-
         local = frame->local;
         if (!local)
                 goto out;
 
+        if ((op_ret < 0) && (op_errno == ENODATA) && local->key) {
+                mdc_inode_xatt_unset (this, local->fd->inode, local->key);
+                goto out;
+        }
+
+        if (op_ret < 0)
+                goto out;
+
         mdc_inode_xatt_update (this, local->fd->inode, xattr);
 
 out:
@@ -1719,9 +2093,11 @@ int
 mdc_fgetxattr (call_frame_t *frame, xlator_t *this, fd_t *fd, const char *key,
                dict_t *xdata)
 {
-        int           ret;
-        mdc_local_t  *local = NULL;
-	dict_t       *xattr = NULL;
+        int              ret;
+        mdc_local_t     *local = NULL;
+	dict_t          *xattr = NULL;
+	struct mdc_keys *keys = NULL;
+	struct mdc_key  *mdc_key = NULL;
 
         local = mdc_local_get (frame);
         if (!local)
@@ -1729,24 +2105,119 @@ mdc_fgetxattr (call_frame_t *frame, xlator_t *this, fd_t *fd, const char *key,
 
         local->fd = fd_ref (fd);
 
-	if (!is_mdc_key_satisfied (key))
-		goto uncached;
+	keys = mdc_keys_get (this);
 
-	ret = mdc_inode_xatt_get (this, fd->inode, &xattr);
-	if (ret != 0)
+	mdc_key = mdc_key_find (keys, key);
+	if (!mdc_key || !mdc_key->check)
 		goto uncached;
 
-	if (!dict_get (xattr, (char *)key))
-		goto uncached;
+	local->key = gf_strdup (key);
 
-        MDC_STACK_UNWIND (fgetxattr, frame, 0, 0, xattr, xdata);
+	ret = mdc_inode_xatt_get (this, fd->inode, &xattr);
+	if ((ret == 0) && dict_get (xattr, (char *)key)) {
+		MDC_STACK_UNWIND (fgetxattr, frame, 0, 0, xattr, xdata);
+		goto out;
+	}
 
-        return 0;
+	if (mdc_inode_xatt_absent (this, fd->inode, keys, mdc_key)) {
+		MDC_STACK_UNWIND (fgetxattr, frame, -1, ENODATA, NULL, xdata);
+		goto out;
+	}
 
 uncached:
         STACK_WIND (frame, mdc_fgetxattr_cbk,
                     FIRST_CHILD(this), FIRST_CHILD(this)->fops->fgetxattr,
                     fd, key, xdata);
+out:
+	mdc_keys_put (keys);
+
+	if (xattr)
+		dict_unref (xattr);
+
+        return 0;
+}
+
+
+int
+mdc_removexattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+		     int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        mdc_local_t  *local = NULL;
+
+        local = frame->local;
+
+        if (op_ret != 0)
+                goto out;
+
+        if (!local || !local->key)
+                goto out;
+
+        mdc_inode_xatt_unset (this, local->loc.inode, local->key);
+
+out:
+        MDC_STACK_UNWIND (removexattr, frame, op_ret, op_errno, xdata);
+
+        return 0;
+}
+
+
+int
+mdc_removexattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+		 const char *name, dict_t *xdata)
+{
+        mdc_local_t  *local = NULL;
+
+        local = mdc_local_get (frame);
+        if (local) {
+                loc_copy (&local->loc, loc);
+                local->key = gf_strdup (name);
+        }
+
+        STACK_WIND (frame, mdc_removexattr_cbk,
+                    FIRST_CHILD(this), FIRST_CHILD(this)->fops->removexattr,
+                    loc, name, xdata);
+        return 0;
+}
+
+
+int
+mdc_fremovexattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+		      int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        mdc_local_t  *local = NULL;
+
+        local = frame->local;
+
+        if (op_ret != 0)
+                goto out;
+
+        if (!local || !local->key)
+                goto out;
+
+        mdc_inode_xatt_unset (this, local->fd->inode, local->key);
+
+out:
+        MDC_STACK_UNWIND (fremovexattr, frame, op_ret, op_errno, xdata);
+
+        return 0;
+}
+
+
+int
+mdc_fremovexattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
+		  const char *name, dict_t *xdata)
+{
+        mdc_local_t  *local = NULL;
+
+        local = mdc_local_get (frame);
+        if (local) {
+                local->fd = fd_ref (fd);
+                local->key = gf_strdup (name);
+        }
+
+        STACK_WIND (frame, mdc_fremovexattr_cbk,
+                    FIRST_CHILD(this), FIRST_CHILD(this)->fops->fremovexattr,
+                    fd, name, xdata);
         return 0;
 }
 
@@ -1755,7 +2226,8 @@ int
 mdc_readdirp_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 		  int op_ret, int op_errno, gf_dirent_t *entries, dict_t *xdata)
 {
-        gf_dirent_t *entry      = NULL;
+        gf_dirent_t     *entry      = NULL;
+	struct mdc_keys *keys       = cookie;
 
 	if (op_ret <= 0)
 		goto unwind;
@@ -1764,30 +2236,24 @@ mdc_readdirp_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 if (!entry->inode)
 			continue;
                 mdc_inode_iatt_set (this, entry->inode, &entry->d_stat);
-                mdc_inode_xatt_set (this, entry->inode, entry->dict);
+                mdc_inode_xatt_set (this, entry->inode, entry->dict, keys);
         }
 
 unwind:
 	STACK_UNWIND_STRICT (readdirp, frame, op_ret, op_errno, entries, xdata);
+
+	mdc_keys_put (keys);
 	return 0;
 }
 
 
+/* the entries come with the cached xattrs, the key set they were asked
+   for travels as the cookie */
 int
 mdc_readdirp (call_frame_t *frame, xlator_t *this, fd_t *fd,
 	      size_t size, off_t offset, dict_t *xdata)
 {
-	STACK_WIND (frame, mdc_readdirp_cbk,
-		    FIRST_CHILD (this), FIRST_CHILD (this)->fops->readdirp,
-		    fd, size, offset, xdata);
-	return 0;
-}
-
-
-int
-mdc_readdir (call_frame_t *frame, xlator_t *this, fd_t *fd,
-	     size_t size, off_t offset, dict_t *xdata)
-{
+	struct mdc_keys *keys = NULL;
         int need_unref = 0;
 
 	if (!xdata) {
@@ -1795,12 +2261,17 @@ mdc_readdir (call_frame_t *frame, xlator_t *this, fd_t *fd,
                 need_unref = 1;
         }
 
-        if (xdata)
-		mdc_load_reqs (this, xdata);
+        if (xdata) {
+		keys = mdc_keys_get (this);
+		if (mdc_load_reqs (keys, xdata)) {
+			mdc_keys_put (keys);
+			keys = NULL;
+		}
+	}
 
-	STACK_WIND (frame, mdc_readdirp_cbk,
-		    FIRST_CHILD (this), FIRST_CHILD (this)->fops->readdirp,
-		    fd, size, offset, xdata);
+	STACK_WIND_COOKIE (frame, mdc_readdirp_cbk, keys,
+			   FIRST_CHILD (this), FIRST_CHILD (this)->fops->readdirp,
+			   fd, size, offset, xdata);
 
         if (need_unref && xdata)
                 dict_unref (xdata);
@@ -1810,40 +2281,40 @@ mdc_readdir (call_frame_t *frame, xlator_t *this, fd_t *fd,
 
 
 int
-mdc_forget (xlator_t *this, inode_t *inode)
+mdc_readdir (call_frame_t *frame, xlator_t *this, fd_t *fd,
+	     size_t size, off_t offset, dict_t *xdata)
 {
-        mdc_inode_wipe (this, inode);
-
-        return 0;
+	return mdc_readdirp (frame, this, fd, size, offset, xdata);
 }
 
 
 int
-is_strpfx (const char *str1, const char *str2)
+mdc_forget (xlator_t *this, inode_t *inode)
 {
-	/* is one of the string a prefix of the other? */
-	int i;
-
-	for (i = 0; str1[i] == str2[i]; i++) {
-		if (!str1[i] || !str2[i])
-			break;
-	}
+        mdc_inode_wipe (this, inode);
 
-	return !(str1[i] && str2[i]);
+        return 0;
 }
 
 
+/* the inode changed behind our back (cache invalidation from the bricks),
+   attributes and xattrs are fetched again on next use */
 int
-mdc_key_load_set (struct mdc_key *keys, char *pattern, gf_boolean_t val)
+mdc_invalidate (xlator_t *this, inode_t *inode)
 {
-	struct mdc_key *key = NULL;
+        struct md_cache *mdc = NULL;
 
-	for (key = keys; key->name; key++) {
-		if (is_strpfx (key->name, pattern))
-			key->load = val;
-	}
+        if (mdc_inode_ctx_get (this, inode, &mdc) != 0)
+                goto out;
 
-	return 0;
+        LOCK (&mdc->lock);
+        {
+                mdc->ia_time = 0;
+                mdc->xa_time = 0;
+        }
+        UNLOCK (&mdc->lock);
+out:
+        return 0;
 }
 
 
@@ -1857,11 +2328,12 @@ reconfigure (xlator_t *this, dict_t *options)
 	GF_OPTION_RECONF ("md-cache-timeout", conf->timeout, options, int32, out);
 
 	GF_OPTION_RECONF ("cache-selinux", conf->cache_selinux, options, bool, out);
-	mdc_key_load_set (mdc_keys, "security.", conf->cache_selinux);
 
 	GF_OPTION_RECONF ("cache-posix-acl", conf->cache_posix_acl, options, bool, out);
-	mdc_key_load_set (mdc_keys, "system.posix_acl_", conf->cache_posix_acl);
 
+	GF_OPTION_RECONF ("cache-xattrs", conf->cache_xattrs, options, str, out);
+
+	mdc_keys_install (this);
 out:
 	return 0;
 }
@@ -1887,16 +2359,26 @@ init (xlator_t *this)
 		return -1;
 	}
 
+	LOCK_INIT (&conf->lock);
+
         GF_OPTION_INIT ("md-cache-timeout", conf->timeout, int32, out);
 
 	GF_OPTION_INIT ("cache-selinux", conf->cache_selinux, bool, out);
-	mdc_key_load_set (mdc_keys, "security.", conf->cache_selinux);
 
 	GF_OPTION_INIT ("cache-posix-acl", conf->cache_posix_acl, bool, out);
-	mdc_key_load_set (mdc_keys, "system.posix_acl_", conf->cache_posix_acl);
+
+	GF_OPTION_INIT ("cache-xattrs", conf->cache_xattrs, str, out);
 out:
 	this->private = conf;
 
+	/* fops always find a key set */
+	if (mdc_keys_install (this)) {
+		LOCK_DESTROY (&conf->lock);
+		GF_FREE (conf);
+		this->private = NULL;
+		return -1;
+	}
+
         return 0;
 }
 
@@ -1904,7 +2386,17 @@ out:
 void
 fini (xlator_t *this)
 {
-        return;
+	struct mdc_conf *conf = NULL;
+
+	conf = this->private;
+	if (!conf)
+		return;
+
+	this->private = NULL;
+
+	mdc_keys_put (conf->keys);
+	LOCK_DESTROY (&conf->lock);
+	GF_FREE (conf);
 }
 
 
@@ -1931,6 +2423,8 @@ struct xlator_fops fops = {
         .fsetxattr   = mdc_fsetxattr,
         .getxattr    = mdc_getxattr,
         .fgetxattr   = mdc_fgetxattr,
+        .removexattr = mdc_removexattr,
+        .fremovexattr = mdc_fremovexattr,
 	.readdirp    = mdc_readdirp,
 	.readdir     = mdc_readdir
 };
@@ -1938,6 +2432,7 @@ struct xlator_fops fops = {
 
 struct xlator_cbks cbks = {
         .forget      = mdc_forget,
+        .invalidate  = mdc_invalidate,
 };
 
 struct volume_options options[] = {
@@ -1949,11 +2444,19 @@ struct volume_options options[] = {
 	  .type = GF_OPTION_TYPE_BOOL,
 	  .default_value = "false",
 	},
+	{ .key = {"cache-xattrs"},
+	  .type = GF_OPTION_TYPE_STR,
+	  .description = "Comma separated list of extended attributes to "
+			 "fetch with lookup and readdirp and to cache, "
+			 "including their absence.",
+	},
         { .key = {"md-cache-timeout"},
           .type = GF_OPTION_TYPE_INT,
           .min = 0,
-          .max = 60,
+          .max = 600,
           .default_value = "1",
-          .description = "Time period after which cache has to be refreshed",
+          .description = "Time period after which cache has to be refreshed. "
+                         "Values above a few seconds are only safe with "
+                         "features.cache-invalidation on the volume.",
         },
 };
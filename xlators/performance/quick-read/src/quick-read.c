@@ -3423,6 +3423,37 @@ out:
 }
 
 
+/* the file changed on the bricks, make the next access validate the cached
+   content */
+int32_t
+qr_invalidate (xlator_t *this, inode_t *inode)
+{
+        qr_inode_t   *qr_inode = NULL;
+        uint64_t      value     = 0;
+        qr_private_t *priv      = NULL;
+
+        GF_VALIDATE_OR_GOTO ("quick-read", this, out);
+        GF_VALIDATE_OR_GOTO (this->name, this->private, out);
+        GF_VALIDATE_OR_GOTO (this->name, inode, out);
+
+        priv = this->private;
+
+        LOCK (&priv->table.lock);
+        {
+                if (inode_ctx_get (inode, this, &value) == 0) {
+                        qr_inode = (qr_inode_t *)(long) value;
+                        if (qr_inode)
+                                memset (&qr_inode->tv, 0,
+                                        sizeof (qr_inode->tv));
+                }
+        }
+        UNLOCK (&priv->table.lock);
+
+out:
+        return 0;
+}
+
+
 int32_t
 qr_inodectx_dump (xlator_t *this, inode_t *inode)
 {
@@ -3941,8 +3972,9 @@ struct xlator_fops fops = {
 };
 
 struct xlator_cbks cbks = {
-        .forget  = qr_forget,
-        .release = qr_release,
+        .forget     = qr_forget,
+        .release    = qr_release,
+        .invalidate = qr_invalidate,
 };
 
 struct xlator_dumpops dumpops = {
@@ -3965,8 +3997,10 @@ struct volume_options options[] = {
         { .key  = {"cache-timeout"},
           .type = GF_OPTION_TYPE_INT,
           .min = 1,
-          .max = 60,
+          .max = 600,
           .default_value = "1",
+          .description = "Values above a few seconds are only safe with "
+                         "features.cache-invalidation on the volume.",
         },
         { .key  = {"max-file-size"},
           .type = GF_OPTION_TYPE_SIZET,
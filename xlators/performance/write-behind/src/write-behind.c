@@ -25,10 +25,16 @@
 #include "call-stub.h"
 #include "statedump.h"
 #include "defaults.h"
+#include "interval-tree.h"
 #include "write-behind-mem-types.h"
 
 #define MAX_VECTOR_COUNT          8
-#define WB_AGGREGATE_SIZE         131072 /* 128 KB */
+#define WB_COPY_WRITE_SIZE        1024   /* writes up to this size are
+                                            copied when collapsed, larger
+                                            ones are chained */
+#define WB_CHAIN_MAX_WASTE        4      /* and so are larger ones whose
+                                            buffers are over this many
+                                            times their size */
 #define WB_WINDOW_SIZE            1048576 /* 1MB */
 
 typedef struct list_head list_head_t;
@@ -89,6 +95,11 @@ typedef struct wb_inode {
 				     write-behind from this list, and therefore
 				     get "upgraded" to the "liability" list.
 			     */
+        struct itree_root lies;   /* @liability indexed on the ranges the
+                                     entries cover, for the causal checks
+                                     and for answering reads
+                                  */
+        uint64_t     cached_reads; /* reads answered from @lies */
 	uint64_t     gen;    /* Liability generation number. Represents
 				the current 'state' of liability. Every
 				new addition to the liability list bumps
@@ -118,6 +129,8 @@ typedef struct wb_request {
         list_head_t           all;
         list_head_t           todo;
 	list_head_t           lie;  /* either in @liability or @temptation */
+        struct itree_node     lie_node; /* in wb_inode->lies while in
+                                           @liability */
         list_head_t           winds;
         list_head_t           unwinds;
 
@@ -142,7 +155,11 @@ typedef struct wb_request {
         wb_inode_t           *wb_inode;
         glusterfs_fop_t       fop;
         gf_lkowner_t          lk_owner;
-	struct iobref        *iobref;
+	struct iobuf         *tail; /* buffer small writes collapsed into
+				       this request are copied to. Always
+				       the last entry of the writev vector
+				       and held by the iobref of the stub.
+				    */
 	uint64_t              gen;  /* inode liability state at the time of
 				       request arrival */
 
@@ -256,6 +273,49 @@ wb_requests_overlap (wb_request_t *req1, wb_request_t *req2)
 }
 
 
+/* range a liability is indexed on: an append conflicts with everything,
+   whatever offset it carries */
+static void
+wb_lie_range (wb_request_t *lie, uint64_t *start, uint64_t *end)
+{
+	if (lie->ordering.append) {
+		*start = 0;
+		*end = ULLONG_MAX;
+		return;
+	}
+
+	*start = lie->ordering.off;
+	if (lie->ordering.size)
+		*end = *start + lie->ordering.size - 1;
+	else
+		*end = ULLONG_MAX;
+}
+
+
+static void
+__wb_lie_index (wb_inode_t *wb_inode, wb_request_t *lie)
+{
+	uint64_t start = 0;
+	uint64_t end   = 0;
+
+	wb_lie_range (lie, &start, &end);
+	itree_node_init (&lie->lie_node, start, end);
+	itree_insert (&wb_inode->lies, &lie->lie_node);
+}
+
+
+/* the range of a liability changes as small writes are collapsed into it */
+static void
+__wb_lie_reindex (wb_inode_t *wb_inode, wb_request_t *lie)
+{
+	if (!itree_node_linked (&lie->lie_node))
+		return;
+
+	itree_remove (&wb_inode->lies, &lie->lie_node);
+	__wb_lie_index (wb_inode, lie);
+}
+
+
 gf_boolean_t
 wb_requests_conflict (wb_request_t *lie, wb_request_t *req)
 {
@@ -288,17 +348,37 @@ wb_requests_conflict (wb_request_t *lie, wb_request_t *req)
 }
 
 
+static int
+wb_lie_conflicts (struct itree_node *node, void *data)
+{
+	wb_request_t *lie = NULL;
+
+	lie = itree_entry (node, wb_request_t, lie_node);
+
+	return wb_requests_conflict (lie, data);
+}
+
+
 gf_boolean_t
 wb_liability_has_conflict (wb_inode_t *wb_inode, wb_request_t *req)
 {
-        wb_request_t *each     = NULL;
+	wb_conf_t    *conf  = NULL;
+	uint64_t      start = 0;
+	uint64_t      end   = ULLONG_MAX;
 
-        list_for_each_entry (each, &wb_inode->liability, lie) {
-		if (wb_requests_conflict (each, req))
-			return _gf_true;
-        }
+	conf = wb_inode->this->private;
+
+	/* with strict ordering every older lie conflicts, otherwise only
+	   the ones overlapping @req can (appends cover the whole file) */
+	if (!conf->strict_write_ordering) {
+		start = req->ordering.off;
+		if (req->ordering.size)
+			end = start + req->ordering.size - 1;
+	}
 
-        return _gf_false;
+	return itree_foreach_overlap (&wb_inode->lies, start, end,
+				      wb_lie_conflicts, req) ? _gf_true
+							     : _gf_false;
 }
 
 
@@ -320,6 +400,7 @@ __wb_request_unref (wb_request_t *req)
         if (req->refcount == 0) {
                 list_del_init (&req->todo);
                 list_del_init (&req->lie);
+		itree_remove (&wb_inode->lies, &req->lie_node);
 
 		list_del_init (&req->all);
 		if (list_empty (&wb_inode->all)) {
@@ -336,9 +417,6 @@ __wb_request_unref (wb_request_t *req)
 			req->stub = NULL;
                 } /* else we would have call_resume()'ed */
 
-		if (req->iobref)
-			iobref_unref (req->iobref);
-
 		if (req->fd)
 			fd_unref (req->fd);
 
@@ -541,6 +619,7 @@ __wb_inode_create (xlator_t *this, inode_t *inode)
         INIT_LIST_HEAD (&wb_inode->todo);
         INIT_LIST_HEAD (&wb_inode->liability);
         INIT_LIST_HEAD (&wb_inode->temptation);
+        itree_init (&wb_inode->lies);
 
         wb_inode->this = this;
 
@@ -843,6 +922,7 @@ __wb_pick_unwinds (wb_inode_t *wb_inode, list_head_t *lies)
 		if (!req->ordering.fulfilled) {
 			/* burden increased */
 			list_add_tail (&req->lie, &wb_inode->liability);
+			__wb_lie_index (wb_inode, req);
 
 			req->ordering.lied = 1;
 
@@ -854,58 +934,119 @@ __wb_pick_unwinds (wb_inode_t *wb_inode, list_head_t *lies)
 }
 
 
+/* Grow @holder by @req. The buffers of @req are chained behind those of
+   @holder without copying, except for very small writes and for writes
+   in buffers much larger than they are (as the ones fuse reads requests
+   into), which would stay pinned outside of the window until @holder is
+   wound: those are copied into a tail buffer of @holder. The transports
+   take a bounded number of iovecs per request, so once the vector of
+   @holder is full this fails and @req starts a new holder.
+*/
 int
-__wb_collapse_small_writes (wb_request_t *holder, wb_request_t *req)
+__wb_collapse_small_writes (wb_conf_t *conf, wb_request_t *holder,
+			    wb_request_t *req)
 {
-        char          *ptr    = NULL;
+        struct iovec  *vector = NULL;
+        struct iovec  *last   = NULL;
         struct iobuf  *iobuf  = NULL;
         struct iobref *iobref = NULL;
+        int            count  = 0;
+        int            extra  = 0;
+        size_t         space  = 0;
+        gf_boolean_t   chain  = _gf_false;
         int            ret    = -1;
 
-        if (!holder->iobref) {
-                /* TODO: check the required size */
-                iobuf = iobuf_get (req->wb_inode->this->ctx->iobuf_pool);
-                if (iobuf == NULL) {
-                        goto out;
-                }
+        count = holder->stub->args.writev.count;
+        extra = req->stub->args.writev.count;
 
+        if (!holder->stub->args.writev.iobref) {
                 iobref = iobref_new ();
-                if (iobref == NULL) {
-                        iobuf_unref (iobuf);
+                if (iobref == NULL)
                         goto out;
-                }
 
-                ret = iobref_add (iobref, iobuf);
+                holder->stub->args.writev.iobref = iobref;
+        }
+
+        if ((req->write_size > WB_COPY_WRITE_SIZE) &&
+            req->stub->args.writev.iobref &&
+            (iobref_size (req->stub->args.writev.iobref) <=
+             WB_CHAIN_MAX_WASTE * req->write_size))
+                chain = _gf_true;
+
+        if (chain) {
+                if (count + extra > MAX_VECTOR_COUNT)
+                        goto out;
+
+                vector = GF_REALLOC (holder->stub->args.writev.vector,
+                                     (count + extra) * sizeof (*vector));
+                if (vector == NULL)
+                        goto out;
+
+                memcpy (&vector[count], req->stub->args.writev.vector,
+                        extra * sizeof (*vector));
+
+                holder->stub->args.writev.vector = vector;
+                holder->stub->args.writev.count += extra;
+
+                iobref_merge (holder->stub->args.writev.iobref,
+                              req->stub->args.writev.iobref);
+
+                holder->tail = NULL;
+                goto done;
+        }
+
+        if (holder->tail) {
+                last = &holder->stub->args.writev.vector[count - 1];
+                space = iobuf_pagesize (holder->tail)
+                        - ((char *)last->iov_base + last->iov_len
+                           - (char *)holder->tail->ptr);
+        }
+
+        if (!holder->tail || (space < req->write_size)) {
+                if (count >= MAX_VECTOR_COUNT)
+                        goto out;
+
+                vector = GF_REALLOC (holder->stub->args.writev.vector,
+                                     (count + 1) * sizeof (*vector));
+                if (vector == NULL)
+                        goto out;
+
+                holder->stub->args.writev.vector = vector;
+
+                /* room for whatever can still be aggregated */
+                iobuf = iobuf_get2 (req->wb_inode->this->ctx->iobuf_pool,
+                                    conf->aggregate_size - holder->write_size);
+                if (iobuf == NULL)
+                        goto out;
+
+                ret = iobref_add (holder->stub->args.writev.iobref, iobuf);
+                iobuf_unref (iobuf);
                 if (ret != 0) {
-                        iobuf_unref (iobuf);
-                        iobref_unref (iobref);
                         gf_log (req->wb_inode->this->name, GF_LOG_WARNING,
                                 "cannot add iobuf (%p) into iobref (%p)",
-                                iobuf, iobref);
+                                iobuf, holder->stub->args.writev.iobref);
+                        ret = -1;
                         goto out;
                 }
 
-                iov_unload (iobuf->ptr, holder->stub->args.writev.vector,
-                            holder->stub->args.writev.count);
-                holder->stub->args.writev.vector[0].iov_base = iobuf->ptr;
-		holder->stub->args.writev.count = 1;
+                vector[count].iov_base = iobuf->ptr;
+                vector[count].iov_len = 0;
+                holder->stub->args.writev.count = ++count;
 
-                iobref_unref (holder->stub->args.writev.iobref);
-                holder->stub->args.writev.iobref = iobref;
-
-                iobuf_unref (iobuf);
-
-                holder->iobref = iobref_ref (iobref);
+                holder->tail = iobuf;
         }
 
-        ptr = holder->stub->args.writev.vector[0].iov_base + holder->write_size;
+        last = &holder->stub->args.writev.vector[count - 1];
 
-        iov_unload (ptr, req->stub->args.writev.vector,
-                    req->stub->args.writev.count);
+        iov_unload ((char *)last->iov_base + last->iov_len,
+                    req->stub->args.writev.vector, extra);
 
-        holder->stub->args.writev.vector[0].iov_len += req->write_size;
+        last->iov_len += req->write_size;
+
+done:
         holder->write_size += req->write_size;
         holder->ordering.size += req->write_size;
+        __wb_lie_reindex (holder->wb_inode, holder);
 
         ret = 0;
 out:
@@ -923,7 +1064,6 @@ __wb_preprocess_winds (wb_inode_t *wb_inode)
 	wb_request_t *holder          = NULL;
 	wb_conf_t    *conf            = NULL;
         int           ret             = 0;
-	size_t        page_size       = 0;
 
 	/* With asynchronous IO from a VM guest (as a file), there
 	   can be two sequential writes happening in two regions
@@ -934,7 +1074,6 @@ __wb_preprocess_winds (wb_inode_t *wb_inode)
 	   through the interleaved ops
 	*/
 
-	page_size = wb_inode->this->ctx->page_size;
 	conf = wb_inode->this->private;
 
         list_for_each_entry_safe (req, tmp, &wb_inode->todo, todo) {
@@ -968,7 +1107,9 @@ __wb_preprocess_winds (wb_inode_t *wb_inode)
 			continue;
 		}
 
-		space_left = page_size - holder->write_size;
+		space_left = 0;
+		if (holder->write_size < conf->aggregate_size)
+			space_left = conf->aggregate_size - holder->write_size;
 
 		if (space_left < req->write_size) {
 			holder->ordering.go = 1;
@@ -976,9 +1117,12 @@ __wb_preprocess_winds (wb_inode_t *wb_inode)
 			continue;
 		}
 
-		ret = __wb_collapse_small_writes (holder, req);
-		if (ret)
+		ret = __wb_collapse_small_writes (conf, holder, req);
+		if (ret) {
+			holder->ordering.go = 1;
+			holder = req;
 			continue;
+		}
 
 		/* collapsed request is as good as wound
 		   (from its p.o.v)
@@ -1182,17 +1326,131 @@ wb_readv_helper (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 }
 
 
+struct wb_read_probe {
+	wb_request_t *lie;
+	int           count;
+};
+
+
+static int
+wb_lie_probe (struct itree_node *node, void *data)
+{
+	struct wb_read_probe *probe = data;
+
+	probe->lie = itree_entry (node, wb_request_t, lie_node);
+
+	/* more than one liability over the range, let the read wait */
+	return (++probe->count > 1);
+}
+
+
+/* A read falling entirely within a single lied write is answered from the
+   buffer of that write, provided nothing else queued modifies the range.
+   Otherwise the read has to wait in the todo list till every overlapping
+   liability is fulfilled.
+*/
+static int
+__wb_readv_from_liability (wb_inode_t *wb_inode, off_t offset, size_t size,
+			   struct iovec **vector, int *count,
+			   struct iobref **iobref)
+{
+	struct wb_read_probe  probe = {0, };
+	wb_request_t         *lie   = NULL;
+	wb_request_t         *each  = NULL;
+	uint64_t              end   = 0;
+	uint64_t              each_end = 0;
+	off_t                 src   = 0;
+	int                   ret   = -1;
+
+	if (!size || itree_empty (&wb_inode->lies))
+		goto out;
+
+	end = offset + size - 1;
+
+	if (itree_foreach_overlap (&wb_inode->lies, offset, end,
+				   wb_lie_probe, &probe) || !probe.lie)
+		goto out;
+
+	lie = probe.lie;
+
+	if ((lie->fop != GF_FOP_WRITE) || lie->ordering.append ||
+	    !lie->stub->args.writev.iobref ||
+	    (lie->ordering.off > offset) ||
+	    (lie->ordering.off + lie->ordering.size < offset + size))
+		goto out;
+
+	list_for_each_entry (each, &wb_inode->todo, todo) {
+		if ((each == lie) || ((each->fop != GF_FOP_WRITE) &&
+				      (each->fop != GF_FOP_TRUNCATE) &&
+				      (each->fop != GF_FOP_FTRUNCATE)))
+			continue;
+
+		if (each->ordering.append)
+			goto out;
+
+		each_end = ULLONG_MAX;
+		if (each->ordering.size)
+			each_end = each->ordering.off + each->ordering.size - 1;
+
+		if ((each_end >= offset) && (end >= each->ordering.off))
+			goto out;
+	}
+
+	src = offset - lie->ordering.off;
+
+	*count = iov_subset (lie->stub->args.writev.vector,
+			     lie->stub->args.writev.count, src, src + size,
+			     NULL);
+
+	*vector = GF_CALLOC (*count, sizeof (struct iovec), gf_wb_mt_iovec);
+	if (!*vector)
+		goto out;
+
+	*count = iov_subset (lie->stub->args.writev.vector,
+			     lie->stub->args.writev.count, src, src + size,
+			     *vector);
+
+	*iobref = iobref_ref (lie->stub->args.writev.iobref);
+
+	wb_inode->cached_reads++;
+
+	ret = 0;
+out:
+	return ret;
+}
+
+
 int
 wb_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
           off_t offset, uint32_t flags, dict_t *xdata)
 {
-        wb_inode_t   *wb_inode     = NULL;
-        call_stub_t  *stub         = NULL;
+        wb_inode_t    *wb_inode     = NULL;
+        call_stub_t   *stub         = NULL;
+        struct iovec  *vector       = NULL;
+        struct iobref *iobref       = NULL;
+        struct iatt    buf          = {0, };
+        int            count        = 0;
+        int            ret          = -1;
 
         wb_inode = wb_inode_ctx_get (this, fd->inode);
 	if (!wb_inode)
 		goto noqueue;
 
+        LOCK (&wb_inode->lock);
+        {
+                ret = __wb_readv_from_liability (wb_inode, offset, size,
+                                                 &vector, &count, &iobref);
+        }
+        UNLOCK (&wb_inode->lock);
+
+        if (!ret) {
+                STACK_UNWIND_STRICT (readv, frame, size, 0, vector, count,
+                                     &buf, iobref, NULL);
+                GF_FREE (vector);
+                iobref_unref (iobref);
+                return 0;
+        }
+
 	stub = fop_readv_stub (frame, wb_readv_helper, fd, size,
 			       offset, flags, xdata);
 	if (!stub)
@@ -1671,7 +1929,7 @@ wb_priv_dump (xlator_t *this)
 
         gf_proc_dump_add_section (key_prefix);
 
-        gf_proc_dump_write ("aggregate_size", "%d", conf->aggregate_size);
+        gf_proc_dump_write ("aggregate_size", "%"PRIu64, conf->aggregate_size);
         gf_proc_dump_write ("window_size", "%d", conf->window_size);
         gf_proc_dump_write ("flush_behind", "%d", conf->flush_behind);
         gf_proc_dump_write ("trickling_writes", "%d", conf->trickling_writes);
@@ -1773,6 +2031,12 @@ wb_inode_dump (xlator_t *this, inode_t *inode)
         ret = TRY_LOCK (&wb_inode->lock);
         if (!ret)
         {
+                gf_proc_dump_write ("liabilities", "%"PRIu64,
+                                    wb_inode->lies.count);
+
+                gf_proc_dump_write ("cached_reads", "%"PRIu64,
+                                    wb_inode->cached_reads);
+
                 if (!list_empty (&wb_inode->all)) {
                         __wb_dump_requests (&wb_inode->all, key_prefix);
                 }
@@ -1821,6 +2085,17 @@ reconfigure (xlator_t *this, dict_t *options)
 
         GF_OPTION_RECONF ("cache-size", conf->window_size, options, size, out);
 
+        GF_OPTION_RECONF ("aggregate-size", conf->aggregate_size, options,
+                          size, out);
+
+        if (conf->window_size < conf->aggregate_size) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "aggregate-size(%"PRIu64") cannot be more than "
+                        "window-size(%"PRIu64"), using window-size",
+                        conf->aggregate_size, conf->window_size);
+                conf->aggregate_size = conf->window_size;
+        }
+
         GF_OPTION_RECONF ("flush-behind", conf->flush_behind, options, bool,
                           out);
 
@@ -1863,7 +2138,7 @@ init (xlator_t *this)
         }
 
         /* configure 'options aggregate-size <size>' */
-        conf->aggregate_size = WB_AGGREGATE_SIZE;
+        GF_OPTION_INIT ("aggregate-size", conf->aggregate_size, size, out);
 
         /* configure 'option window-size <size>' */
         GF_OPTION_INIT ("cache-size", conf->window_size, size, out);
@@ -1968,6 +2243,14 @@ struct volume_options options[] = {
           .description = "Size of the write-behind buffer for a single file "
                          "(inode)."
         },
+        { .key  = {"aggregate-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 4 * GF_UNIT_KB,
+          .max  = 1 * GF_UNIT_MB,
+          .default_value = "128KB",
+          .description = "Largest write sent down after contiguous writes "
+                         "are aggregated. Cannot be more than cache-size."
+        },
         { .key = {"trickling-writes"},
           .type = GF_OPTION_TYPE_BOOL,
           .default_value = "on",
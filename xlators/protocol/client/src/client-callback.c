@@ -15,6 +15,7 @@
 
 #include "client.h"
 #include "rpc-clnt.h"
+#include "upcall-utils.h"
 
 int
 client_cbk_null (struct rpc_clnt *rpc, void *mydata, void *data)
@@ -40,10 +41,56 @@ client_cbk_ino_flush (struct rpc_clnt *rpc, void *mydata, void *data)
         return 0;
 }
 
+/* A brick tells us the inode was changed by another client: drop what the
+   caches of this graph hold for it, up to the kernel. */
+int
+client_cbk_cache_invalidation (struct rpc_clnt *rpc, void *mydata, void *data)
+{
+        gfs3_cbk_cache_invalidation_req  req      = {{0,},};
+        xlator_t                        *this     = NULL;
+        xlator_t                        *top      = NULL;
+        inode_t                         *inode    = NULL;
+        struct iovec                    *iov      = NULL;
+        int                              ret      = -1;
+
+        this = mydata;
+        iov = data;
+
+        THIS = this;
+
+        ret = xdr_to_generic (*iov, &req, (xdrproc_t)
+                              xdr_gfs3_cbk_cache_invalidation_req);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "failed to decode cache invalidation");
+                goto out;
+        }
+
+        top = this->graph ? this->graph->top : NULL;
+        if (!top || !top->itable)
+                goto out;
+
+        inode = inode_find (top->itable, (unsigned char *) req.gfid);
+        if (!inode)
+                goto out;
+
+        gf_log (this->name, GF_LOG_TRACE, "invalidating %s (flags 0x%x)",
+                uuid_utoa (inode->gfid), req.flags);
+
+        inode_invalidate (inode);
+
+        inode_unref (inode);
+out:
+        return 0;
+}
+
 rpcclnt_cb_actor_t gluster_cbk_actors[] = {
         [GF_CBK_NULL]      = {"NULL",      GF_CBK_NULL,      client_cbk_null },
         [GF_CBK_FETCHSPEC] = {"FETCHSPEC", GF_CBK_FETCHSPEC, client_cbk_fetchspec },
         [GF_CBK_INO_FLUSH] = {"INO_FLUSH", GF_CBK_INO_FLUSH, client_cbk_ino_flush },
+        [GF_CBK_CACHE_INVALIDATION] = {"CACHE_INVALIDATION",
+                                       GF_CBK_CACHE_INVALIDATION,
+                                       client_cbk_cache_invalidation },
 };
 
 
@@ -19,6 +19,7 @@
 #include "defaults.h"
 #include "glusterfs.h"
 #include "statedump.h"
+#include "event.h"
 #include "compat-errno.h"
 
 #include "glusterfs3.h"
@@ -2386,6 +2387,13 @@ reconfigure (xlator_t *this, dict_t *options)
         if (ret)
                 goto out;
 
+        GF_OPTION_RECONF ("event-threads", conf->event_threads, options,
+                          int32, out);
+        ret = event_reconfigure_threads (this->ctx->event_pool,
+                                         conf->event_threads);
+        if (ret)
+                goto out;
+
         ret = 0;
 out:
 	return ret;
@@ -2427,6 +2435,12 @@ init (xlator_t *this)
         if (ret)
                 goto out;
 
+        GF_OPTION_INIT ("event-threads", conf->event_threads, int32, out);
+        ret = event_reconfigure_threads (this->ctx->event_pool,
+                                         conf->event_threads);
+        if (ret)
+                goto out;
+
         LOCK_INIT (&conf->rec_lock);
 
         conf->last_sent_event = -1; /* To start with we don't have any events */
@@ -2717,5 +2731,13 @@ struct volume_options options[] = {
          .min  = GF_MIN_SOCKET_WINDOW_SIZE,
          .max  = GF_MAX_SOCKET_WINDOW_SIZE
         },
+        { .key   = {"event-threads"},
+          .type  = GF_OPTION_TYPE_INT,
+          .min   = 1,
+          .max   = EVENT_MAX_THREADS,
+          .default_value = "1",
+          .description = "Number of threads dispatching network events "
+                         "(socket reads and writes) in the client process."
+        },
         { .key   = {NULL} },
 };
@@ -114,6 +114,7 @@ typedef struct clnt_conf {
 						   the reconnection happen after
 						   the usual 3-second wait
 						*/
+        int32_t                event_threads; /* epoll dispatchers */
 } clnt_conf_t;
 
 typedef struct _client_fd_ctx {
@@ -617,6 +617,11 @@ server_connection_destroy (xlator_t *this, server_connection_t *conn)
 
                 if (fdtable)
                         gf_fd_fdtable_destroy (fdtable);
+
+                /* let the translators which remember clients by their
+                   frame->root->trans forget this one, before the address
+                   can be reused */
+                xlator_notify (bound_xl, GF_EVENT_CLIENT_DESTROY, conn);
         }
 
         gf_log (this->name, GF_LOG_INFO, "destroyed connection of %s",
@@ -30,6 +30,7 @@
 #include "glusterfs3-xdr.h"
 #include "glusterfs3.h"
 #include "compat-errno.h"
+#include "checksum.h"
 
 #include "xdr-nfs3.h"
 
@@ -1497,6 +1498,8 @@ server_rchecksum_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         gfs3_rchecksum_rsp  rsp = {0,};
         rpcsvc_request_t   *req = NULL;
         server_state_t      *state = NULL;
+        char               *type_name = NULL;
+        int                 type = GF_RSYNC_STRONG_MD5;
 
         req = frame->local;
         state = CALL_STATE(frame);
@@ -1514,8 +1517,18 @@ server_rchecksum_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         rsp.weak_checksum = weak_checksum;
 
+        /* the digest length follows the type the child computed */
+        if (xdata && !dict_get_str (xdata, GF_RCHECKSUM_TYPE_KEY, &type_name))
+                type = gf_rsync_strong_type_from_name (type_name);
+        if (type < 0) {
+                op_ret   = -1;
+                op_errno = ENOTSUP;
+                goto out;
+        }
+
         rsp.strong_checksum.strong_checksum_val = (char *)strong_checksum;
-        rsp.strong_checksum.strong_checksum_len = MD5_DIGEST_LENGTH;
+        rsp.strong_checksum.strong_checksum_len =
+                gf_rsync_strong_checksum_len (type);
 
 out:
         rsp.op_ret    = op_ret;
@@ -32,9 +32,19 @@
 #include "glusterfs3-xdr.h"
 #include "call-stub.h"
 #include "statedump.h"
+#include "event.h"
 #include "defaults.h"
 #include "authenticate.h"
 #include "rpcsvc.h"
+#include "upcall-utils.h"
+
+#define SERVER_UPCALL_XPRTS 8
+
+rpcsvc_cbk_program_t server_cbk_prog = {
+        .progname  = "Gluster Callback",
+        .prognum   = GLUSTER_CBK_PROGRAM,
+        .progver   = GLUSTER_CBK_VERSION,
+};
 
 void
 grace_time_handler (void *data)
@@ -996,6 +1006,13 @@ reconfigure (xlator_t *this, dict_t *options)
                 }
         }
         ret = server_init_grace_timer (this, options, conf);
+        if (ret)
+                goto out;
+
+        GF_OPTION_RECONF ("event-threads", conf->event_threads, options,
+                          int32, out);
+        ret = event_reconfigure_threads (this->ctx->event_pool,
+                                         conf->event_threads);
 
 out:
         gf_log ("", GF_LOG_DEBUG, "returning %d", ret);
@@ -1040,6 +1057,12 @@ init (xlator_t *this)
         if (ret)
                 goto out;
 
+        GF_OPTION_INIT ("event-threads", conf->event_threads, int32, out);
+        ret = event_reconfigure_threads (this->ctx->event_pool,
+                                         conf->event_threads);
+        if (ret)
+                goto out;
+
         ret = dict_get_str (this->options, "config-directory", &conf->conf_dir);
         if (ret)
                 conf->conf_dir = CONFDIR;
@@ -1199,11 +1222,88 @@ fini (xlator_t *this)
         return;
 }
 
+/* Send the cache invalidation of features/upcall to the transports of the
+ * connection it is meant for. The transports are picked under conf->mutex
+ * and written to outside of it.
+ */
+int
+server_process_event_upcall (xlator_t *this, void *data)
+{
+        struct gf_upcall                 *upcall = NULL;
+        server_conf_t                    *conf   = NULL;
+        rpc_transport_t                  *xprt   = NULL;
+        rpc_transport_t                  *xprts[SERVER_UPCALL_XPRTS] = {0,};
+        gfs3_cbk_cache_invalidation_req   req    = {{0,},};
+        struct iovec                      iov    = {0,};
+        struct iobuf                     *iob    = NULL;
+        ssize_t                           len    = 0;
+        int                               count  = 0;
+        int                               i      = 0;
+        int                               ret    = -1;
+
+        upcall = data;
+        conf = this->private;
+
+        GF_VALIDATE_OR_GOTO (this->name, upcall, out);
+        GF_VALIDATE_OR_GOTO (this->name, conf, out);
+
+        memcpy (req.gfid, upcall->gfid, sizeof (req.gfid));
+        req.flags = upcall->flags;
+
+        len = xdr_sizeof ((xdrproc_t) xdr_gfs3_cbk_cache_invalidation_req,
+                          &req);
+        iob = iobuf_get2 (this->ctx->iobuf_pool, len);
+        if (!iob)
+                goto out;
+
+        iobuf_to_iovec (iob, &iov);
+        len = xdr_serialize_generic (iov, &req, (xdrproc_t)
+                                     xdr_gfs3_cbk_cache_invalidation_req);
+        if (len < 0)
+                goto out;
+        iov.iov_len = len;
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                list_for_each_entry (xprt, &conf->xprt_list, list) {
+                        if (xprt->xl_private != upcall->client)
+                                continue;
+                        xprts[count++] = rpc_transport_ref (xprt);
+                        if (count == SERVER_UPCALL_XPRTS)
+                                break;
+                }
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
+        ret = 0;
+        for (i = 0; i < count; i++) {
+                if (rpcsvc_callback_submit (conf->rpc, xprts[i],
+                                            &server_cbk_prog,
+                                            GF_CBK_CACHE_INVALIDATION,
+                                            &iov, 1))
+                        ret = -1;
+                rpc_transport_unref (xprts[i]);
+        }
+
+        if (ret)
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "failed to send cache invalidation of %s",
+                        uuid_utoa (upcall->gfid));
+out:
+        if (iob)
+                iobuf_unref (iob);
+        return ret;
+}
+
+
 int
 notify (xlator_t *this, int32_t event, void *data, ...)
 {
         int          ret = 0;
         switch (event) {
+        case GF_EVENT_UPCALL:
+                ret = server_process_event_upcall (this, data);
+                break;
         default:
                 default_notify (this, event, data);
                 break;
@@ -1287,6 +1387,14 @@ struct volume_options options[] = {
          .min  = GF_MIN_SOCKET_WINDOW_SIZE,
          .max  = GF_MAX_SOCKET_WINDOW_SIZE
         },
+        { .key   = {"event-threads"},
+          .type  = GF_OPTION_TYPE_INT,
+          .min   = 1,
+          .max   = EVENT_MAX_THREADS,
+          .default_value = "1",
+          .description = "Number of threads dispatching network events "
+                         "(socket reads and writes) in the brick process."
+        },
 
         /*  The following two options are defined in addr.c, redifined here *
          * for the sake of validation during volume set from cli            */
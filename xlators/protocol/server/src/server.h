@@ -116,6 +116,7 @@ struct server_conf {
         pthread_mutex_t         mutex;
         struct list_head        conns;
         struct list_head        xprt_list;
+        int32_t                 event_threads; /* epoll dispatchers */
 };
 typedef struct server_conf server_conf_t;
 
@@ -2711,6 +2711,49 @@ out:
 }
 
 
+/* Answers GF_SEEK_DATA_KEY".<offset>" with the first extent of data at or
+ * after <offset> as "<start>:<end>", end being the start of the next hole.
+ * Fails with ENXIO when only a hole is left after <offset>. */
+static ssize_t
+posix_fd_seek_data (int fd, const char *name, dict_t *dict)
+{
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+        int64_t  offset = 0;
+        off_t    start  = 0;
+        off_t    end    = 0;
+        char    *value  = NULL;
+        int      ret    = 0;
+
+        if (name[strlen (GF_SEEK_DATA_KEY)] != '.' ||
+            gf_string2int64 (name + strlen (GF_SEEK_DATA_KEY) + 1, &offset))
+                return -EINVAL;
+
+        start = lseek (fd, offset, SEEK_DATA);
+        if (start == -1)
+                return -errno;
+
+        end = lseek (fd, start, SEEK_HOLE);
+        if (end == -1)
+                return -errno;
+
+        ret = gf_asprintf (&value, "%"PRId64":%"PRId64, (int64_t) start,
+                           (int64_t) end);
+        if (ret < 0)
+                return -ENOMEM;
+
+        ret = dict_set_dynstr (dict, (char *)name, value);
+        if (ret) {
+                GF_FREE (value);
+                return -ENOMEM;
+        }
+
+        return strlen (value);
+#else
+        return -ENOTSUP;
+#endif
+}
+
+
 int32_t
 posix_fgetxattr (call_frame_t *frame, xlator_t *this,
                  fd_t *fd, const char *name, dict_t *xdata)
@@ -2761,6 +2804,16 @@ posix_fgetxattr (call_frame_t *frame, xlator_t *this,
                 goto done;
         }
 
+        if (name && !strncmp (name, GF_SEEK_DATA_KEY,
+                              strlen (GF_SEEK_DATA_KEY))) {
+                size = posix_fd_seek_data (_fd, name, dict);
+                if (size < 0) {
+                        op_errno = -size;
+                        size = -1;
+                }
+                goto done;
+        }
+
         if (name) {
                 strcpy (key, name);
 
@@ -3895,15 +3948,18 @@ posix_rchecksum (call_frame_t *frame, xlator_t *this,
         int                     op_errno        = 0;
         int                     ret             = 0;
         int32_t                 weak_checksum   = 0;
-        unsigned char           strong_checksum[MD5_DIGEST_LENGTH] = {0};
+        unsigned char           strong_checksum[GF_RSYNC_STRONG_CHECKSUM_MAXLEN] = {0};
         struct posix_private    *priv           = NULL;
+        char                    *type_name      = NULL;
+        int                     type            = GF_RSYNC_STRONG_MD5;
+        dict_t                  *rsp_xdata      = NULL;
 
         VALIDATE_OR_GOTO (frame, out);
         VALIDATE_OR_GOTO (this, out);
         VALIDATE_OR_GOTO (fd, out);
 
         priv = this->private;
-        memset (strong_checksum, 0, MD5_DIGEST_LENGTH);
+        memset (strong_checksum, 0, sizeof (strong_checksum));
 
         alloc_buf = _page_aligned_alloc (len, &buf);
         if (!alloc_buf) {
@@ -3941,15 +3997,36 @@ posix_rchecksum (call_frame_t *frame, xlator_t *this,
         if (ret < 0)
                 goto out;
 
+        /* callers that know other strong checksums ask for one; the
+           reply names the type used, its absence means MD5 */
+        if (xdata && !dict_get_str (xdata, GF_RCHECKSUM_TYPE_KEY,
+                                    &type_name)) {
+                type = gf_rsync_strong_type_from_name (type_name);
+                if (type < 0)
+                        type = GF_RSYNC_STRONG_MD5;
+
+                rsp_xdata = dict_new ();
+                if (!rsp_xdata ||
+                    dict_set_str (rsp_xdata, GF_RCHECKSUM_TYPE_KEY,
+                                  (char *) gf_rsync_strong_type_name (type))) {
+                        op_errno = ENOMEM;
+                        goto out;
+                }
+        }
+
         weak_checksum = gf_rsync_weak_checksum ((unsigned char *) buf, (size_t) len);
-        gf_rsync_strong_checksum ((unsigned char *) buf, (size_t) len, (unsigned char *) strong_checksum);
+        gf_rsync_strong_checksum_by_type (type, (unsigned char *) buf,
+                                          (size_t) len,
+                                          (unsigned char *) strong_checksum);
 
         op_ret = 0;
 out:
         STACK_UNWIND_STRICT (rchecksum, frame, op_ret, op_errno,
-                             weak_checksum, strong_checksum, NULL);
+                             weak_checksum, strong_checksum, rsp_xdata);
 
         GF_FREE (alloc_buf);
+        if (rsp_xdata)
+                dict_unref (rsp_xdata);
 
         return 0;
 }